@@ -0,0 +1,80 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+
+#include "leveldb/env.h"
+#include "util/crc32c.h"
+#include "util/random.h"
+
+// Measures the throughput of crc32c::Extend(), which uses CRC32C
+// instructions when the CPU has them, against the portable
+// implementation, for a range of buffer sizes.
+//
+//   --bytes=<n>      -- total bytes to checksum per size (default 1G)
+//   --max_size=<n>   -- largest buffer size to try (default 4M)
+static int FLAGS_bytes = 1 << 30;
+static int FLAGS_max_size = 4 << 20;
+
+namespace leveldb {
+namespace {
+
+typedef uint32_t (*ExtendFunction)(uint32_t, const char*, size_t);
+
+// Returns the throughput of "extend" over buffers of "size" bytes, in MB/s.
+double Measure(ExtendFunction extend, const std::string& data, size_t size) {
+  Env* env = Env::Default();
+  const int iterations = std::max<int>(1, FLAGS_bytes / size);
+  uint32_t crc = 0;
+  const uint64_t start = env->NowMicros();
+  for (int i = 0; i < iterations; i++) {
+    crc = extend(crc, data.data(), size);
+  }
+  const uint64_t micros = std::max<uint64_t>(1, env->NowMicros() - start);
+  // Print the checksum so the loop cannot be optimized away.
+  fprintf(stderr, "%08x\r", crc);
+  return (static_cast<double>(size) * iterations / 1048576.0) /
+         (micros * 1e-6);
+}
+
+void Run() {
+  Random rnd(301);
+  std::string data(FLAGS_max_size, '\0');
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<char>(rnd.Uniform(256));
+  }
+
+  fprintf(stdout, "%10s %14s %14s\n", "size", "Extend MB/s", "portable MB/s");
+  for (size_t size = 64; size <= data.size(); size *= 4) {
+    const double fast = Measure(&crc32c::Extend, data, size);
+    const double portable = Measure(&crc32c::ExtendPortable, data, size);
+    fprintf(stdout, "%10d %14.1f %14.1f\n", static_cast<int>(size), fast,
+            portable);
+  }
+}
+
+}  // namespace
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    int n;
+    char junk;
+    if (sscanf(argv[i], "--bytes=%d%c", &n, &junk) == 1 && n > 0) {
+      FLAGS_bytes = n;
+    } else if (sscanf(argv[i], "--max_size=%d%c", &n, &junk) == 1 && n >= 64) {
+      FLAGS_max_size = n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      exit(1);
+    }
+  }
+
+  leveldb::Run();
+  return 0;
+}
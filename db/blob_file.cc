@@ -0,0 +1,82 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file.h"
+
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+void BlobIndex::EncodeTo(std::string* dst) const {
+  PutVarint64(dst, file_number);
+  PutVarint64(dst, offset);
+  PutVarint64(dst, size);
+}
+
+bool BlobIndex::DecodeFrom(Slice input) {
+  return GetVarint64(&input, &file_number) && GetVarint64(&input, &offset) &&
+         GetVarint64(&input, &size) && input.empty();
+}
+
+BlobFileBuilder::BlobFileBuilder(WritableFile* file, uint64_t number)
+    : file_(file), number_(number), offset_(0), num_entries_(0) {}
+
+Status BlobFileBuilder::Add(const Slice& user_key, const Slice& value,
+                            std::string* index) {
+  record_.assign(4, '\0');  // Checksum, filled in below
+  PutVarint32(&record_, user_key.size());
+  PutVarint32(&record_, value.size());
+  record_.append(user_key.data(), user_key.size());
+  record_.append(value.data(), value.size());
+  const uint32_t crc =
+      crc32c::Value(record_.data() + 4, record_.size() - 4);
+  EncodeFixed32(&record_[0], crc32c::Mask(crc));
+
+  Status s = file_->Append(record_);
+  if (s.ok()) {
+    BlobIndex handle;
+    handle.file_number = number_;
+    handle.offset = offset_;
+    handle.size = record_.size();
+    index->clear();
+    handle.EncodeTo(index);
+    offset_ += record_.size();
+    num_entries_++;
+  }
+  return s;
+}
+
+Status ReadBlobRecord(RandomAccessFile* file, const BlobIndex& index,
+                      bool verify_checksum, std::string* value) {
+  std::string scratch;
+  scratch.resize(index.size);
+  Slice record;
+  Status s = file->Read(index.offset, index.size, &record, &scratch[0]);
+  if (!s.ok()) {
+    return s;
+  }
+  if (record.size() != index.size || record.size() < 4) {
+    return Status::Corruption("truncated blob record");
+  }
+  if (verify_checksum) {
+    const uint32_t crc = crc32c::Unmask(DecodeFixed32(record.data()));
+    if (crc32c::Value(record.data() + 4, record.size() - 4) != crc) {
+      return Status::Corruption("blob record checksum mismatch");
+    }
+  }
+
+  Slice input(record.data() + 4, record.size() - 4);
+  uint32_t key_length, value_length;
+  if (!GetVarint32(&input, &key_length) ||
+      !GetVarint32(&input, &value_length) ||
+      input.size() != static_cast<uint64_t>(key_length) + value_length) {
+    return Status::Corruption("bad blob record");
+  }
+  value->assign(input.data() + key_length, value_length);
+  return Status::OK();
+}
+
+}  // namespace leveldb
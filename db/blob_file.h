@@ -0,0 +1,78 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// With Options::min_blob_size set, large values are separated from their
+// keys: memtable flushes append them to a blob file, and the table stores
+// the entry (key, seq, kTypeBlobIndex) whose value is a BlobIndex pointing
+// at the record.  Compactions then move the small index entries around
+// instead of the values.
+//
+// A blob file is a sequence of records:
+//     checksum: fixed32          // Masked crc32c of the rest of the record
+//     key_length: varint32
+//     value_length: varint32
+//     key: char[key_length]      // User key the value was written for
+//     value: char[value_length]
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_FILE_H_
+#define STORAGE_LEVELDB_DB_BLOB_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class RandomAccessFile;
+class WritableFile;
+
+// Location of a record in a blob file.
+struct BlobIndex {
+  BlobIndex() : file_number(0), offset(0), size(0) {}
+
+  void EncodeTo(std::string* dst) const;
+  bool DecodeFrom(Slice input);
+
+  uint64_t file_number;
+  uint64_t offset;  // Of the record in the file
+  uint64_t size;    // Of the whole record
+};
+
+// Appends records to a new blob file.
+class BlobFileBuilder {
+ public:
+  // Create a builder that will store the records of blob file "number" in
+  // "*file".  Does not close the file.
+  BlobFileBuilder(WritableFile* file, uint64_t number);
+
+  BlobFileBuilder(const BlobFileBuilder&) = delete;
+  BlobFileBuilder& operator=(const BlobFileBuilder&) = delete;
+
+  // Append a record of "value" written for "user_key", and store its
+  // encoded BlobIndex in *index.
+  Status Add(const Slice& user_key, const Slice& value, std::string* index);
+
+  // Number of records and bytes added so far.
+  uint64_t NumEntries() const { return num_entries_; }
+  uint64_t FileSize() const { return offset_; }
+
+ private:
+  WritableFile* const file_;
+  const uint64_t number_;
+  uint64_t offset_;
+  uint64_t num_entries_;
+  std::string record_;  // Scratch space for the record being added
+};
+
+// Read the record "index" points at from "file", and store its value in
+// *value.
+Status ReadBlobRecord(RandomAccessFile* file, const BlobIndex& index,
+                      bool verify_checksum, std::string* value);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_FILE_H_
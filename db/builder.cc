@@ -4,8 +4,10 @@
 
 #include "db/builder.h"
 
+#include "db/blob_file.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "leveldb/db.h"
@@ -15,37 +17,123 @@
 namespace leveldb {
 
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+                  TableCache* table_cache, Iterator* iter,
+                  Iterator* range_del_iter, FileMetaData* meta,
+                  BlobFileMetaData* blob) {
   Status s;
   meta->file_size = 0;
+  meta->has_range_tombstones = false;
+  const bool separate_values = blob != nullptr && options.min_blob_size > 0;
+  if (blob != nullptr) {
+    blob->total_bytes = 0;
+  }
+  WritableFile* blob_file = nullptr;
+  BlobFileBuilder* blob_builder = nullptr;
+  bool has_blob_file = false;
   iter->SeekToFirst();
+  if (range_del_iter != nullptr) {
+    range_del_iter->SeekToFirst();
+  }
+  const bool has_range_dels =
+      range_del_iter != nullptr && range_del_iter->Valid();
 
   std::string fname = TableFileName(dbname, meta->number);
-  if (iter->Valid()) {
+  if (iter->Valid() || has_range_dels) {
     WritableFile* file;
-    s = env->NewWritableFile(fname, &file);
+    if (options.use_direct_io_for_flush_and_compaction) {
+      s = env->NewDirectWritableFile(fname, &file);
+    } else {
+      s = env->NewWritableFile(fname, &file);
+    }
     if (!s.ok()) {
       return s;
     }
 
     // 将memtabe中的记录，逐条写入sstable。
     TableBuilder* builder = new TableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
+    bool has_bounds = iter->Valid();
+    if (has_bounds) {
+      meta->smallest.DecodeFrom(iter->key());
+    }
+    std::string blob_index;
     for (; iter->Valid(); iter->Next()) {
       Slice key = iter->key();
       meta->largest.DecodeFrom(key);
-      builder->Add(key, iter->value());
+      Slice value = iter->value();
+      ParsedInternalKey ikey;
+      if (separate_values && value.size() >= options.min_blob_size &&
+          ParseInternalKey(key, &ikey) && ikey.type == kTypeValue) {
+        // Store the value in the blob file, and a reference to it here.
+        if (blob_builder == nullptr) {
+          const std::string blob_fname = BlobFileName(dbname, blob->number);
+          s = options.use_direct_io_for_flush_and_compaction
+                  ? env->NewDirectWritableFile(blob_fname, &blob_file)
+                  : env->NewWritableFile(blob_fname, &blob_file);
+          if (!s.ok()) {
+            break;
+          }
+          blob_builder = new BlobFileBuilder(blob_file, blob->number);
+          has_blob_file = true;
+        }
+        s = blob_builder->Add(ikey.user_key, value, &blob_index);
+        if (!s.ok()) {
+          break;
+        }
+        builder->Add(InternalKey(ikey.user_key, ikey.sequence, kTypeBlobIndex)
+                         .Encode(),
+                     blob_index);
+      } else {
+        builder->Add(key, value);
+      }
+    }
+
+    // Range tombstones go to their own block, and widen the key range of
+    // the table to the keys they delete.
+    const InternalKeyComparator* icmp =
+        static_cast<const InternalKeyComparator*>(options.comparator);
+    for (; s.ok() && has_range_dels && range_del_iter->Valid();
+         range_del_iter->Next()) {
+      ParsedInternalKey ikey;
+      if (!ParseInternalKey(range_del_iter->key(), &ikey)) {
+        s = Status::Corruption("corrupted range tombstone");
+        break;
+      }
+      builder->AddRangeTombstone(range_del_iter->key(),
+                                 range_del_iter->value());
+      ExtendKeyRange(*icmp,
+                     RangeTombstone(ikey.user_key, range_del_iter->value(),
+                                    ikey.sequence),
+                     &has_bounds, &meta->smallest, &meta->largest);
     }
+    meta->has_range_tombstones = has_range_dels;
 
     // Finish and check for builder errors
-    s = builder->Finish();
+    if (s.ok()) {
+      s = builder->Finish();
+    } else {
+      builder->Abandon();
+    }
     if (s.ok()) {
       meta->file_size = builder->FileSize();
       assert(meta->file_size > 0);
     }
     delete builder;
 
-    // Finish and check for file errors
+    // Finish and check for file errors.  The blob file goes first, so that
+    // the table never refers to values that did not make it to disk.
+    if (blob_builder != nullptr) {
+      if (s.ok()) {
+        s = blob_file->Sync();
+      }
+      if (s.ok()) {
+        s = blob_file->Close();
+      }
+      if (s.ok()) {
+        blob->total_bytes = blob_builder->FileSize();
+      }
+      delete blob_builder;
+      delete blob_file;
+    }
     if (s.ok()) {
       s = file->Sync();
     }
@@ -68,11 +156,18 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
   if (!iter->status().ok()) {
     s = iter->status();
   }
+  if (range_del_iter != nullptr && !range_del_iter->status().ok()) {
+    s = range_del_iter->status();
+  }
 
   if (s.ok() && meta->file_size > 0) {
     // Keep it
   } else {
     env->DeleteFile(fname);
+    if (has_blob_file) {
+      env->DeleteFile(BlobFileName(dbname, blob->number));
+      blob->total_bytes = 0;
+    }
   }
   return s;
 }
@@ -10,6 +10,7 @@
 namespace leveldb {
 
 struct Options;
+struct BlobFileMetaData;
 struct FileMetaData;
 
 class Env;
@@ -17,13 +18,21 @@ class Iterator;
 class TableCache;
 class VersionEdit;
 
-// Build a Table file from the contents of *iter.  The generated file
-// will be named according to meta->number.  On success, the rest of
+// Build a Table file from the contents of *iter, and of the range
+// tombstones yielded by *range_del_iter unless it is null.  The generated
+// file will be named according to meta->number.  On success, the rest of
 // *meta will be filled with metadata about the generated table.
-// If no data is present in *iter, meta->file_size will be set to
+// If no data is present in either iterator, meta->file_size will be set to
 // zero, and no Table file will be produced.
+//
+// If "blob" is non-null and options.min_blob_size is non-zero, large
+// values go to the blob file named according to blob->number instead, and
+// blob->total_bytes is set to its size.  It is zero if no value was large
+// enough, in which case no blob file is produced.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  TableCache* table_cache, Iterator* iter,
+                  Iterator* range_del_iter, FileMetaData* meta,
+                  BlobFileMetaData* blob = nullptr);
 
 }  // namespace leveldb
 
@@ -14,6 +14,7 @@
 #include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/pinnable_slice.h"
 #include "leveldb/status.h"
 #include "leveldb/write_batch.h"
 
@@ -31,6 +32,7 @@ using leveldb::Logger;
 using leveldb::NewBloomFilterPolicy;
 using leveldb::NewLRUCache;
 using leveldb::Options;
+using leveldb::PinnableSlice;
 using leveldb::RandomAccessFile;
 using leveldb::Range;
 using leveldb::ReadOptions;
@@ -65,6 +67,9 @@ struct leveldb_writeoptions_t {
 struct leveldb_options_t {
   Options rep;
 };
+struct leveldb_pinnableslice_t {
+  PinnableSlice rep;
+};
 struct leveldb_cache_t {
   Cache* rep;
 };
@@ -213,6 +218,31 @@ char* leveldb_get(leveldb_t* db, const leveldb_readoptions_t* options,
   return result;
 }
 
+leveldb_pinnableslice_t* leveldb_get_pinned(
+    leveldb_t* db, const leveldb_readoptions_t* options, const char* key,
+    size_t keylen, char** errptr) {
+  leveldb_pinnableslice_t* result = new leveldb_pinnableslice_t;
+  Status s = db->rep->Get(options->rep, Slice(key, keylen), &result->rep);
+  if (!s.ok()) {
+    delete result;
+    result = nullptr;
+    if (!s.IsNotFound()) {
+      SaveError(errptr, s);
+    }
+  }
+  return result;
+}
+
+const char* leveldb_pinnableslice_value(const leveldb_pinnableslice_t* slice,
+                                        size_t* vallen) {
+  *vallen = slice->rep.size();
+  return slice->rep.data();
+}
+
+void leveldb_pinnableslice_destroy(leveldb_pinnableslice_t* slice) {
+  delete slice;
+}
+
 leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db, const leveldb_readoptions_t* options) {
   leveldb_iterator_t* result = new leveldb_iterator_t;
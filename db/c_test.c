@@ -65,6 +65,24 @@ static void CheckGet(
   Free(&val);
 }
 
+static void CheckPinnedGet(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    const char* key,
+    const char* expected) {
+  char* err = NULL;
+  size_t val_len = 0;
+  const char* val = NULL;
+  leveldb_pinnableslice_t* slice;
+  slice = leveldb_get_pinned(db, options, key, strlen(key), &err);
+  CheckNoError(err);
+  if (slice != NULL) {
+    val = leveldb_pinnableslice_value(slice, &val_len);
+  }
+  CheckEqual(expected, val, val_len);
+  leveldb_pinnableslice_destroy(slice);
+}
+
 static void CheckIter(leveldb_iterator_t* iter,
                       const char* key, const char* val) {
   size_t len;
@@ -214,6 +232,8 @@ int main(int argc, char** argv) {
   StartPhase("compactall");
   leveldb_compact_range(db, NULL, 0, NULL, 0);
   CheckGet(db, roptions, "foo", "hello");
+  CheckPinnedGet(db, roptions, "foo", "hello");
+  CheckPinnedGet(db, roptions, "bar", NULL);
 
   StartPhase("compactrange");
   leveldb_compact_range(db, "a", 1, "z", 1);
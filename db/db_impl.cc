@@ -9,10 +9,15 @@
 
 #include <algorithm>
 #include <atomic>
+#include <deque>
+#include <functional>
 #include <set>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_iter.h"
 #include "db/dbformat.h"
@@ -20,11 +25,15 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/merge_context.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/merge_operator.h"
 #include "leveldb/status.h"
 #include "leveldb/table.h"
 #include "leveldb/table_builder.h"
@@ -58,6 +67,8 @@ struct DBImpl::CompactionState {
     uint64_t number;
     uint64_t file_size;
     InternalKey smallest, largest;
+    bool has_range_tombstones;
+    std::set<uint64_t> blob_files;  // Blob files its entries refer to
   };
 
   Output* current_output() { return &outputs[outputs.size() - 1]; }
@@ -65,9 +76,19 @@ struct DBImpl::CompactionState {
   explicit CompactionState(Compaction* c)
       : compaction(c),
         smallest_snapshot(0),
+        largest_snapshot(0),
         outfile(nullptr),
         builder(nullptr),
-        total_bytes(0) {}
+        total_bytes(0),
+        bottommost_output(false),
+        next_output_number(0),
+        output_number_limit(0),
+        range_dels(nullptr),
+        has_output_lower_bound(false),
+        blob_outfile(nullptr),
+        blob_builder(nullptr) {}
+
+  ~CompactionState() { delete range_dels; }
 
   Compaction* const compaction;
 
@@ -78,6 +99,10 @@ struct DBImpl::CompactionState {
   // we can drop all entries for the same key with sequence numbers < S.
   SequenceNumber smallest_snapshot;
 
+  // Entries with larger sequence numbers are invisible to every snapshot,
+  // so Options::compaction_filter may change them.  0 if there are none.
+  SequenceNumber largest_snapshot;
+
   std::vector<Output> outputs;
 
   // State kept for output being generated
@@ -85,8 +110,218 @@ struct DBImpl::CompactionState {
   TableBuilder* builder;
 
   uint64_t total_bytes;
+
+  // True if no level below the output level holds any files.
+  bool bottommost_output;
+
+  // File numbers [next_output_number, output_number_limit) reserved for
+  // the outputs of an intra-level-0 compaction.  They precede the numbers
+  // of tables flushed while it runs, which hold newer data.  Both are 0
+  // for other compactions, whose outputs take new file numbers.
+  uint64_t next_output_number;
+  uint64_t output_number_limit;
+
+  // Range tombstones of the inputs, or null if there are none.
+  RangeTombstoneList* range_dels;
+
+  // The range tombstones kept by the compaction, sorted by start key.  Each
+  // output gets the part of them between its lower bound and the first user
+  // key of the next output, so that outputs do not overlap.
+  std::vector<RangeTombstone> output_range_dels;
+  std::string output_lower_bound;  // Unset for the first output
+  bool has_output_lower_bound;
+
+  // Blob file receiving the values moved out of blob files with too much
+  // garbage.  blob_output.number is 0 until it is opened.
+  BlobFileMetaData blob_output;
+  WritableFile* blob_outfile;
+  BlobFileBuilder* blob_builder;
+
+  // Bytes of blob records that the inputs refer to and the outputs do not,
+  // by blob file number.
+  std::map<uint64_t, uint64_t> blob_garbage;
+};
+
+// Writes the memtables filled while replaying the log files to level-0
+// tables while replay goes on, on up to options_.max_recovery_flushes
+// worker threads that take them from a queue.
+class DBImpl::RecoveryFlusher {
+ public:
+  RecoveryFlusher(DBImpl* db, VersionEdit* edit)
+      : db_(db),
+        edit_(edit),
+        pending_(0),
+        live_workers_(0),
+        shutting_down_(false),
+        work_cv_(&db->mutex_),
+        done_cv_(&db->mutex_) {}
+
+  ~RecoveryFlusher() { assert(workers_.empty()); }
+
+  // Writes "mem" to a level-0 table, and unrefs it once written.
+  void Schedule(MemTable* mem) EXCLUSIVE_LOCKS_REQUIRED(db_->mutex_) {
+    db_->mutex_.AssertHeld();
+    const int max_flushes = db_->options_.max_recovery_flushes;
+    if (max_flushes <= 0) {
+      Status s = db_->WriteLevel0Table(mem, edit_, nullptr);
+      mem->Unref();
+      if (status_.ok()) status_ = s;
+      return;
+    }
+    // Bounds the memory held by memtables waiting to be written.
+    while (pending_ >= max_flushes) {
+      done_cv_.Wait();
+    }
+    if (static_cast<int>(workers_.size()) < max_flushes) {
+      live_workers_++;
+      workers_.emplace_back(&RecoveryFlusher::WorkerMain, this);
+    }
+    // Numbered here, so that level-0 tables are ordered like the
+    // memtables they were written from.
+    const uint64_t number = db_->versions_->NewFileNumber();
+    db_->pending_outputs_.insert(number);
+    queue_.push_back(std::make_pair(mem, number));
+    pending_++;
+    work_cv_.Signal();
+  }
+
+  // Returns the first error of the flushes scheduled so far.
+  Status status() const EXCLUSIVE_LOCKS_REQUIRED(db_->mutex_) {
+    return status_;
+  }
+
+  // Waits for all scheduled flushes to finish, and returns the first error.
+  Status Finish() EXCLUSIVE_LOCKS_REQUIRED(db_->mutex_) {
+    db_->mutex_.AssertHeld();
+    shutting_down_ = true;
+    work_cv_.SignalAll();
+    while (live_workers_ > 0) {
+      done_cv_.Wait();
+    }
+    // Each worker is done with the mutex once it has left live_workers_.
+    for (std::thread& worker : workers_) {
+      worker.join();
+    }
+    workers_.clear();
+    return status_;
+  }
+
+ private:
+  void WorkerMain() {
+    MutexLock l(&db_->mutex_);
+    while (true) {
+      while (queue_.empty() && !shutting_down_) {
+        work_cv_.Wait();
+      }
+      if (queue_.empty()) {
+        break;
+      }
+      MemTable* mem = queue_.front().first;
+      const uint64_t number = queue_.front().second;
+      queue_.pop_front();
+      Status s = db_->WriteLevel0Table(mem, number, edit_, nullptr);
+      mem->Unref();
+      if (status_.ok()) status_ = s;
+      pending_--;
+      done_cv_.SignalAll();
+    }
+    live_workers_--;
+    done_cv_.SignalAll();
+  }
+
+  DBImpl* const db_;
+  VersionEdit* const edit_;
+  std::vector<std::thread> workers_;
+  // Memtables to write, with their table numbers.
+  std::deque<std::pair<MemTable*, uint64_t>> queue_ GUARDED_BY(db_->mutex_);
+  int pending_ GUARDED_BY(db_->mutex_);  // Queued or being written
+  int live_workers_ GUARDED_BY(db_->mutex_);
+  bool shutting_down_ GUARDED_BY(db_->mutex_);
+  Status status_ GUARDED_BY(db_->mutex_);
+  port::CondVar work_cv_;  // Signaled when a memtable is queued
+  port::CondVar done_cv_;  // Signaled when a flush or a worker is done
 };
 
+namespace {
+
+// Reads the records of a log file in a thread of its own, ahead of the
+// thread that applies them, so that reading and checksumming the log
+// overlaps with inserting its records into memtables.
+class RecordPrefetcher {
+ public:
+  // "read" stores the next record in its argument and returns true, or
+  // returns false at the end of the log.  It is called by the prefetching
+  // thread only.
+  explicit RecordPrefetcher(std::function<bool(std::string*)> read)
+      : read_(std::move(read)),
+        cv_(&mu_),
+        queued_bytes_(0),
+        done_(false),
+        stopped_(false),
+        thread_(&RecordPrefetcher::Run, this) {}
+
+  ~RecordPrefetcher() {
+    {
+      MutexLock l(&mu_);
+      stopped_ = true;
+      cv_.SignalAll();
+    }
+    thread_.join();
+  }
+
+  // Stores the next record in *record and returns true, or returns false
+  // at the end of the log.
+  bool Next(std::string* record) {
+    MutexLock l(&mu_);
+    while (queue_.empty() && !done_) {
+      cv_.Wait();
+    }
+    if (queue_.empty()) {
+      return false;
+    }
+    record->swap(queue_.front());
+    queue_.pop_front();
+    queued_bytes_ -= record->size();
+    cv_.SignalAll();
+    return true;
+  }
+
+ private:
+  // Bound on the memory held by records read ahead.
+  static const size_t kMaxQueuedBytes = 4 << 20;
+
+  void Run() {
+    std::string record;
+    while (read_(&record)) {
+      MutexLock l(&mu_);
+      while (queued_bytes_ >= kMaxQueuedBytes && !stopped_) {
+        cv_.Wait();
+      }
+      if (stopped_) {
+        break;
+      }
+      queued_bytes_ += record.size();
+      queue_.emplace_back();
+      queue_.back().swap(record);
+      cv_.SignalAll();
+    }
+    MutexLock l(&mu_);
+    done_ = true;
+    cv_.SignalAll();
+  }
+
+  const std::function<bool(std::string*)> read_;
+  port::Mutex mu_;
+  port::CondVar cv_;
+  std::deque<std::string> queue_ GUARDED_BY(mu_);
+  size_t queued_bytes_ GUARDED_BY(mu_);
+  bool done_ GUARDED_BY(mu_);
+  bool stopped_ GUARDED_BY(mu_);
+  std::thread thread_;  // Started last, once the members above are set
+};
+
+}  // namespace
+
 // Fix user-supplied options to be reasonable
 template <class T, class V>
 static void ClipToRange(T* ptr, V minvalue, V maxvalue) {
@@ -104,6 +339,8 @@ Options SanitizeOptions(const std::string& dbname,
   ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
   ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
   ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+  ClipToRange(&result.parallel_compression_threads, 1, 64);
+  ClipToRange(&result.max_recovery_flushes, 0, 64);
   if (result.info_log == nullptr) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -125,6 +362,25 @@ static int TableCacheSize(const Options& sanitized_options) {
   return sanitized_options.max_open_files - kNumNonTableCacheFiles;
 }
 
+// Returns the options to build a table that will be placed in "level".
+// Only tables written to the bottommost non-empty level train a compression
+// dictionary: they hold most of the data and are rewritten least often, so
+// the training cost pays off the most there.
+static Options TableOptionsForLevel(const Options& options, int level,
+                                    bool bottommost) {
+  Options result = options;
+  if (!bottommost) {
+    result.zstd_max_train_bytes = 0;
+  }
+  const std::vector<CompressionType>& per_level =
+      options.compression_per_level;
+  if (!per_level.empty()) {
+    result.compression =
+        per_level[std::min<size_t>(level, per_level.size() - 1)];
+  }
+  return result;
+}
+
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
@@ -151,6 +407,11 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       log_(nullptr),
       log_hot_(nullptr),
       seed_(0),
+      log_sync_requested_signal_(&mutex_),
+      log_synced_signal_(&mutex_),
+      log_sync_requested_(0),
+      log_synced_(0),
+      log_sync_busy_(false),
       tmp_batch_(new WriteBatch),
       background_compaction_scheduled_(false),
       manual_compaction_(nullptr),
@@ -164,7 +425,11 @@ DBImpl::~DBImpl() {
   while (background_compaction_scheduled_) {
     background_work_finished_signal_.Wait();
   }
+  log_sync_requested_signal_.SignalAll();
   mutex_.Unlock();
+  if (log_sync_thread_.joinable()) {
+    log_sync_thread_.join();
+  }
 
   if (db_lock_ != nullptr) {
     env_->UnlockFile(db_lock_);
@@ -254,6 +519,21 @@ void DBImpl::DeleteObsoleteFiles() {
   std::set<uint64_t> live = pending_outputs_;
   versions_->AddLiveFiles(&live);
 
+  // Keep obsolete logs for recycling, oldest first.
+  for (auto it = retired_logs_.begin(); it != retired_logs_.end();) {
+    const uint64_t number = *it;
+    if (number >= log_number || number == prev_log_number) {
+      ++it;
+      continue;
+    }
+    if (recyclable_logs_.size() < options_.recycle_log_file_num) {
+      recyclable_logs_.push_back(number);
+    }
+    it = retired_logs_.erase(it);
+  }
+  const std::set<uint64_t> recyclable(recyclable_logs_.begin(),
+                                      recyclable_logs_.end());
+
   std::vector<std::string> filenames;
   env_->GetChildren(dbname_, &filenames);  // Ignoring errors on purpose
 
@@ -266,7 +546,8 @@ void DBImpl::DeleteObsoleteFiles() {
       bool keep = true;
       switch (type) {
         case kLogFile:
-          keep = ((number >= log_number) || (number == prev_log_number));
+          keep = ((number >= log_number) || (number == prev_log_number) ||
+                  (recyclable.find(number) != recyclable.end()));
           break;
         case kDescriptorFile:
           // Keep my manifest file, and any newer incarnations'
@@ -274,6 +555,7 @@ void DBImpl::DeleteObsoleteFiles() {
           keep = (number >= manifest_file_number);
           break;
         case kTableFile:
+        case kBlobFile:
           keep = (live.find(number) != live.end());
           break;
         case kTempFile:
@@ -289,7 +571,7 @@ void DBImpl::DeleteObsoleteFiles() {
       }
 
       if (!keep) {
-        if (type == kTableFile) {
+        if (type == kTableFile || type == kBlobFile) {
           table_cache_->Evict(number);
         }
         Log(options_.info_log, "Delete type=%d #%lld\n", static_cast<int>(type),
@@ -301,6 +583,41 @@ void DBImpl::DeleteObsoleteFiles() {
   mutex_.Lock();
 }
 
+Status DBImpl::NewLogFile(uint64_t log_number, WritableFile** file,
+                          log::Writer** writer) {
+  mutex_.AssertHeld();
+  const std::string fname = LogFileName(dbname_, log_number);
+  Status s;
+  *file = nullptr;
+  if (!recyclable_logs_.empty()) {
+    const uint64_t old_number = recyclable_logs_.front();
+    recyclable_logs_.pop_front();
+    Log(options_.info_log, "Recycling log #%llu as #%llu\n",
+        static_cast<unsigned long long>(old_number),
+        static_cast<unsigned long long>(log_number));
+    s = env_->ReuseWritableFile(fname, LogFileName(dbname_, old_number), file);
+    if (!s.ok()) {
+      Log(options_.info_log, "Recycling log failed: %s\n",
+          s.ToString().c_str());
+    }
+  }
+  if (*file == nullptr) {
+    s = env_->NewWritableFile(fname, file);
+    if (!s.ok()) {
+      return s;
+    }
+    // A log grows to about the size of the memtable it backs.
+    (*file)->Preallocate(options_.write_buffer_size +
+                         options_.write_buffer_size / 8);
+  }
+  if (options_.recycle_log_file_num > 0) {
+    *writer = new log::Writer(*file, log_number, true);
+  } else {
+    *writer = new log::Writer(*file);
+  }
+  return s;
+}
+
 Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
   mutex_.AssertHeld();
 
@@ -370,13 +687,15 @@ Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
     return Status::Corruption(buf, TableFileName(dbname_, *(expected.begin())));
   }
 
-  // Recover in the order in which the logs were generated
+  // Recover in the order in which the logs were generated.  Memtables
+  // filled by one log may still be written while the next one is replayed.
   std::sort(logs.begin(), logs.end());
+  RecoveryFlusher flusher(this, edit);
   for (size_t i = 0; i < logs.size(); i++) {
-    s = RecoverLogFile(logs[i], (i == logs.size() - 1), save_manifest, edit,
-                       &max_sequence);
+    s = RecoverLogFile(logs[i], (i == logs.size() - 1), save_manifest,
+                       &flusher, &max_sequence);
     if (!s.ok()) {
-      return s;
+      break;
     }
 
     // The previous incarnation may not have written any MANIFEST
@@ -384,6 +703,13 @@ Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
     // update the file number allocation counter in VersionSet.
     versions_->MarkFileNumberUsed(logs[i]);
   }
+  Status flush_status = flusher.Finish();
+  if (s.ok()) {
+    s = flush_status;
+  }
+  if (!s.ok()) {
+    return s;
+  }
 
   if (versions_->LastSequence() < max_sequence) {
     versions_->SetLastSequence(max_sequence);
@@ -393,7 +719,7 @@ Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
 }
 
 Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
-                              bool* save_manifest, VersionEdit* edit,
+                              bool* save_manifest, RecoveryFlusher* flusher,
                               SequenceNumber* max_sequence) {
   struct LogReporter : public log::Reader::Reporter {
     Env* env;
@@ -419,67 +745,92 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     return status;
   }
 
-  // Create the log reader.
+  // Create the log reader.  It runs in the prefetching thread, and reports
+  // corruptions to read_status until that thread is done.
+  Status read_status;
   LogReporter reporter;
   reporter.env = env_;
   reporter.info_log = options_.info_log;
   reporter.fname = fname.c_str();
-  reporter.status = (options_.paranoid_checks ? &status : nullptr);
+  reporter.status = (options_.paranoid_checks ? &read_status : nullptr);
   // We intentionally make log::Reader do checksumming even if
   // paranoid_checks==false so that corruptions cause entire commits
   // to be skipped instead of propagating bad information (like overly
   // large sequence numbers).
-  log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/);
+  log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/,
+                     log_number);
   Log(options_.info_log, "Recovering log #%llu",
       (unsigned long long)log_number);
 
-  // Read all the records and add to a memtable
-  std::string scratch;
-  Slice record;
-  WriteBatch batch;
+  // Read all the records and add to a memtable.  Nothing else uses the
+  // database while it is being recovered, except for the threads writing
+  // full memtables, so mutex_ is only held to hand those off.
   int compactions = 0;
   MemTable* mem = nullptr;
-  while (reader.ReadRecord(&record, &scratch) && status.ok()) {
-    if (record.size() < 12) {
-      reporter.Corruption(record.size(),
-                          Status::Corruption("log record too small"));
-      continue;
-    }
-    WriteBatchInternal::SetContents(&batch, record);
+  mutex_.Unlock();
+  {
+    std::string scratch;
+    RecordPrefetcher prefetcher([&](std::string* record) {
+      Slice slice;
+      while (reader.ReadRecord(&slice, &scratch) && read_status.ok()) {
+        if (slice.size() < 12) {
+          reporter.Corruption(slice.size(),
+                              Status::Corruption("log record too small"));
+          continue;
+        }
+        record->assign(slice.data(), slice.size());
+        return true;
+      }
+      return false;
+    });
 
-    if (mem == nullptr) {
-      mem = new MemTable(internal_comparator_);
-      mem->Ref();
-    }
-    status = WriteBatchInternal::InsertInto(&batch, mem);
-    MaybeIgnoreError(&status);
-    if (!status.ok()) {
-      break;
-    }
-    const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
-                                    WriteBatchInternal::Count(&batch) - 1;
-    if (last_seq > *max_sequence) {
-      *max_sequence = last_seq;
-    }
+    std::string record;
+    WriteBatch batch;
+    while (prefetcher.Next(&record)) {
+      WriteBatchInternal::SetContents(&batch, record);
 
-    if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
-      compactions++;
-      *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
-      mem->Unref();
-      mem = nullptr;
+      if (mem == nullptr) {
+        mem = new MemTable(internal_comparator_);
+        mem->Ref();
+      }
+      status = WriteBatchInternal::InsertInto(&batch, mem);
+      MaybeIgnoreError(&status);
       if (!status.ok()) {
-        // Reflect errors immediately so that conditions like full
-        // file-systems cause the DB::Open() to fail.
         break;
       }
+      const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
+                                      WriteBatchInternal::Count(&batch) - 1;
+      if (last_seq > *max_sequence) {
+        *max_sequence = last_seq;
+      }
+
+      if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
+        compactions++;
+        mutex_.Lock();
+        *save_manifest = true;
+        flusher->Schedule(mem);
+        status = flusher->status();
+        mutex_.Unlock();
+        mem = nullptr;
+        if (!status.ok()) {
+          // Reflect errors immediately so that conditions like full
+          // file-systems cause the DB::Open() to fail.
+          break;
+        }
+      }
     }
+  }  // Waits for the prefetching thread
+  mutex_.Lock();
+  if (status.ok()) {
+    status = read_status;
   }
 
   delete file;
 
-  // See if we should keep reusing the last log file.
-  if (status.ok() && options_.reuse_logs && last_log && compactions == 0) {
+  // See if we should keep reusing the last log file.  A log in recyclable
+  // format may be followed by stale data, so it is never appended to.
+  if (status.ok() && options_.reuse_logs && last_log && compactions == 0 &&
+      options_.recycle_log_file_num == 0 && !reader.IsRecycled()) {
     assert(logfile_ == nullptr);
     assert(log_ == nullptr);
     assert(mem_ == nullptr);
@@ -504,9 +855,11 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     // mem did not get reused; compact it.
     if (status.ok()) {
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      flusher->Schedule(mem);
+      status = flusher->status();
+    } else {
+      mem->Unref();
     }
-    mem->Unref();
   }
 
   return status;
@@ -515,11 +868,24 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
 Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
                                 Version* base) {
   mutex_.AssertHeld();
+  const uint64_t number = versions_->NewFileNumber();
+  pending_outputs_.insert(number);
+  return WriteLevel0Table(mem, number, edit, base);
+}
+
+Status DBImpl::WriteLevel0Table(MemTable* mem, uint64_t number,
+                                VersionEdit* edit, Version* base) {
+  mutex_.AssertHeld();
   const uint64_t start_micros = env_->NowMicros();
   FileMetaData meta;
-  meta.number = versions_->NewFileNumber();
-  pending_outputs_.insert(meta.number);
+  meta.number = number;
+  BlobFileMetaData blob;
+  if (options_.min_blob_size > 0) {
+    blob.number = versions_->NewFileNumber();
+    pending_outputs_.insert(blob.number);
+  }
   Iterator* iter = mem->NewIterator();
+  Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
   Log(options_.info_log, "Level-0 table #%llu: started",
       (unsigned long long)meta.number);
 
@@ -527,15 +893,23 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   {
     mutex_.Unlock();
     //新生成一个Table_builder负责写文件
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_, TableOptionsForLevel(options_, 0, false),
+                   table_cache_, iter, range_del_iter, &meta,
+                   blob.number != 0 ? &blob : nullptr);
     mutex_.Lock();
   }
 
   Log(options_.info_log, "Level-0 table #%llu: %lld bytes %s",
       (unsigned long long)meta.number, (unsigned long long)meta.file_size,
       s.ToString().c_str());
+  if (blob.total_bytes > 0) {
+    Log(options_.info_log, "Blob file #%llu: %lld bytes",
+        (unsigned long long)blob.number, (long long)blob.total_bytes);
+  }
   delete iter;
+  delete range_del_iter;
   pending_outputs_.erase(meta.number);
+  pending_outputs_.erase(blob.number);
 
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
@@ -543,16 +917,22 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   if (s.ok() && meta.file_size > 0) {
     const Slice min_user_key = meta.smallest.user_key();
     const Slice max_user_key = meta.largest.user_key();
-    if (base != nullptr) {
+    // Tiered compaction keeps every run in level-0.
+    if (base != nullptr &&
+        options_.compaction_style == kLeveledCompaction) {
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
     }
+    if (blob.total_bytes > 0) {
+      meta.blob_files.push_back(blob.number);
+      edit->AddBlobFile(blob.number, blob.total_bytes);
+    }
     edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
-                  meta.largest);
+                  meta.largest, meta.has_range_tombstones, meta.blob_files);
   }
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros;
-  stats.bytes_written = meta.file_size;
+  stats.bytes_written = meta.file_size + blob.total_bytes;
   stats_[level].Add(stats);
   return s;
 }
@@ -721,6 +1101,7 @@ typedef struct{
 	std::string key;
   std::string value;
 	int cnt;      //key出现的频率
+  bool merge;   //最新记录是合并操作数，值还没有合并出来，不能放入热数据表
 }Keys;
 const int key_num = 1024000; //key数量上限
 Keys keys_all[key_num]; // 所有的key
@@ -756,6 +1137,9 @@ void DBImpl::BackgroundCompaction() {
         // 复制key，第一次拷贝需要复制value（获取最新值）
         keys_all[key_index].key = ExtractUserKey(iter->key()).ToString();
         keys_all[key_index].value = iter->value().ToString();
+        keys_all[key_index].merge =
+            (DecodeFixed64(iter->key().data() + iter->key().size() - 8) &
+             0xff) == kTypeMerge;
         // 新key数量+1
         keys_all[key_index].cnt = 1;
       }
@@ -771,7 +1155,7 @@ void DBImpl::BackgroundCompaction() {
       //os2<<"put:mem_hot_ = new Skiplist_(), node_count: " + std::to_string(mem_hot_->node_count) << std::endl;
       // 将访问频率大于1，并且访问频率在前20%的数据插入热数据表中，同时插入的数据量小于1000个
       // if (keys_all[i].cnt > 1 && keys_all[i].cnt > (int)(max_freq * 0.8) && hot_num < 1000)
-      if (keys_all[i].cnt > 1)
+      if (keys_all[i].cnt > 1 && !keys_all[i].merge)
       {
         mem_hot_->set(keys_all[i].key, keys_all[i].value);
         // 调试代码
@@ -859,7 +1243,7 @@ void DBImpl::BackgroundCompaction() {
     FileMetaData* f = c->input(0, 0);
     c->edit()->DeleteFile(c->level(), f->number);
     c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
-                       f->largest);
+                       f->largest, f->has_range_tombstones, f->blob_files);
     status = versions_->LogAndApply(c->edit(), &mutex_); //写入version
     if (!status.ok()) {
       RecordBackgroundError(status);
@@ -918,6 +1302,9 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
     const CompactionState::Output& out = compact->outputs[i];
     pending_outputs_.erase(out.number);
   }
+  delete compact->blob_builder;
+  delete compact->blob_outfile;
+  pending_outputs_.erase(compact->blob_output.number);
   delete compact;
 }
 
@@ -927,27 +1314,39 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   uint64_t file_number;
   {
     mutex_.Lock();
-    file_number = versions_->NewFileNumber();
+    if (compact->output_number_limit != 0) {
+      assert(compact->next_output_number < compact->output_number_limit);
+      file_number = compact->next_output_number++;
+    } else {
+      file_number = versions_->NewFileNumber();
+    }
     pending_outputs_.insert(file_number);
     CompactionState::Output out;
     out.number = file_number;
     out.smallest.Clear();
     out.largest.Clear();
+    out.has_range_tombstones = false;
     compact->outputs.push_back(out);
     mutex_.Unlock();
   }
 
   // Make the output file
   std::string fname = TableFileName(dbname_, file_number);
-  Status s = env_->NewWritableFile(fname, &compact->outfile);
+  Status s = options_.use_direct_io_for_flush_and_compaction
+                 ? env_->NewDirectWritableFile(fname, &compact->outfile)
+                 : env_->NewWritableFile(fname, &compact->outfile);
   if (s.ok()) {
-    compact->builder = new TableBuilder(options_, compact->outfile);
+    compact->builder = new TableBuilder(
+        TableOptionsForLevel(options_, compact->compaction->output_level(),
+                             compact->bottommost_output),
+        compact->outfile);
   }
   return s;
 }
 
 Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
-                                          Iterator* input) {
+                                          Iterator* input,
+                                          const Slice* next_user_key) {
   assert(compact != nullptr);
   assert(compact->outfile != nullptr);
   assert(compact->builder != nullptr);
@@ -955,6 +1354,46 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   const uint64_t output_number = compact->current_output()->number;
   assert(output_number != 0);
 
+  // Add the part of the range tombstones between the bounds of the output,
+  // in internal key order.
+  const Comparator* ucmp = user_comparator();
+  std::vector<RangeTombstone> tombstones;
+  for (const RangeTombstone& t : compact->output_range_dels) {
+    if (next_user_key != nullptr && ucmp->Compare(t.start, *next_user_key) >= 0) {
+      break;
+    }
+    RangeTombstone clipped = t;
+    if (compact->has_output_lower_bound &&
+        ucmp->Compare(clipped.start, compact->output_lower_bound) < 0) {
+      clipped.start = compact->output_lower_bound;
+    }
+    if (next_user_key != nullptr &&
+        ucmp->Compare(clipped.end, *next_user_key) > 0) {
+      clipped.end = next_user_key->ToString();
+    }
+    if (ucmp->Compare(clipped.start, clipped.end) < 0) {
+      tombstones.push_back(std::move(clipped));
+    }
+  }
+  std::sort(tombstones.begin(), tombstones.end(),
+            [ucmp](const RangeTombstone& a, const RangeTombstone& b) {
+              const int r = ucmp->Compare(a.start, b.start);
+              return r != 0 ? r < 0 : a.seq > b.seq;
+            });
+  CompactionState::Output* out = compact->current_output();
+  bool has_bounds = compact->builder->NumEntries() > 0;
+  for (const RangeTombstone& t : tombstones) {
+    compact->builder->AddRangeTombstone(
+        InternalKey(t.start, t.seq, kTypeRangeDeletion).Encode(), t.end);
+    ExtendKeyRange(internal_comparator_, t, &has_bounds, &out->smallest,
+                   &out->largest);
+  }
+  out->has_range_tombstones = !tombstones.empty();
+  if (next_user_key != nullptr) {
+    compact->output_lower_bound = next_user_key->ToString();
+    compact->has_output_lower_bound = true;
+  }
+
   // Check for iterator errors
   Status s = input->status();
   const uint64_t current_entries = compact->builder->NumEntries();
@@ -979,27 +1418,270 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   delete compact->outfile;
   compact->outfile = nullptr;
 
-  if (s.ok() && current_entries > 0) {
+  if (s.ok() && (current_entries > 0 || !tombstones.empty())) {
     // Verify that the table is usable
     Iterator* iter =
         table_cache_->NewIterator(ReadOptions(), output_number, current_bytes);
     s = iter->status();
     delete iter;
     if (s.ok()) {
-      Log(options_.info_log, "Generated table #%llu@%d: %lld keys, %lld bytes",
+      Log(options_.info_log,
+          "Generated table #%llu@%d: %lld keys, %d range tombstones, "
+          "%lld bytes",
           (unsigned long long)output_number, compact->compaction->level(),
           (unsigned long long)current_entries,
+          static_cast<int>(tombstones.size()),
           (unsigned long long)current_bytes);
     }
   }
   return s;
 }
 
+Status DBImpl::ReleaseBlobReference(CompactionState* compact,
+                                    const Slice& user_key,
+                                    const Slice& blob_index, bool relocate,
+                                    std::string* new_index) {
+  BlobIndex index;
+  if (!index.DecodeFrom(blob_index)) {
+    return Status::Corruption("bad blob index for ", user_key);
+  }
+  if (relocate) {
+    std::string value;
+    Status s = table_cache_->GetBlob(ReadOptions(), blob_index, &value);
+    if (s.ok() && compact->blob_builder == nullptr) {
+      mutex_.Lock();
+      compact->blob_output.number = versions_->NewFileNumber();
+      pending_outputs_.insert(compact->blob_output.number);
+      mutex_.Unlock();
+      const std::string fname =
+          BlobFileName(dbname_, compact->blob_output.number);
+      s = options_.use_direct_io_for_flush_and_compaction
+              ? env_->NewDirectWritableFile(fname, &compact->blob_outfile)
+              : env_->NewWritableFile(fname, &compact->blob_outfile);
+      if (s.ok()) {
+        compact->blob_builder = new BlobFileBuilder(
+            compact->blob_outfile, compact->blob_output.number);
+      }
+    }
+    if (s.ok()) {
+      s = compact->blob_builder->Add(user_key, value, new_index);
+    }
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  compact->blob_garbage[index.file_number] += index.size;
+  return Status::OK();
+}
+
+Status DBImpl::FoldMergeOperands(
+    CompactionState* compact, Iterator* input,
+    std::vector<std::pair<std::string, std::string>>* entries) {
+  ParsedInternalKey ikey;
+  ParseInternalKey(input->key(), &ikey);
+  const std::string user_key = ikey.user_key.ToString();
+  // Operands of the key, newest first.
+  std::vector<std::pair<SequenceNumber, std::string>> operands;
+  operands.emplace_back(ikey.sequence, input->value().ToString());
+
+  // The older entries of the key are hidden from every snapshot by the
+  // operand, so the first entry that is not an operand decides the value
+  // they apply to.  It is consumed here, and the entries after it are then
+  // dropped by the caller.
+  bool has_base = false;
+  bool has_existing_value = false;
+  std::string existing_value;
+  for (input->Next(); input->Valid(); input->Next()) {
+    if (!ParseInternalKey(input->key(), &ikey) ||
+        user_comparator()->Compare(ikey.user_key, user_key) != 0) {
+      break;
+    }
+    if (compact->range_dels != nullptr &&
+        compact->range_dels->MaxCoveringSequence(
+            user_key, compact->smallest_snapshot) > ikey.sequence) {
+      has_base = true;
+      break;
+    }
+    if (ikey.type == kTypeMerge) {
+      operands.emplace_back(ikey.sequence, input->value().ToString());
+      continue;
+    }
+    has_base = true;
+    if (ikey.type == kTypeValue) {
+      has_existing_value = true;
+      existing_value = input->value().ToString();
+    } else if (ikey.type == kTypeBlobIndex) {
+      has_existing_value = true;
+      Status s = table_cache_->GetBlob(ReadOptions(), input->value(),
+                                      &existing_value);
+      if (s.ok()) {
+        // No output refers to the record any more.
+        s = ReleaseBlobReference(compact, user_key, input->value(), false,
+                                 nullptr);
+      }
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    input->Next();
+    break;
+  }
+
+  entries->clear();
+  if (has_base || compact->compaction->IsBaseLevelForKey(user_key)) {
+    std::vector<Slice> ordered;
+    ordered.reserve(operands.size());
+    for (auto it = operands.rbegin(); it != operands.rend(); ++it) {
+      ordered.push_back(it->second);
+    }
+    const Slice existing(existing_value);
+    std::string value;
+    if (!options_.merge_operator->FullMerge(
+            user_key, has_existing_value ? &existing : nullptr, ordered,
+            &value)) {
+      return Status::Corruption("merge operands rejected for ", user_key);
+    }
+    entries->emplace_back(
+        InternalKey(user_key, operands.front().first, kTypeValue)
+            .Encode()
+            .ToString(),
+        std::move(value));
+    return Status::OK();
+  }
+
+  // The value is in a deeper level, so only combine runs of operands that
+  // the operator can combine.
+  std::vector<std::pair<SequenceNumber, std::string>> folded;  // Oldest first
+  std::string combined;
+  for (auto it = operands.rbegin(); it != operands.rend(); ++it) {
+    if (!folded.empty() &&
+        options_.merge_operator->PartialMerge(user_key, folded.back().second,
+                                              it->second, &combined)) {
+      folded.back().first = it->first;
+      folded.back().second.swap(combined);
+    } else {
+      folded.push_back(std::move(*it));
+    }
+  }
+  for (auto it = folded.rbegin(); it != folded.rend(); ++it) {
+    entries->emplace_back(
+        InternalKey(user_key, it->first, kTypeMerge).Encode().ToString(),
+        std::move(it->second));
+  }
+  return Status::OK();
+}
+
+Status DBImpl::FinishCompactionBlobFile(CompactionState* compact) {
+  assert(compact->blob_builder != nullptr);
+  Status s = compact->blob_outfile->Sync();
+  if (s.ok()) {
+    s = compact->blob_outfile->Close();
+  }
+  if (s.ok()) {
+    compact->blob_output.total_bytes = compact->blob_builder->FileSize();
+    Log(options_.info_log, "Generated blob file #%llu: %lld values, %lld bytes",
+        (unsigned long long)compact->blob_output.number,
+        (long long)compact->blob_builder->NumEntries(),
+        (long long)compact->blob_output.total_bytes);
+  }
+  delete compact->blob_builder;
+  compact->blob_builder = nullptr;
+  delete compact->blob_outfile;
+  compact->blob_outfile = nullptr;
+  return s;
+}
+
+void DBImpl::DropCoveredInputs(CompactionState* compact) {
+  mutex_.AssertHeld();
+  Compaction* const c = compact->compaction;
+  if (c->HasBlobFiles()) {
+    // The blob records the dropped files refer to would never be counted
+    // as garbage.
+    return;
+  }
+
+  // Data at the next level is older than the tombstones of the level
+  // compacted, so a file whose whole key range lies in tombstones that no
+  // snapshot predates holds nothing visible.
+  std::vector<RangeTombstone> tombstones;
+  for (int i = 0; i < c->num_input_files(0); i++) {
+    FileMetaData* f = c->input(0, i);
+    if (f->has_range_tombstones &&
+        !table_cache_->GetRangeTombstones(f->number, f->file_size, &tombstones)
+             .ok()) {
+      return;  // The compaction will report the error
+    }
+  }
+  if (tombstones.empty()) {
+    return;
+  }
+  size_t n = 0;
+  for (size_t i = 0; i < tombstones.size(); i++) {
+    if (tombstones[i].seq <= compact->smallest_snapshot) {
+      if (n != i) tombstones[n] = std::move(tombstones[i]);
+      tombstones[n++].seq = 0;  // Merge all of them
+    }
+  }
+  tombstones.resize(n);
+  const Comparator* ucmp = user_comparator();
+  CoalesceRangeTombstones(ucmp, &tombstones);
+
+  int dropped = 0;
+  for (int i = c->num_input_files(1) - 1; i >= 0; i--) {
+    FileMetaData* f = c->input(1, i);
+    for (const RangeTombstone& t : tombstones) {
+      if (ucmp->Compare(t.start, f->smallest.user_key()) <= 0 &&
+          ucmp->Compare(f->largest.user_key(), t.end) < 0) {
+        c->DropInput(1, i);
+        dropped++;
+        break;
+      }
+    }
+  }
+  if (dropped > 0) {
+    Log(options_.info_log, "Dropped %d files covered by range tombstones",
+        dropped);
+  }
+}
+
+Status DBImpl::ReadInputRangeTombstones(CompactionState* compact) {
+  Compaction* const c = compact->compaction;
+  std::vector<RangeTombstone> tombstones;
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < c->num_input_files(which); i++) {
+      FileMetaData* f = c->input(which, i);
+      if (f->has_range_tombstones) {
+        Status s =
+            table_cache_->GetRangeTombstones(f->number, f->file_size,
+                                             &tombstones);
+        if (!s.ok()) {
+          return s;
+        }
+      }
+    }
+  }
+  if (tombstones.empty()) {
+    return Status::OK();
+  }
+  compact->range_dels =
+      new RangeTombstoneList(user_comparator(), std::move(tombstones));
+
+  // Tombstones no snapshot predates have nothing left to delete once at
+  // the bottom of the tree.
+  for (const RangeTombstone& t : compact->range_dels->tombstones()) {
+    if (!compact->bottommost_output || t.seq > compact->smallest_snapshot) {
+      compact->output_range_dels.push_back(t);
+    }
+  }
+  return Status::OK();
+}
+
 Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   mutex_.AssertHeld();
   Log(options_.info_log, "Compacted %d@%d + %d@%d files => %lld bytes",
       compact->compaction->num_input_files(0), compact->compaction->level(),
-      compact->compaction->num_input_files(1), compact->compaction->level() + 1,
+      compact->compaction->num_input_files(1),
+      compact->compaction->output_level(),
       static_cast<long long>(compact->total_bytes));
 
   // compaction完成后被合并的sst在新版本中就没有用了，将这些文件加入到VersionEdit的deleted_files_中
@@ -1007,11 +1689,20 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   compact->compaction->AddInputDeletions(compact->compaction->edit());
 
   // 将新生成的sst文件加入到VersionEdit的new_files_中
-  const int level = compact->compaction->level();
+  const int level = compact->compaction->output_level();
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
-    compact->compaction->edit()->AddFile(level + 1, out.number, out.file_size,
-                                         out.smallest, out.largest);
+    compact->compaction->edit()->AddFile(
+        level, out.number, out.file_size, out.smallest, out.largest,
+        out.has_range_tombstones,
+        std::vector<uint64_t>(out.blob_files.begin(), out.blob_files.end()));
+  }
+  if (compact->blob_output.total_bytes > 0) {
+    compact->compaction->edit()->AddBlobFile(compact->blob_output.number,
+                                             compact->blob_output.total_bytes);
+  }
+  for (const auto& garbage : compact->blob_garbage) {
+    compact->compaction->edit()->AddBlobGarbage(garbage.first, garbage.second);
   }
 
   // LogAndApply会根据VerionEdit中deleted_files_和new_files_生成一个新的Version
@@ -1025,7 +1716,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   Log(options_.info_log, "Compacting %d@%d + %d@%d files",
       compact->compaction->num_input_files(0), compact->compaction->level(),
       compact->compaction->num_input_files(1),
-      compact->compaction->level() + 1);
+      compact->compaction->output_level());
 
   assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
   assert(compact->builder == nullptr);
@@ -1036,8 +1727,38 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     compact->smallest_snapshot = versions_->LastSequence();
   } else {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
+    compact->largest_snapshot = snapshots_.newest()->sequence_number();
   }
 
+  compact->bottommost_output = true;
+  for (int level = compact->compaction->output_level() + 1;
+       level < config::kNumLevels; level++) {
+    if (versions_->NumLevelFiles(level) > 0) {
+      compact->bottommost_output = false;
+      break;
+    }
+  }
+
+  if (compact->compaction->IsIntraL0()) {
+    if (compact->compaction->num_input_sublevels() <
+        versions_->NumL0SubLevels()) {
+      compact->bottommost_output = false;
+    }
+
+    // Reserve more numbers than the outputs should need; if they do run
+    // out, the last output takes the rest of the data.
+    uint64_t input_bytes = 0;
+    for (int i = 0; i < compact->compaction->num_input_files(0); i++) {
+      input_bytes += compact->compaction->input(0, i)->file_size;
+    }
+    const uint64_t n =
+        2 * (input_bytes / compact->compaction->MaxOutputFileSize()) + 8;
+    compact->next_output_number = versions_->NewFileNumbers(n);
+    compact->output_number_limit = compact->next_output_number + n;
+  }
+
+  DropCoveredInputs(compact);
+
   // 这里生成一个MergingIterator，相当于在遍历要合并的sst文件时，同时进行多路归并排序
   // MergingIterator内部维护了n个Iterator，每个Iterator指向一个sst，进行迭代时，MergingIterator
   // 会找所有Iterators所指key中的最小那个，这样就完成了多路归并排序
@@ -1047,12 +1768,19 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   mutex_.Unlock();
 
   input->SeekToFirst();
-  Status status;
+  Status status = ReadInputRangeTombstones(compact);
   ParsedInternalKey ikey;
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
-  while (input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
+  std::string filtered_key;    // Backing store for keys the filter deleted
+  std::string filtered_value;  // Backing store for values the filter changed
+  std::string blob_value;      // Value of a blob reference passed to the filter
+  std::string new_blob_index;  // Backing store for relocated blob references
+  // Entries merge operands were folded into, newest first.
+  std::vector<std::pair<std::string, std::string>> merged_entries;
+  while (status.ok() && input->Valid() &&
+         !shutting_down_.load(std::memory_order_acquire)) {
     // Prioritize immutable compaction work
     if (has_imm_.load(std::memory_order_relaxed)) {
       const uint64_t imm_start = env_->NowMicros();
@@ -1067,9 +1795,21 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     }
 
     Slice key = input->key();
-    if (compact->compaction->ShouldStopBefore(key) &&
-        compact->builder != nullptr) {
-      status = FinishCompactionOutputFile(compact, input);
+    const bool parsed = ParseInternalKey(key, &ikey);
+
+    // Close the output file if it is big enough, or overlaps too much of
+    // the grandparent level.  Entries for one user key are never split
+    // across outputs, which the range tombstones rely on.
+    const bool stop_before = compact->compaction->ShouldStopBefore(key);
+    if (compact->builder != nullptr && parsed &&
+        (compact->output_number_limit == 0 ||
+         compact->next_output_number < compact->output_number_limit) &&
+        (stop_before || compact->builder->FileSize() >=
+                            compact->compaction->MaxOutputFileSize()) &&
+        !(has_current_user_key &&
+          user_comparator()->Compare(ikey.user_key,
+                                     Slice(current_user_key)) == 0)) {
+      status = FinishCompactionOutputFile(compact, input, &ikey.user_key);
       if (!status.ok()) {
         break;
       }
@@ -1077,7 +1817,17 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
     // Handle key/value, add to state, etc.
     bool drop = false;
-    if (!ParseInternalKey(key, &ikey)) {
+    bool input_advanced = false;
+    merged_entries.clear();
+    Slice value = input->value();
+    // Blob record the entry refers to, until the output no longer does.
+    Slice blob_index;
+    bool keep_blob_reference = false;
+    if (parsed && ikey.type == kTypeBlobIndex) {
+      blob_index = value;
+      keep_blob_reference = true;
+    }
+    if (!parsed) {
       // Do not hide error keys
       current_user_key.clear();
       has_current_user_key = false;
@@ -1091,6 +1841,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         has_current_user_key = true;
         last_sequence_for_key = kMaxSequenceNumber;
       }
+      const bool newest_for_key = last_sequence_for_key == kMaxSequenceNumber;
 
       if (last_sequence_for_key <= compact->smallest_snapshot) {
         // Hidden by an newer entry for same user key
@@ -1106,6 +1857,70 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         //     few iterations of this loop (by rule (A) above).
         // Therefore this deletion marker is obsolete and can be dropped.
         drop = true;
+      } else if (compact->range_dels != nullptr &&
+                 compact->range_dels->MaxCoveringSequence(
+                     ikey.user_key, compact->smallest_snapshot) >
+                     ikey.sequence) {
+        // Deleted by a range tombstone that every snapshot sees.
+        drop = true;
+      } else if (ikey.type == kTypeMerge &&
+                 options_.merge_operator != nullptr &&
+                 ikey.sequence <= compact->smallest_snapshot) {
+        // Every snapshot reads this operand together with the older
+        // entries of the key, so combine them.
+        status = FoldMergeOperands(compact, input, &merged_entries);
+        if (!status.ok()) {
+          break;
+        }
+        input_advanced = true;
+        key = merged_entries.front().first;
+        value = merged_entries.front().second;
+      } else if (options_.compaction_filter != nullptr && newest_for_key &&
+                 (ikey.type == kTypeValue || ikey.type == kTypeBlobIndex) &&
+                 ikey.sequence > compact->largest_snapshot) {
+        // No snapshot reads this value, so the filter may remove or
+        // rewrite it.
+        Slice existing_value = value;
+        if (ikey.type == kTypeBlobIndex) {
+          status = table_cache_->GetBlob(ReadOptions(), blob_index,
+                                         &blob_value);
+          if (!status.ok()) {
+            break;
+          }
+          existing_value = blob_value;
+        }
+        bool value_changed = false;
+        filtered_value.clear();
+        if (options_.compaction_filter->Filter(
+                compact->compaction->output_level(), ikey.user_key,
+                existing_value, &filtered_value, &value_changed)) {
+          keep_blob_reference = false;
+          if (ikey.sequence <= compact->smallest_snapshot &&
+              compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+            // Same reasoning as for obsolete deletion markers above.
+            drop = true;
+          } else {
+            // Older values remain in deeper levels or for snapshots;
+            // shadow them.
+            filtered_key.clear();
+            AppendInternalKey(&filtered_key,
+                              ParsedInternalKey(ikey.user_key, ikey.sequence,
+                                                kTypeDeletion));
+            key = filtered_key;
+            value = Slice();
+          }
+        } else if (value_changed) {
+          if (ikey.type == kTypeBlobIndex) {
+            // The new value is stored in the table.
+            filtered_key.clear();
+            AppendInternalKey(&filtered_key,
+                              ParsedInternalKey(ikey.user_key, ikey.sequence,
+                                                kTypeValue));
+            key = filtered_key;
+            keep_blob_reference = false;
+          }
+          value = filtered_value;
+        }
       }
 
       last_sequence_for_key = ikey.sequence;
@@ -1120,6 +1935,31 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
+    uint64_t blob_file_number = 0;  // Of the record the output refers to
+    if (!blob_index.empty()) {
+      // Count the records no output refers to any more, and move the kept
+      // values out of blob files that hold mostly garbage.
+      const bool released = drop || !keep_blob_reference;
+      BlobIndex index;
+      const bool relocate =
+          !released && index.DecodeFrom(blob_index) &&
+          compact->compaction->ShouldRelocateBlobs(index.file_number);
+      if (released || relocate) {
+        status = ReleaseBlobReference(compact, ikey.user_key, blob_index,
+                                      relocate, &new_blob_index);
+        if (!status.ok()) {
+          break;
+        }
+        if (relocate) {
+          value = new_blob_index;
+        }
+      }
+      if (!released) {
+        blob_file_number =
+            relocate ? compact->blob_output.number : index.file_number;
+      }
+    }
+
     if (!drop) {
       // Open output file if necessary
       if (compact->builder == nullptr) {
@@ -1132,26 +1972,40 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         compact->current_output()->smallest.DecodeFrom(key);
       }
       compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value());
-
-      // Close output file if it is big enough
-      if (compact->builder->FileSize() >=
-          compact->compaction->MaxOutputFileSize()) {
-        status = FinishCompactionOutputFile(compact, input);
-        if (!status.ok()) {
-          break;
-        }
+      compact->builder->Add(key, value);
+      if (blob_file_number != 0) {
+        compact->current_output()->blob_files.insert(blob_file_number);
+      }
+      for (size_t i = 1; i < merged_entries.size(); i++) {
+        compact->current_output()->largest.DecodeFrom(merged_entries[i].first);
+        compact->builder->Add(merged_entries[i].first,
+                              merged_entries[i].second);
       }
     }
 
-    input->Next();
+    if (!input_advanced) {
+      input->Next();
+    }
   }
 
   if (status.ok() && shutting_down_.load(std::memory_order_acquire)) {
     status = Status::IOError("Deleting DB during compaction");
   }
+  if (status.ok() && compact->builder == nullptr) {
+    // Range tombstones past the last output still need a file.
+    for (const RangeTombstone& t : compact->output_range_dels) {
+      if (!compact->has_output_lower_bound ||
+          user_comparator()->Compare(t.end, compact->output_lower_bound) > 0) {
+        status = OpenCompactionOutputFile(compact);
+        break;
+      }
+    }
+  }
   if (status.ok() && compact->builder != nullptr) {
-    status = FinishCompactionOutputFile(compact, input);
+    status = FinishCompactionOutputFile(compact, input, nullptr);
+  }
+  if (status.ok() && compact->blob_builder != nullptr) {
+    status = FinishCompactionBlobFile(compact);
   }
   if (status.ok()) {
     status = input->status();
@@ -1169,9 +2023,10 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     stats.bytes_written += compact->outputs[i].file_size;
   }
+  stats.bytes_written += compact->blob_output.total_bytes;
 
   mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
+  stats_[compact->compaction->output_level()].Add(stats);
 
   if (status.ok()) {
     status = InstallCompactionResults(compact);   // 将新生成的sst 加入到Version中
@@ -1192,6 +2047,13 @@ struct IterState {
   MemTable* const mem GUARDED_BY(mu);
   MemTable* const imm GUARDED_BY(mu);
 
+  // The bounds of the iterator as internal keys, which the ReadOptions
+  // of the table iterators point to.
+  std::string lower_bound_key;
+  std::string upper_bound_key;
+  Slice lower_bound;
+  Slice upper_bound;
+
   IterState(port::Mutex* mutex, MemTable* mem, MemTable* imm, Version* version)
       : mu(mutex), version(version), mem(mem), imm(imm) {}
 };
@@ -1208,9 +2070,9 @@ static void CleanupIteratorState(void* arg1, void* arg2) {
 
 }  // anonymous namespace
 
-Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
-                                      SequenceNumber* latest_snapshot,
-                                      uint32_t* seed) {
+Iterator* DBImpl::NewInternalIterator(
+    const ReadOptions& options, SequenceNumber* latest_snapshot,
+    uint32_t* seed, std::vector<RangeTombstoneList*>* range_dels) {
   mutex_.Lock();
   *latest_snapshot = versions_->LastSequence();
 
@@ -1222,16 +2084,58 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
     list.push_back(imm_->NewIterator());
     imm_->Ref();
   }
-  versions_->current()->AddIterators(options, &list);
+  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
+  ReadOptions table_options = options;
+  if (options.iterate_lower_bound != nullptr) {
+    // The smallest internal key with the bound as user key.
+    AppendInternalKey(&cleanup->lower_bound_key,
+                      ParsedInternalKey(*options.iterate_lower_bound,
+                                        kMaxSequenceNumber, kValueTypeForSeek));
+    cleanup->lower_bound = cleanup->lower_bound_key;
+    table_options.iterate_lower_bound = &cleanup->lower_bound;
+  }
+  if (options.iterate_upper_bound != nullptr) {
+    AppendInternalKey(&cleanup->upper_bound_key,
+                      ParsedInternalKey(*options.iterate_upper_bound,
+                                        kMaxSequenceNumber, kValueTypeForSeek));
+    cleanup->upper_bound = cleanup->upper_bound_key;
+    table_options.iterate_upper_bound = &cleanup->upper_bound;
+  }
+  versions_->current()->AddIterators(table_options, &list);
   Iterator* internal_iter =
       NewMergingIterator(&internal_comparator_, &list[0], list.size());
   versions_->current()->Ref();
 
-  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
+  MemTable* const mem = mem_;
+  MemTable* const imm = imm_;
+  Version* const current = versions_->current();
   internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
 
   *seed = ++seed_;
   mutex_.Unlock();
+
+  if (range_dels != nullptr) {
+    // The references taken above keep the sources of the tombstones alive.
+    // Their cached lists may hold tombstones newer than *latest_snapshot,
+    // which the iterator ignores.
+    range_dels->clear();
+    RangeTombstoneList* list = mem->GetRangeTombstones();
+    if (list != nullptr) range_dels->push_back(list);
+    if (imm != nullptr) {
+      list = imm->GetRangeTombstones();
+      if (list != nullptr) range_dels->push_back(list);
+    }
+    Status s = current->GetRangeTombstones(&list);
+    if (list != nullptr) range_dels->push_back(list);
+    if (!s.ok()) {
+      for (RangeTombstoneList* l : *range_dels) {
+        l->Unref();
+      }
+      range_dels->clear();
+      delete internal_iter;
+      return NewErrorIterator(s);
+    }
+  }
   return internal_iter;
 }
 
@@ -1248,6 +2152,18 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
 
 Status DBImpl::Get(const ReadOptions& options, const Slice& key,
                    std::string* value) {
+  // Values that cannot be pinned are copied straight into *value
+  PinnableSlice pinnable(value);
+  Status s = Get(options, key, &pinnable);
+  if (s.ok() && pinnable.IsPinned()) {
+    value->assign(pinnable.data(), pinnable.size());
+  }
+  return s;
+}
+
+Status DBImpl::Get(const ReadOptions& options, const Slice& key,
+                   PinnableSlice* value) {
+  value->Reset();
   Status s;
   MutexLock l(&mutex_); //获取互斥锁。
 
@@ -1288,27 +2204,33 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
     // 2、从 Immutable Memtable 查找。
     // 3、从 SSTable 文件查找。
     LookupKey lkey(key, snapshot);
-    if (mem_hot != nullptr && mem_hot->get(key.ToString(), *value)) {
+    // 内存中的值只能拷贝出来（memtable 的引用计数需要持有互斥锁），
+    // 只有 SST 文件中的值可以直接引用 block cache 中的数据。
+    std::string* copy = value->GetSelf();
+    MergeContext merge_context;
+    if (mem_hot != nullptr && mem_hot->get(key.ToString(), *copy)) {
       // 调试代码
-      //os4<<"get:mem_hot->get(key.ToString(), value: " + *value << std::endl;
-      // Done
-    } else if (mem_level0 != nullptr && mem_level0->get(key.ToString(), *value)) {
-      //os4<<"get:mem_level0->get(key.ToString(), value: " + *value << std::endl;
-      // Done
-    } else if (mem_level1 != nullptr && mem_level1->get(key.ToString(), *value)) {
-      //os4<<"get:mem_level1->get(key.ToString(), value: " + *value << std::endl;
-      // Done
-    } else if (mem_level2 != nullptr && mem_level2->get(key.ToString(), *value)) {
-      //os4<<"get:mem_level2->get(key.ToString(), value: " + *value << std::endl;
-      // Done
-    } else if (mem->Get(lkey, value, &s)) {
-      //os4<<"get:mem->Get(lkey, value, &s), value: " + *value << std::endl;
-      // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
-      //os4<<"get:imm->Get(lkey, value, &s), value: " + *value << std::endl;
-      // Done
+      //os4<<"get:mem_hot->get(key.ToString(), value: " + *copy << std::endl;
+      value->PinSelf();
+    } else if (mem_level0 != nullptr && mem_level0->get(key.ToString(), *copy)) {
+      //os4<<"get:mem_level0->get(key.ToString(), value: " + *copy << std::endl;
+      value->PinSelf();
+    } else if (mem_level1 != nullptr && mem_level1->get(key.ToString(), *copy)) {
+      //os4<<"get:mem_level1->get(key.ToString(), value: " + *copy << std::endl;
+      value->PinSelf();
+    } else if (mem_level2 != nullptr && mem_level2->get(key.ToString(), *copy)) {
+      //os4<<"get:mem_level2->get(key.ToString(), value: " + *copy << std::endl;
+      value->PinSelf();
+    } else if (mem->Get(lkey, copy, &s, &merge_context,
+                        options_.merge_operator)) {
+      //os4<<"get:mem->Get(lkey, value, &s), value: " + *copy << std::endl;
+      if (s.ok()) value->PinSelf();
+    } else if (imm != nullptr && imm->Get(lkey, copy, &s, &merge_context,
+                                          options_.merge_operator)) {
+      //os4<<"get:imm->Get(lkey, value, &s), value: " + *copy << std::endl;
+      if (s.ok()) value->PinSelf();
     } else {
-      s = current->Get(options, lkey, value, &stats);
+      s = current->Get(options, lkey, value, &stats, &merge_context);
       have_stat_update = true;
       // mem_hot_->set(key.ToString(), *value);
       // // 调试代码
@@ -1359,13 +2281,16 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   uint32_t seed;
-  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
+  std::vector<RangeTombstoneList*> range_dels;
+  Iterator* iter =
+      NewInternalIterator(options, &latest_snapshot, &seed, &range_dels);
   return NewDBIterator(this, user_comparator(), iter,
                        (options.snapshot != nullptr
                             ? static_cast<const SnapshotImpl*>(options.snapshot)
                                   ->sequence_number()
                             : latest_snapshot),
-                       seed);
+                       seed, range_dels, options, options_.prefix_extractor,
+                       options_.merge_operator);
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1375,6 +2300,11 @@ void DBImpl::RecordReadSample(Slice key) {
   }
 }
 
+Status DBImpl::ReadBlob(const ReadOptions& options, const Slice& blob_index,
+                        std::string* value) {
+  return table_cache_->GetBlob(options, blob_index, value);
+}
+
 const Snapshot* DBImpl::GetSnapshot() {
   MutexLock l(&mutex_);
   return snapshots_.New(versions_->LastSequence());
@@ -1386,69 +2316,132 @@ void DBImpl::ReleaseSnapshot(const Snapshot* snapshot) {
 }
 
 // Convenience methods
+// 热数据的 Put、Delete、Merge 和 DeleteRange 都在持有 mutex_ 时读写热数据表和
+// log_hot_，彼此不会交错，也不会与后台线程轮换热数据表交错。
 Status DBImpl::Put(const WriteOptions& options, const Slice& key, const Slice& val) {
   // 判断是否为热数据：使用Get检查数据是否在热数据表中，如果在就直接写入，如果不在就写入冷数据表
-  Status s;
-  std::string value;
-  if (mem_hot_ != nullptr && mem_hot_->get(key.ToString(), value, val.ToString(), log_hot_)) {
-    // 调试代码
-    //os5<<"DBImpl::Put, mem_hot_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
-    // 写入热数据表
-    return s.OK();
-  }
-  else if (mem_level0_ != nullptr && mem_level0_->get(key.ToString(), value, val.ToString())) {
-    // 写入Level0
-    //os5<<"DBImpl::Put, mem_level0_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
-    return s.OK();
-  }
-  else if (mem_level1_ != nullptr && mem_level1_->get(key.ToString(), value, val.ToString())) {
-    // 写入Level1
-    //os5<<"DBImpl::Put, mem_level1_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
-    return s.OK();
-  }
-  else if (mem_level2_ != nullptr && mem_level2_->get(key.ToString(), value, val.ToString())) {
-    // 写入Level2
-    //os5<<"DBImpl::Put, mem_level2_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
-    return s.OK();
-  }
-  else
   {
-    //os6<<"DB::Put(options, key, val), key: " + key.ToString() << ", val: " + val.ToString() << std::endl;
-    // 写入冷数据表
-    return DB::Put(options, key, val);
+    MutexLock l(&mutex_);
+    std::string value;
+    if (mem_hot_ != nullptr && mem_hot_->get(key.ToString(), value, val.ToString(), log_hot_)) {
+      // 调试代码
+      //os5<<"DBImpl::Put, mem_hot_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
+      // 写入热数据表
+      return Status::OK();
+    }
+    else if (mem_level0_ != nullptr && mem_level0_->get(key.ToString(), value, val.ToString())) {
+      // 写入Level0
+      //os5<<"DBImpl::Put, mem_level0_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
+      return Status::OK();
+    }
+    else if (mem_level1_ != nullptr && mem_level1_->get(key.ToString(), value, val.ToString())) {
+      // 写入Level1
+      //os5<<"DBImpl::Put, mem_level1_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
+      return Status::OK();
+    }
+    else if (mem_level2_ != nullptr && mem_level2_->get(key.ToString(), value, val.ToString())) {
+      // 写入Level2
+      //os5<<"DBImpl::Put, mem_level2_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
+      return Status::OK();
+    }
   }
+  //os6<<"DB::Put(options, key, val), key: " + key.ToString() << ", val: " + val.ToString() << std::endl;
+  // 写入冷数据表
+  return DB::Put(options, key, val);
 }
 
 Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
-  Status s;
   // 判断是否为热数据：使用Get检查数据是否在热数据表中，如果在就直接写入，如果不在就写入冷数据表
-  std::string value;
-  if (mem_hot_ != nullptr && mem_hot_->get(key.ToString(), value, "", log_hot_)) {
-    // 写入热数据表
-    //os5<<"DBImpl::Delete, mem_hot_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
-    return s.OK();
-  }
-  else if (mem_level0_ != nullptr && mem_level0_->get(key.ToString(), value, "")) {
-    // 写入Level0
-    //os5<<"DBImpl::Delete, mem_level0_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
-    return s.OK();
-  }
-  else if (mem_level1_ != nullptr && mem_level1_->get(key.ToString(), value, "")) {
-    // 写入Level1
-    //os5<<"DBImpl::Delete, mem_level1_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
-    return s.OK();
-  }
-  else if (mem_level2_ != nullptr && mem_level2_->get(key.ToString(), value, "")) {
-    // 写入Level2
-    //os5<<"DBImpl::Delete, mem_level2_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
-    return s.OK();
-  }
-  else
   {
-   // os6<<"DB::Delete(options, key, val), key: " + key.ToString() << std::endl;
-    // 写入冷数据表
-    return DB::Delete(options, key);
+    MutexLock l(&mutex_);
+    std::string value;
+    if (mem_hot_ != nullptr && mem_hot_->get(key.ToString(), value, "", log_hot_)) {
+      // 写入热数据表
+      //os5<<"DBImpl::Delete, mem_hot_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
+      return Status::OK();
+    }
+    else if (mem_level0_ != nullptr && mem_level0_->get(key.ToString(), value, "")) {
+      // 写入Level0
+      //os5<<"DBImpl::Delete, mem_level0_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
+      return Status::OK();
+    }
+    else if (mem_level1_ != nullptr && mem_level1_->get(key.ToString(), value, "")) {
+      // 写入Level1
+      //os5<<"DBImpl::Delete, mem_level1_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
+      return Status::OK();
+    }
+    else if (mem_level2_ != nullptr && mem_level2_->get(key.ToString(), value, "")) {
+      // 写入Level2
+      //os5<<"DBImpl::Delete, mem_level2_->get(key.ToString(), value, val.ToString()), key: " + key.ToString() + ", value: " + value << std::endl;
+      return Status::OK();
+    }
+  }
+  // os6<<"DB::Delete(options, key, val), key: " + key.ToString() << std::endl;
+  // 写入冷数据表
+  return DB::Delete(options, key);
+}
+
+Status DBImpl::Merge(const WriteOptions& options, const Slice& key,
+                     const Slice& val) {
+  if (options_.merge_operator == nullptr) {
+    return Status::NotSupported("Merge() without Options::merge_operator");
+  }
+  // 热数据表中保存的是完整的值：如果是热数据，直接在热数据表中合并，否则写入冷数据表。
+  {
+    MutexLock l(&mutex_);
+    Skiplist_* const hot_tables[] = {mem_hot_, mem_level0_, mem_level1_,
+                                     mem_level2_};
+    std::string value;
+    for (int i = 0; i < 4; i++) {
+      Skiplist_* table = hot_tables[i];
+      if (table != nullptr && table->get(key.ToString(), value)) {
+        MergeContext merge_context;
+        merge_context.AddOlder(val);
+        // 热数据的 Delete 写入的是空值，此时没有已有的值可以合并
+        const Slice existing_value(value);
+        std::string merged;
+        Status s = merge_context.Merge(
+            options_.merge_operator, key,
+            value.empty() ? nullptr : &existing_value, &merged);
+        if (s.ok()) {
+          // 只有热数据表 mem_hot_ 记录日志，与 Put 相同
+          table->get(key.ToString(), value, merged,
+                     (i == 0) ? log_hot_ : nullptr);
+        }
+        return s;
+      }
+    }
   }
+  // 写入冷数据表
+  return DB::Merge(options, key, val);
+}
+
+Status DBImpl::DeleteRange(const WriteOptions& options,
+                           const Slice& begin_key, const Slice& end_key) {
+  const int r = user_comparator()->Compare(begin_key, end_key);
+  if (r > 0) {
+    return Status::InvalidArgument("DeleteRange: begin_key > end_key");
+  } else if (r == 0) {
+    return Status::OK();  // Empty range
+  }
+  // 热数据表中的key没有序列号，不受范围删除标记的影响，所以直接删除范围内的热数据
+  {
+    MutexLock l(&mutex_);
+    if (mem_hot_ != nullptr) {
+      mem_hot_->clear_range(begin_key.ToString(), end_key.ToString(), log_hot_);
+    }
+    if (mem_level0_ != nullptr) {
+      mem_level0_->clear_range(begin_key.ToString(), end_key.ToString());
+    }
+    if (mem_level1_ != nullptr) {
+      mem_level1_->clear_range(begin_key.ToString(), end_key.ToString());
+    }
+    if (mem_level2_ != nullptr) {
+      mem_level2_->clear_range(begin_key.ToString(), end_key.ToString());
+    }
+  }
+  // 写入冷数据表
+  return DB::DeleteRange(options, begin_key, end_key);
 }
 
 // 处理过程
@@ -1485,6 +2478,7 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   // 获取本次写入的版本号,其实就是个uint64
   uint64_t last_sequence = versions_->LastSequence();
   Writer* last_writer = &w;
+  bool wait_for_log_sync = false;
   //这里writer还是队列中第一个,由于下面会队列前面的writers也可能合并起来,所以last_writer指针会指向被合并的最后一个writer
   if (status.ok() && updates != nullptr) {  // nullptr batch is for compactions
     WriteBatch* updates = BuildBatchGroup(&last_writer); //这里会把writers队列中的其他适合的写操作一起执行
@@ -1500,9 +2494,14 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
       status = log_->AddRecord(WriteBatchInternal::Contents(updates));  //第一步写入log，用于故障恢复，防止数据丢失。
       bool sync_error = false;
       if (status.ok() && options.sync) {
-        status = logfile_->Sync();
-        if (!status.ok()) {
-          sync_error = true;
+        if (options_.async_log_sync && logfile_->SupportsConcurrentSync()) {
+          // Leave the sync to the log sync thread, after leaving the queue.
+          wait_for_log_sync = true;
+        } else {
+          status = logfile_->Sync();
+          if (!status.ok()) {
+            sync_error = true;
+          }
         }
       }
       if (status.ok()) {
@@ -1522,13 +2521,19 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   }
 
   // 将处理完的任务从队列里取出，并置状态为done，然后通知对应的CondVar启动。
+  // A group that waits for the log sync thread is only notified after it.
+  std::vector<Writer*> group;
   while (true) {
     Writer* ready = writers_.front();
     writers_.pop_front();
     if (ready != &w) {
-      ready->status = status;
-      ready->done = true;
-      ready->cv.Signal();
+      if (wait_for_log_sync && status.ok()) {
+        group.push_back(ready);
+      } else {
+        ready->status = status;
+        ready->done = true;
+        ready->cv.Signal();
+      }
     }
     if (ready == last_writer) break; //直到last_writer通知为止。
   }
@@ -1538,9 +2543,75 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     writers_.front()->cv.Signal();
   }
 
+  if (wait_for_log_sync && status.ok()) {
+    status = WaitForLogSync(last_sequence);
+    for (Writer* ready : group) {
+      ready->status = status;
+      ready->done = true;
+      ready->cv.Signal();
+    }
+  }
+
   return status;
 }
 
+Status DBImpl::WaitForLogSync(SequenceNumber sequence) {
+  mutex_.AssertHeld();
+  if (!log_sync_thread_.joinable()) {
+    log_sync_thread_ = std::thread(&DBImpl::LogSyncThread, this);
+  }
+  if (log_sync_requested_ < sequence) {
+    log_sync_requested_ = sequence;
+    log_sync_requested_signal_.Signal();
+  }
+  while (log_synced_ < sequence && log_sync_status_.ok()) {
+    log_synced_signal_.Wait();
+  }
+  return log_sync_status_;
+}
+
+void DBImpl::WaitForLogSyncIdle() {
+  mutex_.AssertHeld();
+  while (log_sync_busy_ ||
+         (log_synced_ < log_sync_requested_ && log_sync_status_.ok())) {
+    log_synced_signal_.Wait();
+  }
+}
+
+// Syncs the log whenever a write group asks for it.  Everything up to
+// LastSequence() has been handed to the operating system by then, so one
+// sync covers the groups logged while the previous one was running.
+void DBImpl::LogSyncThread() {
+  MutexLock l(&mutex_);
+  while (true) {
+    while (log_synced_ >= log_sync_requested_ &&
+           !shutting_down_.load(std::memory_order_acquire)) {
+      log_sync_requested_signal_.Wait();
+    }
+    if (log_synced_ >= log_sync_requested_ || !log_sync_status_.ok()) {
+      break;
+    }
+
+    const SequenceNumber synced = versions_->LastSequence();
+    WritableFile* const file = logfile_;
+    log_sync_busy_ = true;
+    mutex_.Unlock();
+    Status s = file->SyncFlushed();
+    mutex_.Lock();
+    log_sync_busy_ = false;
+    if (s.ok()) {
+      log_synced_ = synced;
+    } else {
+      // As for a failed sync in Write(), the log may or may not hold the
+      // records, so all future writes fail.
+      log_sync_status_ = s;
+      RecordBackgroundError(s);
+    }
+    log_synced_signal_.SignalAll();
+  }
+  log_synced_signal_.SignalAll();
+}
+
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-null batch
 
@@ -1616,7 +2687,7 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // Yield previous error 如果后台任务已经出错,直接返回错误
       s = bg_error_;
       break;
-    } else if (allow_delay && versions_->NumLevelFiles(0) >=
+    } else if (allow_delay && versions_->NumL0SubLevels() >=
                                   config::kL0_SlowdownWritesTrigger) {
       // level0的文件数限制超过8,睡眠1ms,简单等待后台任务执行。写入writer线程向压缩线程转让cpu。
       // We are getting close to hitting a hard limit on the number of
@@ -1640,9 +2711,9 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // 等待之前的imuable memtable完成compact到level0
       Log(options_.info_log, "Current memtable full; waiting...\n");
       background_work_finished_signal_.Wait();
-    } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
-      // There are too many level-0 files.
-      Log(options_.info_log, "Too many L0 files; waiting...\n");
+    } else if (versions_->NumL0SubLevels() >= config::kL0_StopWritesTrigger) {
+      // There are too many level-0 sub-levels.
+      Log(options_.info_log, "Too many L0 sub-levels; waiting...\n");
       background_work_finished_signal_.Wait();
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
@@ -1650,17 +2721,22 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       assert(versions_->PrevLogNumber() == 0);
       uint64_t new_log_number = versions_->NewFileNumber();
       WritableFile* lfile = nullptr;
-      s = env_->NewWritableFile(LogFileName(dbname_, new_log_number), &lfile); //生成新的log文件
+      log::Writer* new_log = nullptr;
+      s = NewLogFile(new_log_number, &lfile, &new_log); //生成新的log文件
       if (!s.ok()) {
         // Avoid chewing through file number space in a tight loop.
         versions_->ReuseFileNumber(new_log_number);
         break;
       }
+      if (options_.recycle_log_file_num > 0) {
+        retired_logs_.insert(logfile_number_);
+      }
+      WaitForLogSyncIdle();
       delete log_; //删除旧的log对象分配新的
       delete logfile_;
       logfile_ = lfile;
       logfile_number_ = new_log_number;
-      log_ = new log::Writer(lfile);
+      log_ = new_log;
       imm_ = mem_; //切换memtable到Imuable memtable
       has_imm_.store(true, std::memory_order_release);
       mem_ = new MemTable(internal_comparator_);
@@ -1694,6 +2770,11 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
       *value = buf;
       return true;
     }
+  } else if (in == "num-l0-sublevels") {
+    char buf[100];
+    snprintf(buf, sizeof(buf), "%d", versions_->NumL0SubLevels());
+    *value = buf;
+    return true;
   } else if (in == "stats") {
     char buf[200];
     snprintf(buf, sizeof(buf),
@@ -1766,6 +2847,30 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+Status DB::DeleteRange(const WriteOptions& opt, const Slice& begin_key,
+                       const Slice& end_key) {
+  WriteBatch batch;
+  batch.DeleteRange(begin_key, end_key);
+  return Write(opt, &batch);
+}
+
+Status DB::Merge(const WriteOptions& opt, const Slice& key,
+                 const Slice& value) {
+  WriteBatch batch;
+  batch.Merge(key, value);
+  return Write(opt, &batch);
+}
+
+Status DB::Get(const ReadOptions& options, const Slice& key,
+               PinnableSlice* value) {
+  value->Reset();
+  Status s = Get(options, key, value->GetSelf());
+  if (s.ok()) {
+    value->PinSelf();
+  }
+  return s;
+}
+
 DB::~DB() = default;
 
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
@@ -1781,17 +2886,23 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     // Create new log and a corresponding memtable.
     uint64_t new_log_number = impl->versions_->NewFileNumber();
     WritableFile* lfile;
-    s = options.env->NewWritableFile(LogFileName(dbname, new_log_number),
-                                     &lfile);
+    log::Writer* log;
+    s = impl->NewLogFile(new_log_number, &lfile, &log);
     uint64_t new_log_number_hot = impl->versions_->NewFileNumber();
     WritableFile* lfile_hot;
-    s = options.env->NewWritableFile(LogFileName(dbname, new_log_number_hot),
-                                     &lfile_hot);
+    if (s.ok()) {
+      s = options.env->NewWritableFile(LogFileName(dbname, new_log_number_hot),
+                                       &lfile_hot);
+      if (!s.ok()) {
+        delete log;
+        delete lfile;
+      }
+    }
     if (s.ok()) {
       edit.SetLogNumber(new_log_number);
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
-      impl->log_ = new log::Writer(lfile);
+      impl->log_ = log;
       impl->log_hot_ = new log::Writer(lfile_hot);
       impl->mem_ = new MemTable(impl->internal_comparator_);
       impl->mem_->Ref();
@@ -9,6 +9,7 @@
 #include <deque>
 #include <set>
 #include <string>
+#include <thread>
 
 // 调试代码
 #include <fstream> 
@@ -26,6 +27,7 @@
 namespace leveldb {
 
 class MemTable;
+class RangeTombstoneList;
 class TableCache;
 class Version;
 class VersionEdit;
@@ -44,9 +46,15 @@ class DBImpl : public DB {
   Status Put(const WriteOptions& options, const Slice& key,
              const Slice& value) override;
   Status Delete(const WriteOptions& options, const Slice& key) override;
+  Status DeleteRange(const WriteOptions& options, const Slice& begin_key,
+                     const Slice& end_key) override;
+  Status Merge(const WriteOptions& options, const Slice& key,
+               const Slice& value) override;
   Status Write(const WriteOptions& options, WriteBatch* updates) override;
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override;
+  Status Get(const ReadOptions& options, const Slice& key,
+             PinnableSlice* value) override;
   Iterator* NewIterator(const ReadOptions&) override;
   const Snapshot* GetSnapshot() override;
   void ReleaseSnapshot(const Snapshot* snapshot) override;
@@ -76,10 +84,16 @@ class DBImpl : public DB {
   // bytes.
   void RecordReadSample(Slice key);
 
+  // Store in *value the value in a blob file that "blob_index", the value
+  // of a kTypeBlobIndex entry, refers to.
+  Status ReadBlob(const ReadOptions& options, const Slice& blob_index,
+                  std::string* value);
+
  private:
   friend class DB;
   struct CompactionState;
   struct Writer;
+  class RecoveryFlusher;
 
   // Information for a manual compaction
   struct ManualCompaction {
@@ -106,9 +120,11 @@ class DBImpl : public DB {
     int64_t bytes_written;
   };
 
-  Iterator* NewInternalIterator(const ReadOptions&,
-                                SequenceNumber* latest_snapshot,
-                                uint32_t* seed);
+  // If "range_dels" is non-null, also sets *range_dels to referenced
+  // lists of the range tombstones of the memtables and tables read.
+  Iterator* NewInternalIterator(
+      const ReadOptions&, SequenceNumber* latest_snapshot, uint32_t* seed,
+      std::vector<RangeTombstoneList*>* range_dels = nullptr);
 
   Status NewDB();
 
@@ -123,20 +139,38 @@ class DBImpl : public DB {
   // Delete any unneeded files and stale in-memory entries.
   void DeleteObsoleteFiles() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Create the write-ahead log file numbered "log_number", recycling an
+  // obsolete log file if one is available, and a writer for it.
+  Status NewLogFile(uint64_t log_number, WritableFile** file,
+                    log::Writer** writer) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   // Compact the in-memory write buffer to disk.  Switches to a new
   // log-file/memtable and writes a new descriptor iff successful.
   // Errors are recorded in bg_error_.
   void CompactMemTable() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   Status RecoverLogFile(uint64_t log_number, bool last_log, bool* save_manifest,
-                        VersionEdit* edit, SequenceNumber* max_sequence)
+                        RecoveryFlusher* flusher, SequenceNumber* max_sequence)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Same as above, writing table number "number", which the caller has
+  // allocated and added to pending_outputs_.
+  Status WriteLevel0Table(MemTable* mem, uint64_t number, VersionEdit* edit,
+                          Version* base) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   Status MakeRoomForWrite(bool force /* compact even if there is room? */)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Waits until the log is synced past "sequence" by the log sync thread,
+  // starting it if needed.
+  Status WaitForLogSync(SequenceNumber sequence)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Waits until the log sync thread is done with the current log file.
+  void WaitForLogSyncIdle() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void LogSyncThread();
   WriteBatch* BuildBatchGroup(Writer** last_writer)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -152,7 +186,25 @@ class DBImpl : public DB {
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   Status OpenCompactionOutputFile(CompactionState* compact);
-  Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
+  Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input,
+                                    const Slice* next_user_key);
+  // Count the blob record "blob_index" refers to as garbage.  If
+  // "relocate" is set, first copy its value to the blob file of the
+  // compaction, and store the new reference in *new_index.
+  Status ReleaseBlobReference(CompactionState* compact, const Slice& user_key,
+                              const Slice& blob_index, bool relocate,
+                              std::string* new_index);
+  // Combine the merge operand at "input", which every snapshot reads, with
+  // the older entries of its key, and store the resulting (internal key,
+  // value) entries in *entries, newest first.  Leaves "input" at the first
+  // entry that was not combined.
+  Status FoldMergeOperands(
+      CompactionState* compact, Iterator* input,
+      std::vector<std::pair<std::string, std::string>>* entries);
+  Status FinishCompactionBlobFile(CompactionState* compact);
+  void DropCoveredInputs(CompactionState* compact)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  Status ReadInputRangeTombstones(CompactionState* compact);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -203,6 +255,23 @@ class DBImpl : public DB {
   log::Writer* log_hot_;
   uint32_t seed_ GUARDED_BY(mutex_);  // For sampling.
 
+  // State of the thread syncing the log for options_.async_log_sync.
+  std::thread log_sync_thread_;
+  port::CondVar log_sync_requested_signal_;  // Signalled to the thread
+  port::CondVar log_synced_signal_;          // Signalled by the thread
+  // The log is durable up to log_synced_ and must be made durable up to
+  // log_sync_requested_.
+  SequenceNumber log_sync_requested_ GUARDED_BY(mutex_);
+  SequenceNumber log_synced_ GUARDED_BY(mutex_);
+  bool log_sync_busy_ GUARDED_BY(mutex_);  // Syncing logfile_ unlocked
+  Status log_sync_status_ GUARDED_BY(mutex_);
+
+  // Logs switched away from by MakeRoomForWrite() in recyclable format,
+  // which may be recycled once they are obsolete.
+  std::set<uint64_t> retired_logs_ GUARDED_BY(mutex_);
+  // Obsolete log files kept to be overwritten by new logs.
+  std::deque<uint64_t> recyclable_logs_ GUARDED_BY(mutex_);
+
   // Queue of writers.
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
   WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
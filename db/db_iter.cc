@@ -7,8 +7,11 @@
 #include "db/db_impl.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/merge_context.h"
+#include "db/range_tombstone.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "leveldb/slice_transform.h"
 #include "port/port.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -46,34 +49,70 @@ class DBIter : public Iterator {
   enum Direction { kForward, kReverse };
 
   DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-         uint32_t seed)
+         uint32_t seed, const std::vector<RangeTombstoneList*>& range_dels,
+         const ReadOptions& options, const SliceTransform* prefix_extractor,
+         const MergeOperator* merge_operator)
       : db_(db),
         user_comparator_(cmp),
         iter_(iter),
+        range_dels_(range_dels),
         sequence_(s),
+        read_options_(options),
+        prefix_extractor_(options.prefix_same_as_start ? prefix_extractor
+                                                       : nullptr),
+        lower_bound_(options.iterate_lower_bound),
+        upper_bound_(options.iterate_upper_bound),
+        merge_operator_(merge_operator),
         direction_(kForward),
         valid_(false),
+        prefix_bounded_(false),
+        merged_(false),
+        value_is_blob_index_(false),
+        blob_loaded_(false),
         rnd_(seed),
         bytes_until_read_sampling_(RandomCompactionPeriod()) {}
 
   DBIter(const DBIter&) = delete;
   DBIter& operator=(const DBIter&) = delete;
 
-  ~DBIter() override { delete iter_; }
+  ~DBIter() override {
+    delete iter_;
+    for (RangeTombstoneList* list : range_dels_) {
+      list->Unref();
+    }
+  }
   bool Valid() const override { return valid_; }
   Slice key() const override {
     assert(valid_);
-    return (direction_ == kForward) ? ExtractUserKey(iter_->key()) : saved_key_;
+    return (direction_ == kForward && !merged_) ? ExtractUserKey(iter_->key())
+                                                : saved_key_;
   }
   Slice value() const override {
     assert(valid_);
-    return (direction_ == kForward) ? iter_->value() : saved_value_;
+    Slice raw_value =
+        (direction_ == kForward && !merged_) ? iter_->value() : saved_value_;
+    if (!value_is_blob_index_) {
+      return raw_value;
+    }
+    // Read the value from its blob file on first use, so that scans that
+    // only need keys never do.
+    if (!blob_loaded_) {
+      blob_loaded_ = true;
+      Status s = db_->ReadBlob(read_options_, raw_value, &blob_value_);
+      if (!s.ok()) {
+        blob_status_ = s;
+        blob_value_.clear();
+      }
+    }
+    return blob_value_;
   }
   Status status() const override {
-    if (status_.ok()) {
-      return iter_->status();
-    } else {
+    if (!status_.ok()) {
       return status_;
+    } else if (!blob_status_.ok()) {
+      return blob_status_;
+    } else {
+      return iter_->status();
     }
   }
 
@@ -86,8 +125,38 @@ class DBIter : public Iterator {
  private:
   void FindNextUserEntry(bool skipping, std::string* skip);
   void FindPrevUserEntry();
+  bool MergeForward();
+  bool MergeOperands(const MergeContext& merge_context, ValueType base_type,
+                     const Slice& base);
   bool ParseKey(ParsedInternalKey* key);
 
+  // Returns the type of "ikey", with values and merge operands covered by
+  // a range tombstone turned into deletions.
+  inline ValueType EffectiveType(const ParsedInternalKey& ikey) const {
+    if (ikey.type == kTypeValue || ikey.type == kTypeBlobIndex ||
+        ikey.type == kTypeMerge) {
+      for (const RangeTombstoneList* list : range_dels_) {
+        if (list->MaxCoveringSequence(ikey.user_key, sequence_) >
+            ikey.sequence) {
+          return kTypeDeletion;
+        }
+      }
+    }
+    return ikey.type;
+  }
+
+  // Returns true if "user_key", and so every key after it, is past the
+  // keys the iterator may yield.
+  inline bool PastEnd(const Slice& user_key) const {
+    if (upper_bound_ != nullptr &&
+        user_comparator_->Compare(user_key, *upper_bound_) >= 0) {
+      return true;
+    }
+    return prefix_bounded_ && (!prefix_extractor_->InDomain(user_key) ||
+                               prefix_extractor_->Transform(user_key) !=
+                                   Slice(prefix_));
+  }
+
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
   }
@@ -109,12 +178,35 @@ class DBIter : public Iterator {
   DBImpl* db_;
   const Comparator* const user_comparator_;
   Iterator* const iter_;
+  const std::vector<RangeTombstoneList*> range_dels_;
   SequenceNumber const sequence_;
+  const ReadOptions read_options_;  // For reading blob values
+  // Null unless ReadOptions::prefix_same_as_start, which makes the
+  // children of iter_ skip tables, so that iter_ can only move forward
+  // after a Seek().
+  const SliceTransform* const prefix_extractor_;
+  const Slice* const lower_bound_;  // May be null
+  const Slice* const upper_bound_;  // May be null
+  const MergeOperator* const merge_operator_;  // May be null
   Status status_;
   std::string saved_key_;    // == current key when direction_==kReverse
   std::string saved_value_;  // == current raw value when direction_==kReverse
   Direction direction_;
   bool valid_;
+  bool prefix_bounded_;  // Only keys with prefix_ may be yielded
+  std::string prefix_;
+
+  // The current entry is the merge of the operands of saved_key_, kept in
+  // saved_value_, and iter_ is past the entries they were read from.  Only
+  // set when moving forward.
+  bool merged_;
+
+  // The raw value is the BlobIndex of the current value, which value()
+  // reads into blob_value_ once.
+  bool value_is_blob_index_;
+  mutable bool blob_loaded_;
+  mutable std::string blob_value_;
+  mutable Status blob_status_;
   Random rnd_;
   size_t bytes_until_read_sampling_;
 };
@@ -157,6 +249,15 @@ void DBIter::Next() {
       return;
     }
     // saved_key_ already contains the key to skip past.
+  } else if (merged_) {
+    // iter_ is already past the entries for this->key(), which is in
+    // saved_key_.
+    if (!iter_->Valid()) {
+      valid_ = false;
+      merged_ = false;
+      saved_key_.clear();
+      return;
+    }
   } else {
     // Store in saved_key_ the current key so we skip it below.
     SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
@@ -178,26 +279,53 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   // Loop until we hit an acceptable entry to yield
   assert(iter_->Valid());
   assert(direction_ == kForward);
+  merged_ = false;
   do {
     ParsedInternalKey ikey;
     if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
-      switch (ikey.type) {
+      if (PastEnd(ikey.user_key)) {
+        break;
+      }
+      switch (EffectiveType(ikey)) {
         case kTypeDeletion:
           // Arrange to skip all upcoming entries for this key since
-          // they are hidden by this deletion.
+          // they are hidden by this deletion (or a range tombstone, which
+          // then covers all of them as well).
           SaveKey(ikey.user_key, skip);
           skipping = true;
           break;
         case kTypeValue:
+        case kTypeBlobIndex:
           if (skipping &&
               user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
             // Entry hidden
           } else {
             valid_ = true;
             saved_key_.clear();
+            value_is_blob_index_ = (ikey.type == kTypeBlobIndex);
+            blob_loaded_ = false;
             return;
           }
           break;
+        case kTypeMerge:
+          if (skipping &&
+              user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
+            // Entry hidden
+          } else {
+            SaveKey(ikey.user_key, &saved_key_);
+            valid_ = MergeForward();
+            merged_ = valid_;
+            value_is_blob_index_ = false;
+            if (!valid_) {
+              saved_key_.clear();
+              ClearSavedValue();
+            }
+            return;
+          }
+          break;
+        case kTypeRangeDeletion:
+          // Never yielded by internal iterators
+          break;
       }
     }
     iter_->Next();
@@ -206,14 +334,82 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   valid_ = false;
 }
 
+// Combines the merge operand at iter_ with the older entries of saved_key_
+// into saved_value_, leaving iter_ past the entries used.
+bool DBIter::MergeForward() {
+  MergeContext merge_context;
+  merge_context.AddOlder(iter_->value());
+  ValueType base_type = kTypeDeletion;
+  for (iter_->Next(); iter_->Valid(); iter_->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseKey(&ikey)) {
+      return false;
+    }
+    if (user_comparator_->Compare(ikey.user_key, saved_key_) != 0) {
+      break;
+    }
+    const ValueType type = EffectiveType(ikey);
+    if (type == kTypeMerge) {
+      merge_context.AddOlder(iter_->value());
+      continue;
+    }
+    if (type == kTypeValue || type == kTypeBlobIndex) {
+      base_type = type;
+    }
+    break;
+  }
+  return MergeOperands(merge_context, base_type,
+                       base_type == kTypeDeletion ? Slice() : iter_->value());
+}
+
+// Applies the operands of saved_key_ to "base", the raw value of type
+// "base_type", or to no value if "base_type" is kTypeDeletion, and stores
+// the result in saved_value_.
+bool DBIter::MergeOperands(const MergeContext& merge_context,
+                           ValueType base_type, const Slice& base) {
+  Status s;
+  std::string blob_value;
+  Slice existing_value = base;
+  if (base_type == kTypeBlobIndex) {
+    s = db_->ReadBlob(read_options_, base, &blob_value);
+    existing_value = blob_value;
+  }
+  if (s.ok()) {
+    s = merge_context.Merge(
+        merge_operator_, saved_key_,
+        base_type == kTypeDeletion ? nullptr : &existing_value, &saved_value_);
+  }
+  if (!s.ok()) {
+    status_ = s;
+    return false;
+  }
+  return true;
+}
+
 void DBIter::Prev() {
   assert(valid_);
 
+  if (prefix_extractor_ != nullptr) {
+    valid_ = false;
+    status_ = Status::NotSupported("Prev() with prefix_same_as_start");
+    return;
+  }
+
   if (direction_ == kForward) {  // Switch directions?
     // iter_ is pointing at the current entry.  Scan backwards until
     // the key changes so we can use the normal reverse scanning code.
+    if (merged_) {
+      // iter_ is past the entries for this->key(), so go back to the first.
+      merged_ = false;
+      std::string seek_key;
+      AppendInternalKey(&seek_key, ParsedInternalKey(saved_key_,
+                                                     kMaxSequenceNumber,
+                                                     kValueTypeForSeek));
+      iter_->Seek(seek_key);
+    } else {
+      SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+    }
     assert(iter_->Valid());  // Otherwise valid_ would have been false
-    SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
     while (true) {
       iter_->Prev();
       if (!iter_->Valid()) {
@@ -237,19 +433,34 @@ void DBIter::FindPrevUserEntry() {
   assert(direction_ == kReverse);
 
   ValueType value_type = kTypeDeletion;
+  // The type of saved_value_ that merge operands of saved_key_ apply to,
+  // kTypeDeletion if none.
+  ValueType base_type = kTypeDeletion;
+  MergeContext merge_context;
   if (iter_->Valid()) {
     do {
       ParsedInternalKey ikey;
       if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+        if (lower_bound_ != nullptr &&
+            user_comparator_->Compare(ikey.user_key, *lower_bound_) < 0) {
+          // Every entry from here on is before the bound.
+          break;
+        }
         if ((value_type != kTypeDeletion) &&
             user_comparator_->Compare(ikey.user_key, saved_key_) < 0) {
           // We encountered a non-deleted value in entries for previous keys,
           break;
         }
-        value_type = ikey.type;
+        value_type = EffectiveType(ikey);
         if (value_type == kTypeDeletion) {
           saved_key_.clear();
           ClearSavedValue();
+          base_type = kTypeDeletion;
+          merge_context.Clear();
+        } else if (value_type == kTypeMerge) {
+          // Entries of a key are met from oldest to newest.
+          SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+          merge_context.AddNewer(iter_->value());
         } else {
           Slice raw_value = iter_->value();
           if (saved_value_.capacity() > raw_value.size() + 1048576) {
@@ -258,6 +469,8 @@ void DBIter::FindPrevUserEntry() {
           }
           SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
           saved_value_.assign(raw_value.data(), raw_value.size());
+          base_type = value_type;
+          merge_context.Clear();
         }
       }
       iter_->Prev();
@@ -270,17 +483,36 @@ void DBIter::FindPrevUserEntry() {
     saved_key_.clear();
     ClearSavedValue();
     direction_ = kForward;
+  } else if (value_type == kTypeMerge &&
+             !MergeOperands(merge_context, base_type, saved_value_)) {
+    valid_ = false;
+    saved_key_.clear();
+    ClearSavedValue();
+    direction_ = kForward;
   } else {
     valid_ = true;
+    value_is_blob_index_ = (value_type == kTypeBlobIndex);
+    blob_loaded_ = false;
   }
 }
 
 void DBIter::Seek(const Slice& target) {
+  if (lower_bound_ != nullptr &&
+      user_comparator_->Compare(target, *lower_bound_) < 0) {
+    Seek(*lower_bound_);
+    return;
+  }
   direction_ = kForward;
   ClearSavedValue();
   saved_key_.clear();
   AppendInternalKey(&saved_key_,
                     ParsedInternalKey(target, sequence_, kValueTypeForSeek));
+  prefix_bounded_ =
+      prefix_extractor_ != nullptr && prefix_extractor_->InDomain(target);
+  if (prefix_bounded_) {
+    Slice prefix = prefix_extractor_->Transform(target);
+    prefix_.assign(prefix.data(), prefix.size());
+  }
   iter_->Seek(saved_key_);
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
@@ -290,8 +522,13 @@ void DBIter::Seek(const Slice& target) {
 }
 
 void DBIter::SeekToFirst() {
+  if (lower_bound_ != nullptr) {
+    Seek(*lower_bound_);
+    return;
+  }
   direction_ = kForward;
   ClearSavedValue();
+  prefix_bounded_ = false;
   iter_->SeekToFirst();
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
@@ -301,9 +538,29 @@ void DBIter::SeekToFirst() {
 }
 
 void DBIter::SeekToLast() {
+  if (prefix_extractor_ != nullptr) {
+    valid_ = false;
+    status_ = Status::NotSupported("SeekToLast() with prefix_same_as_start");
+    return;
+  }
   direction_ = kReverse;
+  merged_ = false;
   ClearSavedValue();
-  iter_->SeekToLast();
+  if (upper_bound_ != nullptr) {
+    // Start from the last entry before the bound.
+    saved_key_.clear();
+    AppendInternalKey(&saved_key_, ParsedInternalKey(*upper_bound_,
+                                                     kMaxSequenceNumber,
+                                                     kValueTypeForSeek));
+    iter_->Seek(saved_key_);
+    if (iter_->Valid()) {
+      iter_->Prev();
+    } else {
+      iter_->SeekToLast();
+    }
+  } else {
+    iter_->SeekToLast();
+  }
   FindPrevUserEntry();
 }
 
@@ -311,8 +568,13 @@ void DBIter::SeekToLast() {
 
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+                        uint32_t seed,
+                        const std::vector<RangeTombstoneList*>& range_dels,
+                        const ReadOptions& options,
+                        const SliceTransform* prefix_extractor,
+                        const MergeOperator* merge_operator) {
+  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed,
+                    range_dels, options, prefix_extractor, merge_operator);
 }
 
 }  // namespace leveldb
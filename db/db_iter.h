@@ -7,19 +7,32 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 #include "db/dbformat.h"
 #include "leveldb/db.h"
 
 namespace leveldb {
 
 class DBImpl;
+class MergeOperator;
+class RangeTombstoneList;
+class SliceTransform;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys.  Entries covered by a range tombstone of
+// one of "range_dels" are hidden; the iterator takes over a reference to
+// each of these lists.  The bounds of "options" limit the keys yielded,
+// "prefix_extractor" is used for ReadOptions::prefix_same_as_start, and
+// "merge_operator" combines merge operands with the values they apply to.
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed);
+                        uint32_t seed,
+                        const std::vector<RangeTombstoneList*>& range_dels,
+                        const ReadOptions& options,
+                        const SliceTransform* prefix_extractor,
+                        const MergeOperator* merge_operator);
 
 }  // namespace leveldb
 
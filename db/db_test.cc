@@ -4,6 +4,7 @@
 
 #include "leveldb/db.h"
 
+#include <algorithm>
 #include <atomic>
 #include <string>
 
@@ -12,11 +13,17 @@
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/merge_operator.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
+#include "table/block.h"
+#include "table/format.h"
+#include "util/coding.h"
 #include "util/hash.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -120,6 +127,9 @@ class SpecialEnv : public EnvWrapper {
   bool count_random_reads_;
   AtomicCounter random_read_counter_;
 
+  // Counts SyncFlushed() calls on sstables and logs.
+  AtomicCounter sync_flushed_counter_;
+
   explicit SpecialEnv(Env* base)
       : EnvWrapper(base),
         delay_data_sync_(false),
@@ -158,6 +168,19 @@ class SpecialEnv : public EnvWrapper {
         }
         return base_->Sync();
       }
+      bool SupportsConcurrentSync() const {
+        return base_->SupportsConcurrentSync();
+      }
+      Status SyncFlushed() {
+        if (env_->data_sync_error_.load(std::memory_order_acquire)) {
+          return Status::IOError("simulated data sync error");
+        }
+        while (env_->delay_data_sync_.load(std::memory_order_acquire)) {
+          DelayMilliseconds(100);
+        }
+        env_->sync_flushed_counter_.Increment();
+        return base_->SyncFlushed();
+      }
     };
     class ManifestFile : public WritableFile {
      private:
@@ -387,6 +410,14 @@ class DBTest {
             case kTypeDeletion:
               result += "DEL";
               break;
+            case kTypeMerge:
+              result += "+" + iter->value().ToString();
+              break;
+            case kTypeBlobIndex:
+              result += "BLOB";
+              break;
+            case kTypeRangeDeletion:
+              break;
           }
         }
         iter->Next();
@@ -407,6 +438,12 @@ class DBTest {
     return std::stoi(property);
   }
 
+  std::string Property(const std::string& name) {
+    std::string property;
+    ASSERT_TRUE(db_->GetProperty(name, &property));
+    return property;
+  }
+
   int TotalTableFiles() {
     int result = 0;
     for (int level = 0; level < config::kNumLevels; level++) {
@@ -509,6 +546,21 @@ class DBTest {
     return false;
   }
 
+  // Returns the numbers of the blob files in the database directory.
+  std::vector<uint64_t> BlobFileNumbers() {
+    std::vector<std::string> filenames;
+    env_->GetChildren(dbname_, &filenames);
+    std::vector<uint64_t> result;
+    uint64_t number;
+    FileType type;
+    for (size_t i = 0; i < filenames.size(); i++) {
+      if (ParseFileName(filenames[i], &number, &type) && type == kBlobFile) {
+        result.push_back(number);
+      }
+    }
+    return result;
+  }
+
   // Returns number of files renamed.
   int RenameLDBToSST() {
     std::vector<std::string> filenames;
@@ -612,6 +664,42 @@ TEST(DBTest, GetFromVersions) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, GetPinned) {
+  do {
+    ASSERT_OK(Put("foo", std::string(1000, 'a')));
+    ASSERT_OK(Put("bar", "vbar"));
+    PinnableSlice value;
+    ASSERT_OK(db_->Get(ReadOptions(), "foo", &value));
+    ASSERT_EQ(std::string(1000, 'a'), value.ToString());
+
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(db_->Get(ReadOptions(), "foo", &value));
+    ASSERT_TRUE(value.IsPinned());
+    ASSERT_EQ(std::string(1000, 'a'), value.ToString());
+
+    // The value stays valid after the table holding it is compacted away.
+    ASSERT_OK(Put("foo", "v2"));
+    ASSERT_OK(Delete("bar"));
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+    ASSERT_EQ(std::string(1000, 'a'), value.ToString());
+
+    ReadOptions no_fill;
+    no_fill.fill_cache = false;
+    ASSERT_OK(db_->Get(no_fill, "foo", &value));
+    ASSERT_EQ("v2", value.ToString());
+    ASSERT_TRUE(db_->Get(ReadOptions(), "bar", &value).IsNotFound());
+    ASSERT_EQ("", value.ToString());
+    ASSERT_TRUE(!value.IsPinned());
+
+    // Get() into a string copies out of pinned blocks.
+    std::string copy;
+    ASSERT_OK(db_->Get(ReadOptions(), "foo", &copy));
+    ASSERT_EQ("v2", copy);
+  } while (ChangeOptions());
+}
+
 TEST(DBTest, GetMemUsage) {
   do {
     ASSERT_OK(Put("foo", "v1"));
@@ -1449,193 +1537,1065 @@ TEST(DBTest, OverlapInLevel0) {
   } while (ChangeOptions());
 }
 
-TEST(DBTest, L0_CompactionBug_Issue44_a) {
-  Reopen();
-  ASSERT_OK(Put("b", "v"));
-  Reopen();
-  ASSERT_OK(Delete("b"));
-  ASSERT_OK(Delete("a"));
-  Reopen();
-  ASSERT_OK(Delete("a"));
-  Reopen();
-  ASSERT_OK(Put("a", "v"));
-  Reopen();
-  Reopen();
-  ASSERT_EQ("(a->v)", Contents());
-  DelayMilliseconds(1000);  // Wait for compaction to finish
-  ASSERT_EQ("(a->v)", Contents());
-}
+TEST(DBTest, L0SubLevels) {
+  // Keep the new tables below in level-0 by covering their range in
+  // level-1.
+  MakeTables(2, "a", "z");
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+
+  // Disjoint tables share a sub-level.
+  ASSERT_OK(Put("b1", "v1"));
+  ASSERT_OK(Put("b2", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("d1", "v1"));
+  ASSERT_OK(Put("d2", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("2,1,1", FilesPerLevel());
+  ASSERT_EQ("1", Property("leveldb.num-l0-sublevels"));
+
+  // A table overlapping both goes above them.
+  ASSERT_OK(Put("b2", "v2"));
+  ASSERT_OK(Put("d1", "v2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("3,1,1", FilesPerLevel());
+  ASSERT_EQ("2", Property("leveldb.num-l0-sublevels"));
+
+  ASSERT_EQ("v1", Get("b1"));
+  ASSERT_EQ("v2", Get("b2"));
+  ASSERT_EQ("v2", Get("d1"));
+  ASSERT_EQ("v1", Get("d2"));
+  ASSERT_EQ("(a->begin)(b1->v1)(b2->v2)(d1->v2)(d2->v1)(z->end)",
+            Contents());
 
-TEST(DBTest, L0_CompactionBug_Issue44_b) {
-  Reopen();
-  Put("", "");
-  Reopen();
-  Delete("e");
-  Put("", "");
-  Reopen();
-  Put("c", "cv");
-  Reopen();
-  Put("", "");
-  Reopen();
-  Put("", "");
-  DelayMilliseconds(1000);  // Wait for compaction to finish
-  Reopen();
-  Put("d", "dv");
-  Reopen();
-  Put("", "");
-  Reopen();
-  Delete("d");
-  Delete("b");
   Reopen();
-  ASSERT_EQ("(->)(c->cv)", Contents());
-  DelayMilliseconds(1000);  // Wait for compaction to finish
-  ASSERT_EQ("(->)(c->cv)", Contents());
+  ASSERT_EQ("2", Property("leveldb.num-l0-sublevels"));
+  ASSERT_EQ("v2", Get("b2"));
+  ASSERT_EQ("v1", Get("d2"));
 }
 
-TEST(DBTest, Fflush_Issue474) {
-  static const int kNum = 100000;
-  Random rnd(test::RandomSeed());
-  for (int i = 0; i < kNum; i++) {
-    fflush(nullptr);
-    ASSERT_OK(Put(RandomKey(&rnd), RandomString(&rnd, 100)));
-  }
-}
+TEST(DBTest, IntraL0Compaction) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.compression = kNoCompression;
+  Reopen(&options);
 
-TEST(DBTest, ComparatorCheck) {
-  class NewComparator : public Comparator {
-   public:
-    const char* Name() const override { return "leveldb.NewComparator"; }
-    int Compare(const Slice& a, const Slice& b) const override {
-      return BytewiseComparator()->Compare(a, b);
+  // Make level-1 much larger than the level-0 tables written below.  The
+  // first table is pushed down to level-2, the overlapping second one
+  // stops at level-1.
+  Random rnd(301);
+  for (int t = 0; t < 2; t++) {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_OK(Put(Key(i), RandomString(&rnd, 10000)));
     }
-    void FindShortestSeparator(std::string* s, const Slice& l) const override {
-      BytewiseComparator()->FindShortestSeparator(s, l);
+    dbfull()->TEST_CompactMemTable();
+  }
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  const int level1_files = NumTableFilesAtLevel(1);
+  ASSERT_GT(level1_files, 0);
+
+  // Overlapping level-0 tables reach the compaction trigger.
+  for (int t = 0; t < config::kL0_CompactionTrigger; t++) {
+    for (int i = t; i < 100; i += 10) {
+      ASSERT_OK(Put(Key(i), "v" + NumberToString(t)));
     }
-    void FindShortSuccessor(std::string* key) const override {
-      BytewiseComparator()->FindShortSuccessor(key);
+    dbfull()->TEST_CompactMemTable();
+  }
+  for (int i = 0; i < 100 && NumTableFilesAtLevel(0) > 1; i++) {
+    DelayMilliseconds(10);
+  }
+
+  // They were merged among themselves instead of into level-1.
+  ASSERT_EQ(1, NumTableFilesAtLevel(0));
+  ASSERT_EQ("1", Property("leveldb.num-l0-sublevels"));
+  ASSERT_EQ(level1_files, NumTableFilesAtLevel(1));
+  for (int t = 0; t < config::kL0_CompactionTrigger; t++) {
+    for (int i = t; i < 100; i += 10) {
+      ASSERT_EQ("v" + NumberToString(t), Get(Key(i)));
     }
-  };
-  NewComparator cmp;
-  Options new_options = CurrentOptions();
-  new_options.comparator = &cmp;
-  Status s = TryReopen(&new_options);
-  ASSERT_TRUE(!s.ok());
-  ASSERT_TRUE(s.ToString().find("comparator") != std::string::npos)
-      << s.ToString();
+  }
+  ASSERT_EQ(10000u, Get(Key(99)).size());
 }
 
-TEST(DBTest, CustomComparator) {
-  class NumberComparator : public Comparator {
-   public:
-    const char* Name() const override { return "test.NumberComparator"; }
-    int Compare(const Slice& a, const Slice& b) const override {
-      return ToNumber(a) - ToNumber(b);
-    }
-    void FindShortestSeparator(std::string* s, const Slice& l) const override {
-      ToNumber(*s);  // Check format
-      ToNumber(l);   // Check format
+TEST(DBTest, TieredCompaction) {
+  Options options = CurrentOptions();
+  options.compaction_style = kTieredCompaction;
+  Reopen(&options);
+
+  // Every flush adds a run to level-0, and runs of similar size are merged
+  // among themselves.  Keys are not repeated within a memtable, which
+  // would move them to the hot tables.
+  Random rnd(301);
+  std::map<std::string, std::string> model;
+  for (int t = 0; t < 40; t++) {
+    const int offset = rnd.Uniform(500);
+    for (int i = 0; i < 50; i++) {
+      const std::string k = Key((offset + 7 * i) % 500);
+      const std::string v = RandomString(&rnd, 100);
+      ASSERT_OK(Put(k, v));
+      model[k] = v;
     }
-    void FindShortSuccessor(std::string* key) const override {
-      ToNumber(*key);  // Check format
+    dbfull()->TEST_CompactMemTable();
+    // Merges run in the background, and may lag behind the flushes.
+    int sublevels = std::stoi(Property("leveldb.num-l0-sublevels"));
+    for (int wait = 0;
+         wait < 100 && sublevels >= config::kL0_SlowdownWritesTrigger; wait++) {
+      DelayMilliseconds(10);
+      sublevels = std::stoi(Property("leveldb.num-l0-sublevels"));
     }
+    ASSERT_LT(sublevels, config::kL0_SlowdownWritesTrigger);
+  }
+  ASSERT_EQ(NumberToString(NumTableFilesAtLevel(0)), FilesPerLevel());
+  ASSERT_LT(NumTableFilesAtLevel(0), 10);
+  for (const auto& kv : model) {
+    ASSERT_EQ(kv.second, Get(kv.first));
+  }
 
-   private:
-    static int ToNumber(const Slice& x) {
-      // Check that there are no extra characters.
-      ASSERT_TRUE(x.size() >= 2 && x[0] == '[' && x[x.size() - 1] == ']')
-          << EscapeString(x);
-      int val;
-      char ignored;
-      ASSERT_TRUE(sscanf(x.ToString().c_str(), "[%i]%c", &val, &ignored) == 1)
-          << EscapeString(x);
-      return val;
-    }
-  };
-  NumberComparator cmp;
-  Options new_options = CurrentOptions();
-  new_options.create_if_missing = true;
-  new_options.comparator = &cmp;
-  new_options.filter_policy = nullptr;   // Cannot use bloom filters
-  new_options.write_buffer_size = 1000;  // Compact more often
-  DestroyAndReopen(&new_options);
-  ASSERT_OK(Put("[10]", "ten"));
-  ASSERT_OK(Put("[0x14]", "twenty"));
-  for (int i = 0; i < 2; i++) {
-    ASSERT_EQ("ten", Get("[10]"));
-    ASSERT_EQ("ten", Get("[0xa]"));
-    ASSERT_EQ("twenty", Get("[20]"));
-    ASSERT_EQ("twenty", Get("[0x14]"));
-    ASSERT_EQ("NOT_FOUND", Get("[15]"));
-    ASSERT_EQ("NOT_FOUND", Get("[0xf]"));
-    Compact("[0]", "[9999]");
+  // A manual compaction merges all runs into one.
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("1", Property("leveldb.num-l0-sublevels"));
+  ASSERT_EQ("1", FilesPerLevel());
+
+  // The database can switch back to leveled compaction.
+  Reopen();
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  for (const auto& kv : model) {
+    ASSERT_EQ(kv.second, Get(kv.first));
   }
+}
 
-  for (int run = 0; run < 2; run++) {
-    for (int i = 0; i < 1000; i++) {
-      char buf[100];
-      snprintf(buf, sizeof(buf), "[%d]", i * 10);
-      ASSERT_OK(Put(buf, buf));
+TEST(DBTest, TieredCompactionSpaceAmplification) {
+  Options options = CurrentOptions();
+  options.compaction_style = kTieredCompaction;
+  options.compression = kNoCompression;
+  Reopen(&options);
+
+  // Overwriting the same keys merges the runs back into one whenever the
+  // newer ones would outgrow the oldest twice over.  That leaves at most
+  // three runs, plus the ones flushed while a merge is still running.
+  Random rnd(301);
+  for (int t = 0; t < 30; t++) {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_OK(Put(Key(i), RandomString(&rnd, 1000)));
     }
-    Compact("[0]", "[1000000]");
+    dbfull()->TEST_CompactMemTable();
+    for (int wait = 0; wait < 100 && Size("", Key(100)) > 7 * 100 * 1000;
+         wait++) {
+      DelayMilliseconds(10);
+    }
+    ASSERT_LE(Size("", Key(100)), 7 * 100 * 1000);
   }
 }
 
-TEST(DBTest, ManualCompaction) {
-  ASSERT_EQ(config::kMaxMemCompactLevel, 2)
-      << "Need to update this test to match kMaxMemCompactLevel";
+TEST(DBTest, TieredCompactionKeepsOlderRunsHidden) {
+  Options options = CurrentOptions();
+  options.compaction_style = kTieredCompaction;
+  Reopen(&options);
 
-  MakeTables(3, "p", "q");
-  ASSERT_EQ("1,1,1", FilesPerLevel());
+  // The oldest run is large enough not to be merged automatically.
+  ASSERT_OK(Put("a", "v1"));
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put("a" + Key(i), std::string(1000, 'x')));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Delete("a"));
+  ASSERT_OK(Put("c", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("c", "v2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("3", Property("leveldb.num-l0-sublevels"));
 
-  // Compaction range falls before files
-  Compact("", "c");
-  ASSERT_EQ("1,1,1", FilesPerLevel());
+  // Merging the two runs holding "c" keeps the deletion of "a", which
+  // still hides the value in the oldest run.
+  Slice c("c");
+  db_->CompactRange(&c, &c);
+  ASSERT_EQ("2", Property("leveldb.num-l0-sublevels"));
+  ASSERT_EQ("[ DEL, v1 ]", AllEntriesFor("a"));
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ("v2", Get("c"));
 
-  // Compaction range falls after files
-  Compact("r", "z");
-  ASSERT_EQ("1,1,1", FilesPerLevel());
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("1", Property("leveldb.num-l0-sublevels"));
+  ASSERT_EQ("[ ]", AllEntriesFor("a"));
+  ASSERT_EQ("[ v2 ]", AllEntriesFor("c"));
+}
 
-  // Compaction range overlaps files
-  Compact("p1", "p9");
-  ASSERT_EQ("0,0,1", FilesPerLevel());
+TEST(DBTest, DeleteRange) {
+  do {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("b", "vb"));
+    ASSERT_OK(Put("c", "vc"));
+    ASSERT_OK(Put("d", "vd"));
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), "b", "d"));
+    ASSERT_EQ("va", Get("a"));
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("NOT_FOUND", Get("c"));
+    ASSERT_EQ("vd", Get("d"));
+    ASSERT_EQ("(a->va)(d->vd)", Contents());
 
-  // Populate a different range
-  MakeTables(3, "c", "e");
-  ASSERT_EQ("1,1,2", FilesPerLevel());
+    // Later writes are not affected.
+    ASSERT_OK(Put("c", "vc2"));
+    ASSERT_EQ("vc2", Get("c"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
 
-  // Compact just the new range
-  Compact("b", "f");
-  ASSERT_EQ("0,0,2", FilesPerLevel());
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("vc2", Get("c"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
 
-  // Compact all
-  MakeTables(1, "a", "z");
-  ASSERT_EQ("0,1,2", FilesPerLevel());
-  db_->CompactRange(nullptr, nullptr);
-  ASSERT_EQ("0,0,1", FilesPerLevel());
-}
+    Reopen();
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
 
-TEST(DBTest, DBOpen_Options) {
-  std::string dbname = test::TmpDir() + "/db_options_test";
-  DestroyDB(dbname, Options());
+    ASSERT_TRUE(db_->DeleteRange(WriteOptions(), "d", "a").IsInvalidArgument());
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), "d", "d"));
+    ASSERT_EQ("vd", Get("d"));
+  } while (ChangeOptions());
+}
 
-  // Does not exist, and create_if_missing == false: error
-  DB* db = nullptr;
-  Options opts;
-  opts.create_if_missing = false;
-  Status s = DB::Open(opts, dbname, &db);
-  ASSERT_TRUE(strstr(s.ToString().c_str(), "does not exist") != nullptr);
-  ASSERT_TRUE(db == nullptr);
+TEST(DBTest, DeleteRangeAcrossLevels) {
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put(Key(i), "old"));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,0,1", FilesPerLevel());
 
-  // Does not exist, and create_if_missing == true: OK
-  opts.create_if_missing = true;
-  s = DB::Open(opts, dbname, &db);
-  ASSERT_OK(s);
-  ASSERT_TRUE(db != nullptr);
+  // The tombstone lands in a table above the data it covers.
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(20), Key(40)));
+  ASSERT_OK(Put(Key(30), "new"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+  ASSERT_EQ("old", Get(Key(19)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(20)));
+  ASSERT_EQ("new", Get(Key(30)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(39)));
+  ASSERT_EQ("old", Get(Key(40)));
 
-  delete db;
-  db = nullptr;
+  // A tombstone in the memtable hides values in tables.
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(0), Key(10)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(5)));
 
-  // Does exist, and error_if_exists == true: error
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_OK(iter->status());
+  delete iter;
+  ASSERT_EQ(100 - 10 - 20 + 1, count);
+
+  // Tables keep their tombstones in the descriptors rewritten on reopen.
+  Reopen();
+  Reopen();
+  ASSERT_EQ("NOT_FOUND", Get(Key(20)));
+  ASSERT_EQ("new", Get(Key(30)));
+
+  // Compactions drop the deleted entries, and the tombstones once at the
+  // bottom of the tree.
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ("[ ]", AllEntriesFor(Key(20)));
+  ASSERT_EQ("[ new ]", AllEntriesFor(Key(30)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(5)));
+  ASSERT_EQ("new", Get(Key(30)));
+  ASSERT_EQ("old", Get(Key(99)));
+
+  Reopen();
+  ASSERT_EQ("NOT_FOUND", Get(Key(25)));
+  ASSERT_EQ("old", Get(Key(10)));
+}
+
+TEST(DBTest, DeleteRangeSnapshot) {
+  ASSERT_OK(Put("foo", "v1"));
+  const Snapshot* s1 = db_->GetSnapshot();
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "a", "z"));
+  ASSERT_EQ("NOT_FOUND", Get("foo"));
+  ASSERT_EQ("v1", Get("foo", s1));
+
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("NOT_FOUND", Get("foo"));
+  ASSERT_EQ("v1", Get("foo", s1));
+  ASSERT_EQ("[ v1 ]", AllEntriesFor("foo"));
+
+  // Nothing needs the entry once the snapshot is gone.
+  db_->ReleaseSnapshot(s1);
+  ASSERT_OK(Put("a", "va"));
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("[ ]", AllEntriesFor("foo"));
+  ASSERT_EQ("NOT_FOUND", Get("foo"));
+  ASSERT_EQ("(a->va)", Contents());
+}
+
+TEST(DBTest, DeleteRangeCachedTombstones) {
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(Put(Key(i), "v"));
+  }
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(0), Key(2)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(1)));
+  Iterator* before = db_->NewIterator(ReadOptions());
+
+  // A tombstone added after the memtable built its list is seen by reads
+  // that start later, but not by an iterator created before it.
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(4), Key(6)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(1)));
+  ASSERT_EQ("v", Get(Key(3)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(5)));
+  int count = 0;
+  for (before->SeekToFirst(); before->Valid(); before->Next()) {
+    count++;
+  }
+  ASSERT_EQ(8, count);
+  delete before;
+
+  // Once flushed, the tombstones are shared from the version.
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(8), Key(9)));
+  for (int round = 0; round < 2; round++) {
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    std::string keys;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      keys += iter->key().ToString().back();
+    }
+    ASSERT_OK(iter->status());
+    delete iter;
+    ASSERT_EQ("23679", keys);
+  }
+  ASSERT_EQ("NOT_FOUND", Get(Key(8)));
+}
+
+TEST(DBTest, DeleteRangeDropsCoveredFiles) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.compression = kNoCompression;
+  env_->count_random_reads_ = true;
+  Reopen(&options);
+
+  Random rnd(301);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put(Key(i), RandomString(&rnd, 1000)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(0), Key(100)));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+
+  // The level-2 table is dropped without reading any of its blocks.
+  env_->random_read_counter_.Reset();
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+  ASSERT_EQ("", FilesPerLevel());
+  ASSERT_EQ("NOT_FOUND", Get(Key(50)));
+  ASSERT_EQ("", Contents());
+}
+
+namespace {
+
+// Drops the value "drop" and replaces the value "change" with "changed".
+class TestCompactionFilter : public CompactionFilter {
+ public:
+  const char* Name() const override { return "TestCompactionFilter"; }
+
+  bool Filter(int level, const Slice& key, const Slice& existing_value,
+              std::string* new_value, bool* value_changed) const override {
+    if (existing_value == "drop") {
+      return true;
+    }
+    if (existing_value == "change") {
+      new_value->assign("changed");
+      *value_changed = true;
+    }
+    return false;
+  }
+};
+
+std::string TimestampedValue(const std::string& value, uint64_t micros) {
+  std::string result = value;
+  PutFixed32(&result, static_cast<uint32_t>(micros / 1000000));
+  return result;
+}
+
+}  // namespace
+
+TEST(DBTest, CompactionFilter) {
+  TestCompactionFilter filter;
+  Options options = CurrentOptions();
+  options.compaction_filter = &filter;
+  Reopen(&options);
+
+  ASSERT_OK(Put("a", "keep"));
+  ASSERT_OK(Put("b", "drop"));
+  ASSERT_OK(Put("c", "change"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+
+  // Flushes do not filter; compactions do.
+  ASSERT_EQ("drop", Get("b"));
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("0,0,0,1", FilesPerLevel());
+  ASSERT_EQ("keep", Get("a"));
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+  ASSERT_EQ("changed", Get("c"));
+  ASSERT_EQ("[ ]", AllEntriesFor("b"));
+}
+
+TEST(DBTest, CompactionFilterShadowsOlderValues) {
+  TestCompactionFilter filter;
+  Options options = CurrentOptions();
+  options.compaction_filter = &filter;
+  Reopen(&options);
+
+  ASSERT_OK(Put("a", "old"));
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_OK(Put("a", "mid"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("a", "drop"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,1,1,1", FilesPerLevel());
+
+  // The level-3 value must not reappear once the newer one is filtered.
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("0,0,1,1", FilesPerLevel());
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ("[ DEL, old ]", AllEntriesFor("a"));
+}
+
+TEST(DBTest, CompactionFilterSkipsSnapshots) {
+  TestCompactionFilter filter;
+  Options options = CurrentOptions();
+  options.compaction_filter = &filter;
+  Reopen(&options);
+
+  ASSERT_OK(Put("a", "drop"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("drop", Get("a", snapshot));
+  ASSERT_EQ("drop", Get("a"));
+
+  db_->ReleaseSnapshot(snapshot);
+  dbfull()->TEST_CompactRange(3, nullptr, nullptr);
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+}
+
+TEST(DBTest, TTLCompactionFilter) {
+  const CompactionFilter* filter = NewTTLCompactionFilter(env_, 3600);
+  Options options = CurrentOptions();
+  options.compaction_filter = filter;
+  Reopen(&options);
+
+  const uint64_t now = env_->NowMicros();
+  const std::string fresh = TimestampedValue("fresh", now);
+  ASSERT_OK(Put("expired", TimestampedValue("old", now - 7200 * 1000000ull)));
+  ASSERT_OK(Put("fresh", fresh));
+  ASSERT_OK(Put("short", "v"));
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("NOT_FOUND", Get("expired"));
+  ASSERT_EQ(fresh, Get("fresh"));
+  ASSERT_EQ("v", Get("short"));
+
+  Close();
+  delete filter;
+}
+
+TEST(DBTest, Merge) {
+  const MergeOperator* merge_operator = NewStringAppendOperator(',');
+  Options options = CurrentOptions();
+  options.merge_operator = merge_operator;
+  Reopen(&options);
+
+  ASSERT_OK(Put("a", "x"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "y"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "b", "1"));
+  ASSERT_EQ("x,y", Get("a"));
+  ASSERT_EQ("1", Get("b"));
+  ASSERT_EQ("(a->x,y)(b->1)", Contents());
+
+  // Operands in the memtable apply to values in tables.
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "z"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "b", "2"));
+  ASSERT_EQ("x,y,z", Get("a"));
+  ASSERT_EQ("1,2", Get("b"));
+  ASSERT_EQ("(a->x,y,z)(b->1,2)", Contents());
+
+  // Deletions end the operands that apply.
+  ASSERT_OK(Delete("a"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "w"));
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "b", "c"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "b", "3"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "c", "4"));
+  ASSERT_EQ("w", Get("a"));
+  ASSERT_EQ("3", Get("b"));
+  ASSERT_EQ("(a->w)(b->3)(c->4)", Contents());
+
+  // Changing direction on a merged entry.
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->Seek("b");
+  ASSERT_EQ("b->3", IterStatus(iter));
+  iter->Next();
+  ASSERT_EQ("c->4", IterStatus(iter));
+  iter->Prev();
+  ASSERT_EQ("b->3", IterStatus(iter));
+  iter->Prev();
+  ASSERT_EQ("a->w", IterStatus(iter));
+  iter->Next();
+  ASSERT_EQ("b->3", IterStatus(iter));
+  ASSERT_OK(iter->status());
+  delete iter;
+
+  Close();
+  delete merge_operator;
+}
+
+TEST(DBTest, MergeCompaction) {
+  const MergeOperator* merge_operator = NewStringAppendOperator(',');
+  Options options = CurrentOptions();
+  options.merge_operator = merge_operator;
+  Reopen(&options);
+
+  ASSERT_OK(Put("a", "x"));
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "y"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "z"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,1,1,1", FilesPerLevel());
+  ASSERT_EQ("x,y,z", Get("a"));
+
+  // The value is in a deeper level, so the operands are only combined.
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("[ +y,z, x ]", AllEntriesFor("a"));
+  ASSERT_EQ("x,y,z", Get("a"));
+
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("[ x,y,z ]", AllEntriesFor("a"));
+  ASSERT_EQ("x,y,z", Get("a"));
+
+  Close();
+  delete merge_operator;
+}
+
+TEST(DBTest, MergeSnapshots) {
+  const MergeOperator* merge_operator = NewStringAppendOperator(',');
+  Options options = CurrentOptions();
+  options.merge_operator = merge_operator;
+  Reopen(&options);
+
+  ASSERT_OK(Put("a", "x"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "y"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "z"));
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("x", Get("a", snapshot));
+  ASSERT_EQ("x,y,z", Get("a"));
+  ASSERT_EQ("[ +z, +y, x ]", AllEntriesFor("a"));
+
+  db_->ReleaseSnapshot(snapshot);
+  dbfull()->TEST_CompactRange(3, nullptr, nullptr);
+  ASSERT_EQ("[ x,y,z ]", AllEntriesFor("a"));
+
+  Close();
+  delete merge_operator;
+}
+
+TEST(DBTest, MergeCounters) {
+  const MergeOperator* merge_operator = NewUInt64AddOperator();
+  Options options = CurrentOptions();
+  options.merge_operator = merge_operator;
+  Reopen(&options);
+
+  std::string one;
+  PutFixed64(&one, 1);
+  for (int i = 0; i < 30; i++) {
+    ASSERT_OK(db_->Merge(WriteOptions(), Key(i % 3), one));
+    if (i % 10 == 9) {
+      dbfull()->TEST_CompactMemTable();
+    }
+  }
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(8, Get(Key(i)).size());
+    ASSERT_EQ(10, DecodeFixed64(Get(Key(i)).data()));
+  }
+  dbfull()->CompactRange(nullptr, nullptr);
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(10, DecodeFixed64(Get(Key(i)).data()));
+  }
+
+  // Operands the operator rejects are reported as corruption.
+  ASSERT_OK(db_->Merge(WriteOptions(), Key(0), "bad"));
+  std::string value;
+  ASSERT_TRUE(db_->Get(ReadOptions(), Key(0), &value).IsCorruption());
+
+  Close();
+  delete merge_operator;
+}
+
+TEST(DBTest, MergeWithoutOperator) {
+  ASSERT_TRUE(db_->Merge(WriteOptions(), "a", "b").IsNotSupportedError());
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+}
+
+namespace {
+
+struct HotMerger {
+  DB* db;
+  std::string operand;
+  int merges;
+  Status status;
+  std::atomic<bool> done;
+};
+
+static void HotMergerBody(void* arg) {
+  HotMerger* m = reinterpret_cast<HotMerger*>(arg);
+  for (int i = 0; i < m->merges && m->status.ok(); i++) {
+    m->status = m->db->Merge(WriteOptions(), "hot", m->operand);
+  }
+  m->done.store(true, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST(DBTest, MergeHotKey) {
+  const MergeOperator* merge_operator = NewUInt64AddOperator();
+  Options options = CurrentOptions();
+  options.merge_operator = merge_operator;
+  Reopen(&options);
+
+  // Keys written more than once in a memtable move to the hot tables when
+  // it is flushed, and are merged in place from then on.
+  std::string zero, one, seven;
+  PutFixed64(&zero, 0);
+  PutFixed64(&one, 1);
+  PutFixed64(&seven, 7);
+  ASSERT_OK(Put("hot", zero));
+  ASSERT_OK(Put("hot", seven));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(db_->Merge(WriteOptions(), "hot", one));
+  ASSERT_EQ(8, DecodeFixed64(Get("hot").data()));
+
+  // A deleted hot key has no value for the operands to apply to.
+  ASSERT_OK(Delete("hot"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "hot", seven));
+  ASSERT_EQ(seven, Get("hot"));
+
+  // Concurrent merges of a hot key do not lose updates.
+  const int kMergers = 4;
+  const int kMerges = 1000;
+  HotMerger mergers[kMergers];
+  for (int i = 0; i < kMergers; i++) {
+    mergers[i].db = db_;
+    mergers[i].operand = one;
+    mergers[i].merges = kMerges;
+    mergers[i].done.store(false, std::memory_order_release);
+    env_->StartThread(HotMergerBody, &mergers[i]);
+  }
+  for (int i = 0; i < kMergers; i++) {
+    while (!mergers[i].done.load(std::memory_order_acquire)) {
+      DelayMilliseconds(10);
+    }
+    ASSERT_OK(mergers[i].status);
+  }
+  ASSERT_EQ(7 + kMergers * kMerges, DecodeFixed64(Get("hot").data()));
+
+  Close();
+  delete merge_operator;
+}
+
+static std::string BlobValue(int i, char c) {
+  return std::string(200, c) + Key(i);
+}
+
+TEST(DBTest, BlobFiles) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 100;
+  Reopen(&options);
+
+  for (int i = 0; i < 50; i++) {
+    ASSERT_OK(Put(Key(i), i % 2 == 0 ? BlobValue(i, 'a') : Key(i)));
+  }
+  ASSERT_EQ(0, BlobFileNumbers().size());
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ(1, BlobFileNumbers().size());
+
+  for (int i = 0; i < 50; i++) {
+    ASSERT_EQ(i % 2 == 0 ? BlobValue(i, 'a') : Key(i), Get(Key(i)));
+  }
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int i = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next(), i++) {
+    ASSERT_EQ(Key(i), iter->key().ToString());
+    ASSERT_EQ(i % 2 == 0 ? BlobValue(i, 'a') : Key(i),
+              iter->value().ToString());
+  }
+  ASSERT_EQ(50, i);
+  for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+    i--;
+    ASSERT_EQ(i % 2 == 0 ? BlobValue(i, 'a') : Key(i),
+              iter->value().ToString());
+  }
+  ASSERT_EQ(0, i);
+  ASSERT_OK(iter->status());
+  delete iter;
+
+  // Compactions keep the references.
+  ASSERT_OK(Put(Key(0), "small"));
+  ASSERT_OK(Put(Key(1), BlobValue(1, 'b')));
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ(2, BlobFileNumbers().size());
+
+  Reopen(&options);
+  ASSERT_EQ("small", Get(Key(0)));
+  ASSERT_EQ(BlobValue(1, 'b'), Get(Key(1)));
+  ASSERT_EQ(BlobValue(2, 'a'), Get(Key(2)));
+  ASSERT_EQ(Key(3), Get(Key(3)));
+}
+
+TEST(DBTest, BlobFilesVerifyChecksums) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 100;
+  Reopen(&options);
+
+  ASSERT_OK(Put(Key(0), BlobValue(0, 'a')));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(1, BlobFileNumbers().size());
+  const std::string fname = BlobFileName(dbname_, BlobFileNumbers()[0]);
+  std::string contents;
+  ASSERT_OK(ReadFileToString(env_, fname, &contents));
+  contents[contents.size() / 2] ^= 0x1;
+  ASSERT_OK(WriteStringToFile(env_, contents, fname));
+
+  // Iterators read blob values with the options they were created with.
+  ReadOptions read_options;
+  for (int verify = 0; verify < 2; verify++) {
+    read_options.verify_checksums = (verify == 1);
+    Iterator* iter = db_->NewIterator(read_options);
+    iter->SeekToFirst();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_NE(BlobValue(0, 'a'), iter->value().ToString());
+    if (read_options.verify_checksums) {
+      ASSERT_TRUE(iter->status().IsCorruption());
+    } else {
+      ASSERT_OK(iter->status());
+    }
+    delete iter;
+  }
+}
+
+TEST(DBTest, BlobGarbageCollection) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 100;
+  options.blob_gc_garbage_ratio = 0.5;
+  Reopen(&options);
+
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put(Key(i), BlobValue(i, 'a')));
+  }
+  dbfull()->TEST_CompactMemTable();
+  const std::vector<uint64_t> first = BlobFileNumbers();
+  ASSERT_EQ(1, first.size());
+
+  // Most values of the first blob file become garbage...
+  for (int i = 0; i < 60; i++) {
+    ASSERT_OK(Put(Key(i), BlobValue(i, 'b')));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+
+  // ...so a compaction is scheduled to move the others elsewhere, although
+  // the database is idle.
+  std::vector<uint64_t> blobs;
+  for (int i = 0; i < 1000; i++) {
+    blobs = BlobFileNumbers();
+    if (std::find(blobs.begin(), blobs.end(), first[0]) == blobs.end()) {
+      break;
+    }
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ(2, blobs.size());
+  ASSERT_TRUE(std::find(blobs.begin(), blobs.end(), first[0]) == blobs.end());
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+
+  Reopen(&options);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(BlobValue(i, i < 60 ? 'b' : 'a'), Get(Key(i)));
+  }
+
+  // Blob files none of whose values are used are deleted.
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put(Key(i), "small"));
+  }
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ(0, BlobFileNumbers().size());
+  ASSERT_EQ("small", Get(Key(50)));
+}
+
+TEST(DBTest, MergeBlobBase) {
+  const MergeOperator* merge_operator = NewStringAppendOperator(',');
+  Options options = CurrentOptions();
+  options.merge_operator = merge_operator;
+  options.min_blob_size = 100;
+  Reopen(&options);
+
+  const std::string base = BlobValue(0, 'a');
+  ASSERT_OK(Put("a", base));
+  dbfull()->TEST_CompactMemTable();
+  const std::vector<uint64_t> first = BlobFileNumbers();
+  ASSERT_EQ(1, first.size());
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "y"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "z"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(base + ",y,z", Get("a"));
+
+  // The operands are combined with the value read from the blob file, whose
+  // only record is then garbage, so the file is deleted.
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("[ " + base + ",y,z ]", AllEntriesFor("a"));
+  const std::vector<uint64_t> blobs = BlobFileNumbers();
+  ASSERT_TRUE(std::find(blobs.begin(), blobs.end(), first[0]) == blobs.end());
+
+  Reopen(&options);
+  ASSERT_EQ(base + ",y,z", Get("a"));
+
+  Close();
+  delete merge_operator;
+}
+
+TEST(DBTest, MergeRangeTombstone) {
+  const MergeOperator* merge_operator = NewStringAppendOperator(',');
+  Options options = CurrentOptions();
+  options.merge_operator = merge_operator;
+  options.min_blob_size = 100;
+  Reopen(&options);
+
+  ASSERT_OK(Put("a", BlobValue(0, 'a')));
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "x"));
+  dbfull()->TEST_CompactMemTable();
+  const std::vector<uint64_t> first = BlobFileNumbers();
+  ASSERT_EQ(1, first.size());
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "a", "b"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "y"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "z"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("y,z", Get("a"));
+
+  // The tombstone ends the chain: the operands under it and the value they
+  // applied to are dropped rather than combined.
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("y,z", Get("a"));
+  const std::vector<uint64_t> blobs = BlobFileNumbers();
+  ASSERT_TRUE(std::find(blobs.begin(), blobs.end(), first[0]) == blobs.end());
+
+  Reopen(&options);
+  ASSERT_EQ("y,z", Get("a"));
+
+  Close();
+  delete merge_operator;
+}
+
+TEST(DBTest, L0_CompactionBug_Issue44_a) {
+  Reopen();
+  ASSERT_OK(Put("b", "v"));
+  Reopen();
+  ASSERT_OK(Delete("b"));
+  ASSERT_OK(Delete("a"));
+  Reopen();
+  ASSERT_OK(Delete("a"));
+  Reopen();
+  ASSERT_OK(Put("a", "v"));
+  Reopen();
+  Reopen();
+  ASSERT_EQ("(a->v)", Contents());
+  DelayMilliseconds(1000);  // Wait for compaction to finish
+  ASSERT_EQ("(a->v)", Contents());
+}
+
+TEST(DBTest, L0_CompactionBug_Issue44_b) {
+  Reopen();
+  Put("", "");
+  Reopen();
+  Delete("e");
+  Put("", "");
+  Reopen();
+  Put("c", "cv");
+  Reopen();
+  Put("", "");
+  Reopen();
+  Put("", "");
+  DelayMilliseconds(1000);  // Wait for compaction to finish
+  Reopen();
+  Put("d", "dv");
+  Reopen();
+  Put("", "");
+  Reopen();
+  Delete("d");
+  Delete("b");
+  Reopen();
+  ASSERT_EQ("(->)(c->cv)", Contents());
+  DelayMilliseconds(1000);  // Wait for compaction to finish
+  ASSERT_EQ("(->)(c->cv)", Contents());
+}
+
+TEST(DBTest, Fflush_Issue474) {
+  static const int kNum = 100000;
+  Random rnd(test::RandomSeed());
+  for (int i = 0; i < kNum; i++) {
+    fflush(nullptr);
+    ASSERT_OK(Put(RandomKey(&rnd), RandomString(&rnd, 100)));
+  }
+}
+
+TEST(DBTest, ComparatorCheck) {
+  class NewComparator : public Comparator {
+   public:
+    const char* Name() const override { return "leveldb.NewComparator"; }
+    int Compare(const Slice& a, const Slice& b) const override {
+      return BytewiseComparator()->Compare(a, b);
+    }
+    void FindShortestSeparator(std::string* s, const Slice& l) const override {
+      BytewiseComparator()->FindShortestSeparator(s, l);
+    }
+    void FindShortSuccessor(std::string* key) const override {
+      BytewiseComparator()->FindShortSuccessor(key);
+    }
+  };
+  NewComparator cmp;
+  Options new_options = CurrentOptions();
+  new_options.comparator = &cmp;
+  Status s = TryReopen(&new_options);
+  ASSERT_TRUE(!s.ok());
+  ASSERT_TRUE(s.ToString().find("comparator") != std::string::npos)
+      << s.ToString();
+}
+
+TEST(DBTest, CustomComparator) {
+  class NumberComparator : public Comparator {
+   public:
+    const char* Name() const override { return "test.NumberComparator"; }
+    int Compare(const Slice& a, const Slice& b) const override {
+      return ToNumber(a) - ToNumber(b);
+    }
+    void FindShortestSeparator(std::string* s, const Slice& l) const override {
+      ToNumber(*s);  // Check format
+      ToNumber(l);   // Check format
+    }
+    void FindShortSuccessor(std::string* key) const override {
+      ToNumber(*key);  // Check format
+    }
+
+   private:
+    static int ToNumber(const Slice& x) {
+      // Check that there are no extra characters.
+      ASSERT_TRUE(x.size() >= 2 && x[0] == '[' && x[x.size() - 1] == ']')
+          << EscapeString(x);
+      int val;
+      char ignored;
+      ASSERT_TRUE(sscanf(x.ToString().c_str(), "[%i]%c", &val, &ignored) == 1)
+          << EscapeString(x);
+      return val;
+    }
+  };
+  NumberComparator cmp;
+  Options new_options = CurrentOptions();
+  new_options.create_if_missing = true;
+  new_options.comparator = &cmp;
+  new_options.filter_policy = nullptr;   // Cannot use bloom filters
+  new_options.write_buffer_size = 1000;  // Compact more often
+  DestroyAndReopen(&new_options);
+  ASSERT_OK(Put("[10]", "ten"));
+  ASSERT_OK(Put("[0x14]", "twenty"));
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ("ten", Get("[10]"));
+    ASSERT_EQ("ten", Get("[0xa]"));
+    ASSERT_EQ("twenty", Get("[20]"));
+    ASSERT_EQ("twenty", Get("[0x14]"));
+    ASSERT_EQ("NOT_FOUND", Get("[15]"));
+    ASSERT_EQ("NOT_FOUND", Get("[0xf]"));
+    Compact("[0]", "[9999]");
+  }
+
+  for (int run = 0; run < 2; run++) {
+    for (int i = 0; i < 1000; i++) {
+      char buf[100];
+      snprintf(buf, sizeof(buf), "[%d]", i * 10);
+      ASSERT_OK(Put(buf, buf));
+    }
+    Compact("[0]", "[1000000]");
+  }
+}
+
+TEST(DBTest, ManualCompaction) {
+  ASSERT_EQ(config::kMaxMemCompactLevel, 2)
+      << "Need to update this test to match kMaxMemCompactLevel";
+
+  MakeTables(3, "p", "q");
+  ASSERT_EQ("1,1,1", FilesPerLevel());
+
+  // Compaction range falls before files
+  Compact("", "c");
+  ASSERT_EQ("1,1,1", FilesPerLevel());
+
+  // Compaction range falls after files
+  Compact("r", "z");
+  ASSERT_EQ("1,1,1", FilesPerLevel());
+
+  // Compaction range overlaps files
+  Compact("p1", "p9");
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+
+  // Populate a different range
+  MakeTables(3, "c", "e");
+  ASSERT_EQ("1,1,2", FilesPerLevel());
+
+  // Compact just the new range
+  Compact("b", "f");
+  ASSERT_EQ("0,0,2", FilesPerLevel());
+
+  // Compact all
+  MakeTables(1, "a", "z");
+  ASSERT_EQ("0,1,2", FilesPerLevel());
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+}
+
+TEST(DBTest, DBOpen_Options) {
+  std::string dbname = test::TmpDir() + "/db_options_test";
+  DestroyDB(dbname, Options());
+
+  // Does not exist, and create_if_missing == false: error
+  DB* db = nullptr;
+  Options opts;
+  opts.create_if_missing = false;
+  Status s = DB::Open(opts, dbname, &db);
+  ASSERT_TRUE(strstr(s.ToString().c_str(), "does not exist") != nullptr);
+  ASSERT_TRUE(db == nullptr);
+
+  // Does not exist, and create_if_missing == true: OK
+  opts.create_if_missing = true;
+  s = DB::Open(opts, dbname, &db);
+  ASSERT_OK(s);
+  ASSERT_TRUE(db != nullptr);
+
+  delete db;
+  db = nullptr;
+
+  // Does exist, and error_if_exists == true: error
   opts.create_if_missing = false;
   opts.error_if_exists = true;
   s = DB::Open(opts, dbname, &db);
@@ -1915,6 +2875,517 @@ TEST(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+TEST(DBTest, PrefixSameAsStart) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.prefix_extractor = NewFixedPrefixTransform(4);
+  Reopen(&options);
+
+  // Three overlapping tables, each holding a third of the even prefixes.
+  const int kPrefixes = 300;
+  char buf[20];
+  for (int round = 0; round < 3; round++) {
+    for (int p = 2 * round; p < kPrefixes; p += 6) {
+      for (int i = 0; i < 10; i++) {
+        snprintf(buf, sizeof(buf), "p%03d/%d", p, i);
+        ASSERT_OK(Put(buf, buf));
+      }
+    }
+    dbfull()->TEST_CompactMemTable();
+  }
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  ReadOptions prefix_options;
+  prefix_options.prefix_same_as_start = true;
+  Iterator* iter = db_->NewIterator(prefix_options);
+
+  // Present prefixes only read the table that holds them.
+  env_->random_read_counter_.Reset();
+  for (int p = 0; p < kPrefixes; p += 2) {
+    snprintf(buf, sizeof(buf), "p%03d", p);
+    int count = 0;
+    for (iter->Seek(buf); iter->Valid(); iter->Next()) {
+      ASSERT_TRUE(iter->key().starts_with(buf));
+      count++;
+    }
+    ASSERT_OK(iter->status());
+    ASSERT_EQ(10, count);
+  }
+  // One data block each, or two for the few prefixes split across blocks.
+  int reads = env_->random_read_counter_.Read();
+  ASSERT_GE(reads, kPrefixes / 2);
+  ASSERT_LE(reads, kPrefixes / 2 + kPrefixes / 20);
+
+  // Missing prefixes rarely read any table.
+  env_->random_read_counter_.Reset();
+  for (int p = 1; p < kPrefixes; p += 2) {
+    snprintf(buf, sizeof(buf), "p%03d", p);
+    iter->Seek(buf);
+    ASSERT_TRUE(!iter->Valid());
+    ASSERT_OK(iter->status());
+  }
+  reads = env_->random_read_counter_.Read();
+  ASSERT_LE(reads, 3 * 3 * kPrefixes / 2 / 100);
+
+  // Keys without a prefix are not bounded.
+  iter->Seek("p00");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("p000/0", iter->key().ToString());
+  iter->Next();
+  ASSERT_TRUE(iter->Valid());
+
+  // Iterators with a prefix extractor only move forward.
+  iter->Prev();
+  ASSERT_TRUE(!iter->Valid());
+  ASSERT_TRUE(iter->status().IsNotSupportedError());
+  delete iter;
+
+  // Without prefix_same_as_start, seeks read every table and go on past
+  // the prefix.
+  iter = db_->NewIterator(ReadOptions());
+  env_->random_read_counter_.Reset();
+  iter->Seek("p101");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("p102/0", iter->key().ToString());
+  ASSERT_EQ(3, env_->random_read_counter_.Read());
+  delete iter;
+
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+  delete options.prefix_extractor;
+}
+
+TEST(DBTest, IterateUpperBound) {
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+    if (i == 50) {
+      dbfull()->TEST_CompactMemTable();
+    }
+  }
+  Slice upper_bound = "key000060";  // Key(60)
+  ReadOptions options;
+  options.iterate_upper_bound = &upper_bound;
+  Iterator* iter = db_->NewIterator(options);
+
+  int count = 0;
+  for (iter->Seek(Key(40)); iter->Valid(); iter->Next()) {
+    ASSERT_LT(iter->key().compare(upper_bound), 0);
+    count++;
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(20, count);
+
+  // Reverse iteration starts before the bound.
+  iter->SeekToLast();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ(Key(59), iter->key().ToString());
+  iter->Prev();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ(Key(58), iter->key().ToString());
+  iter->Next();
+  iter->Next();
+  ASSERT_TRUE(!iter->Valid());
+
+  iter->Seek(Key(70));
+  ASSERT_TRUE(!iter->Valid());
+  ASSERT_OK(iter->status());
+  delete iter;
+}
+
+TEST(DBTest, IterateBoundsSkipTables) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  Reopen(&options);
+
+  // Ten tables of 100 keys each, with disjoint ranges.
+  const std::string value(100, 'v');
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_OK(Put(Key(i), value));
+    if (i % 100 == 99) {
+      dbfull()->TEST_CompactMemTable();
+    }
+  }
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  // Scanning [250, 300) without bounds also reads the table after it.
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  env_->random_read_counter_.Reset();
+  int count = 0;
+  for (iter->Seek(Key(250));
+       iter->Valid() && iter->key().ToString() < Key(300); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(50, count);
+  const int unbounded_reads = env_->random_read_counter_.Read();
+  delete iter;
+
+  const std::string lower_key = Key(250);
+  const std::string upper_key = Key(300);
+  Slice lower_bound = lower_key;
+  Slice upper_bound = upper_key;
+  ReadOptions read_options;
+  read_options.iterate_lower_bound = &lower_bound;
+  read_options.iterate_upper_bound = &upper_bound;
+  iter = db_->NewIterator(read_options);
+  env_->random_read_counter_.Reset();
+  count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ASSERT_EQ(Key(250 + count), iter->key().ToString());
+    count++;
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(50, count);
+  // The same blocks are read, except for the one of the table after the
+  // bounds.
+  const int bounded_reads = env_->random_read_counter_.Read();
+  ASSERT_GT(bounded_reads, 0);
+  ASSERT_EQ(unbounded_reads - 1, bounded_reads);
+
+  // Reverse scans stay within the bounds too.
+  env_->random_read_counter_.Reset();
+  count = 0;
+  for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+    ASSERT_EQ(Key(299 - count), iter->key().ToString());
+    count++;
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(50, count);
+  ASSERT_LE(env_->random_read_counter_.Read(), bounded_reads);
+
+  // Seeks before the lower bound start at it.
+  iter->Seek(Key(100));
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ(Key(250), iter->key().ToString());
+  iter->Seek(Key(300));
+  ASSERT_TRUE(!iter->Valid());
+  delete iter;
+
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.block_cache;
+}
+
+TEST(DBTest, DirectIO) {
+  Options options = CurrentOptions();
+  options.use_direct_reads = true;
+  options.use_direct_io_for_flush_and_compaction = true;
+  Reopen(&options);
+
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 1000; i++) {
+    values.push_back(RandomString(&rnd, 1000));
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  dbfull()->TEST_CompactMemTable();
+  Compact("a", "z");
+  Reopen(&options);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+}
+
+TEST(DBTest, ParallelRecoveryFlushes) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 10 << 20;
+  Reopen(&options);
+
+  // Spread over two logs, each large enough for several memtables once
+  // the database is reopened with a smaller write buffer.
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 4000; i++) {
+    values.push_back(RandomString(&rnd, 1000));
+    ASSERT_OK(Put(Key(i % 3000), values[i]));
+    if (i == 2000) {
+      ASSERT_OK(dbfull()->TEST_CompactMemTable());
+    }
+  }
+
+  for (int flushes = 0; flushes <= 4; flushes += 4) {
+    options.write_buffer_size = 100000;
+    options.max_recovery_flushes = flushes;
+    Reopen(&options);
+    for (int i = 0; i < 3000; i++) {
+      ASSERT_EQ(values[i < 1000 ? i + 3000 : i], Get(Key(i)));
+    }
+    // Write the last value of every key again, for the next round.
+    options.write_buffer_size = 10 << 20;
+    Reopen(&options);
+    for (int i = 0; i < 3000; i++) {
+      ASSERT_OK(Put(Key(i), values[i < 1000 ? i + 3000 : i]));
+    }
+  }
+}
+
+TEST(DBTest, RecycleLogFiles) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;
+  options.recycle_log_file_num = 2;
+  Reopen(&options);
+
+  // Enough data for many memtable switches, each of which should reuse the
+  // log file the previous flush made obsolete.
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 2000; i++) {
+    values.push_back(RandomString(&rnd, 1000));
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int i = 0; i < 10; i++) {
+    values[i] = RandomString(&rnd, 100);
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+
+  // Logs written so far, other than the live ones, are either deleted or
+  // kept for recycling.
+  std::vector<std::string> filenames;
+  ASSERT_OK(env_->GetChildren(dbname_, &filenames));
+  int log_files = 0;
+  uint64_t number;
+  FileType type;
+  for (size_t i = 0; i < filenames.size(); i++) {
+    if (ParseFileName(filenames[i], &number, &type) && type == kLogFile) {
+      log_files++;
+    }
+  }
+  ASSERT_LE(log_files, 2 + 2 + 2);
+
+  // Recovery stops at the end of each recycled log.
+  Reopen(&options);
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+  options.recycle_log_file_num = 0;
+  Reopen(&options);
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+}
+
+// Checks that the table "fname" stores a zstd dictionary and that some of
+// its data blocks need the dictionary to be decompressed.
+static void CheckZstdDictionaryUsed(const std::string& fname) {
+  Env* env = Env::Default();
+  uint64_t file_size;
+  ASSERT_OK(env->GetFileSize(fname, &file_size));
+  RandomAccessFile* file;
+  ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+
+  char footer_space[Footer::kEncodedLength];
+  Slice footer_input;
+  ASSERT_OK(file->Read(file_size - Footer::kEncodedLength,
+                       Footer::kEncodedLength, &footer_input, footer_space));
+  Footer footer;
+  ASSERT_OK(footer.DecodeFrom(&footer_input));
+
+  ReadOptions opt;
+  opt.verify_checksums = true;
+  BlockContents contents;
+  ASSERT_OK(ReadBlock(file, opt, footer.metaindex_handle(), nullptr,
+                      &contents));
+  Block* meta = new Block(contents);
+  Iterator* meta_iter = meta->NewIterator(BytewiseComparator());
+  meta_iter->Seek(kZstdDictionaryBlockKey);
+  ASSERT_TRUE(meta_iter->Valid());
+  ASSERT_EQ(kZstdDictionaryBlockKey, meta_iter->key().ToString());
+  BlockHandle dict_handle;
+  Slice dict_value = meta_iter->value();
+  ASSERT_OK(dict_handle.DecodeFrom(&dict_value));
+  delete meta_iter;
+  delete meta;
+
+  ASSERT_OK(ReadBlock(file, opt, dict_handle, nullptr, &contents));
+  port::ZstdDecompressionDict* dict = new port::ZstdDecompressionDict(
+      contents.data.data(), contents.data.size());
+  if (contents.heap_allocated) {
+    delete[] contents.data.data();
+  }
+  ASSERT_TRUE(dict->ok());
+
+  ASSERT_OK(ReadBlock(file, opt, footer.index_handle(), nullptr, &contents));
+  Block* index = new Block(contents);
+  Iterator* index_iter = index->NewIterator(BytewiseComparator());
+  int blocks = 0;
+  int needing_dict = 0;
+  for (index_iter->SeekToFirst(); index_iter->Valid(); index_iter->Next()) {
+    BlockHandle handle;
+    Slice handle_value = index_iter->value();
+    ASSERT_OK(handle.DecodeFrom(&handle_value));
+    blocks++;
+    BlockContents block;
+    if (!ReadBlock(file, opt, handle, nullptr, &block).ok()) {
+      needing_dict++;
+    } else if (block.heap_allocated) {
+      delete[] block.data.data();
+    }
+    ASSERT_OK(ReadBlock(file, opt, handle, dict, &block));
+    if (block.heap_allocated) {
+      delete[] block.data.data();
+    }
+  }
+  ASSERT_OK(index_iter->status());
+  delete index_iter;
+  delete index;
+  ASSERT_GT(blocks, 0);
+  ASSERT_GT(needing_dict, 0);
+
+  delete dict;
+  delete file;
+}
+
+TEST(DBTest, ZstdDictionaryCompression) {
+  Options options = CurrentOptions();
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.compression = kZstdCompression;
+  options.block_size = 512;
+  options.zstd_max_train_bytes = 16 << 10;
+  options.zstd_max_dict_bytes = 4 << 10;
+  Reopen(&options);
+
+  // Small, similar records; without zstd the tables are written
+  // uncompressed, which still exercises the held back blocks.
+  const int N = 5000;
+  char value[100];
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < N; i++) {
+      snprintf(value, sizeof(value),
+               "{\"id\": %d, \"name\": \"user%d\", \"round\": %d}", i,
+               i * 7, round);
+      ASSERT_OK(Put(Key(i), value));
+    }
+    dbfull()->TEST_CompactMemTable();
+  }
+  // The second table overlaps the first, so it lands on a higher level
+  // and is then compacted into the bottommost one.
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(1));
+  ASSERT_GT(NumTableFilesAtLevel(2), 0);
+
+  for (int i = 0; i < N; i++) {
+    snprintf(value, sizeof(value),
+             "{\"id\": %d, \"name\": \"user%d\", \"round\": %d}", i,
+             i * 7, 1);
+    ASSERT_EQ(value, Get(Key(i)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(N, count);
+  delete iter;
+
+  std::string probe;
+  if (port::Zstd_Compress(1, value, strlen(value), &probe)) {
+    // Every output table carries a dictionary, and its data blocks cannot
+    // be decompressed without it.
+    std::vector<std::string> filenames;
+    ASSERT_OK(env_->GetChildren(dbname_, &filenames));
+    int tables = 0;
+    for (const std::string& filename : filenames) {
+      uint64_t number;
+      FileType type;
+      if (ParseFileName(filename, &number, &type) && type == kTableFile) {
+        tables++;
+        CheckZstdDictionaryUsed(dbname_ + "/" + filename);
+      }
+    }
+    ASSERT_GT(tables, 0);
+  }
+
+  Close();
+  delete options.filter_policy;
+}
+
+namespace {
+
+struct SyncWriter {
+  DB* db;
+  std::string key;
+  Status status;
+  std::atomic<bool> done;
+};
+
+static void SyncWriterBody(void* arg) {
+  SyncWriter* w = reinterpret_cast<SyncWriter*>(arg);
+  WriteOptions write_options;
+  write_options.sync = true;
+  w->status = w->db->Put(write_options, w->key, "v_" + w->key);
+  w->done.store(true, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST(DBTest, AsyncLogSync) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.async_log_sync = true;
+  Reopen(&options);
+
+  // While the sync of the first write is stalled, the following writes are
+  // logged and applied instead of queueing behind it.
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+  const int kWriters = 4;
+  SyncWriter writers[kWriters];
+  for (int i = 0; i < kWriters; i++) {
+    writers[i].db = db_;
+    writers[i].key = Key(i);
+    writers[i].done.store(false, std::memory_order_release);
+    env_->StartThread(SyncWriterBody, &writers[i]);
+  }
+  for (int i = 0; i < kWriters; i++) {
+    for (int tries = 0; Get(Key(i)) != "v_" + Key(i); tries++) {
+      ASSERT_LT(tries, 1000);
+      DelayMilliseconds(10);
+    }
+  }
+  for (int i = 0; i < kWriters; i++) {
+    ASSERT_TRUE(!writers[i].done.load(std::memory_order_acquire));
+  }
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  for (int i = 0; i < kWriters; i++) {
+    while (!writers[i].done.load(std::memory_order_acquire)) {
+      DelayMilliseconds(10);
+    }
+    ASSERT_OK(writers[i].status);
+  }
+  // The stalled sync, and at most one for all the writes behind it.
+  ASSERT_LE(env_->sync_flushed_counter_.Read(), 2);
+
+  WriteOptions write_options;
+  write_options.sync = true;
+  for (int i = kWriters; i < 100; i++) {
+    ASSERT_OK(db_->Put(write_options, Key(i), "v_" + Key(i)));
+  }
+  Reopen(&options);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ("v_" + Key(i), Get(Key(i)));
+  }
+
+  // A failed sync fails the write, and all later ones.
+  env_->data_sync_error_.store(true, std::memory_order_release);
+  ASSERT_TRUE(!db_->Put(write_options, "foo", "v1").ok());
+  env_->data_sync_error_.store(false, std::memory_order_release);
+  ASSERT_TRUE(!db_->Put(WriteOptions(), "foo", "v2").ok());
+  Close();
+}
+
 // Multi-threaded test:
 namespace {
 
@@ -2064,6 +3535,11 @@ class ModelDB : public DB {
         (*map_)[key.ToString()] = value.ToString();
       }
       void Delete(const Slice& key) override { map_->erase(key.ToString()); }
+      void DeleteRange(const Slice& begin_key,
+                       const Slice& end_key) override {
+        map_->erase(map_->lower_bound(begin_key.ToString()),
+                    map_->lower_bound(end_key.ToString()));
+      }
     };
     Handler handler;
     handler.map_ = &map_;
@@ -2226,6 +3702,59 @@ TEST(DBTest, Randomized) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, DeleteRangeRandomized) {
+  Random rnd(test::RandomSeed());
+  do {
+    ModelDB model(CurrentOptions());
+    const int N = 2000;
+    std::string k, k2, v;
+    for (int step = 0; step < N; step++) {
+      const int p = rnd.Uniform(100);
+      if (p < 70) {
+        k = RandomKey(&rnd);
+        v = RandomString(&rnd, rnd.Uniform(8));
+        ASSERT_OK(model.Put(WriteOptions(), k, v));
+        ASSERT_OK(db_->Put(WriteOptions(), k, v));
+      } else if (p < 85) {
+        k = RandomKey(&rnd);
+        ASSERT_OK(model.Delete(WriteOptions(), k));
+        ASSERT_OK(db_->Delete(WriteOptions(), k));
+      } else if (p < 90) {
+        k = RandomKey(&rnd);
+        k2 = RandomKey(&rnd);
+        if (k > k2) std::swap(k, k2);
+        ASSERT_OK(model.DeleteRange(WriteOptions(), k, k2));
+        ASSERT_OK(db_->DeleteRange(WriteOptions(), k, k2));
+      } else {
+        dbfull()->TEST_CompactRange(rnd.Uniform(config::kNumLevels - 1),
+                                    nullptr, nullptr);
+      }
+
+      if ((step % 200) == 0) {
+        ASSERT_TRUE(CompareIterators(step, &model, db_, nullptr, nullptr));
+        Iterator* model_iter = model.NewIterator(ReadOptions());
+        for (int i = 0; i < 20; i++) {
+          k = RandomKey(&rnd);
+          model_iter->Seek(k);
+          std::string expected = "NOT_FOUND";
+          if (model_iter->Valid() && model_iter->key() == k) {
+            expected = model_iter->value().ToString();
+          }
+          ASSERT_EQ(expected, Get(k));
+        }
+        delete model_iter;
+
+        // Reopening writes the memtable out to a table.
+        Reopen();
+        ASSERT_TRUE(CompareIterators(step, &model, db_, nullptr, nullptr));
+      }
+    }
+    ASSERT_TRUE(CompareIterators(N, &model, db_, nullptr, nullptr));
+    Reopen();
+    ASSERT_TRUE(CompareIterators(N, &model, db_, nullptr, nullptr));
+  } while (ChangeOptions());
+}
+
 std::string MakeKey(unsigned int num) {
   char buf[30];
   snprintf(buf, sizeof(buf), "%016u", num);
@@ -99,6 +99,20 @@ void InternalKeyComparator::FindShortSuccessor(std::string* key) const {
   }
 }
 
+bool InternalKeyComparator::OrderedPrefix(const Slice& key,
+                                          uint64_t* prefix) const {
+  // Keys sort by user key first, so the user key's prefix is ordered too.
+  return key.size() >= 8 &&
+         user_comparator_->OrderedPrefix(ExtractUserKey(key), prefix);
+}
+
+bool InternalKeyComparator::HashIndexKey(const Slice& key,
+                                         Slice* result) const {
+  // All versions of a user key are adjacent, so they share one entry.
+  return key.size() >= 8 &&
+         user_comparator_->HashIndexKey(ExtractUserKey(key), result);
+}
+
 const char* InternalFilterPolicy::Name() const { return user_policy_->Name(); }
 
 void InternalFilterPolicy::CreateFilter(const Slice* keys, int n,
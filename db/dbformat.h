@@ -27,10 +27,12 @@ static const int kNumLevels = 7;
 // Level-0 compaction is started when we hit this many files.
 static const int kL0_CompactionTrigger = 4;
 
-// Soft limit on number of level-0 files.  We slow down writes at this point.
+// Soft limit on number of level-0 sub-levels (runs of non-overlapping
+// files; a read probes one file per sub-level).  We slow down writes at
+// this point.
 static const int kL0_SlowdownWritesTrigger = 8;
 
-// Maximum number of level-0 files.  We stop writes at this point.
+// Maximum number of level-0 sub-levels.  We stop writes at this point.
 static const int kL0_StopWritesTrigger = 12;
 
 // Maximum level to which a new compacted memtable is pushed if it
@@ -51,14 +53,20 @@ class InternalKey;
 // Value types encoded as the last component of internal keys.
 // DO NOT CHANGE THESE ENUM VALUES: they are embedded in the on-disk
 // data structures.
-enum ValueType { kTypeDeletion = 0x0, kTypeValue = 0x1 };
+enum ValueType {
+  kTypeDeletion = 0x0,
+  kTypeValue = 0x1,
+  kTypeRangeDeletion = 0x2,  // Only in memtable and table range tombstones
+  kTypeBlobIndex = 0x3,      // Only in tables; the value is in a blob file
+  kTypeMerge = 0x4           // The value is an operand of the merge operator
+};
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
 // sequence number (since we sort sequence numbers in decreasing order
 // and the value type is embedded as the low 8 bits in the sequence
 // number in internal keys, we need to use the highest-numbered
 // ValueType, not the lowest).
-static const ValueType kValueTypeForSeek = kTypeValue;
+static const ValueType kValueTypeForSeek = kTypeMerge;
 
 typedef uint64_t SequenceNumber;
 
@@ -112,6 +120,8 @@ class InternalKeyComparator : public Comparator {
   void FindShortestSeparator(std::string* start,
                              const Slice& limit) const override;
   void FindShortSuccessor(std::string* key) const override;
+  bool OrderedPrefix(const Slice& key, uint64_t* prefix) const override;
+  bool HashIndexKey(const Slice& key, Slice* result) const override;
 
   const Comparator* user_comparator() const { return user_comparator_; }
 
@@ -182,7 +192,7 @@ inline bool ParseInternalKey(const Slice& internal_key,
   result->sequence = num >> 8;
   result->type = static_cast<ValueType>(c);
   result->user_key = Slice(internal_key.data(), n - 8);
-  return (c <= static_cast<uint8_t>(kTypeValue));
+  return (c <= static_cast<uint8_t>(kTypeMerge));
 }
 
 // A helper class useful for DBImpl::Get()
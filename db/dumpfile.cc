@@ -23,7 +23,7 @@ namespace leveldb {
 
 namespace {
 
-bool GuessType(const std::string& fname, FileType* type) {
+bool GuessType(const std::string& fname, uint64_t* number, FileType* type) {
   size_t pos = fname.rfind('/');
   std::string basename;
   if (pos == std::string::npos) {
@@ -31,8 +31,7 @@ bool GuessType(const std::string& fname, FileType* type) {
   } else {
     basename = std::string(fname.data() + pos + 1, fname.size() - pos - 1);
   }
-  uint64_t ignored;
-  return ParseFileName(basename, &ignored, type);
+  return ParseFileName(basename, number, type);
 }
 
 // Notified when log reader encounters corruption.
@@ -51,7 +50,9 @@ class CorruptionReporter : public log::Reader::Reporter {
 };
 
 // Print contents of a log file. (*func)() is called on every record.
+// "log_number" is the number of the log, in case it was recycled.
 Status PrintLogContents(Env* env, const std::string& fname,
+                        uint64_t log_number,
                         void (*func)(uint64_t, Slice, WritableFile*),
                         WritableFile* dst) {
   SequentialFile* file;
@@ -61,7 +62,7 @@ Status PrintLogContents(Env* env, const std::string& fname,
   }
   CorruptionReporter reporter;
   reporter.dst_ = dst;
-  log::Reader reader(file, &reporter, true, 0);
+  log::Reader reader(file, &reporter, true, 0, log_number);
   Slice record;
   std::string scratch;
   while (reader.ReadRecord(&record, &scratch)) {
@@ -88,6 +89,14 @@ class WriteBatchItemPrinter : public WriteBatch::Handler {
     r += "'\n";
     dst_->Append(r);
   }
+  void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+    std::string r = "  delrange '";
+    AppendEscapedStringTo(&r, begin_key);
+    r += "' '";
+    AppendEscapedStringTo(&r, end_key);
+    r += "'\n";
+    dst_->Append(r);
+  }
 
   WritableFile* dst_;
 };
@@ -119,8 +128,9 @@ static void WriteBatchPrinter(uint64_t pos, Slice record, WritableFile* dst) {
   }
 }
 
-Status DumpLog(Env* env, const std::string& fname, WritableFile* dst) {
-  return PrintLogContents(env, fname, WriteBatchPrinter, dst);
+Status DumpLog(Env* env, const std::string& fname, uint64_t log_number,
+               WritableFile* dst) {
+  return PrintLogContents(env, fname, log_number, WriteBatchPrinter, dst);
 }
 
 // Called on every log record (each one of which is a WriteBatch)
@@ -141,7 +151,7 @@ static void VersionEditPrinter(uint64_t pos, Slice record, WritableFile* dst) {
 }
 
 Status DumpDescriptor(Env* env, const std::string& fname, WritableFile* dst) {
-  return PrintLogContents(env, fname, VersionEditPrinter, dst);
+  return PrintLogContents(env, fname, 0, VersionEditPrinter, dst);
 }
 
 Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
@@ -189,6 +199,10 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
         r += "del";
       } else if (key.type == kTypeValue) {
         r += "val";
+      } else if (key.type == kTypeBlobIndex) {
+        r += "blob";
+      } else if (key.type == kTypeMerge) {
+        r += "merge";
       } else {
         AppendNumberTo(&r, key.type);
       }
@@ -212,13 +226,14 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
 }  // namespace
 
 Status DumpFile(Env* env, const std::string& fname, WritableFile* dst) {
+  uint64_t number;
   FileType ftype;
-  if (!GuessType(fname, &ftype)) {
+  if (!GuessType(fname, &number, &ftype)) {
     return Status::InvalidArgument(fname + ": unknown file type");
   }
   switch (ftype) {
     case kLogFile:
-      return DumpLog(env, fname, dst);
+      return DumpLog(env, fname, number, dst);
     case kDescriptorFile:
       return DumpDescriptor(env, fname, dst);
     case kTableFile:
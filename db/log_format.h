@@ -20,15 +20,27 @@ enum RecordType {
   // For fragments
   kFirstType = 2,
   kMiddleType = 3,
-  kLastType = 4
+  kLastType = 4,
+
+  // Same as above, for logs that may overwrite an old log file in place.
+  // Their header also holds the log number, so that the records left over
+  // from the file's previous use can be told apart.
+  kRecyclableFullType = 5,
+  kRecyclableFirstType = 6,
+  kRecyclableMiddleType = 7,
+  kRecyclableLastType = 8
 };
-static const int kMaxRecordType = kLastType;
+static const int kMaxRecordType = kRecyclableLastType;
 
 static const int kBlockSize = 32768;
 
 // Header is checksum (4 bytes), length (2 bytes), type (1 byte).
 static const int kHeaderSize = 4 + 2 + 1;
 
+// Header of recyclable records is checksum (4 bytes), length (2 bytes),
+// type (1 byte), low 32 bits of the log number (4 bytes).
+static const int kRecyclableHeaderSize = kHeaderSize + 4;
+
 }  // namespace log
 }  // namespace leveldb
 
@@ -17,6 +17,10 @@ Reader::Reporter::~Reporter() = default;
 
 Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
                uint64_t initial_offset)
+    : Reader(file, reporter, checksum, initial_offset, 0) {}
+
+Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
+               uint64_t initial_offset, uint64_t log_number)
     : file_(file),
       reporter_(reporter),
       checksum_(checksum),
@@ -26,7 +30,10 @@ Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
       last_record_offset_(0),
       end_of_buffer_offset_(0),
       initial_offset_(initial_offset),
-      resyncing_(initial_offset > 0) {}
+      resyncing_(initial_offset > 0),
+      log_number_(static_cast<uint32_t>(log_number)),
+      recycled_(false),
+      last_header_size_(kHeaderSize) {}
 
 Reader::~Reader() { delete[] backing_store_; }
 
@@ -76,8 +83,8 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
     // ReadPhysicalRecord may have only had an empty trailer remaining in its
     // internal buffer. Calculate the offset of the next physical record now
     // that it has returned, properly accounting for its header size.
-    uint64_t physical_record_offset =
-        end_of_buffer_offset_ - buffer_.size() - kHeaderSize - fragment.size();
+    uint64_t physical_record_offset = end_of_buffer_offset_ - buffer_.size() -
+                                      last_header_size_ - fragment.size();
 
     if (resyncing_) {
       if (record_type == kMiddleType) {
@@ -228,16 +235,26 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
     const uint32_t b = static_cast<uint32_t>(header[5]) & 0xff;
     const unsigned int type = header[6];
     const uint32_t length = a | (b << 8);
-    if (kHeaderSize + length > buffer_.size()) {
+    const int header_size =
+        (type >= kRecyclableFullType && type <= kRecyclableLastType)
+            ? kRecyclableHeaderSize
+            : kHeaderSize;
+    if (recycled_ && type > kMaxRecordType) {
+      // Garbage past the end of a recycled log.
+      buffer_.clear();
+      return kEof;
+    }
+    if (header_size + length > buffer_.size()) {
       size_t drop_size = buffer_.size();
       buffer_.clear();
-      if (!eof_) {
+      if (!eof_ && !recycled_) {
         ReportCorruption(drop_size, "bad record length");
         return kBadRecord;
       }
       // If the end of the file has been reached without reading |length| bytes
       // of payload, assume the writer died in the middle of writing the record.
-      // Don't report a corruption.
+      // Don't report a corruption.  In a recycled file, this is most likely
+      // where the stale records begin.
       return kEof;
     }
 
@@ -252,7 +269,8 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
     // Check crc
     if (checksum_) {
       uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(header));
-      uint32_t actual_crc = crc32c::Value(header + 6, 1 + length);
+      uint32_t actual_crc =
+          crc32c::Value(header + 6, 1 + (header_size - kHeaderSize) + length);
       if (actual_crc != expected_crc) {
         // Drop the rest of the buffer since "length" itself may have
         // been corrupted and if we trust it, we could find some
@@ -260,21 +278,41 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
         // like a valid log record.
         size_t drop_size = buffer_.size();
         buffer_.clear();
+        if (recycled_) {
+          // Most likely the partially overwritten records of the older log.
+          return kEof;
+        }
         ReportCorruption(drop_size, "checksum mismatch");
         return kBadRecord;
       }
     }
 
-    buffer_.remove_prefix(kHeaderSize + length);
+    if (header_size == kRecyclableHeaderSize) {
+      // The file may have held an older log, whose records follow the end
+      // of this one.
+      recycled_ = true;
+    }
+    if (recycled_ && (header_size == kHeaderSize ||
+                      DecodeFixed32(header + kHeaderSize) != log_number_)) {
+      // A record of the older log: the end of this one.
+      buffer_.clear();
+      return kEof;
+    }
+
+    buffer_.remove_prefix(header_size + length);
+    last_header_size_ = header_size;
 
     // Skip physical record that started before initial_offset_
-    if (end_of_buffer_offset_ - buffer_.size() - kHeaderSize - length <
+    if (end_of_buffer_offset_ - buffer_.size() - header_size - length <
         initial_offset_) {
       result->clear();
       return kBadRecord;
     }
 
-    *result = Slice(header + kHeaderSize, length);
+    *result = Slice(header + header_size, length);
+    if (header_size == kRecyclableHeaderSize) {
+      return type - (kRecyclableFullType - kFullType);
+    }
     return type;
   }
 }
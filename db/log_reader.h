@@ -43,6 +43,12 @@ class Reader {
   Reader(SequentialFile* file, Reporter* reporter, bool checksum,
          uint64_t initial_offset);
 
+  // Same as above, for a log that may have been written by a Writer for
+  // recyclable records with log number "log_number".  Records of other log
+  // numbers are stale data from an older log, and end the log.
+  Reader(SequentialFile* file, Reporter* reporter, bool checksum,
+         uint64_t initial_offset, uint64_t log_number);
+
   Reader(const Reader&) = delete;
   Reader& operator=(const Reader&) = delete;
 
@@ -60,6 +66,10 @@ class Reader {
   // Undefined before the first call to ReadRecord.
   uint64_t LastRecordOffset();
 
+  // Returns true if the log holds recyclable records, and so may continue
+  // with stale data past its last record.
+  bool IsRecycled() const { return recycled_; }
+
  private:
   // Extend record types with the following special values
   enum {
@@ -104,6 +114,10 @@ class Reader {
   // particular, a run of kMiddleType and kLastType records can be silently
   // skipped in this mode
   bool resyncing_;
+
+  const uint32_t log_number_;  // Expected in recyclable records
+  bool recycled_;              // Seen a recyclable record header
+  int last_header_size_;       // Header size of the last physical record
 };
 
 }  // namespace log
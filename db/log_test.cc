@@ -54,6 +54,27 @@ class LogTest {
     writer_ = new Writer(&dest_, dest_.contents_.size());
   }
 
+  // Overwrite the log from its beginning with recyclable records for log
+  // "log_number", as when its file is recycled.  Call AppendStaleTail()
+  // before reading to leave the rest of the old contents in place.
+  void StartRecycledLog(uint64_t log_number) {
+    delete writer_;
+    delete reader_;
+    stale_.swap(dest_.contents_);
+    dest_.contents_.clear();
+    writer_ = new Writer(&dest_, log_number, true /*recyclable*/);
+    reader_ = new Reader(&source_, &report_, true /*checksum*/,
+                         0 /*initial_offset*/, log_number);
+  }
+
+  void AppendStaleTail() {
+    if (stale_.size() > dest_.contents_.size()) {
+      dest_.contents_.append(stale_, dest_.contents_.size(), std::string::npos);
+    }
+  }
+
+  bool IsRecycled() const { return reader_->IsRecycled(); }
+
   void Write(const std::string& msg) {
     ASSERT_TRUE(!reading_) << "Write() after starting to read";
     writer_->AddRecord(Slice(msg));
@@ -230,6 +251,7 @@ class LogTest {
   StringDest dest_;
   StringSource source_;
   ReportCollector report_;
+  std::string stale_;  // Contents overwritten by StartRecycledLog()
   bool reading_;
   Writer* writer_;
   Reader* reader_;
@@ -514,6 +536,65 @@ TEST(LogTest, ErrorJoinsRecords) {
   ASSERT_GE(dropped, 2 * kBlockSize);
 }
 
+TEST(LogTest, RecyclableRecords) {
+  StartRecycledLog(7);
+  Write("foo");
+  Write("bar");
+  Write("");
+  Write(BigString("x", 3 * kBlockSize));
+  Write("xxxx");
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ(BigString("x", 3 * kBlockSize), Read());
+  ASSERT_EQ("xxxx", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_TRUE(IsRecycled());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST(LogTest, RecycledLogEndsAtStaleRecords) {
+  StartRecycledLog(5);
+  Random rnd(301);
+  for (int i = 0; i < 500; i++) {
+    Write(RandomSkewedString(i, &rnd));
+  }
+  StartRecycledLog(6);
+  Write("foo");
+  Write(BigString("bar", kBlockSize + 1000));
+  Write("baz");
+  AppendStaleTail();
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ(BigString("bar", kBlockSize + 1000), Read());
+  ASSERT_EQ("baz", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST(LogTest, RecycledLogEndsAtLegacyRecords) {
+  for (int i = 0; i < 100; i++) {
+    Write(BigString(NumberString(i), 1000));
+  }
+  StartRecycledLog(2);
+  Write("foo");
+  Write("bar");
+  AppendStaleTail();
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST(LogTest, RecycledLogChecksumMismatch) {
+  StartRecycledLog(3);
+  Write("foo");
+  Write("bar");
+  IncrementByte(2 * kRecyclableHeaderSize + 3, 1);
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
 TEST(LogTest, ReadStart) { CheckInitialOffsetRecord(0, 0); }
 
 TEST(LogTest, ReadSecondOneOff) { CheckInitialOffsetRecord(1, 1); }
@@ -20,12 +20,30 @@ static void InitTypeCrc(uint32_t* type_crc) {
   }
 }
 
-Writer::Writer(WritableFile* dest) : dest_(dest), block_offset_(0) {
+Writer::Writer(WritableFile* dest)
+    : dest_(dest),
+      block_offset_(0),
+      header_size_(kHeaderSize),
+      recyclable_(false),
+      log_number_(0) {
   InitTypeCrc(type_crc_);
 }
 
 Writer::Writer(WritableFile* dest, uint64_t dest_length)
-    : dest_(dest), block_offset_(dest_length % kBlockSize) {
+    : dest_(dest),
+      block_offset_(dest_length % kBlockSize),
+      header_size_(kHeaderSize),
+      recyclable_(false),
+      log_number_(0) {
+  InitTypeCrc(type_crc_);
+}
+
+Writer::Writer(WritableFile* dest, uint64_t log_number, bool recyclable)
+    : dest_(dest),
+      block_offset_(0),
+      header_size_(recyclable ? kRecyclableHeaderSize : kHeaderSize),
+      recyclable_(recyclable),
+      log_number_(static_cast<uint32_t>(log_number)) {
   InitTypeCrc(type_crc_);
 }
 
@@ -43,20 +61,20 @@ Status Writer::AddRecord(const Slice& slice) {
   do {
     const int leftover = kBlockSize - block_offset_;
     assert(leftover >= 0);
-    if (leftover < kHeaderSize) {
+    if (leftover < header_size_) {
       // Switch to a new block
       if (leftover > 0) {
-        // Fill the trailer (literal below relies on kHeaderSize being 7)
-        static_assert(kHeaderSize == 7, "");
-        dest_->Append(Slice("\x00\x00\x00\x00\x00\x00", leftover));
+        // Fill the trailer
+        static const char kZeros[kRecyclableHeaderSize] = {0};
+        dest_->Append(Slice(kZeros, leftover));
       }
       block_offset_ = 0;
     }
 
-    // Invariant: we never leave < kHeaderSize bytes in a block.
-    assert(kBlockSize - block_offset_ - kHeaderSize >= 0);
+    // Invariant: we never leave < header_size_ bytes in a block.
+    assert(kBlockSize - block_offset_ - header_size_ >= 0);
 
-    const size_t avail = kBlockSize - block_offset_ - kHeaderSize;
+    const size_t avail = kBlockSize - block_offset_ - header_size_;
     const size_t fragment_length = (left < avail) ? left : avail;
 
     // 如果新的slice小于avail，则该slice可用整个添加到当前Block中，
@@ -74,6 +92,9 @@ Status Writer::AddRecord(const Slice& slice) {
     } else {
       type = kMiddleType;
     }
+    if (recyclable_) {
+      type = static_cast<RecordType>(type + kRecyclableFullType - kFullType);
+    }
 
     // 将数据组建成指定格式后存储到磁盘
     s = EmitPhysicalRecord(type, ptr, fragment_length);
@@ -87,28 +108,33 @@ Status Writer::AddRecord(const Slice& slice) {
 Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr,
                                   size_t length) {
   assert(length <= 0xffff);  // Must fit in two bytes
-  assert(block_offset_ + kHeaderSize + length <= kBlockSize);
+  assert(block_offset_ + header_size_ + length <= kBlockSize);
 
   // Format the header
-  char buf[kHeaderSize];
+  char buf[kRecyclableHeaderSize];
   buf[4] = static_cast<char>(length & 0xff);
   buf[5] = static_cast<char>(length >> 8);
   buf[6] = static_cast<char>(t);
 
-  // Compute the crc of the record type and the payload.
-  uint32_t crc = crc32c::Extend(type_crc_[t], ptr, length);
+  // Compute the crc of the record type, the log number and the payload.
+  uint32_t crc = type_crc_[t];
+  if (recyclable_) {
+    EncodeFixed32(buf + kHeaderSize, log_number_);
+    crc = crc32c::Extend(crc, buf + kHeaderSize, 4);
+  }
+  crc = crc32c::Extend(crc, ptr, length);
   crc = crc32c::Mask(crc);  // Adjust for storage
   EncodeFixed32(buf, crc);
 
   // Write the header and the payload
-  Status s = dest_->Append(Slice(buf, kHeaderSize));
+  Status s = dest_->Append(Slice(buf, header_size_));
   if (s.ok()) {
     s = dest_->Append(Slice(ptr, length));
     if (s.ok()) {
       s = dest_->Flush();
     }
   }
-  block_offset_ += kHeaderSize + length;
+  block_offset_ += header_size_ + length;
   return s;
 }
 
@@ -4,10 +4,13 @@
 
 #include "db/memtable.h"
 #include "db/dbformat.h"
+#include "db/merge_context.h"
+#include "db/range_tombstone.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -19,9 +22,17 @@ static Slice GetLengthPrefixedSlice(const char* data) {
 }
 
 MemTable::MemTable(const InternalKeyComparator& comparator)
-    : comparator_(comparator), refs_(0), table_(comparator_, &arena_) {}
-
-MemTable::~MemTable() { assert(refs_ == 0); }
+    : comparator_(comparator), refs_(0),
+      table_(comparator_, &arena_),
+      range_del_table_(comparator_, &arena_),
+      range_dels_(nullptr) {}
+
+MemTable::~MemTable() {
+  assert(refs_ == 0);
+  if (range_dels_ != nullptr) {
+    range_dels_->Unref();
+  }
+}
 
 size_t MemTable::ApproximateMemoryUsage() { return arena_.MemoryUsage(); }
 
@@ -73,6 +84,10 @@ class MemTableIterator : public Iterator {
 
 Iterator* MemTable::NewIterator() { return new MemTableIterator(&table_); }
 
+Iterator* MemTable::NewRangeTombstoneIterator() {
+  return new MemTableIterator(&range_del_table_);
+}
+
 void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
                    const Slice& value) {
   // Format of an entry is concatenation of:
@@ -95,18 +110,80 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   p = EncodeVarint32(p, val_size);                   // value_size 变长编码
   memcpy(p, value.data(), val_size);                 // value
   assert(p + val_size == buf + encoded_len);
-  table_.Insert(buf);
+  if (type == kTypeRangeDeletion) {
+    range_del_table_.Insert(buf);
+    // Readers that build the list from now on see the new tombstone.
+    MutexLock l(&range_dels_mu_);
+    if (range_dels_ != nullptr) {
+      range_dels_->Unref();
+      range_dels_ = nullptr;
+    }
+  } else {
+    table_.Insert(buf);
+  }
 
   // memtable_key = A + B + C
   // internal_key = B + C
   // user_key = B
 }
 
-bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+RangeTombstoneList* MemTable::GetRangeTombstones() {
+  Table::Iterator iter(&range_del_table_);
+  iter.SeekToFirst();
+  if (!iter.Valid()) {
+    return nullptr;
+  }
+  MutexLock l(&range_dels_mu_);
+  if (range_dels_ == nullptr) {
+    std::vector<RangeTombstone> tombstones;
+    Iterator* tombstone_iter = NewRangeTombstoneIterator();
+    Status s = AppendRangeTombstones(tombstone_iter, &tombstones);
+    assert(s.ok());  // The memtable only holds well-formed tombstones
+    (void)s;
+    delete tombstone_iter;
+    range_dels_ = new RangeTombstoneList(
+        comparator_.comparator.user_comparator(), std::move(tombstones));
+    range_dels_->Ref();
+  }
+  range_dels_->Ref();
+  return range_dels_;
+}
+
+SequenceNumber MemTable::MaxCoveringTombstone(const Slice& user_key,
+                                              SequenceNumber snapshot) {
+  RangeTombstoneList* range_dels = GetRangeTombstones();
+  if (range_dels == nullptr) {
+    return 0;
+  }
+  const SequenceNumber result =
+      range_dels->MaxCoveringSequence(user_key, snapshot);
+  range_dels->Unref();
+  return result;
+}
+
+// Stores in *s and *value the outcome of a read of "key" that found a
+// deletion, after the operands in *merge_context.
+static bool Deleted(const LookupKey& key, std::string* value, Status* s,
+                    MergeContext* merge_context,
+                    const MergeOperator* merge_operator) {
+  if (merge_context->empty()) {
+    *s = Status::NotFound(Slice());
+  } else {
+    *s = merge_context->Merge(merge_operator, key.user_key(), nullptr, value);
+  }
+  return true;
+}
+
+bool MemTable::Get(const LookupKey& key, std::string* value, Status* s,
+                   MergeContext* merge_context,
+                   const MergeOperator* merge_operator) {
   Slice memkey = key.memtable_key();
+  const Slice ikey = key.internal_key();
+  const SequenceNumber covering = MaxCoveringTombstone(
+      key.user_key(), DecodeFixed64(ikey.data() + ikey.size() - 8) >> 8);
   Table::Iterator iter(&table_);
-  iter.Seek(memkey.data());
-  if (iter.Valid()) {
+  // Merge operands send the search on to the older entries of the key.
+  for (iter.Seek(memkey.data()); iter.Valid(); iter.Next()) {
     // entry format is:
     //    klength  varint32
     //    userkey  char[klength]
@@ -124,21 +201,39 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
     const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length); 
     //用用户提供的键比较器(默认BytewiseComparator)比较用户键，因为SkipList的Seek不是准确定位
     if (comparator_.comparator.user_comparator()->Compare(
-            Slice(key_ptr, key_length - 8), key.user_key()) == 0) {
-      // Correct user key
-      const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
-      switch (static_cast<ValueType>(tag & 0xff)) {
-        case kTypeValue: {
-          Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+            Slice(key_ptr, key_length - 8), key.user_key()) != 0) {
+      break;
+    }
+    // Correct user key
+    const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+    if ((tag >> 8) < covering) {
+      break;
+    }
+    switch (static_cast<ValueType>(tag & 0xff)) {
+      case kTypeValue: {
+        Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+        if (merge_context->empty()) {
           value->assign(v.data(), v.size());
-          return true;
+        } else {
+          *s = merge_context->Merge(merge_operator, key.user_key(), &v, value);
         }
-        // 如果是删除的对象，那么返回的就是没有找到的状态
-        case kTypeDeletion:
-          *s = Status::NotFound(Slice());
-          return true;
+        return true;
       }
+      // 如果是删除的对象，那么返回的就是没有找到的状态
+      case kTypeDeletion:
+        return Deleted(key, value, s, merge_context, merge_operator);
+      case kTypeMerge:
+        // 合并操作数，继续查找更旧的记录
+        merge_context->AddOlder(GetLengthPrefixedSlice(key_ptr + key_length));
+        continue;
+      case kTypeRangeDeletion:
+      case kTypeBlobIndex:
+        break;
     }
+    break;
+  }
+  if (covering > 0) {
+    return Deleted(key, value, s, merge_context, merge_operator);
   }
   return false;
 }
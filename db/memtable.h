@@ -10,12 +10,17 @@
 #include "db/dbformat.h"
 #include "db/skiplist.h"
 #include "leveldb/db.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "util/arena.h"
 
 namespace leveldb {
 
 class InternalKeyComparator;
 class MemTableIterator;
+class MergeContext;
+class MergeOperator;
+class RangeTombstoneList;
 
 class MemTable {
  public:
@@ -51,17 +56,33 @@ class MemTable {
   // db/format.{h,cc} module.
   Iterator* NewIterator();
 
+  // Return an iterator over the range tombstones added to the memtable,
+  // keyed by (begin_key, seq, kTypeRangeDeletion) with end_key as value.
+  Iterator* NewRangeTombstoneIterator();
+
+  // Return the range tombstones added to the memtable so far, or nullptr
+  // if there are none.  The list is built on first use after a tombstone
+  // is added, and then shared until the next one is added.  The caller
+  // must Unref() the result.
+  RangeTombstoneList* GetRangeTombstones();
+
   // Add an entry into memtable that maps key to value at the
   // specified sequence number and with the specified type.
-  // Typically value will be empty if type==kTypeDeletion.
+  // Typically value will be empty if type==kTypeDeletion.  For
+  // type==kTypeRangeDeletion, key and value are the bounds of the range.
   void Add(SequenceNumber seq, ValueType type, const Slice& key,
            const Slice& value);
 
   // If memtable contains a value for key, store it in *value and return true.
   // If memtable contains a deletion for key, store a NotFound() error
-  // in *status and return true.
+  // in *status and return true.  A range tombstone of the memtable
+  // covering key counts as a deletion.
+  // Merge operands of key are added to *merge_context; once a value or
+  // deletion is found, the operands gathered are applied to it with
+  // merge_operator, and the result, or error, is stored as above.
   // Else, return false.
-  bool Get(const LookupKey& key, std::string* value, Status* s);
+  bool Get(const LookupKey& key, std::string* value, Status* s,
+           MergeContext* merge_context, const MergeOperator* merge_operator);
 
  private:
   friend class MemTableIterator;
@@ -78,10 +99,20 @@ class MemTable {
 
   ~MemTable();  // Private since only Unref() should be used to delete it
 
+  // Largest sequence number no larger than "snapshot" of a range tombstone
+  // covering "user_key", or 0 if there is none.
+  SequenceNumber MaxCoveringTombstone(const Slice& user_key,
+                                      SequenceNumber snapshot);
+
   KeyComparator comparator_;
   int refs_;
   Arena arena_;
   Table table_;
+  Table range_del_table_;  // Range tombstones, kept out of table_
+
+  port::Mutex range_dels_mu_;
+  // Fragmented range_del_table_, or null until built.
+  RangeTombstoneList* range_dels_ GUARDED_BY(range_dels_mu_);
 };
 
 }  // namespace leveldb
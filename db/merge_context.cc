@@ -0,0 +1,34 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/merge_context.h"
+
+#include <vector>
+
+#include "leveldb/merge_operator.h"
+
+namespace leveldb {
+
+Status MergeContext::Merge(const MergeOperator* merge_operator,
+                           const Slice& user_key, const Slice* existing_value,
+                           std::string* result) const {
+  if (merge_operator == nullptr) {
+    return Status::NotSupported("merge operands without a merge operator");
+  }
+  std::vector<Slice> operands;
+  operands.reserve(operands_.size());
+  for (auto it = operands_.rbegin(); it != operands_.rend(); ++it) {
+    operands.push_back(*it);
+  }
+  std::string merged;
+  if (!merge_operator->FullMerge(user_key, existing_value, operands,
+                                 &merged)) {
+    return Status::Corruption("merge operands rejected for ", user_key);
+  }
+  // "existing_value" may refer to *result
+  result->swap(merged);
+  return Status::OK();
+}
+
+}  // namespace leveldb
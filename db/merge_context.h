@@ -0,0 +1,49 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_MERGE_CONTEXT_H_
+#define STORAGE_LEVELDB_DB_MERGE_CONTEXT_H_
+
+#include <deque>
+#include <string>
+
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class MergeOperator;
+
+// The merge operands (kTypeMerge entries) of a key that a read has seen
+// so far, waiting for the value they apply to.
+class MergeContext {
+ public:
+  MergeContext() = default;
+
+  MergeContext(const MergeContext&) = delete;
+  MergeContext& operator=(const MergeContext&) = delete;
+
+  bool empty() const { return operands_.empty(); }
+  void Clear() { operands_.clear(); }
+
+  // Add an operand older, or newer, than all operands added so far.
+  void AddOlder(const Slice& operand) {
+    operands_.emplace_back(operand.data(), operand.size());
+  }
+  void AddNewer(const Slice& operand) {
+    operands_.emplace_front(operand.data(), operand.size());
+  }
+
+  // Apply the operands to "existing_value", or to no value if it is null,
+  // with "merge_operator", and store the result in *result.
+  Status Merge(const MergeOperator* merge_operator, const Slice& user_key,
+               const Slice* existing_value, std::string* result) const;
+
+ private:
+  std::deque<std::string> operands_;  // Newest first
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_MERGE_CONTEXT_H_
@@ -0,0 +1,156 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_tombstone.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+
+namespace leveldb {
+
+Status AppendRangeTombstones(Iterator* iter,
+                             std::vector<RangeTombstone>* result) {
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseInternalKey(iter->key(), &ikey) ||
+        ikey.type != kTypeRangeDeletion) {
+      return Status::Corruption("corrupted range tombstone");
+    }
+    result->push_back(RangeTombstone(ikey.user_key, iter->value(),
+                                     ikey.sequence));
+  }
+  return iter->status();
+}
+
+void CoalesceRangeTombstones(const Comparator* ucmp,
+                             std::vector<RangeTombstone>* tombstones) {
+  std::vector<RangeTombstone>& v = *tombstones;
+  std::sort(v.begin(), v.end(),
+            [ucmp](const RangeTombstone& a, const RangeTombstone& b) {
+              if (a.seq != b.seq) return a.seq > b.seq;
+              return ucmp->Compare(a.start, b.start) < 0;
+            });
+  size_t n = 0;
+  for (size_t i = 0; i < v.size(); i++) {
+    if (ucmp->Compare(v[i].start, v[i].end) >= 0) {
+      continue;
+    }
+    if (n > 0 && v[n - 1].seq == v[i].seq &&
+        ucmp->Compare(v[i].start, v[n - 1].end) <= 0) {
+      if (ucmp->Compare(v[i].end, v[n - 1].end) > 0) {
+        v[n - 1].end.swap(v[i].end);
+      }
+    } else {
+      if (n != i) v[n] = std::move(v[i]);
+      n++;
+    }
+  }
+  v.resize(n);
+  std::sort(v.begin(), v.end(),
+            [ucmp](const RangeTombstone& a, const RangeTombstone& b) {
+              const int r = ucmp->Compare(a.start, b.start);
+              return r != 0 ? r < 0 : a.seq > b.seq;
+            });
+}
+
+void ExtendKeyRange(const InternalKeyComparator& icmp, const RangeTombstone& t,
+                    bool* has_bounds, InternalKey* smallest,
+                    InternalKey* largest) {
+  if (icmp.user_comparator()->Compare(t.start, t.end) >= 0) {
+    return;  // Deletes nothing
+  }
+  InternalKey start(t.start, t.seq, kTypeRangeDeletion);
+  InternalKey end(t.end, kMaxSequenceNumber, kTypeRangeDeletion);
+  if (!*has_bounds) {
+    *smallest = start;
+    *largest = end;
+    *has_bounds = true;
+    return;
+  }
+  if (icmp.Compare(start, *smallest) < 0) {
+    *smallest = start;
+  }
+  if (icmp.Compare(end, *largest) > 0) {
+    *largest = end;
+  }
+}
+
+RangeTombstoneList::RangeTombstoneList(const Comparator* ucmp,
+                                       std::vector<RangeTombstone> tombstones)
+    : refs_(0), ucmp_(ucmp), tombstones_(std::move(tombstones)) {
+  CoalesceRangeTombstones(ucmp_, &tombstones_);
+
+  std::vector<Slice> bounds;
+  bounds.reserve(2 * tombstones_.size());
+  for (const RangeTombstone& t : tombstones_) {
+    bounds.push_back(t.start);
+    bounds.push_back(t.end);
+  }
+  std::sort(bounds.begin(), bounds.end(), [this](const Slice& a, const Slice& b) {
+    return ucmp_->Compare(a, b) < 0;
+  });
+  bounds.erase(std::unique(bounds.begin(), bounds.end(),
+                           [this](const Slice& a, const Slice& b) {
+                             return ucmp_->Compare(a, b) == 0;
+                           }),
+               bounds.end());
+
+  // Sweep the bounds in order, keeping the tombstones that cover the
+  // current fragment.  Each of them spans the whole fragment since every
+  // start and end key is a bound.
+  std::vector<const RangeTombstone*> active;
+  size_t next = 0;
+  for (size_t i = 0; i + 1 < bounds.size(); i++) {
+    const Slice lo = bounds[i];
+    while (next < tombstones_.size() &&
+           ucmp_->Compare(tombstones_[next].start, lo) <= 0) {
+      active.push_back(&tombstones_[next++]);
+    }
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [this, &lo](const RangeTombstone* t) {
+                                  return ucmp_->Compare(t->end, lo) <= 0;
+                                }),
+                 active.end());
+    if (active.empty()) continue;
+
+    Fragment f;
+    f.start = lo.ToString();
+    f.end = bounds[i + 1].ToString();
+    f.seqs_begin = seqs_.size();
+    for (const RangeTombstone* t : active) {
+      seqs_.push_back(t->seq);
+    }
+    f.seqs_end = seqs_.size();
+    std::sort(seqs_.begin() + f.seqs_begin, seqs_.end(),
+              std::greater<SequenceNumber>());
+    fragments_.push_back(std::move(f));
+  }
+}
+
+SequenceNumber RangeTombstoneList::MaxCoveringSequence(
+    const Slice& user_key, SequenceNumber snapshot) const {
+  // Find the last fragment starting at or before user_key.
+  auto it = std::upper_bound(fragments_.begin(), fragments_.end(), user_key,
+                             [this](const Slice& key, const Fragment& f) {
+                               return ucmp_->Compare(key, f.start) < 0;
+                             });
+  if (it == fragments_.begin()) {
+    return 0;
+  }
+  --it;
+  if (ucmp_->Compare(user_key, it->end) >= 0) {
+    return 0;
+  }
+  for (size_t i = it->seqs_begin; i < it->seqs_end; i++) {
+    if (seqs_[i] <= snapshot) {
+      return seqs_[i];
+    }
+  }
+  return 0;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,107 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A range tombstone deletes every entry whose user key lies in
+// [start, end) and whose sequence number is smaller than its own.  It is
+// written by DB::DeleteRange() and kept out of the regular key space: in
+// a second skiplist of the memtable, and in a meta block of each table.
+// Either stores the internal key (start, seq, kTypeRangeDeletion) mapped to
+// the end key.
+
+#ifndef STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
+#define STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Comparator;
+class Iterator;
+
+struct RangeTombstone {
+  RangeTombstone() : seq(0) {}
+  RangeTombstone(const Slice& s, const Slice& e, SequenceNumber sequence)
+      : start(s.ToString()), end(e.ToString()), seq(sequence) {}
+
+  std::string start;  // First deleted user key
+  std::string end;    // First user key past the deleted range
+  SequenceNumber seq;
+};
+
+// Appends the tombstones yielded by "iter", an iterator over range
+// tombstone entries, to *result.  Returns the iterator status, or
+// Corruption() for malformed entries.
+Status AppendRangeTombstones(Iterator* iter,
+                             std::vector<RangeTombstone>* result);
+
+// Sorts *tombstones by start key and merges overlapping or adjacent
+// tombstones with the same sequence number.  Empty ones are removed.
+void CoalesceRangeTombstones(const Comparator* ucmp,
+                             std::vector<RangeTombstone>* tombstones);
+
+// Widens [*smallest, *largest] to cover the keys deleted by "t", or sets
+// it if "*has_bounds" is false.  The largest key is then the sentinel
+// (t.end, kMaxSequenceNumber, kTypeRangeDeletion), which sorts before every
+// entry for t.end, so that the range does not claim to hold that key.
+void ExtendKeyRange(const InternalKeyComparator& icmp, const RangeTombstone& t,
+                    bool* has_bounds, InternalKey* smallest,
+                    InternalKey* largest);
+
+// An immutable set of range tombstones, split at every start and end key
+// into non-overlapping fragments so that the tombstones covering a key are
+// found with one binary search.
+//
+// Lists cached by a memtable or a version are shared with the iterators
+// reading them, and reference counted: the initial count is zero, and
+// Unref() deletes the list once the last reference is dropped, from any
+// thread.  Lists with a single owner may simply be deleted.
+class RangeTombstoneList {
+ public:
+  RangeTombstoneList(const Comparator* ucmp,
+                     std::vector<RangeTombstone> tombstones);
+
+  RangeTombstoneList(const RangeTombstoneList&) = delete;
+  RangeTombstoneList& operator=(const RangeTombstoneList&) = delete;
+
+  void Ref() { refs_.fetch_add(1, std::memory_order_relaxed); }
+  void Unref() {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  bool empty() const { return tombstones_.empty(); }
+
+  // The tombstones the list was built from, coalesced.
+  const std::vector<RangeTombstone>& tombstones() const { return tombstones_; }
+
+  // Return the largest sequence number no larger than "snapshot" of a
+  // tombstone covering "user_key", or 0 if there is none.
+  SequenceNumber MaxCoveringSequence(const Slice& user_key,
+                                     SequenceNumber snapshot) const;
+
+ private:
+  struct Fragment {
+    std::string start;
+    std::string end;
+    size_t seqs_begin;  // Range of seqs_ covering the fragment, largest
+    size_t seqs_end;    // first
+  };
+
+  std::atomic<int> refs_;
+  const Comparator* const ucmp_;
+  std::vector<RangeTombstone> tombstones_;
+  std::vector<Fragment> fragments_;  // Sorted by start, non-overlapping
+  std::vector<SequenceNumber> seqs_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
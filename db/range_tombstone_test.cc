@@ -0,0 +1,75 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_tombstone.h"
+
+#include "leveldb/comparator.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+class RangeTombstoneTest {
+ public:
+  SequenceNumber Covering(const RangeTombstoneList& list, const char* key,
+                          SequenceNumber snapshot = kMaxSequenceNumber) {
+    return list.MaxCoveringSequence(key, snapshot);
+  }
+};
+
+TEST(RangeTombstoneTest, EmptyList) {
+  RangeTombstoneList list(BytewiseComparator(), {});
+  ASSERT_TRUE(list.empty());
+  ASSERT_EQ(0, Covering(list, "a"));
+}
+
+TEST(RangeTombstoneTest, Single) {
+  RangeTombstoneList list(BytewiseComparator(), {RangeTombstone("b", "d", 5)});
+  ASSERT_EQ(0, Covering(list, "a"));
+  ASSERT_EQ(5, Covering(list, "b"));
+  ASSERT_EQ(5, Covering(list, "c"));
+  ASSERT_EQ(0, Covering(list, "d"));
+  ASSERT_EQ(0, Covering(list, "b", 4));
+  ASSERT_EQ(5, Covering(list, "b", 5));
+}
+
+TEST(RangeTombstoneTest, Overlapping) {
+  RangeTombstoneList list(
+      BytewiseComparator(),
+      {RangeTombstone("e", "k", 3), RangeTombstone("a", "g", 7),
+       RangeTombstone("f", "h", 5), RangeTombstone("x", "x", 9)});
+  ASSERT_EQ(7, Covering(list, "a"));
+  ASSERT_EQ(7, Covering(list, "e"));
+  ASSERT_EQ(7, Covering(list, "f"));
+  ASSERT_EQ(5, Covering(list, "g"));
+  ASSERT_EQ(3, Covering(list, "h"));
+  ASSERT_EQ(0, Covering(list, "k"));
+  ASSERT_EQ(0, Covering(list, "x"));
+
+  // Older snapshots only see older tombstones.
+  ASSERT_EQ(5, Covering(list, "f", 6));
+  ASSERT_EQ(3, Covering(list, "f", 4));
+  ASSERT_EQ(0, Covering(list, "a", 6));
+
+  // The empty tombstone is dropped.
+  ASSERT_EQ(3, list.tombstones().size());
+}
+
+TEST(RangeTombstoneTest, Coalesce) {
+  std::vector<RangeTombstone> v = {
+      RangeTombstone("c", "e", 4), RangeTombstone("a", "c", 4),
+      RangeTombstone("d", "f", 4), RangeTombstone("b", "d", 2),
+      RangeTombstone("m", "m", 4)};
+  CoalesceRangeTombstones(BytewiseComparator(), &v);
+  ASSERT_EQ(2, v.size());
+  ASSERT_EQ("a", v[0].start);
+  ASSERT_EQ("f", v[0].end);
+  ASSERT_EQ(4, v[0].seq);
+  ASSERT_EQ("b", v[1].start);
+  ASSERT_EQ("d", v[1].end);
+  ASSERT_EQ(2, v[1].seq);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) { return leveldb::test::RunAllTests(); }
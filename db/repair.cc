@@ -31,6 +31,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "db/write_batch_internal.h"
@@ -119,6 +120,8 @@ class Repairer {
             logs_.push_back(number);
           } else if (type == kTableFile) {
             table_numbers_.push_back(number);
+          } else if (type == kBlobFile) {
+            blob_numbers_.push_back(number);
           } else {
             // Ignore other files
           }
@@ -171,7 +174,7 @@ class Repairer {
     // propagating bad information (like overly large sequence
     // numbers).
     log::Reader reader(lfile, &reporter, false /*do not checksum*/,
-                       0 /*initial_offset*/);
+                       0 /*initial_offset*/, log);
 
     // Read all the records and add to a memtable
     std::string scratch;
@@ -203,8 +206,11 @@ class Repairer {
     FileMetaData meta;
     meta.number = next_file_number_++;
     Iterator* iter = mem->NewIterator();
-    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
+    status = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                        range_del_iter, &meta);
     delete iter;
+    delete range_del_iter;
     mem->Unref();
     mem = nullptr;
     if (status.ok()) {
@@ -281,6 +287,22 @@ class Repairer {
       status = iter->status();
     }
     delete iter;
+
+    // Range tombstones widen the key range of the table.
+    std::vector<RangeTombstone> tombstones;
+    if (status.ok()) {
+      status = table_cache_->GetRangeTombstones(t.meta.number,
+                                                t.meta.file_size, &tombstones);
+    }
+    bool has_bounds = !empty;
+    for (const RangeTombstone& tombstone : tombstones) {
+      ExtendKeyRange(icmp_, tombstone, &has_bounds, &t.meta.smallest,
+                     &t.meta.largest);
+      if (tombstone.seq > t.max_sequence) {
+        t.max_sequence = tombstone.seq;
+      }
+    }
+    t.meta.has_range_tombstones = !tombstones.empty();
     Log(options_.info_log, "Table #%llu: %d entries %s",
         (unsigned long long)t.meta.number, counter, status.ToString().c_str());
 
@@ -369,7 +391,19 @@ class Repairer {
       // TODO(opt): separate out into multiple levels
       const TableInfo& t = tables_[i];
       edit_.AddFile(0, t.meta.number, t.meta.file_size, t.meta.smallest,
-                    t.meta.largest);
+                    t.meta.largest, t.meta.has_range_tombstones);
+    }
+
+    // The tables may refer to any blob file.  Keep them all, with no
+    // garbage, since which records are in use is not known.
+    for (size_t i = 0; i < blob_numbers_.size(); i++) {
+      uint64_t file_size;
+      if (env_->GetFileSize(BlobFileName(dbname_, blob_numbers_[i]),
+                            &file_size)
+              .ok() &&
+          file_size > 0) {
+        edit_.AddBlobFile(blob_numbers_[i], file_size);
+      }
     }
 
     // fprintf(stderr, "NewDescriptor:\n%s\n", edit_.DebugString().c_str());
@@ -436,6 +470,7 @@ class Repairer {
 
   std::vector<std::string> manifests_;
   std::vector<uint64_t> table_numbers_;
+  std::vector<uint64_t> blob_numbers_;
   std::vector<uint64_t> logs_;
   std::vector<TableInfo> tables_;
   uint64_t next_file_number_;
@@ -81,6 +81,30 @@ public:
 		}
 	}
 
+	// 将[begin, end)范围内所有key的value置为空，与Delete的处理方式相同
+	void clear_range(const std::string &begin, const std::string &end, log::Writer *log_=NULL)
+	{
+		assert(header != NULL);
+		node_ptr p = header;
+		// 先找到第一个不小于begin的节点
+		for (int i = current_level - 1; i >= 0; --i)
+		{
+			node_ptr next = NULL;
+			while ((next = p->get_level(i)) != NULL && next->key < begin)
+				p = next;
+		}
+		for (p = p->get_level(0); p != NULL && p->key < end; p = p->get_level(0))
+		{
+			if (log_ != NULL)
+			{
+				WriteBatch updates;
+				updates.Put(Slice(p->key), Slice());
+				log_->AddRecord(WriteBatchInternal::Contents(&updates));
+			}
+			p->value = "";
+		}
+	}
+
 	bool remove(const std::string &k)
 	{
 		assert(header != NULL);
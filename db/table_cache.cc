@@ -4,7 +4,10 @@
 
 #include "db/table_cache.h"
 
+#include "db/blob_file.h"
+#include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_tombstone.h"
 #include "leveldb/env.h"
 #include "leveldb/table.h"
 #include "util/coding.h"
@@ -14,15 +17,21 @@ namespace leveldb {
 struct TableAndFile {
   RandomAccessFile* file;
   Table* table;
+  RangeTombstoneList* range_dels;  // Null if the table has no tombstones
 };
 
 static void DeleteEntry(const Slice& key, void* value) {
   TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
+  delete tf->range_dels;
   delete tf->table;
   delete tf->file;
   delete tf;
 }
 
+static void DeleteBlobFileEntry(const Slice& key, void* value) {
+  delete reinterpret_cast<RandomAccessFile*>(value);
+}
+
 static void UnrefEntry(void* arg1, void* arg2) {
   Cache* cache = reinterpret_cast<Cache*>(arg1);
   Cache::Handle* h = reinterpret_cast<Cache::Handle*>(arg2);
@@ -38,6 +47,14 @@ TableCache::TableCache(const std::string& dbname, const Options& options,
 
 TableCache::~TableCache() { delete cache_; }
 
+Status TableCache::OpenTableFile(const std::string& fname,
+                                 RandomAccessFile** file) {
+  if (options_.use_direct_reads) {
+    return env_->NewDirectRandomAccessFile(fname, file);
+  }
+  return env_->NewRandomAccessFile(fname, file);
+}
+
 Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
                              Cache::Handle** handle) {
   Status s;
@@ -52,10 +69,10 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
     std::string fname = TableFileName(dbname_, file_number);
     RandomAccessFile* file = nullptr;
     Table* table = nullptr;
-    s = env_->NewRandomAccessFile(fname, &file);
+    s = OpenTableFile(fname, &file);
     if (!s.ok()) {
       std::string old_fname = SSTTableFileName(dbname_, file_number);
-      if (env_->NewRandomAccessFile(old_fname, &file).ok()) {
+      if (OpenTableFile(old_fname, &file).ok()) {
         s = Status::OK();
       }
     }
@@ -63,6 +80,14 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
       // 将.sst文件映射到table，Table类用于解析.sst文件
       s = Table::Open(options_, file, file_size, &table);
     }
+    RangeTombstoneList* range_dels = nullptr;
+    if (s.ok()) {
+      s = ReadRangeTombstones(table, &range_dels);
+      if (!s.ok()) {
+        delete table;
+        table = nullptr;
+      }
+    }
 
     if (!s.ok()) {
       assert(table == nullptr);
@@ -73,6 +98,7 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
       TableAndFile* tf = new TableAndFile;
       tf->file = file;
       tf->table = table;
+      tf->range_dels = range_dels;
 
       // 将tf插入到LRUCache中，占据一个大小的缓存，DeleteEntry是删除结点的回调函数
       *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
@@ -81,6 +107,45 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
   return s;
 }
 
+// Blob files share the cache with tables.  File numbers are unique across
+// both, so an entry for a blob file is never looked up as a table.
+Status TableCache::FindBlobFile(uint64_t file_number, Cache::Handle** handle) {
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  Slice key(buf, sizeof(buf));
+  *handle = cache_->Lookup(key);
+  if (*handle != nullptr) {
+    return Status::OK();
+  }
+
+  RandomAccessFile* file = nullptr;
+  Status s = OpenTableFile(BlobFileName(dbname_, file_number), &file);
+  if (s.ok()) {
+    *handle = cache_->Insert(key, file, 1, &DeleteBlobFileEntry);
+  }
+  return s;
+}
+
+Status TableCache::ReadRangeTombstones(Table* table,
+                                       RangeTombstoneList** result) {
+  *result = nullptr;
+  Iterator* iter = table->NewRangeTombstoneIterator();
+  if (iter == nullptr) {
+    return Status::OK();
+  }
+  std::vector<RangeTombstone> tombstones;
+  Status s = AppendRangeTombstones(iter, &tombstones);
+  delete iter;
+  if (s.ok() && !tombstones.empty()) {
+    // Tables of a DB are always built with an InternalKeyComparator.
+    const Comparator* ucmp =
+        static_cast<const InternalKeyComparator*>(options_.comparator)
+            ->user_comparator();
+    *result = new RangeTombstoneList(ucmp, std::move(tombstones));
+  }
+  return s;
+}
+
 Iterator* TableCache::NewIterator(const ReadOptions& options,
                                   uint64_t file_number, uint64_t file_size,
                                   Table** tableptr) {
@@ -106,12 +171,73 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
                        uint64_t file_size, const Slice& k, void* arg,
                        void (*handle_result)(void*, const Slice&,
-                                             const Slice&)) {
+                                             const Slice&),
+                       SequenceNumber* tombstone_seq,
+                       PinnableSlice* value) {
   Cache::Handle* handle = nullptr;
   Status s = FindTable(file_number, file_size, &handle);
   if (s.ok()) {
-    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, handle_result);
+    TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+    if (tombstone_seq != nullptr) {
+      *tombstone_seq = 0;
+      if (tf->range_dels != nullptr) {
+        const SequenceNumber snapshot =
+            DecodeFixed64(k.data() + k.size() - 8) >> 8;
+        *tombstone_seq =
+            tf->range_dels->MaxCoveringSequence(ExtractUserKey(k), snapshot);
+      }
+    }
+    bool table_pinned = false;
+    s = tf->table->InternalGet(options, k, arg, handle_result, value,
+                               &UnrefEntry, cache_, handle, &table_pinned);
+    if (!table_pinned) {
+      cache_->Release(handle);
+    }
+  }
+  return s;
+}
+
+bool TableCache::PrefixMayMatch(uint64_t file_number, uint64_t file_size,
+                                const Slice& target) {
+  Cache::Handle* handle = nullptr;
+  if (!FindTable(file_number, file_size, &handle).ok()) {
+    return true;
+  }
+  Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  const bool result = t->PrefixMayMatch(target);
+  cache_->Release(handle);
+  return result;
+}
+
+Status TableCache::GetRangeTombstones(uint64_t file_number, uint64_t file_size,
+                                      std::vector<RangeTombstone>* result) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+    if (tf->range_dels != nullptr) {
+      const std::vector<RangeTombstone>& t = tf->range_dels->tombstones();
+      result->insert(result->end(), t.begin(), t.end());
+    }
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+Status TableCache::GetBlob(const ReadOptions& options, const Slice& blob_index,
+                           std::string* value) {
+  BlobIndex index;
+  if (!index.DecodeFrom(blob_index)) {
+    return Status::Corruption("bad blob index");
+  }
+  Cache::Handle* handle = nullptr;
+  Status s = FindBlobFile(index.file_number, &handle);
+  if (s.ok()) {
+    RandomAccessFile* file =
+        reinterpret_cast<RandomAccessFile*>(cache_->Value(handle));
+    s = ReadBlobRecord(file, index,
+                       options.verify_checksums || options_.paranoid_checks,
+                       value);
     cache_->Release(handle);
   }
   return s;
@@ -10,9 +10,12 @@
 #include <stdint.h>
 
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
+#include "db/range_tombstone.h"
 #include "leveldb/cache.h"
+#include "leveldb/pinnable_slice.h"
 #include "leveldb/table.h"
 #include "port/port.h"
 
@@ -36,16 +39,41 @@ class TableCache {
                         uint64_t file_size, Table** tableptr = nullptr);
 
   // If a seek to internal key "k" in specified file finds an entry,
-  // call (*handle_result)(arg, found_key, found_value).
+  // call (*handle_result)(arg, found_key, found_value).  If "tombstone_seq"
+  // is non-null, also sets it to the largest sequence number, visible at
+  // the sequence number of "k", of a range tombstone of the file covering
+  // the user key of "k", or to 0 if there is none.  If "value" is
+  // non-null and an entry is found, points *value at its value, pinning
+  // the block that holds it.
   Status Get(const ReadOptions& options, uint64_t file_number,
              uint64_t file_size, const Slice& k, void* arg,
-             void (*handle_result)(void*, const Slice&, const Slice&));
+             void (*handle_result)(void*, const Slice&, const Slice&),
+             SequenceNumber* tombstone_seq = nullptr,
+             PinnableSlice* value = nullptr);
+
+  // Returns false if the specified file holds no key at or after the
+  // internal key "target" with the prefix of "target", according to its
+  // filters.  Errors are treated as potential matches.
+  bool PrefixMayMatch(uint64_t file_number, uint64_t file_size,
+                      const Slice& target);
+
+  // Append the range tombstones of the specified file to *result.
+  Status GetRangeTombstones(uint64_t file_number, uint64_t file_size,
+                            std::vector<RangeTombstone>* result);
+
+  // Store in *value the value that the encoded BlobIndex "blob_index"
+  // refers to.  Blob files are opened and cached like tables.
+  Status GetBlob(const ReadOptions& options, const Slice& blob_index,
+                 std::string* value);
 
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
  private:
+  Status OpenTableFile(const std::string& fname, RandomAccessFile** file);
   Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+  Status FindBlobFile(uint64_t file_number, Cache::Handle**);
+  Status ReadRangeTombstones(Table* table, RangeTombstoneList** result);
 
   Env* const env_;
   const std::string dbname_;
@@ -20,7 +20,11 @@ enum Tag {
   kDeletedFile = 6,
   kNewFile = 7,
   // 8 was used for large value refs
-  kPrevLogNumber = 9
+  kPrevLogNumber = 9,
+  kNewFileWithRangeTombstones = 10,  // kNewFile of a table with tombstones
+  kNewBlobFile = 11,
+  kBlobGarbage = 12,
+  kTableBlobFiles = 13  // Follows the kNewFile of a table referring to blobs
 };
 
 void VersionEdit::Clear() {
@@ -36,6 +40,8 @@ void VersionEdit::Clear() {
   has_last_sequence_ = false;
   deleted_files_.clear();
   new_files_.clear();
+  new_blob_files_.clear();
+  blob_garbage_.clear();
 }
 
 void VersionEdit::EncodeTo(std::string* dst) const {
@@ -74,12 +80,34 @@ void VersionEdit::EncodeTo(std::string* dst) const {
 
   for (size_t i = 0; i < new_files_.size(); i++) {
     const FileMetaData& f = new_files_[i].second;
-    PutVarint32(dst, kNewFile);
+    PutVarint32(dst, f.has_range_tombstones ? kNewFileWithRangeTombstones
+                                            : kNewFile);
     PutVarint32(dst, new_files_[i].first);  // level
     PutVarint64(dst, f.number);
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (!f.blob_files.empty()) {
+      PutVarint32(dst, kTableBlobFiles);
+      PutVarint64(dst, f.number);
+      PutVarint32(dst, static_cast<uint32_t>(f.blob_files.size()));
+      for (uint64_t blob_number : f.blob_files) {
+        PutVarint64(dst, blob_number);
+      }
+    }
+  }
+
+  for (const BlobFileMetaData& f : new_blob_files_) {
+    PutVarint32(dst, kNewBlobFile);
+    PutVarint64(dst, f.number);
+    PutVarint64(dst, f.total_bytes);
+    PutVarint64(dst, f.garbage_bytes);
+  }
+
+  for (const auto& garbage : blob_garbage_) {
+    PutVarint32(dst, kBlobGarbage);
+    PutVarint64(dst, garbage.first);   // file number
+    PutVarint64(dst, garbage.second);  // bytes
   }
 }
 
@@ -112,6 +140,9 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
   int level;
   uint64_t number;
   FileMetaData f;
+  BlobFileMetaData blob;
+  uint64_t bytes;
+  uint32_t count;
   Slice str;
   InternalKey key;
 
@@ -175,6 +206,9 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         break;
 
       case kNewFile:
+      case kNewFileWithRangeTombstones:
+        f.has_range_tombstones = (tag == kNewFileWithRangeTombstones);
+        f.blob_files.clear();
         if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
             GetVarint64(&input, &f.file_size) &&
             GetInternalKey(&input, &f.smallest) &&
@@ -185,6 +219,41 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kTableBlobFiles:
+        if (GetVarint64(&input, &number) && GetVarint32(&input, &count) &&
+            !new_files_.empty() && new_files_.back().second.number == number) {
+          std::vector<uint64_t>* blob_files =
+              &new_files_.back().second.blob_files;
+          for (uint32_t i = 0; i < count && msg == nullptr; i++) {
+            if (GetVarint64(&input, &number)) {
+              blob_files->push_back(number);
+            } else {
+              msg = "table blob files";
+            }
+          }
+        } else {
+          msg = "table blob files";
+        }
+        break;
+
+      case kNewBlobFile:
+        if (GetVarint64(&input, &blob.number) &&
+            GetVarint64(&input, &blob.total_bytes) &&
+            GetVarint64(&input, &blob.garbage_bytes)) {
+          new_blob_files_.push_back(blob);
+        } else {
+          msg = "new-blob-file entry";
+        }
+        break;
+
+      case kBlobGarbage:
+        if (GetVarint64(&input, &number) && GetVarint64(&input, &bytes)) {
+          blob_garbage_.push_back(std::make_pair(number, bytes));
+        } else {
+          msg = "blob garbage";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -249,6 +318,27 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.has_range_tombstones) {
+      r.append(" +range_tombstones");
+    }
+    for (uint64_t blob_number : f.blob_files) {
+      r.append(" +blob ");
+      AppendNumberTo(&r, blob_number);
+    }
+  }
+  for (const BlobFileMetaData& f : new_blob_files_) {
+    r.append("\n  AddBlobFile: ");
+    AppendNumberTo(&r, f.number);
+    r.append(" ");
+    AppendNumberTo(&r, f.total_bytes);
+    r.append(" ");
+    AppendNumberTo(&r, f.garbage_bytes);
+  }
+  for (const auto& garbage : blob_garbage_) {
+    r.append("\n  BlobGarbage: ");
+    AppendNumberTo(&r, garbage.first);
+    r.append(" ");
+    AppendNumberTo(&r, garbage.second);
   }
   r.append("\n}\n");
   return r;
@@ -16,7 +16,11 @@ namespace leveldb {
 class VersionSet;
 
 struct FileMetaData {
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) {}
+  FileMetaData()
+      : refs(0),
+        allowed_seeks(1 << 30),
+        file_size(0),
+        has_range_tombstones(false) {}
 
   int refs;
   int allowed_seeks;  // Seeks allowed until compaction
@@ -24,6 +28,16 @@ struct FileMetaData {
   uint64_t file_size;    // File size in bytes
   InternalKey smallest;  // Smallest internal key served by table
   InternalKey largest;   // Largest internal key served by table
+  bool has_range_tombstones;  // Range tombstones extend smallest..largest
+  std::vector<uint64_t> blob_files;  // Blob files the table refers to
+};
+
+struct BlobFileMetaData {
+  BlobFileMetaData() : number(0), total_bytes(0), garbage_bytes(0) {}
+
+  uint64_t number;
+  uint64_t total_bytes;    // Size of all records in the file
+  uint64_t garbage_bytes;  // Size of the records no table refers to
 };
 
 class VersionEdit {
@@ -60,13 +74,18 @@ class VersionEdit {
   // Add the specified file at the specified number.
   // REQUIRES: This version has not been saved (see VersionSet::SaveTo)
   // REQUIRES: "smallest" and "largest" are smallest and largest keys in file
+  // REQUIRES: "blob_files" lists the blob files the table refers to
   void AddFile(int level, uint64_t file, uint64_t file_size,
-               const InternalKey& smallest, const InternalKey& largest) {
+               const InternalKey& smallest, const InternalKey& largest,
+               bool has_range_tombstones = false,
+               const std::vector<uint64_t>& blob_files = {}) {
     FileMetaData f;
     f.number = file;
     f.file_size = file_size;
     f.smallest = smallest;
     f.largest = largest;
+    f.has_range_tombstones = has_range_tombstones;
+    f.blob_files = blob_files;
     new_files_.push_back(std::make_pair(level, f));
   }
 
@@ -75,6 +94,23 @@ class VersionEdit {
     deleted_files_.insert(std::make_pair(level, file));
   }
 
+  // Add the blob file with the specified number, holding "total_bytes" of
+  // records, of which "garbage_bytes" are no longer referenced.
+  void AddBlobFile(uint64_t file, uint64_t total_bytes,
+                   uint64_t garbage_bytes = 0) {
+    BlobFileMetaData f;
+    f.number = file;
+    f.total_bytes = total_bytes;
+    f.garbage_bytes = garbage_bytes;
+    new_blob_files_.push_back(f);
+  }
+
+  // Record that tables no longer refer to "bytes" of records of blob file
+  // "file".  A blob file is dropped once all of its records are garbage.
+  void AddBlobGarbage(uint64_t file, uint64_t bytes) {
+    blob_garbage_.push_back(std::make_pair(file, bytes));
+  }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(const Slice& src);
 
@@ -99,6 +135,8 @@ class VersionEdit {
   std::vector<std::pair<int, InternalKey>> compact_pointers_;  // <level, 对应level的下次compation启动的key>
   DeletedFileSet deleted_files_;
   std::vector<std::pair<int, FileMetaData>> new_files_;  // <level，文件描述信息>
+  std::vector<BlobFileMetaData> new_blob_files_;
+  std::vector<std::pair<uint64_t, uint64_t>> blob_garbage_;  // <number, bytes>
 };
 
 }  // namespace leveldb
@@ -28,8 +28,14 @@ TEST(VersionEditTest, EncodeDecode) {
     edit.AddFile(3, kBig + 300 + i, kBig + 400 + i,
                  InternalKey("foo", kBig + 500 + i, kTypeValue),
                  InternalKey("zoo", kBig + 600 + i, kTypeDeletion));
+    edit.AddFile(3, kBig + 800 + i, kBig + 400 + i,
+                 InternalKey("foo", kBig + 500 + i, kTypeValue),
+                 InternalKey("zoo", kBig + 600 + i, kTypeBlobIndex), i % 2 == 0,
+                 std::vector<uint64_t>(i + 1, kBig + 1100 + i));
     edit.DeleteFile(4, kBig + 700 + i);
     edit.SetCompactPointer(i, InternalKey("x", kBig + 900 + i, kTypeValue));
+    edit.AddBlobFile(kBig + 1100 + i, kBig + 1200 + i, i);
+    edit.AddBlobGarbage(kBig + 1300 + i, kBig + 1400 + i);
   }
 
   edit.SetComparatorName("foo");
@@ -7,18 +7,22 @@
 #include <stdio.h>
 
 #include <algorithm>
+#include <map>
 
 #include "db/filename.h"
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/merge_context.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
+#include "leveldb/pinnable_slice.h"
 #include "leveldb/table_builder.h"
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
 #include "util/logging.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -52,6 +56,17 @@ static double MaxBytesForLevel(const Options* options, int level) {
   return result;
 }
 
+// An intra-level-0 compaction is preferred over a level-0 => level-1
+// compaction when level-1 holds more than this many times the bytes of
+// level-0 in the key range they share: the small level-0 files are then
+// merged into one sub-level without rewriting the much larger level-1.
+static const int kIntraL0CompactionRatio = 4;
+
+// Under kTieredCompaction, the newest level-0 sub-levels are merged to
+// keep their number below this, where writes would soon be slowed down,
+// even when their sizes do not call for a merge.
+static const int kTieredMaxSubLevels = config::kL0_SlowdownWritesTrigger - 2;
+
 static uint64_t MaxFileSizeForLevel(const Options* options, int level) {
   // We could vary per level to reduce number of files?
   return TargetFileSize(options);
@@ -83,12 +98,19 @@ Version::~Version() {
       }
     }
   }
+  if (range_dels_ != nullptr) {
+    range_dels_->Unref();
+  }
 }
 
 int FindFile(const InternalKeyComparator& icmp,
              const std::vector<FileMetaData*>& files, const Slice& key) {
-  uint32_t left = 0;
-  uint32_t right = files.size();
+  return FindFileInRange(icmp, files, key, 0, files.size());
+}
+
+int FindFileInRange(const InternalKeyComparator& icmp,
+                    const std::vector<FileMetaData*>& files, const Slice& key,
+                    uint32_t left, uint32_t right) {
   while (left < right) {
     uint32_t mid = (left + right) / 2;
     const FileMetaData* f = files[mid];
@@ -105,6 +127,41 @@ int FindFile(const InternalKeyComparator& icmp,
   return right;
 }
 
+void BuildFileIndexBounds(const InternalKeyComparator& icmp,
+                          const std::vector<FileMetaData*>& files,
+                          const std::vector<FileMetaData*>& next_files,
+                          std::vector<FileIndexBound>* bounds) {
+  // A key that FindFile() places at index i of "files" is greater than
+  // files[i-1]->largest and at most files[i]->largest.  Both bounds only
+  // move forward with i, so a single merge pass over the two levels finds
+  // the first file of "next_files" past the former and the first one not
+  // before the latter.
+  bounds->resize(files.size() + 1);
+  uint32_t left = 0;
+  uint32_t right = 0;
+  for (size_t i = 0; i <= files.size(); i++) {
+    if (i > 0) {
+      const Slice prev_largest = files[i - 1]->largest.Encode();
+      while (left < next_files.size() &&
+             icmp.Compare(next_files[left]->largest.Encode(), prev_largest) <=
+                 0) {
+        left++;
+      }
+    }
+    if (i < files.size()) {
+      const Slice largest = files[i]->largest.Encode();
+      while (right < next_files.size() &&
+             icmp.Compare(next_files[right]->largest.Encode(), largest) < 0) {
+        right++;
+      }
+    } else {
+      right = next_files.size();
+    }
+    (*bounds)[i].left = left;
+    (*bounds)[i].right = right;
+  }
+}
+
 static bool AfterFile(const Comparator* ucmp, const Slice* user_key,
                       const FileMetaData* f) {
   // null user_key occurs before all keys and is therefore never after *f
@@ -163,26 +220,30 @@ bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
 // encoded using EncodeFixed64.
 class Version::LevelFileNumIterator : public Iterator {
  public:
+  // Iterates over (*flist)[begin, end), or all of *flist if "end" is -1.
   LevelFileNumIterator(const InternalKeyComparator& icmp,
-                       const std::vector<FileMetaData*>* flist)
-      : icmp_(icmp), flist_(flist), index_(flist->size()) {  // Marks as invalid
-  }
-  bool Valid() const override { return index_ < flist_->size(); }
+                       const std::vector<FileMetaData*>* flist,
+                       uint32_t begin = 0, uint32_t end = -1)
+      : icmp_(icmp),
+        flist_(flist),
+        begin_(begin),
+        end_(std::min<uint32_t>(end, flist->size())),
+        index_(end_) {  // Marks as invalid
+  }
+  bool Valid() const override { return index_ < end_; }
   void Seek(const Slice& target) override {
-    index_ = FindFile(icmp_, *flist_, target);
-  }
-  void SeekToFirst() override { index_ = 0; }
-  void SeekToLast() override {
-    index_ = flist_->empty() ? 0 : flist_->size() - 1;
+    index_ = FindFileInRange(icmp_, *flist_, target, begin_, end_);
   }
+  void SeekToFirst() override { index_ = begin_; }
+  void SeekToLast() override { index_ = end_ == begin_ ? end_ : end_ - 1; }
   void Next() override {
     assert(Valid());
     index_++;
   }
   void Prev() override {
     assert(Valid());
-    if (index_ == 0) {
-      index_ = flist_->size();  // Marks as invalid
+    if (index_ == begin_) {
+      index_ = end_;  // Marks as invalid
     } else {
       index_--;
     }
@@ -202,6 +263,8 @@ class Version::LevelFileNumIterator : public Iterator {
  private:
   const InternalKeyComparator icmp_;
   const std::vector<FileMetaData*>* const flist_;
+  const uint32_t begin_;
+  const uint32_t end_;
   uint32_t index_;
 
   // Backing store for value().  Holds the file number and size.
@@ -220,29 +283,99 @@ static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
   }
 }
 
-Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
-                                            int level) const {
-  return NewTwoLevelIterator(
-      new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetFileIterator,
-      vset_->table_cache_, options);
+// Lets concatenating iterators with ReadOptions::prefix_same_as_start
+// skip the files whose filters lack the prefix they seek.
+static bool FilePrefixMayMatch(void* arg, const Slice& file_value,
+                               const Slice& target) {
+  TableCache* cache = reinterpret_cast<TableCache*>(arg);
+  if (file_value.size() != 16) {
+    return true;
+  }
+  return cache->PrefixMayMatch(DecodeFixed64(file_value.data()),
+                               DecodeFixed64(file_value.data() + 8), target);
+}
+
+void Version::AddSortedRunIterator(const ReadOptions& options,
+                                   const std::vector<FileMetaData*>& files,
+                                   bool lazy,
+                                   std::vector<Iterator*>* iters) const {
+  const InternalKeyComparator& icmp = vset_->icmp_;
+  uint32_t begin = 0;
+  uint32_t end = files.size();
+  if (options.iterate_lower_bound != nullptr) {
+    begin = FindFile(icmp, files, *options.iterate_lower_bound);
+  }
+  if (options.iterate_upper_bound != nullptr) {
+    uint32_t left = begin;
+    while (left < end) {
+      uint32_t mid = (left + end) / 2;
+      if (icmp.Compare(files[mid]->smallest.Encode(),
+                       *options.iterate_upper_bound) < 0) {
+        left = mid + 1;
+      } else {
+        end = mid;
+      }
+    }
+  }
+
+  if (begin >= end) {
+    return;
+  } else if (end - begin == 1 && !lazy) {
+    iters->push_back(vset_->table_cache_->NewIterator(
+        options, files[begin]->number, files[begin]->file_size));
+  } else {
+    iters->push_back(NewTwoLevelIterator(
+        new LevelFileNumIterator(icmp, &files, begin, end), &GetFileIterator,
+        vset_->table_cache_, options, &icmp, &FilePrefixMayMatch));
+  }
 }
 
 void Version::AddIterators(const ReadOptions& options,
                            std::vector<Iterator*>* iters) {
-  // Merge all level zero files together since they may overlap
-  for (size_t i = 0; i < files_[0].size(); i++) {
-    iters->push_back(vset_->table_cache_->NewIterator(
-        options, files_[0][i]->number, files_[0][i]->file_size));
+  // Merge the level-0 sub-levels together since they may overlap.  The
+  // files within a sub-level do not, so each sub-level is walked by a
+  // single concatenating iterator.
+  for (size_t i = 0; i < l0_sublevels_.size(); i++) {
+    AddSortedRunIterator(options, l0_sublevels_[i], false, iters);
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
   // walks through the non-overlapping files in the level, opening them
   // lazily.
   for (int level = 1; level < config::kNumLevels; level++) {
-    if (!files_[level].empty()) {
-      iters->push_back(NewConcatenatingIterator(options, level));
+    AddSortedRunIterator(options, files_[level], true, iters);
+  }
+}
+
+Status Version::GetRangeTombstones(RangeTombstoneList** result) {
+  MutexLock l(&range_dels_mu_);
+  if (!range_dels_loaded_) {
+    std::vector<RangeTombstone> tombstones;
+    for (int level = 0; level < config::kNumLevels; level++) {
+      for (FileMetaData* f : files_[level]) {
+        if (f->has_range_tombstones) {
+          // Errors are not cached, so that the next caller retries.
+          Status s = vset_->table_cache_->GetRangeTombstones(
+              f->number, f->file_size, &tombstones);
+          if (!s.ok()) {
+            *result = nullptr;
+            return s;
+          }
+        }
+      }
+    }
+    if (!tombstones.empty()) {
+      range_dels_ = new RangeTombstoneList(vset_->icmp_.user_comparator(),
+                                           std::move(tombstones));
+      range_dels_->Ref();
     }
+    range_dels_loaded_ = true;
+  }
+  *result = range_dels_;
+  if (range_dels_ != nullptr) {
+    range_dels_->Ref();
   }
+  return Status::OK();
 }
 
 // Callback from TableCache::Get()
@@ -252,12 +385,14 @@ enum SaverState {
   kFound,
   kDeleted,
   kCorrupt,
+  kMerge,
 };
 struct Saver {
   SaverState state;
   const Comparator* ucmp;
   Slice user_key;
-  std::string* value;
+  SequenceNumber seq;  // Of the entry found, if any
+  bool is_blob_index;  // The value is the BlobIndex of the value
 };
 }  // namespace
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -267,49 +402,151 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     s->state = kCorrupt;
   } else {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
-      if (s->state == kFound) {
-        s->value->assign(v.data(), v.size());
+      switch (parsed_key.type) {
+        case kTypeValue:
+        case kTypeBlobIndex:
+          s->state = kFound;
+          break;
+        case kTypeMerge:
+          s->state = kMerge;
+          break;
+        default:
+          s->state = kDeleted;
+          break;
       }
+      s->seq = parsed_key.sequence;
+      s->is_blob_index = (parsed_key.type == kTypeBlobIndex);
     }
   }
 }
 
+// Adds the merge operands for the user key of "ikey" in the table "f", from
+// the entry at "ikey" on, to *merge_context.  If they end in a value or a
+// deletion in the table, applies them to it, stores the result in *value
+// and sets *done.  Entries older than "covering_seq" count as deleted.
+static Status GetMergeOperands(TableCache* table_cache,
+                               const ReadOptions& options,
+                               const Comparator* ucmp,
+                               const MergeOperator* merge_operator,
+                               FileMetaData* f, const Slice& ikey,
+                               SequenceNumber covering_seq,
+                               MergeContext* merge_context,
+                               PinnableSlice* value, bool* done) {
+  const Slice user_key = ExtractUserKey(ikey);
+  Iterator* iter = table_cache->NewIterator(options, f->number, f->file_size);
+  Status s;
+  *done = false;
+  for (iter->Seek(ikey); iter->Valid() && !*done; iter->Next()) {
+    ParsedInternalKey parsed_key;
+    if (!ParseInternalKey(iter->key(), &parsed_key)) {
+      s = Status::Corruption("corrupted key for ", user_key);
+      break;
+    }
+    if (ucmp->Compare(parsed_key.user_key, user_key) != 0) {
+      break;
+    }
+    ValueType type = parsed_key.type;
+    if (parsed_key.sequence < covering_seq) {
+      type = kTypeDeletion;
+    }
+    switch (type) {
+      case kTypeMerge:
+        merge_context->AddOlder(iter->value());
+        break;
+      case kTypeValue: {
+        const Slice existing_value = iter->value();
+        s = merge_context->Merge(merge_operator, user_key, &existing_value,
+                                 value->GetSelf());
+        *done = true;
+        break;
+      }
+      case kTypeBlobIndex: {
+        std::string existing_value;
+        s = table_cache->GetBlob(options, iter->value(), &existing_value);
+        if (s.ok()) {
+          const Slice existing(existing_value);
+          s = merge_context->Merge(merge_operator, user_key, &existing,
+                                   value->GetSelf());
+        }
+        *done = true;
+        break;
+      }
+      default:
+        s = merge_context->Merge(merge_operator, user_key, nullptr,
+                                 value->GetSelf());
+        *done = true;
+        break;
+    }
+    if (!s.ok()) {
+      break;
+    }
+  }
+  if (s.ok()) {
+    s = iter->status();
+  }
+  delete iter;
+  if (s.ok() && *done) {
+    value->PinSelf();
+  }
+  return s;
+}
+
 static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
   return a->number > b->number;
 }
 
+FileMetaData* Version::FindL0File(size_t sublevel, const Slice& user_key,
+                                  const Slice& internal_key) const {
+  const std::vector<FileMetaData*>& files = l0_sublevels_[sublevel];
+  uint32_t index = FindFile(vset_->icmp_, files, internal_key);
+  if (index >= files.size() ||
+      vset_->icmp_.user_comparator()->Compare(
+          user_key, files[index]->smallest.user_key()) < 0) {
+    return nullptr;
+  }
+  return files[index];
+}
+
+uint32_t Version::FindFileCascaded(int level, const Slice& internal_key,
+                                   int* prev_level,
+                                   uint32_t* prev_index) const {
+  uint32_t index;
+  if (*prev_level > 0 && !cascade_[*prev_level].empty()) {
+    const FileIndexBound& bound = cascade_[*prev_level][*prev_index];
+    index = FindFileInRange(vset_->icmp_, files_[level], internal_key,
+                            bound.left, bound.right);
+  } else {
+    index = FindFile(vset_->icmp_, files_[level], internal_key);
+  }
+  *prev_level = level;
+  *prev_index = index;
+  return index;
+}
+
 void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
                                  bool (*func)(void*, int, FileMetaData*)) {
   // TODO(sanjay): Change Version::Get() to use this function.
   const Comparator* ucmp = vset_->icmp_.user_comparator();
 
-  // Search level-0 in order from newest to oldest.
-  std::vector<FileMetaData*> tmp;
-  tmp.reserve(files_[0].size());
-  for (uint32_t i = 0; i < files_[0].size(); i++) {
-    FileMetaData* f = files_[0][i];
-    if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
-        ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
-      tmp.push_back(f);
-    }
-  }
-  if (!tmp.empty()) {
-    std::sort(tmp.begin(), tmp.end(), NewestFirst);
-    for (uint32_t i = 0; i < tmp.size(); i++) {
-      if (!(*func)(arg, 0, tmp[i])) {
-        return;
-      }
+  // Search level-0 in order from newest to oldest.  The sub-levels are
+  // already ordered that way for the files overlapping any one key.
+  for (size_t i = 0; i < l0_sublevels_.size(); i++) {
+    FileMetaData* f = FindL0File(i, user_key, internal_key);
+    if (f != nullptr && !(*func)(arg, 0, f)) {
+      return;
     }
   }
 
   // Search other levels.
+  int prev_level = -1;
+  uint32_t prev_index = 0;
   for (int level = 1; level < config::kNumLevels; level++) {
     size_t num_files = files_[level].size();
     if (num_files == 0) continue;
 
     // Binary search to find earliest index whose largest key >= internal_key.
-    uint32_t index = FindFile(vset_->icmp_, files_[level], internal_key);
+    uint32_t index =
+        FindFileCascaded(level, internal_key, &prev_level, &prev_index);
     if (index < num_files) {
       FileMetaData* f = files_[level][index];
       if (ucmp->Compare(user_key, f->smallest.user_key()) < 0) {
@@ -324,10 +561,12 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
 }
 
 Status Version::Get(const ReadOptions& options, const LookupKey& k,
-                    std::string* value, GetStats* stats) {
+                    PinnableSlice* value, GetStats* stats,
+                    MergeContext* merge_context) {
   Slice ikey = k.internal_key();
   Slice user_key = k.user_key();
   const Comparator* ucmp = vset_->icmp_.user_comparator();
+  const MergeOperator* merge_operator = vset_->options_->merge_operator;
   Status s;
 
   stats->seek_file = nullptr;
@@ -335,11 +574,18 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
   FileMetaData* last_file_read = nullptr;
   int last_file_read_level = -1;
 
+  // Largest sequence number of a range tombstone covering user_key in the
+  // files searched so far.  Like other entries, tombstones never hop
+  // across levels, so everything in later files is older.
+  SequenceNumber covering_seq = 0;
+
   // We can search level-by-level since entries never hop across
   // levels.  Therefore we are guaranteed that if we find data
   // in a smaller level, later levels are irrelevant.
   std::vector<FileMetaData*> tmp;
   FileMetaData* tmp2;
+  int prev_level = -1;
+  uint32_t prev_index = 0;
   for (int level = 0; level < config::kNumLevels; level++) {
     size_t num_files = files_[level].size();
     if (num_files == 0) continue;
@@ -347,24 +593,23 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
     // Get the list of files to search in this level
     FileMetaData* const* files = &files_[level][0];
     if (level == 0) {
-      // Level-0 files may overlap each other.  Find all files that
-      // overlap user_key and process them in order from newest to oldest.
-      tmp.reserve(num_files);
-      for (uint32_t i = 0; i < num_files; i++) {
-        FileMetaData* f = files[i];
-        if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
-            ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
+      // Level-0 files may overlap each other.  Find the file that may
+      // hold user_key in every sub-level; the sub-levels order them from
+      // newest to oldest.
+      tmp.reserve(l0_sublevels_.size());
+      for (size_t i = 0; i < l0_sublevels_.size(); i++) {
+        FileMetaData* f = FindL0File(i, user_key, ikey);
+        if (f != nullptr) {
           tmp.push_back(f);
         }
       }
       if (tmp.empty()) continue;
 
-      std::sort(tmp.begin(), tmp.end(), NewestFirst);
       files = &tmp[0];
       num_files = tmp.size();
     } else {
       // Binary search to find earliest index whose largest key >= ikey.
-      uint32_t index = FindFile(vset_->icmp_, files_[level], ikey);
+      uint32_t index = FindFileCascaded(level, ikey, &prev_level, &prev_index);
       if (index >= num_files) {
         files = nullptr;
         num_files = 0;
@@ -396,35 +641,100 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
       saver.state = kNotFound;
       saver.ucmp = ucmp;
       saver.user_key = user_key;
-      saver.value = value;
-      s = vset_->table_cache_->Get(options, f->number, f->file_size, ikey,
-                                   &saver, SaveValue);
+      saver.seq = 0;
+      saver.is_blob_index = false;
+      SequenceNumber tombstone_seq = 0;
+      s = vset_->table_cache_->Get(
+          options, f->number, f->file_size, ikey, &saver, SaveValue,
+          f->has_range_tombstones ? &tombstone_seq : nullptr, value);
+      if (s.ok() && tombstone_seq > covering_seq) {
+        covering_seq = tombstone_seq;
+      }
+      if (s.ok() && saver.state == kFound && saver.seq < covering_seq) {
+        saver.state = kDeleted;
+      }
+      if (!s.ok() || saver.state != kFound) {
+        // *value was pointed at whatever entry the table found
+        value->Reset();
+      }
       if (!s.ok()) {
         return s;
       }
       switch (saver.state) {
         case kNotFound:
+          if (covering_seq > 0) {
+            return MergeDeleted(user_key, merge_context, value);
+          }
           break;  // Keep searching in other files
         case kFound:
+          if (saver.is_blob_index) {
+            // Reads the blob while *value still pins the index
+            s = vset_->table_cache_->GetBlob(options, *value,
+                                             value->GetSelf());
+            if (s.ok()) {
+              value->PinSelf();
+            } else {
+              value->Reset();
+            }
+          }
+          if (s.ok() && !merge_context->empty()) {
+            const Slice existing_value = *value;
+            s = merge_context->Merge(merge_operator, user_key,
+                                     &existing_value, value->GetSelf());
+            if (s.ok()) {
+              value->PinSelf();
+            } else {
+              value->Reset();
+            }
+          }
           return s;
         case kDeleted:
-          s = Status::NotFound(Slice());  // Use empty error message for speed
-          return s;
+          return MergeDeleted(user_key, merge_context, value);
         case kCorrupt:
           s = Status::Corruption("corrupted key for ", user_key);
           return s;
+        case kMerge: {
+          bool done;
+          s = GetMergeOperands(vset_->table_cache_, options, ucmp,
+                               merge_operator, f, ikey, covering_seq,
+                               merge_context, value, &done);
+          if (!s.ok() || done) {
+            return s;
+          }
+          if (covering_seq > 0) {
+            return MergeDeleted(user_key, merge_context, value);
+          }
+          break;  // The operands apply to entries in other files
+        }
       }
     }
   }
 
-  return Status::NotFound(Slice());  // Use an empty error message for speed
+  return MergeDeleted(user_key, merge_context, value);
+}
+
+Status Version::MergeDeleted(const Slice& user_key,
+                             const MergeContext* merge_context,
+                             PinnableSlice* value) const {
+  if (merge_context->empty()) {
+    return Status::NotFound(Slice());  // Use an empty error message for speed
+  }
+  Status s = merge_context->Merge(vset_->options_->merge_operator, user_key,
+                                  nullptr, value->GetSelf());
+  if (s.ok()) {
+    value->PinSelf();
+  }
+  return s;
 }
 
 // 更新统计信息时，直接将记录的文件的 leveldb::FileMetaData 的 allowed_seeks 减一
 // 当 allowed_seeks <= ０时，表示读取效率很低，需要执行 Compaction，减少这条路径上的文件数量。
 bool Version::UpdateStats(const GetStats& stats) {
   FileMetaData* f = stats.seek_file;
-  if (f != nullptr) {
+  // Seek compactions move files down the levels, which tiered compaction
+  // never does.
+  if (f != nullptr &&
+      vset_->options_->compaction_style == kLeveledCompaction) {
     f->allowed_seeks--;
     if (f->allowed_seeks <= 0 && file_to_compact_ == nullptr) {
       file_to_compact_ = f;
@@ -619,10 +929,12 @@ class VersionSet::Builder {
   VersionSet* vset_;  // 待操作的VersionSet.
   Version* base_;     // Version的基础版本 
   LevelState levels_[config::kNumLevels];  //各level的变化过程，包括删、增的文件。
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
 
  public:
   // Initialize a builder with the files from *base and other info from *vset
-  Builder(VersionSet* vset, Version* base) : vset_(vset), base_(base) {
+  Builder(VersionSet* vset, Version* base)
+      : vset_(vset), base_(base), blob_files_(base->blob_files_) {
     base_->Ref();
     BySmallestKey cmp;
     cmp.internal_comparator = &vset_->icmp_;
@@ -698,6 +1010,17 @@ class VersionSet::Builder {
       levels_[level].deleted_files.erase(f->number);
       levels_[level].added_files->insert(f);
     }
+
+    // Add new blob files, and the garbage of existing ones
+    for (const BlobFileMetaData& f : edit->new_blob_files_) {
+      blob_files_[f.number] = f;
+    }
+    for (const auto& garbage : edit->blob_garbage_) {
+      auto it = blob_files_.find(garbage.first);
+      if (it != blob_files_.end()) {
+        it->second.garbage_bytes += garbage.second;
+      }
+    }
   }
 
   // Save the current state in *v.
@@ -747,6 +1070,13 @@ class VersionSet::Builder {
       }
 #endif
     }
+
+    // Blob files are dropped once no table refers to any of their records.
+    for (const auto& kvp : blob_files_) {
+      if (kvp.second.garbage_bytes < kvp.second.total_bytes) {
+        v->blob_files_.insert(kvp);
+      }
+    }
   }
 
   // 用于将FileMetaData加入到Version的files_中。
@@ -1060,6 +1390,67 @@ void VersionSet::MarkFileNumberUsed(uint64_t number) {
   }
 }
 
+namespace {
+
+// Orders user keys by a user comparator.
+struct UserKeyLess {
+  explicit UserKeyLess(const Comparator* c) : ucmp(c) {}
+  bool operator()(const Slice& a, const Slice& b) const {
+    return ucmp->Compare(a, b) < 0;
+  }
+  const Comparator* ucmp;
+};
+
+// Given the sizes of the sorted runs of a tiered database, newest first,
+// return how many of the newest runs to merge into one, or 0 for none.
+int PickTieredRuns(const Options* options,
+                   const std::vector<uint64_t>& sizes) {
+  const int n = sizes.size();
+  if (n < 2) {
+    return 0;
+  }
+
+  // Merge everything if the newer runs take too much space next to the
+  // oldest one, which holds most of the data once merged.
+  uint64_t newer_bytes = 0;
+  for (int i = 0; i < n - 1; i++) {
+    newer_bytes += sizes[i];
+  }
+  if (newer_bytes * 100 >
+      sizes[n - 1] * static_cast<uint64_t>(
+                         std::max(options->max_size_amplification_percent, 0))) {
+    return n;
+  }
+
+  if (n < config::kL0_CompactionTrigger) {
+    return 0;
+  }
+
+  // Merge the newest runs while the next one is not much larger than all
+  // of them together, so that every entry is rewritten about once for
+  // each doubling of the data it is merged with.
+  uint64_t merged_bytes = sizes[0];
+  int k = 1;
+  while (k < n &&
+         sizes[k] * 100 <=
+             merged_bytes * static_cast<uint64_t>(
+                                100 + std::max(options->tiered_size_ratio, 0))) {
+    merged_bytes += sizes[k];
+    k++;
+  }
+  if (k >= 2) {
+    return k;
+  }
+
+  // Bound the number of runs a read searches.
+  if (n >= kTieredMaxSubLevels) {
+    return n - config::kL0_CompactionTrigger + 2;
+  }
+  return 0;
+}
+
+}  // namespace
+
 // levelDB会计算每个level的总的文件大小，并根据此计算出一个score，最后会根据这个score来选择合适level和文件进行Compact.
 void VersionSet::Finalize(Version* v) {
   // Precomputed best level for next compaction
@@ -1097,6 +1488,98 @@ void VersionSet::Finalize(Version* v) {
 
   v->compaction_level_ = best_level;
   v->compaction_score_ = best_score;
+
+  // Link every level >= 1 to the next non-empty level below it.
+  for (int level = 1; level < config::kNumLevels; level++) {
+    v->cascade_[level].clear();
+    if (v->files_[level].empty()) continue;
+    int next = level + 1;
+    while (next < config::kNumLevels && v->files_[next].empty()) {
+      next++;
+    }
+    if (next < config::kNumLevels) {
+      BuildFileIndexBounds(icmp_, v->files_[level], v->files_[next],
+                           &v->cascade_[level]);
+    }
+  }
+
+  // Split level-0 into sub-levels.  Walking the files from newest to
+  // oldest, each one goes right below the deepest newer file it overlaps.
+  // Files are indexed by smallest user key within each sub-level, where
+  // only the last one starting at or before a file's largest key can
+  // overlap it.
+  const Comparator* ucmp = icmp_.user_comparator();
+  typedef std::map<Slice, FileMetaData*, UserKeyLess> SubLevel;
+  std::vector<FileMetaData*> files = v->files_[0];
+  std::sort(files.begin(), files.end(), NewestFirst);
+  std::vector<SubLevel> sublevels;
+  for (size_t i = 0; i < files.size(); i++) {
+    FileMetaData* f = files[i];
+    size_t s = sublevels.size();
+    while (s > 0) {
+      const SubLevel& sublevel = sublevels[s - 1];
+      SubLevel::const_iterator it = sublevel.upper_bound(f->largest.user_key());
+      if (it != sublevel.begin() &&
+          ucmp->Compare((--it)->second->largest.user_key(),
+                        f->smallest.user_key()) >= 0) {
+        break;
+      }
+      s--;
+    }
+    if (s == sublevels.size()) {
+      sublevels.emplace_back(UserKeyLess(ucmp));
+    }
+    sublevels[s].emplace(f->smallest.user_key(), f);
+  }
+  v->l0_sublevels_.clear();
+  v->l0_sublevels_.resize(sublevels.size());
+  for (size_t i = 0; i < sublevels.size(); i++) {
+    for (const auto& entry : sublevels[i]) {
+      v->l0_sublevels_[i].push_back(entry.second);
+    }
+  }
+
+  if (options_->compaction_style == kTieredCompaction) {
+    // Only level-0 is compacted, so its sub-levels decide alone.
+    std::vector<uint64_t> sizes;
+    for (size_t i = 0; i < v->l0_sublevels_.size(); i++) {
+      sizes.push_back(TotalFileSize(v->l0_sublevels_[i]));
+    }
+    v->tiered_compaction_sublevels_ = PickTieredRuns(options_, sizes);
+    v->compaction_level_ = 0;
+    v->compaction_score_ = (v->tiered_compaction_sublevels_ > 0) ? 1 : 0;
+  } else if (!v->blob_files_.empty()) {
+    // Pick a table referring to the blob file with the highest share of
+    // garbage, so that blob files past Options::blob_gc_garbage_ratio are
+    // collected even if no other compaction reads the tables referring
+    // to them.
+    uint64_t gc_number = 0;
+    double gc_ratio = 0;
+    for (const auto& kvp : v->blob_files_) {
+      const BlobFileMetaData& f = kvp.second;
+      if (f.garbage_bytes == 0 || f.total_bytes == 0 ||
+          f.garbage_bytes < options_->blob_gc_garbage_ratio * f.total_bytes) {
+        continue;
+      }
+      const double ratio = static_cast<double>(f.garbage_bytes) / f.total_bytes;
+      if (ratio > gc_ratio) {
+        gc_number = f.number;
+        gc_ratio = ratio;
+      }
+    }
+    for (int level = 0; gc_number != 0 && level < config::kNumLevels;
+         level++) {
+      for (FileMetaData* f : v->files_[level]) {
+        if (std::find(f->blob_files.begin(), f->blob_files.end(), gc_number) !=
+            f->blob_files.end()) {
+          v->blob_gc_file_ = f;
+          v->blob_gc_level_ = level;
+          gc_number = 0;
+          break;
+        }
+      }
+    }
+  }
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log) {
@@ -1120,10 +1603,17 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest,
+                   f->has_range_tombstones, f->blob_files);
     }
   }
 
+  // Save blob files
+  for (const auto& kvp : current_->blob_files_) {
+    const BlobFileMetaData& f = kvp.second;
+    edit.AddBlobFile(f.number, f.total_bytes, f.garbage_bytes);
+  }
+
   std::string record;
   edit.EncodeTo(&record);
   return log->AddRecord(record);
@@ -1187,6 +1677,9 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
         live->insert(files[i]->number);
       }
     }
+    for (const auto& kvp : v->blob_files_) {
+      live->insert(kvp.first);
+    }
   }
 }
 
@@ -1252,26 +1745,37 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   ReadOptions options;
   options.verify_checksums = options_->paranoid_checks;
   options.fill_cache = false;
+  options.readahead_size = options_->compaction_readahead_size;
 
   // Level-0 files have to be merged together.  For other levels,
-  // we will make a concatenating iterator per level.
-  // TODO(opt): use concatenating iterator for level-0 if there is no overlap
+  // we will make a concatenating iterator per level, and likewise per
+  // sub-level for the whole level-0 sub-levels of an intra-level-0
+  // compaction.
   const int space = (c->level() == 0 ? c->inputs_[0].size() + 1 : 2);
   Iterator** list = new Iterator*[space];
   int num = 0;
-  for (int which = 0; which < 2; which++) {
-    if (!c->inputs_[which].empty()) {
-      if (c->level() + which == 0) {
-        const std::vector<FileMetaData*>& files = c->inputs_[which];
-        for (size_t i = 0; i < files.size(); i++) {
-          list[num++] = table_cache_->NewIterator(options, files[i]->number,
-                                                  files[i]->file_size);
+  if (c->IsIntraL0()) {
+    for (int i = 0; i < c->input_sublevels_; i++) {
+      list[num++] = NewTwoLevelIterator(
+          new Version::LevelFileNumIterator(
+              icmp_, &c->input_version_->l0_sublevels_[i]),
+          &GetFileIterator, table_cache_, options);
+    }
+  } else {
+    for (int which = 0; which < 2; which++) {
+      if (!c->inputs_[which].empty()) {
+        if (c->level() + which == 0) {
+          const std::vector<FileMetaData*>& files = c->inputs_[which];
+          for (size_t i = 0; i < files.size(); i++) {
+            list[num++] = table_cache_->NewIterator(
+                options, files[i]->number, files[i]->file_size);
+          }
+        } else {
+          // Create concatenating iterator for the files from this level
+          list[num++] = NewTwoLevelIterator(
+              new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]),
+              &GetFileIterator, table_cache_, options);
         }
-      } else {
-        // Create concatenating iterator for the files from this level
-        list[num++] = NewTwoLevelIterator(
-            new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]),
-            &GetFileIterator, table_cache_, options);
       }
     }
   }
@@ -1282,6 +1786,10 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
 }
 
 Compaction* VersionSet::PickCompaction() {
+  if (options_->compaction_style == kTieredCompaction) {
+    return PickTieredCompaction();
+  }
+
   Compaction* c;
   int level;
 
@@ -1289,6 +1797,7 @@ Compaction* VersionSet::PickCompaction() {
   // the compactions triggered by seeks.
   const bool size_compaction = (current_->compaction_score_ >= 1);
   const bool seek_compaction = (current_->file_to_compact_ != nullptr);
+  const bool blob_gc_compaction = (current_->blob_gc_file_ != nullptr);
   if (size_compaction) {  // 进行size_compaction
     level = current_->compaction_level_;
     assert(level >= 0);
@@ -1315,6 +1824,11 @@ Compaction* VersionSet::PickCompaction() {
     level = current_->file_to_compact_level_;
     c = new Compaction(options_, level);
     c->inputs_[0].push_back(current_->file_to_compact_);
+  } else if (blob_gc_compaction) {
+    level = current_->blob_gc_level_;
+    c = new Compaction(options_, level);
+    c->blob_gc_ = true;
+    c->inputs_[0].push_back(current_->blob_gc_file_);
   } else {
     return nullptr;
   }
@@ -1322,6 +1836,17 @@ Compaction* VersionSet::PickCompaction() {
   c->input_version_ = current_;
   c->input_version_->Ref();
 
+  // Files of deeper levels do not overlap, so one of them is rewritten in
+  // place, which also covers the last level.
+  if (c->blob_gc_ && level > 0) {
+    c->output_level_ = level;
+    return c;
+  }
+
+  if (size_compaction && level == 0 && PickIntraL0Compaction(c)) {
+    return c;
+  }
+
   // 如果是level 0 则还需查找level 0中其他和输入文件重叠的文件
   // Files in level 0 may overlap each other, so pick up all overlapping ones
   if (level == 0) {
@@ -1339,6 +1864,57 @@ Compaction* VersionSet::PickCompaction() {
   return c;
 }
 
+bool VersionSet::PickIntraL0Compaction(Compaction* c) {
+  const std::vector<FileMetaData*>& level0 = current_->files_[0];
+  if (current_->NumL0SubLevels() < 2) {
+    return false;
+  }
+
+  InternalKey smallest, largest;
+  GetRange(level0, &smallest, &largest);
+  std::vector<FileMetaData*> level1;
+  current_->GetOverlappingInputs(1, &smallest, &largest, &level1);
+  if (TotalFileSize(level1) <=
+      kIntraL0CompactionRatio * TotalFileSize(level0)) {
+    return false;
+  }
+
+  SetupIntraL0Inputs(c, current_->NumL0SubLevels());
+  Log(options_->info_log, "Intra-L0 compaction of %d files in %d sub-levels\n",
+      int(level0.size()), current_->NumL0SubLevels());
+  return true;
+}
+
+Compaction* VersionSet::PickTieredCompaction() {
+  const int sublevels = current_->tiered_compaction_sublevels_;
+  if (sublevels == 0) {
+    return nullptr;
+  }
+  Compaction* c = new Compaction(options_, 0);
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+  SetupIntraL0Inputs(c, sublevels);
+  Log(options_->info_log, "Tiered compaction of %d files in %d of %d sub-levels\n",
+      c->num_input_files(0), sublevels, current_->NumL0SubLevels());
+  return c;
+}
+
+void VersionSet::SetupIntraL0Inputs(Compaction* c, int sublevels) {
+  // Only a prefix of the sub-levels may be merged.  The outputs get newer
+  // file numbers than every file left in level-0, and are only newer than
+  // its data if no newer file overlapping an input is left out.  Any file
+  // overlapping an input from a sub-level further down is older than it.
+  assert(sublevels <= current_->NumL0SubLevels());
+  c->output_level_ = 0;
+  c->input_sublevels_ = sublevels;
+  c->inputs_[0].clear();
+  for (int i = 0; i < sublevels; i++) {
+    const std::vector<FileMetaData*>& files = current_->l0_sublevels_[i];
+    c->inputs_[0].insert(c->inputs_[0].end(), files.begin(), files.end());
+  }
+  c->sublevel_ptrs_.assign(current_->NumL0SubLevels(), 0);
+}
+
 // Finds the largest key in a vector of files. Returns true if files it not
 // empty.
 bool FindLargestKey(const InternalKeyComparator& icmp,
@@ -1491,6 +2067,33 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
 
 Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
                                      const InternalKey* end) {
+  if (level == 0 && options_->compaction_style == kTieredCompaction) {
+    // Merge all sub-levels down to the last one overlapping the range,
+    // unless that already leaves a single one.
+    const Comparator* ucmp = icmp_.user_comparator();
+    Slice user_begin, user_end;
+    if (begin != nullptr) user_begin = begin->user_key();
+    if (end != nullptr) user_end = end->user_key();
+    int sublevels = 0;
+    for (int i = 0; i < current_->NumL0SubLevels(); i++) {
+      for (FileMetaData* f : current_->l0_sublevels_[i]) {
+        if (!AfterFile(ucmp, begin != nullptr ? &user_begin : nullptr, f) &&
+            !BeforeFile(ucmp, end != nullptr ? &user_end : nullptr, f)) {
+          sublevels = i + 1;
+          break;
+        }
+      }
+    }
+    if (sublevels < 2) {
+      return nullptr;
+    }
+    Compaction* c = new Compaction(options_, 0);
+    c->input_version_ = current_;
+    c->input_version_->Ref();
+    SetupIntraL0Inputs(c, sublevels);
+    return c;
+  }
+
   std::vector<FileMetaData*> inputs;
   //将Level-level中的range与begin，end有重叠的SSTable描述符放入inputs中
   current_->GetOverlappingInputs(level, begin, end, &inputs);
@@ -1526,6 +2129,9 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
 
 Compaction::Compaction(const Options* options, int level)
     : level_(level),
+      output_level_(level + 1),
+      input_sublevels_(0),
+      blob_gc_(false),
       max_output_file_size_(MaxFileSizeForLevel(options, level)),
       input_version_(nullptr),
       grandparent_index_(0),
@@ -1550,7 +2156,8 @@ bool Compaction::IsTrivialMove() const {
   // Avoid a move if there is lots of overlapping grandparent data.
   // Otherwise, the move could create a parent file that will require
   // a very expensive merge later on.
-  return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
+  return (!IsIntraL0() && !blob_gc_ && num_input_files(0) == 1 &&
+          num_input_files(1) == 0 &&
           TotalFileSize(grandparents_) <=
               MaxGrandParentOverlapBytes(vset->options_));
 }
@@ -1563,10 +2170,28 @@ void Compaction::AddInputDeletions(VersionEdit* edit) {
   }
 }
 
+void Compaction::DropInput(int which, int i) {
+  edit_.DeleteFile(level_ + which, inputs_[which][i]->number);
+  inputs_[which].erase(inputs_[which].begin() + i);
+}
+
 bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
   // Maybe use binary search to find right entry instead of linear search?
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+  for (size_t s = input_sublevels_; s < sublevel_ptrs_.size(); s++) {
+    const std::vector<FileMetaData*>& files = input_version_->l0_sublevels_[s];
+    while (sublevel_ptrs_[s] < files.size()) {
+      FileMetaData* f = files[sublevel_ptrs_[s]];
+      if (user_cmp->Compare(user_key, f->largest.user_key()) <= 0) {
+        if (user_cmp->Compare(user_key, f->smallest.user_key()) >= 0) {
+          return false;
+        }
+        break;
+      }
+      sublevel_ptrs_[s]++;
+    }
+  }
+  for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
     while (level_ptrs_[lvl] < files.size()) {
       FileMetaData* f = files[level_ptrs_[lvl]];
@@ -1584,6 +2209,19 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
   return true;
 }
 
+bool Compaction::ShouldRelocateBlobs(uint64_t number) const {
+  const std::map<uint64_t, BlobFileMetaData>& blob_files =
+      input_version_->blob_files_;
+  auto it = blob_files.find(number);
+  if (it == blob_files.end()) {
+    return false;
+  }
+  const BlobFileMetaData& f = it->second;
+  return f.garbage_bytes >=
+         input_version_->vset_->options_->blob_gc_garbage_ratio *
+             f.total_bytes;
+}
+
 bool Compaction::ShouldStopBefore(const Slice& internal_key) {
   const VersionSet* vset = input_version_->vset_;
   // Scan to find earliest grandparent file that contains key.
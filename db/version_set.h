@@ -33,8 +33,11 @@ class Writer;
 class Compaction;
 class Iterator;
 class MemTable;
+class MergeContext;
+class PinnableSlice;
 class TableBuilder;
 class TableCache;
+class RangeTombstoneList;
 class Version;
 class VersionSet;
 class WritableFile;
@@ -45,6 +48,28 @@ class WritableFile;
 int FindFile(const InternalKeyComparator& icmp,
              const std::vector<FileMetaData*>& files, const Slice& key);
 
+// Same as FindFile(), but only searches files[left,right), knowing that
+// the result lies in [left,right].
+int FindFileInRange(const InternalKeyComparator& icmp,
+                    const std::vector<FileMetaData*>& files, const Slice& key,
+                    uint32_t left, uint32_t right);
+
+// Range [left,right] of a level that FindFile() lands in.
+struct FileIndexBound {
+  uint32_t left;
+  uint32_t right;
+};
+
+// Fractional cascading between two levels: sets (*bounds)[i] for every i
+// in [0,files.size()] so that FindFile(next_files, key) lies in
+// (*bounds)[i] for any key with FindFile(files, key) == i.
+// REQUIRES: "files" and "next_files" are sorted lists of non-overlapping
+//           files.
+void BuildFileIndexBounds(const InternalKeyComparator& icmp,
+                          const std::vector<FileMetaData*>& files,
+                          const std::vector<FileMetaData*>& next_files,
+                          std::vector<FileIndexBound>* bounds);
+
 // Returns true iff some file in "files" overlaps the user key range
 // [*smallest,*largest].
 // smallest==nullptr represents a key smaller than all keys in the DB.
@@ -68,12 +93,26 @@ class Version {
   };
 
   // Append to *iters a sequence of iterators that will
-  // yield the contents of this Version when merged together.
+  // yield the contents of this Version when merged together.  The bounds
+  // of the options, if any, are internal keys, and files entirely outside
+  // them are left out.
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
   void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
-  Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
-             GetStats* stats);
+  // Set *result to the range tombstones of the files of this Version, or
+  // to nullptr if they hold none.  The list is built on first use and then
+  // shared by every caller.  The caller must Unref() a non-null result.
+  // REQUIRES: lock is not held
+  Status GetRangeTombstones(RangeTombstoneList** result);
+
+  // Lookup the value for key.  If found, point *val at it and return OK,
+  // pinning the block that holds it where possible.  Else return a non-OK
+  // status and leave *val empty.  Fills *stats.  The merge operands of
+  // key newer than this version, if any, are in *merge_context; they are
+  // applied to what is found, and more operands found are added.
+  // REQUIRES: lock is not held
+  Status Get(const ReadOptions&, const LookupKey& key, PinnableSlice* val,
+             GetStats* stats, MergeContext* merge_context);
 
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
@@ -111,6 +150,11 @@ class Version {
 
   int NumFiles(int level) const { return files_[level].size(); }
 
+  // Return the number of level-0 sub-levels.  Every sub-level is a sorted
+  // run of non-overlapping files, so a point lookup probes at most one file
+  // per sub-level.
+  int NumL0SubLevels() const { return l0_sublevels_.size(); }
+
   // Return a human readable string that describes this version's contents.
   std::string DebugString() const;
 
@@ -125,17 +169,39 @@ class Version {
         next_(this),
         prev_(this),
         refs_(0),
+        range_dels_loaded_(false),
+        range_dels_(nullptr),
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {}
+        compaction_level_(-1),
+        tiered_compaction_sublevels_(0),
+        blob_gc_file_(nullptr),
+        blob_gc_level_(-1) {}
 
   Version(const Version&) = delete;
   Version& operator=(const Version&) = delete;
 
   ~Version();
 
-  Iterator* NewConcatenatingIterator(const ReadOptions&, int level) const;
+  // Append to *iters an iterator over the files of the sorted run "files"
+  // that overlap the bounds of "options", unless none do.  A single such
+  // file is opened right away unless "lazy" is set.
+  void AddSortedRunIterator(const ReadOptions& options,
+                            const std::vector<FileMetaData*>& files, bool lazy,
+                            std::vector<Iterator*>* iters) const;
+
+  // Return FindFile() on files_[level], narrowed down by the result
+  // "*prev_index" at "*prev_level", the last level searched (-1 if none).
+  // Sets both to this search for the next level.
+  uint32_t FindFileCascaded(int level, const Slice& internal_key,
+                            int* prev_level, uint32_t* prev_index) const;
+
+  // Return the file in level-0 sub-level "sublevel" whose range may contain
+  // user_key, or nullptr if there is none.
+  // REQUIRES: user portion of internal_key == user_key.
+  FileMetaData* FindL0File(size_t sublevel, const Slice& user_key,
+                           const Slice& internal_key) const;
 
   // Call func(arg, level, f) for every file that overlaps user_key in
   // order from newest to oldest.  If an invocation of func returns
@@ -145,6 +211,13 @@ class Version {
   void ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
                           bool (*func)(void*, int, FileMetaData*));
 
+  // Result of Get() for a key whose older entries are all deleted: the
+  // operands in *merge_context applied to no value, stored in *value, or
+  // NotFound if there are none.
+  Status MergeDeleted(const Slice& user_key,
+                      const MergeContext* merge_context,
+                      PinnableSlice* value) const;
+
   VersionSet* vset_;  // VersionSet to which this Version belongs
   Version* next_;     // Next version in linked list
   Version* prev_;     // Previous version in linked list
@@ -153,6 +226,24 @@ class Version {
   // List of files per level
   std::vector<FileMetaData*> files_[config::kNumLevels];
 
+  // files_[0] split into sub-levels of non-overlapping files, each sorted
+  // by smallest key.  A file lands in the sub-level after the deepest newer
+  // file it overlaps, so the files holding any given key appear in
+  // newest-to-oldest order when walking the sub-levels front to back.
+  // Initialized by Finalize().
+  std::vector<std::vector<FileMetaData*>> l0_sublevels_;
+
+  // For every level >= 1, the bounds of FindFile() in the next non-empty
+  // level for each possible FindFile() result in this one, so that a
+  // lookup descending the levels searches only a few files per level.
+  // Empty if there is no such level.  Initialized by Finalize().
+  std::vector<FileIndexBound> cascade_[config::kNumLevels];
+
+  // Cache of GetRangeTombstones(), filled in on first use.
+  port::Mutex range_dels_mu_;
+  bool range_dels_loaded_ GUARDED_BY(range_dels_mu_);
+  RangeTombstoneList* range_dels_ GUARDED_BY(range_dels_mu_);
+
   // Next file to compact based on seek stats. 用于seek compation.
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
@@ -163,6 +254,19 @@ class Version {
   // 用于size_compation
   double compaction_score_;
   int compaction_level_;
+
+  // Number of newest level-0 sub-levels that a tiered compaction should
+  // merge, or 0.  Initialized by Finalize() under kTieredCompaction.
+  int tiered_compaction_sublevels_;
+
+  // Blob files that tables of this version may refer to, by number.
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
+
+  // Next file to compact so that its values move out of the blob file
+  // with the most garbage, or null if no blob file has reached
+  // Options::blob_gc_garbage_ratio.  Initialized by Finalize().
+  FileMetaData* blob_gc_file_;
+  int blob_gc_level_;
 };
 
 class VersionSet {
@@ -203,12 +307,22 @@ class VersionSet {
     }
   }
 
+  // Allocate "n" consecutive file numbers and return the first of them.
+  uint64_t NewFileNumbers(uint64_t n) {
+    const uint64_t first = next_file_number_;
+    next_file_number_ += n;
+    return first;
+  }
+
   // Return the number of Table files at the specified level.
   int NumLevelFiles(int level) const;
 
   // Return the combined file size of all files at the specified level.
   int64_t NumLevelBytes(int level) const;
 
+  // Return the number of level-0 sub-levels in the current version.
+  int NumL0SubLevels() const { return current_->NumL0SubLevels(); }
+
   // Return the last sequence number.
   uint64_t LastSequence() const { return last_sequence_; }
 
@@ -252,7 +366,8 @@ class VersionSet {
   // Returns true iff some level needs a compaction.
   bool NeedsCompaction() const {
     Version* v = current_;
-    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr);
+    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr) ||
+           (v->blob_gc_file_ != nullptr);
   }
 
   // Add all files listed in any live version to *live.
@@ -289,6 +404,19 @@ class VersionSet {
 
   void SetupOtherInputs(Compaction* c);
 
+  // Turn level-0 compaction "c" into an intra-level-0 compaction of all
+  // level-0 files if that is cheaper than merging them into level-1.
+  // Returns true if it did.
+  bool PickIntraL0Compaction(Compaction* c);
+
+  // Return the tiered compaction that merges the newest level-0
+  // sub-levels picked by Finalize(), or nullptr if there is none.
+  Compaction* PickTieredCompaction();
+
+  // Make "c" merge the newest "sublevels" level-0 sub-levels into a
+  // single new sub-level.
+  void SetupIntraL0Inputs(Compaction* c, int sublevels);
+
   // Save current contents to *log
   Status WriteSnapshot(log::Writer* log);
 
@@ -326,6 +454,19 @@ class Compaction {
   // and "level+1" will be merged to produce a set of "level+1" files.
   int level() const { return level_; }
 
+  // Return the level the outputs are written to: "level+1", or "level"
+  // itself for an intra-level-0 compaction that merges the newest level-0
+  // sub-levels into a single one without involving level-1, and for a
+  // compaction rewriting a file of a deeper level to collect blob garbage.
+  int output_level() const { return output_level_; }
+
+  // Is this an intra-level-0 compaction?
+  bool IsIntraL0() const { return level_ == 0 && output_level_ == 0; }
+
+  // Return the number of level-0 sub-levels merged by an intra-level-0
+  // compaction.  Their files are the inputs at "level()".
+  int num_input_sublevels() const { return input_sublevels_; }
+
   // Return the object that holds the edits to the descriptor done
   // by this compaction.
   VersionEdit* edit() { return &edit_; }
@@ -346,11 +487,23 @@ class Compaction {
   // Add all inputs to this compaction as delete operations to *edit.
   void AddInputDeletions(VersionEdit* edit);
 
+  // Remove the "i"th input file of set "which" from the compaction, so
+  // that it is not read, and record its deletion in edit().  Used for
+  // files whose whole contents are obsolete.
+  void DropInput(int which, int i);
+
   // Returns true if the information we have available guarantees that
-  // the compaction is producing data in "level+1" for which no data exists
-  // in levels greater than "level+1".
+  // the compaction is producing data in "output_level()" for which no data
+  // exists in levels greater than "output_level()".
   bool IsBaseLevelForKey(const Slice& user_key);
 
+  // Returns true if blob file "number" has so much garbage that the values
+  // the compaction keeps from it should move to a new blob file.
+  bool ShouldRelocateBlobs(uint64_t number) const;
+
+  // Returns true if any input may refer to a blob file.
+  bool HasBlobFiles() const { return !input_version_->blob_files_.empty(); }
+
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
   bool ShouldStopBefore(const Slice& internal_key);
@@ -366,6 +519,9 @@ class Compaction {
   Compaction(const Options* options, int level);
 
   int level_;
+  int output_level_;
+  int input_sublevels_;  // For intra-level-0 compactions
+  bool blob_gc_;         // Picked to move values out of a blob file
   uint64_t max_output_file_size_;
   Version* input_version_;
   VersionEdit edit_;
@@ -386,8 +542,12 @@ class Compaction {
   // level_ptrs_ holds indices into input_version_->levels_: our state
   // is that we are positioned at one of the file ranges for each
   // higher level than the ones involved in this compaction (i.e. for
-  // all L >= level_ + 2).
+  // all L > output_level_).
   size_t level_ptrs_[config::kNumLevels];
+
+  // The same for the level-0 sub-levels below the ones an intra-level-0
+  // compaction merges.
+  std::vector<size_t> sublevel_ptrs_;
 };
 
 }  // namespace leveldb
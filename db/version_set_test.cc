@@ -4,6 +4,7 @@
 
 #include "db/version_set.h"
 #include "util/logging.h"
+#include "util/random.h"
 #include "util/testharness.h"
 #include "util/testutil.h"
 
@@ -327,6 +328,82 @@ TEST(AddBoundaryInputsTest, TestDisjoinFilePointers) {
   ASSERT_EQ(f3, compaction_files_[2]);
 }
 
+class FileIndexBoundsTest {
+ public:
+  FileIndexBoundsTest() : icmp_(BytewiseComparator()) {}
+
+  ~FileIndexBoundsTest() {
+    for (int level = 0; level < 2; level++) {
+      for (size_t i = 0; i < files_[level].size(); i++) {
+        delete files_[level][i];
+      }
+    }
+  }
+
+  // Fill "level" with random non-overlapping files over keys [0,1000).
+  void FillLevel(int level, Random* rnd) {
+    int key = rnd->Uniform(20);
+    while (true) {
+      const int smallest = key;
+      const int largest = smallest + rnd->Uniform(50);
+      if (largest >= 1000) break;
+      FileMetaData* f = new FileMetaData;
+      f->number = files_[level].size() + 1;
+      f->smallest = InternalKey(Key(smallest), 100, kTypeValue);
+      f->largest = InternalKey(Key(largest), 100, kTypeValue);
+      files_[level].push_back(f);
+      key = largest + 1 + rnd->Uniform(20);
+    }
+  }
+
+  static std::string Key(int i) {
+    char buf[100];
+    snprintf(buf, sizeof(buf), "%04d", i);
+    return buf;
+  }
+
+  InternalKeyComparator icmp_;
+  std::vector<FileMetaData*> files_[2];
+};
+
+TEST(FileIndexBoundsTest, EmptyLevels) {
+  std::vector<FileIndexBound> bounds;
+  BuildFileIndexBounds(icmp_, files_[0], files_[1], &bounds);
+  ASSERT_EQ(1, bounds.size());
+  ASSERT_EQ(0, bounds[0].left);
+  ASSERT_EQ(0, bounds[0].right);
+}
+
+TEST(FileIndexBoundsTest, RandomLevels) {
+  Random rnd(test::RandomSeed());
+  for (int iter = 0; iter < 20; iter++) {
+    for (int level = 0; level < 2; level++) {
+      for (size_t i = 0; i < files_[level].size(); i++) {
+        delete files_[level][i];
+      }
+      files_[level].clear();
+      FillLevel(level, &rnd);
+    }
+
+    std::vector<FileIndexBound> bounds;
+    BuildFileIndexBounds(icmp_, files_[0], files_[1], &bounds);
+    ASSERT_EQ(files_[0].size() + 1, bounds.size());
+    for (int k = 0; k < 1010; k++) {
+      for (SequenceNumber seq : {kMaxSequenceNumber, SequenceNumber(100),
+                                 SequenceNumber(1)}) {
+        InternalKey key(Key(k), seq, kValueTypeForSeek);
+        const int upper = FindFile(icmp_, files_[0], key.Encode());
+        const int lower = FindFile(icmp_, files_[1], key.Encode());
+        const FileIndexBound& b = bounds[upper];
+        ASSERT_LE(b.left, lower);
+        ASSERT_LE(lower, b.right);
+        ASSERT_EQ(lower, FindFileInRange(icmp_, files_[1], key.Encode(),
+                                         b.left, b.right));
+      }
+    }
+  }
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) { return leveldb::test::RunAllTests(); }
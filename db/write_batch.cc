@@ -9,7 +9,9 @@
 //    data: record[count]
 // record :=
 //    kTypeValue varstring varstring         |
-//    kTypeDeletion varstring
+//    kTypeDeletion varstring                |
+//    kTypeRangeDeletion varstring varstring |
+//    kTypeMerge varstring varstring
 // varstring :=
 //    len: varint32
 //    data: uint8[len]
@@ -34,6 +36,11 @@ WriteBatch::~WriteBatch() = default;
 
 WriteBatch::Handler::~Handler() = default;
 
+void WriteBatch::Handler::DeleteRange(const Slice& begin_key,
+                                      const Slice& end_key) {}
+
+void WriteBatch::Handler::Merge(const Slice& key, const Slice& value) {}
+
 void WriteBatch::Clear() {
   rep_.clear();
   rep_.resize(kHeader);
@@ -70,6 +77,22 @@ Status WriteBatch::Iterate(Handler* handler) const {
           return Status::Corruption("bad WriteBatch Delete");
         }
         break;
+      case kTypeRangeDeletion:
+        if (GetLengthPrefixedSlice(&input, &key) &&
+            GetLengthPrefixedSlice(&input, &value)) {
+          handler->DeleteRange(key, value);
+        } else {
+          return Status::Corruption("bad WriteBatch DeleteRange");
+        }
+        break;
+      case kTypeMerge:
+        if (GetLengthPrefixedSlice(&input, &key) &&
+            GetLengthPrefixedSlice(&input, &value)) {
+          handler->Merge(key, value);
+        } else {
+          return Status::Corruption("bad WriteBatch Merge");
+        }
+        break;
       default:
         return Status::Corruption("unknown WriteBatch tag");
     }
@@ -110,6 +133,20 @@ void WriteBatch::Delete(const Slice& key) {
   PutLengthPrefixedSlice(&rep_, key);
 }
 
+void WriteBatch::DeleteRange(const Slice& begin_key, const Slice& end_key) {
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  rep_.push_back(static_cast<char>(kTypeRangeDeletion));
+  PutLengthPrefixedSlice(&rep_, begin_key);
+  PutLengthPrefixedSlice(&rep_, end_key);
+}
+
+void WriteBatch::Merge(const Slice& key, const Slice& value) {
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  rep_.push_back(static_cast<char>(kTypeMerge));
+  PutLengthPrefixedSlice(&rep_, key);
+  PutLengthPrefixedSlice(&rep_, value);
+}
+
 void WriteBatch::Append(const WriteBatch& source) {
   WriteBatchInternal::Append(this, &source);
 }
@@ -128,6 +165,14 @@ class MemTableInserter : public WriteBatch::Handler {
     mem_->Add(sequence_, kTypeDeletion, key, Slice());
     sequence_++;
   }
+  void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+    mem_->Add(sequence_, kTypeRangeDeletion, begin_key, end_key);
+    sequence_++;
+  }
+  void Merge(const Slice& key, const Slice& value) override {
+    mem_->Add(sequence_, kTypeMerge, key, value);
+    sequence_++;
+  }
 };
 }  // namespace
 
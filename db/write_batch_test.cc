@@ -38,11 +38,42 @@ static std::string PrintContents(WriteBatch* b) {
         state.append(")");
         count++;
         break;
+      case kTypeMerge:
+        state.append("Merge(");
+        state.append(ikey.user_key.ToString());
+        state.append(", ");
+        state.append(iter->value().ToString());
+        state.append(")");
+        count++;
+        break;
+      case kTypeBlobIndex:
+        // Only written by flushes and compactions, never by batches.
+        state.append("BlobIndex(");
+        state.append(ikey.user_key.ToString());
+        state.append(")");
+        count++;
+        break;
+      case kTypeRangeDeletion:
+        break;
     }
     state.append("@");
     state.append(NumberToString(ikey.sequence));
   }
   delete iter;
+  iter = mem->NewRangeTombstoneIterator();
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey ikey;
+    ASSERT_TRUE(ParseInternalKey(iter->key(), &ikey));
+    ASSERT_EQ(kTypeRangeDeletion, ikey.type);
+    state.append("DeleteRange(");
+    state.append(ikey.user_key.ToString());
+    state.append(", ");
+    state.append(iter->value().ToString());
+    state.append(")@");
+    state.append(NumberToString(ikey.sequence));
+    count++;
+  }
+  delete iter;
   if (!s.ok()) {
     state.append("ParseError()");
   } else if (count != WriteBatchInternal::Count(b)) {
@@ -75,6 +106,35 @@ TEST(WriteBatchTest, Multiple) {
       PrintContents(&batch));
 }
 
+TEST(WriteBatchTest, DeleteRange) {
+  WriteBatch batch;
+  batch.Put(Slice("foo"), Slice("bar"));
+  batch.DeleteRange(Slice("a"), Slice("m"));
+  batch.Delete(Slice("box"));
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(100, WriteBatchInternal::Sequence(&batch));
+  ASSERT_EQ(3, WriteBatchInternal::Count(&batch));
+  ASSERT_EQ(
+      "Delete(box)@102"
+      "Put(foo, bar)@100"
+      "DeleteRange(a, m)@101",
+      PrintContents(&batch));
+}
+
+TEST(WriteBatchTest, Merge) {
+  WriteBatch batch;
+  batch.Put(Slice("foo"), Slice("bar"));
+  batch.Merge(Slice("foo"), Slice("baz"));
+  batch.Merge(Slice("box"), Slice("boo"));
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(3, WriteBatchInternal::Count(&batch));
+  ASSERT_EQ(
+      "Merge(box, boo)@102"
+      "Merge(foo, baz)@101"
+      "Put(foo, bar)@100",
+      PrintContents(&batch));
+}
+
 TEST(WriteBatchTest, Corruption) {
   WriteBatch batch;
   batch.Put(Slice("foo"), Slice("bar"));
@@ -61,6 +61,7 @@ typedef struct leveldb_filterpolicy_t leveldb_filterpolicy_t;
 typedef struct leveldb_iterator_t leveldb_iterator_t;
 typedef struct leveldb_logger_t leveldb_logger_t;
 typedef struct leveldb_options_t leveldb_options_t;
+typedef struct leveldb_pinnableslice_t leveldb_pinnableslice_t;
 typedef struct leveldb_randomfile_t leveldb_randomfile_t;
 typedef struct leveldb_readoptions_t leveldb_readoptions_t;
 typedef struct leveldb_seqfile_t leveldb_seqfile_t;
@@ -97,6 +98,19 @@ LEVELDB_EXPORT char* leveldb_get(leveldb_t* db,
                                  const char* key, size_t keylen, size_t* vallen,
                                  char** errptr);
 
+/* Returns NULL if not found.  Otherwise the value, which may be held where
+   the db keeps it, e.g. in the block cache, instead of copied.  The result
+   must be destroyed before the db is closed. */
+LEVELDB_EXPORT leveldb_pinnableslice_t* leveldb_get_pinned(
+    leveldb_t* db, const leveldb_readoptions_t* options, const char* key,
+    size_t keylen, char** errptr);
+
+LEVELDB_EXPORT const char* leveldb_pinnableslice_value(
+    const leveldb_pinnableslice_t* slice, size_t* vallen);
+
+LEVELDB_EXPORT void leveldb_pinnableslice_destroy(
+    leveldb_pinnableslice_t* slice);
+
 LEVELDB_EXPORT leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db, const leveldb_readoptions_t* options);
 
@@ -190,7 +204,12 @@ LEVELDB_EXPORT void leveldb_options_set_block_restart_interval(
 LEVELDB_EXPORT void leveldb_options_set_max_file_size(leveldb_options_t*,
                                                       size_t);
 
-enum { leveldb_no_compression = 0, leveldb_snappy_compression = 1 };
+enum {
+  leveldb_no_compression = 0,
+  leveldb_snappy_compression = 1,
+  leveldb_zstd_compression = 2,
+  leveldb_lz4_compression = 3
+};
 LEVELDB_EXPORT void leveldb_options_set_compression(leveldb_options_t*, int);
 
 /* Comparator */
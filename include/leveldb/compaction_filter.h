@@ -0,0 +1,69 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a custom CompactionFilter object.
+// Compactions pass it the live value of every key they rewrite, and it may
+// drop the key or replace its value.  This lets applications expire or
+// garbage collect data as part of the compactions that run anyway, instead
+// of scanning and deleting it themselves.
+//
+// Most people who want data to expire will use the builtin TTL filter (see
+// NewTTLCompactionFilter() below).
+
+#ifndef STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+#define STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Env;
+class Slice;
+
+class LEVELDB_EXPORT CompactionFilter {
+ public:
+  virtual ~CompactionFilter();
+
+  // Return the name of this filter.  Only used for logging.
+  virtual const char* Name() const = 0;
+
+  // Called for the newest value of "key" in a compaction that writes its
+  // output to "level", unless a snapshot might still read that value.
+  // Return true to delete the key.  Otherwise, to replace the value, store
+  // the new one in *new_value and set *value_changed to true.
+  //
+  // Deleted keys and older values of the key are never passed to the
+  // filter, so a key may stay readable until a compaction reaches it.
+  //
+  // Frequently updated keys that are kept in the in-memory hot tier (see
+  // Options::write_buffer_count_hot) are only filtered once they have
+  // been evicted from it and a compaction rewrites them.  Until then, reads
+  // return the hot-tier value even if the filter would delete or change
+  // it.
+  //
+  // Compactions run in a background thread and may call the filter
+  // concurrently, so implementations must be thread-safe.
+  virtual bool Filter(int level, const Slice& key, const Slice& existing_value,
+                      std::string* new_value, bool* value_changed) const = 0;
+};
+
+// Return a new compaction filter that deletes keys older than "ttl_seconds".
+// Every value must end with the time it was written, in seconds since the
+// epoch, as a 4-byte little-endian integer; values too short to hold one
+// are kept.  The filter reads the current time from "env".  Reads still
+// return the timestamp suffix, and may return expired values until a
+// compaction removes them.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const CompactionFilter* NewTTLCompactionFilter(
+    Env* env, uint32_t ttl_seconds);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
@@ -54,6 +54,26 @@ class LEVELDB_EXPORT Comparator {
   // Simple comparator implementations may return with *key unchanged,
   // i.e., an implementation of this method that does nothing is correct.
   virtual void FindShortSuccessor(std::string* key) const = 0;
+
+  // Optional: lets blocks search their restart points with integer
+  // compares instead of calls to Compare().  If this comparator can map
+  // "key" to an integer such that OrderedPrefix(a) < OrderedPrefix(b)
+  // implies Compare(a, b) < 0, stores it in *prefix and returns true.
+  // Equal prefixes imply nothing.  The mapping is persisted in tables, so
+  // it must never change for a given Name().
+  //
+  // The default implementation returns false.
+  virtual bool OrderedPrefix(const Slice& key, uint64_t* prefix) const;
+
+  // Optional: lets blocks answer exact-match seeks from a hash index.  If
+  // this comparator supports it, stores in *result the part of "key" that
+  // identifies the record "key" belongs to and returns true.  Keys that
+  // compare equal must yield identical bytes, and all keys that yield the
+  // same bytes must be adjacent in the ordering.  The mapping is persisted
+  // in tables, so it must never change for a given Name().
+  //
+  // The default implementation returns false.
+  virtual bool HashIndexKey(const Slice& key, Slice* result) const;
 };
 
 // Return a builtin comparator that uses lexicographic byte-wise
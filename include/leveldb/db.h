@@ -11,6 +11,7 @@
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/pinnable_slice.h"
 
 namespace leveldb {
 
@@ -72,6 +73,22 @@ class LEVELDB_EXPORT DB {
   // Note: consider setting options.sync = true.
   virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+  // Remove the database entries (if any) for the keys in
+  // [begin_key, end_key).  Returns OK on success, and a non-OK status on
+  // error.  The range is recorded as a single tombstone, so the cost does
+  // not depend on the number of keys removed.
+  // Note: consider setting options.sync = true.
+  virtual Status DeleteRange(const WriteOptions& options,
+                             const Slice& begin_key, const Slice& end_key);
+
+  // Apply the operand "value" to the database entry for "key" with
+  // Options::merge_operator, without reading the entry first.  Returns OK
+  // on success, and a non-OK status on error.  Reads of "key" see the
+  // operand applied to the entry it was merged into.
+  // Note: consider setting options.sync = true.
+  virtual Status Merge(const WriteOptions& options, const Slice& key,
+                       const Slice& value);
+
   // Apply the specified updates to the database.
   // Returns OK on success, non-OK on failure.
   // Note: consider setting options.sync = true.
@@ -87,6 +104,15 @@ class LEVELDB_EXPORT DB {
   virtual Status Get(const ReadOptions& options, const Slice& key,
                      std::string* value) = 0;
 
+  // Like Get() above, but *value may refer to the value where the database
+  // holds it, e.g. in the block cache, instead of to a copy.  Whatever it
+  // refers to stays valid until *value is reset or destroyed, which must
+  // happen before this db is deleted.
+  //
+  // If there is no entry for "key", *value is left empty.
+  virtual Status Get(const ReadOptions& options, const Slice& key,
+                     PinnableSlice* value);
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -115,6 +141,8 @@ class LEVELDB_EXPORT DB {
   //
   //  "leveldb.num-files-at-level<N>" - return the number of files at level <N>,
   //     where <N> is an ASCII representation of a level number (e.g. "0").
+  //  "leveldb.num-l0-sublevels" - return the number of level-0 sub-levels,
+  //     i.e. the most level-0 files a read may have to probe.
   //  "leveldb.stats" - returns a multi-line string that describes statistics
   //     about the internal operation of the DB.
   //  "leveldb.sstables" - returns a multi-line string that describes all
@@ -114,6 +114,37 @@ class LEVELDB_EXPORT Env {
   virtual Status NewAppendableFile(const std::string& fname,
                                    WritableFile** result);
 
+  // Like NewRandomAccessFile(), but reads bypass the operating system's
+  // page cache (e.g. with O_DIRECT) where the platform and file system
+  // allow it, so that data the caller caches itself is not cached twice.
+  //
+  // The default implementation calls NewRandomAccessFile().
+  virtual Status NewDirectRandomAccessFile(const std::string& fname,
+                                           RandomAccessFile** result);
+
+  // Like NewWritableFile(), but writes bypass the operating system's page
+  // cache where the platform and file system allow it.  Flush() may keep
+  // data buffered until Sync() or Close().
+  //
+  // The default implementation calls NewWritableFile().
+  virtual Status NewDirectWritableFile(const std::string& fname,
+                                       WritableFile** result);
+
+  // Renames the file "old_fname" to "fname" and creates an object that
+  // writes to it from its beginning, overwriting the old contents in place
+  // instead of truncating them, so that writes within the old size do not
+  // need to allocate space.  On success, stores a pointer to the new file in
+  // *result and returns OK.  On failure stores nullptr in *result and
+  // returns non-OK.
+  //
+  // The returned file will only be accessed by one thread at a time.
+  //
+  // The default implementation renames the file and then truncates it with
+  // NewWritableFile().
+  virtual Status ReuseWritableFile(const std::string& fname,
+                                   const std::string& old_fname,
+                                   WritableFile** result);
+
   // Returns true iff the named file exists.
   virtual bool FileExists(const std::string& fname) = 0;
 
@@ -168,6 +199,16 @@ class LEVELDB_EXPORT Env {
   // serialized.
   virtual void Schedule(void (*function)(void* arg), void* arg) = 0;
 
+  // Arrange to run "(*function)(arg)" once in a pool of threads that is
+  // shared by all callers and kept apart from the background thread used
+  // by Schedule(), so that work items may block on each other's progress
+  // without stalling background compactions.  The pool is grown to at
+  // least "num_threads" threads, which all run work items concurrently.
+  //
+  // The default implementation uses a process-wide pool.
+  virtual void ScheduleParallel(void (*function)(void* arg), void* arg,
+                                int num_threads);
+
   // Start a new thread, invoking "function(arg)" within the new thread.
   // When "function(arg)" returns, the thread will be destroyed.
   virtual void StartThread(void (*function)(void* arg), void* arg) = 0;
@@ -240,6 +281,20 @@ class LEVELDB_EXPORT RandomAccessFile {
   // Safe for concurrent use by multiple threads.
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       char* scratch) const = 0;
+
+  // Hint that the bytes in [offset, offset+n) are going to be read soon.
+  // Implementations may start fetching them in the background (e.g. with
+  // posix_fadvise(POSIX_FADV_WILLNEED)) so that the later Read() does not
+  // block on the device.  The default implementation does nothing.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual void Prefetch(uint64_t offset, size_t n) const;
+
+  // Returns true if Read() never uses "scratch", and instead points
+  // "*result" at memory that stays valid and unchanged for the lifetime of
+  // this object (e.g. a memory-mapped file).  Such files may be read with
+  // a null "scratch".  The default implementation returns false.
+  virtual bool ReadsInPlace() const;
 };
 
 // A file abstraction for sequential writing.  The implementation
@@ -258,6 +313,22 @@ class LEVELDB_EXPORT WritableFile {
   virtual Status Close() = 0;
   virtual Status Flush() = 0;
   virtual Status Sync() = 0;
+
+  // Returns true if SyncFlushed() is supported.  The default
+  // implementation returns false.
+  virtual bool SupportsConcurrentSync() const;
+
+  // Makes the data already handed to the operating system by Flush()
+  // durable, without flushing the buffered data.  Unlike the other methods,
+  // may be called by one thread while another thread calls Append() or
+  // Flush().  The default implementation returns NotSupported.
+  virtual Status SyncFlushed();
+
+  // Hint that about "size" bytes in total will be written to the file, so
+  // that the implementation can allocate the space up front (e.g. with
+  // fallocate()) instead of on every Sync().  Does not change the size of
+  // the file.  The default implementation does nothing.
+  virtual void Preallocate(uint64_t size);
 };
 
 // An interface for writing log messages.
@@ -326,6 +397,18 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
   Status NewAppendableFile(const std::string& f, WritableFile** r) override {
     return target_->NewAppendableFile(f, r);
   }
+  Status NewDirectRandomAccessFile(const std::string& f,
+                                   RandomAccessFile** r) override {
+    return target_->NewDirectRandomAccessFile(f, r);
+  }
+  Status NewDirectWritableFile(const std::string& f,
+                               WritableFile** r) override {
+    return target_->NewDirectWritableFile(f, r);
+  }
+  Status ReuseWritableFile(const std::string& f, const std::string& old_f,
+                           WritableFile** r) override {
+    return target_->ReuseWritableFile(f, old_f, r);
+  }
   bool FileExists(const std::string& f) override {
     return target_->FileExists(f);
   }
@@ -355,6 +438,9 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
   void Schedule(void (*f)(void*), void* a) override {
     return target_->Schedule(f, a);
   }
+  void ScheduleParallel(void (*f)(void*), void* a, int n) override {
+    return target_->ScheduleParallel(f, a, n);
+  }
   void StartThread(void (*f)(void*), void* a) override {
     return target_->StartThread(f, a);
   }
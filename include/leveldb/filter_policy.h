@@ -67,6 +67,30 @@ class LEVELDB_EXPORT FilterPolicy {
 // trailing spaces in keys.
 LEVELDB_EXPORT const FilterPolicy* NewBloomFilterPolicy(int bits_per_key);
 
+// Return a new filter policy that uses a cache-line-blocked bloom filter
+// with approximately the specified number of bits per key.  All probes
+// for a key fall in one 64-byte line, so a lookup costs at most one cache
+// miss, at the price of a slightly higher false positive rate than
+// NewBloomFilterPolicy() for the same bits_per_key (~1% at 10).
+// The same restrictions on custom comparators apply.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const FilterPolicy* NewBlockedBloomFilterPolicy(
+    int bits_per_key);
+
+// Return a new filter policy that uses a Ribbon filter with about the
+// false positive rate of a bloom filter with the specified number of bits
+// per key, while using ~25% less space: at 10, filters take ~7.5 bits
+// per key for a ~0.8% false positive rate.  Building a Ribbon filter
+// costs more CPU than building a bloom filter.  The same restrictions on
+// custom comparators apply.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const FilterPolicy* NewRibbonFilterPolicy(
+    int bloom_equivalent_bits_per_key);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
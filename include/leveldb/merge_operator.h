@@ -0,0 +1,71 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a MergeOperator (see
+// Options::merge_operator), which lets DB::Merge() record an update of a
+// value, e.g. "add 1" to a counter, without reading the value first.  The
+// operands are stored like other entries and combined with the value they
+// apply to when the key is read, and by compactions.
+//
+// Most people will want to use one of the builtin operators (see
+// NewUInt64AddOperator() and NewStringAppendOperator() below).
+
+#ifndef STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+#define STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT MergeOperator {
+ public:
+  virtual ~MergeOperator();
+
+  // Return the name of this operator.  Only used for logging.
+  virtual const char* Name() const = 0;
+
+  // Apply "operands", ordered from oldest to newest, to "existing_value",
+  // which is null if "key" has no value, and store the result in
+  // *new_value.  Return false if the operands cannot be applied, which
+  // reads and compactions of the key report as corruption.
+  //
+  // Reads and background compactions may call this concurrently, so
+  // implementations must be thread-safe.
+  virtual bool FullMerge(const Slice& key, const Slice* existing_value,
+                         const std::vector<Slice>& operands,
+                         std::string* new_value) const = 0;
+
+  // Combine the operands "left" and the newer "right" into the single
+  // operand *new_value that has the same effect as applying both, and
+  // return true.  Compactions use this to fold operands whose value lies
+  // in another level.  The default implementation returns false, which
+  // keeps such operands as they are.
+  virtual bool PartialMerge(const Slice& key, const Slice& left,
+                            const Slice& right, std::string* new_value) const;
+};
+
+// Return a new operator for counters.  Values and operands are 64-bit
+// unsigned integers encoded as 8 bytes in little-endian order, and every
+// operand is added to the value, wrapping around on overflow.  A missing
+// value counts as 0.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const MergeOperator* NewUInt64AddOperator();
+
+// Return a new operator for lists.  Every operand is appended to the
+// value, separated by "delimiter".  A missing value counts as an empty
+// list, so the first operand is not preceded by a delimiter.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const MergeOperator* NewStringAppendOperator(char delimiter);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
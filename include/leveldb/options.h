@@ -7,15 +7,21 @@
 
 #include <stddef.h>
 
+#include <vector>
+
 #include "leveldb/export.h"
 
 namespace leveldb {
 
 class Cache;
+class CompactionFilter;
 class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class MergeOperator;
+class Slice;
+class SliceTransform;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -26,7 +32,24 @@ enum CompressionType {
   // NOTE: do not change the values of existing entries, as these are
   // part of the persistent format on disk.
   kNoCompression = 0x0,
-  kSnappyCompression = 0x1
+  kSnappyCompression = 0x1,
+  kZstdCompression = 0x2,
+  kLZ4Compression = 0x3
+};
+
+// How compactions organize the tables of a database.
+enum CompactionStyle {
+  // Every level holds ten times the data of the one above it, and data is
+  // merged into the next level as a level fills up.  Reads touch few
+  // tables, but each entry is rewritten once per level.
+  kLeveledCompaction = 0x0,
+
+  // Tables stay in level-0 as a stack of sorted runs (the level-0
+  // sub-levels), and compactions merge the newest runs once they are about
+  // the size of the run below them.  Entries are rewritten far less often,
+  // at the cost of more runs for reads to search and more space held by
+  // overwritten entries, bounded by max_size_amplification_percent.
+  kTieredCompaction = 0x1
 };
 
 // Options to control the behavior of a database (passed to DB::Open)
@@ -105,6 +128,25 @@ struct LEVELDB_EXPORT Options {
   // leave this parameter alone.
   int block_restart_interval = 16;
 
+  // If true, blocks also store an integer prefix of the key at every
+  // restart point (8 bytes per restart point), so that Seek() can narrow
+  // its binary search with integer compares before calling the
+  // comparator.  Only takes effect if the comparator implements
+  // Comparator::OrderedPrefix(), as BytewiseComparator() does.  Blocks
+  // written with this option cannot be read by versions of leveldb that
+  // predate it; reading blocks written without it is unaffected.
+  bool block_restart_prefixes = false;
+
+  // If true, data blocks also store a small hash table that maps each key
+  // to its restart point (about 1.3 bytes per key), so that a Seek() for a
+  // key present in the block skips the binary search over restart points.
+  // Only takes effect if the comparator implements
+  // Comparator::HashIndexKey(), as BytewiseComparator() does, and the
+  // block has at most 253 restart points.  Blocks written with this
+  // option cannot be read by versions of leveldb that predate it; reading
+  // blocks written without it is unaffected.
+  bool block_hash_index = false;
+
   // Leveldb will write up to this amount of bytes to a file before
   // switching to a new one.
   // Most clients should leave this parameter alone.  However if your
@@ -115,6 +157,39 @@ struct LEVELDB_EXPORT Options {
   // initially populating a large database.
   size_t max_file_size = 2 * 1024 * 1024;
 
+  // How compactions organize the database; see CompactionStyle.  A
+  // database may be reopened with a different style.  Data that leveled
+  // compactions left below level-0 then stays there under tiered
+  // compaction, and tiered runs are merged down again by leveled
+  // compactions.
+  CompactionStyle compaction_style = kLeveledCompaction;
+
+  // Under kTieredCompaction, a run joins a merge of the newer runs above it
+  // if it is at most this many percent larger than their total size.
+  int tiered_size_ratio = 1;
+
+  // Under kTieredCompaction, all runs are merged into one once the runs
+  // above the oldest one hold more than this many percent of its size, so
+  // the database takes up to about 1 + this / 100 times the space of its
+  // live data.
+  int max_size_amplification_percent = 200;
+
+  // If non-zero, memtable flushes write values of at least this many bytes
+  // to separate blob files, and the tables only hold a small reference to
+  // each of them.  Compactions then rewrite keys and references instead of
+  // whole values, which cuts their I/O for values of a kilobyte or more;
+  // reading such a value costs one more read.  Databases holding blob files
+  // cannot be opened by older versions of leveldb.
+  size_t min_blob_size = 0;
+
+  // Once this fraction of the bytes of a blob file belongs to values that
+  // were overwritten or deleted, compactions copy the values they keep from
+  // it to a new blob file, so that the file can be deleted.  Tables still
+  // referring to such a file get compacted even if the database is idle.
+  // Blob files none of whose values are referenced any more are deleted
+  // right away.
+  double blob_gc_garbage_ratio = 0.5;
+
   // Compress blocks using the specified compression algorithm.  This
   // parameter can be changed dynamically.
   //
@@ -131,6 +206,75 @@ struct LEVELDB_EXPORT Options {
   // efficiently detect that and will switch to uncompressed mode.
   CompressionType compression = kSnappyCompression;
 
+  // If non-empty, overrides "compression" for tables written to each
+  // level: tables written to level L use compression_per_level[L], or the
+  // last entry if L is past the end.  For example {kLZ4Compression,
+  // kLZ4Compression, kZstdCompression} keeps the frequently rewritten
+  // levels 0 and 1 cheap to compress and stores the rest compactly.
+  // Tables flushed from the memtable use the entry for level 0.
+  //
+  // Blocks for which the chosen algorithm is not compiled in are stored
+  // uncompressed.
+  std::vector<CompressionType> compression_per_level;
+
+  // Compression level used for kZstdCompression.  Higher levels compress
+  // better but more slowly; negative levels trade ratio for speed.
+  int zstd_compression_level = 1;
+
+  // If non-zero, tables written by compactions into the bottommost
+  // non-empty level with kZstdCompression train a dictionary from up to
+  // this many bytes of their first data blocks, and compress all of their
+  // data blocks with it.  The dictionary is stored in the table, so small
+  // blocks of similar records compress much better without making blocks
+  // bigger.  A typical value is 100 * zstd_max_dict_bytes.
+  size_t zstd_max_train_bytes = 0;
+
+  // Upper bound on the size of a trained Zstandard dictionary.
+  size_t zstd_max_dict_bytes = 16 * 1024;
+
+  // Number of threads that compress and checksum the data blocks of each
+  // table being built, so that flushes and compactions using an expensive
+  // compression algorithm are not limited to a single core.  Blocks are
+  // still written in order by the thread building the table, which counts
+  // as one of them; the others come from a pool shared by all tables
+  // being built (see Env::ScheduleParallel()).
+  int parallel_compression_threads = 1;
+
+  // If positive, DB::Open() starts up to this many threads that write the
+  // memtables filled while replaying the log files to level-0 tables, so
+  // that replay does not stop while a full memtable is written.  At most
+  // this many memtables wait for or are being written at a time, each
+  // holding up to write_buffer_size bytes of memory.  If zero, they are
+  // written one at a time by the thread replaying the logs.
+  int max_recovery_flushes = 0;
+
+  // If true, table files are read bypassing the operating system's page
+  // cache (see Env::NewDirectRandomAccessFile), so memory is spent on
+  // block_cache instead of a second copy of the same data.  Best combined
+  // with a large block_cache and ReadOptions::readahead_size for scans.
+  bool use_direct_reads = false;
+
+  // If true, tables written by memtable flushes and compactions bypass the
+  // operating system's page cache (see Env::NewDirectWritableFile), so that
+  // they do not push frequently read data out of it.
+  bool use_direct_io_for_flush_and_compaction = false;
+
+  // If true, the log syncs needed by writes with WriteOptions::sync are
+  // issued by a dedicated thread, which syncs everything logged so far in
+  // one go.  A write group waits for that sync after leaving the writer
+  // queue, so the following groups are logged meanwhile and many commits
+  // share one sync.  As with unsynced writes, a concurrent reader may then
+  // see a synced write before Write() returns.  Needs a log file that
+  // supports WritableFile::SyncFlushed(); others are synced as usual.
+  bool async_log_sync = false;
+
+  // If non-zero, up to this many obsolete write-ahead log files are kept
+  // and overwritten in place by later logs instead of being deleted, so
+  // that syncing the log does not have to allocate space and update file
+  // metadata.  Logs written with this option use a record format that
+  // older versions of leveldb cannot read.
+  size_t recycle_log_file_num = 0;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
@@ -141,6 +285,35 @@ struct LEVELDB_EXPORT Options {
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
   const FilterPolicy* filter_policy = nullptr;
+
+  // If non-null, the filters of filter_policy also hold the prefix of
+  // every key, as extracted by this transformation, so that iterators
+  // with ReadOptions::prefix_same_as_start skip the tables and blocks
+  // that hold no key with the prefix they were positioned at.  Requires
+  // a comparator that implements Comparator::HashIndexKey(), as
+  // BytewiseComparator() does.  See leveldb/slice_transform.h.
+  const SliceTransform* prefix_extractor = nullptr;
+
+  // If non-null, compactions pass the live values they rewrite to this
+  // filter, which may delete them or change them.  See
+  // leveldb/compaction_filter.h, and NewTTLCompactionFilter() to expire
+  // old values.
+  const CompactionFilter* compaction_filter = nullptr;
+
+  // If non-null, DB::Merge() records operands that this operator applies
+  // to the value of their key when it is read.  Databases that hold
+  // operands must always be opened with an operator that handles them.
+  // See leveldb/merge_operator.h.
+  const MergeOperator* merge_operator = nullptr;
+
+  // Compaction reads each input table from start to end.  If non-zero,
+  // input tables are read in chunks of this many bytes instead of one
+  // block at a time, and the following chunk is prefetched while the
+  // current one is being merged.  Each open compaction input holds one
+  // buffer of this size.
+  //
+  // Default: 2MB
+  size_t compaction_readahead_size = 2 * 1024 * 1024;
 };
 
 // Options that control read operations
@@ -160,6 +333,32 @@ struct LEVELDB_EXPORT ReadOptions {
   // not have been released).  If "snapshot" is null, use an implicit
   // snapshot of the state at the beginning of this read operation.
   const Snapshot* snapshot = nullptr;
+
+  // If non-zero, iterators created with these options read each table in
+  // chunks of this many bytes and prefetch the following chunk, instead
+  // of issuing one read per block.  Useful for long range scans; wasted
+  // work for short ones.  Has no effect on Get().
+  size_t readahead_size = 0;
+
+  // If true, and Options::prefix_extractor is set, an iterator positioned
+  // by Seek() to a key with a prefix only yields keys with that same
+  // prefix, and becomes invalid after the last of them.  Tables and
+  // blocks whose filters lack the prefix are skipped without being read.
+  // Such iterators only move forward: Prev() and SeekToLast() make them
+  // invalid with a NotSupported status.
+  bool prefix_same_as_start = false;
+
+  // If non-null, iterators yield no key before "*iterate_lower_bound", and
+  // SeekToFirst() and earlier seeks position them at the first key at or
+  // after it.  Tables entirely before it are never opened.  The slice must
+  // stay live while the iterator is in use.
+  const Slice* iterate_lower_bound = nullptr;
+
+  // If non-null, iterators yield no key at or after "*iterate_upper_bound",
+  // and become invalid instead, without reading the blocks past it.
+  // Tables entirely after it are never opened.  The slice must stay live
+  // while the iterator is in use.
+  const Slice* iterate_upper_bound = nullptr;
 };
 
 // Options that control write operations
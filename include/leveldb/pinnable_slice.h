@@ -0,0 +1,76 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PinnableSlice is a Slice that can keep the memory it refers to alive.
+// DB::Get() uses it to return a value where it sits in the block cache,
+// holding on to the block until the slice is reset or destroyed, instead
+// of copying the value out.  Values that cannot be pinned are copied into
+// a buffer of the slice.
+//
+// Multiple threads can invoke const methods on a PinnableSlice without
+// external synchronization, but if any of the threads may call a non-const
+// method, all threads accessing the same PinnableSlice must use external
+// synchronization.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
+#define STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
+
+#include <string>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT PinnableSlice : public Slice {
+ public:
+  using CleanupFunction = void (*)(void* arg1, void* arg2);
+
+  // Create an empty slice that keeps copies in a buffer of its own.
+  PinnableSlice();
+
+  // Create an empty slice that keeps copies in "*buf".  "*buf" must
+  // outlive the slice.
+  explicit PinnableSlice(std::string* buf);
+
+  PinnableSlice(const PinnableSlice&) = delete;
+  PinnableSlice& operator=(const PinnableSlice&) = delete;
+
+  ~PinnableSlice();
+
+  // Refer to "s", whose memory stays valid until (*function)(arg1, arg2)
+  // is called.  That happens when the slice is reset or destroyed.
+  void PinSlice(const Slice& s, CleanupFunction function, void* arg1,
+                void* arg2);
+
+  // Refer to a copy of "s".
+  void PinSelf(const Slice& s);
+
+  // Refer to the contents of *GetSelf(), which the caller has filled in.
+  void PinSelf();
+
+  // Return the buffer that holds copies.
+  std::string* GetSelf() { return buf_; }
+
+  // Release the memory the slice refers to, if pinned, and make it empty.
+  // Leaves the buffer unchanged.
+  void Reset();
+
+  // Return true if the slice refers to memory it keeps alive rather than
+  // to a copy.
+  bool IsPinned() const { return function_ != nullptr; }
+
+ private:
+  void ReleasePin();
+
+  std::string self_space_;
+  std::string* const buf_;
+  CleanupFunction function_;
+  void* arg1_;
+  void* arg2_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
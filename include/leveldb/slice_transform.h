@@ -0,0 +1,57 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a SliceTransform that extracts a
+// prefix from every key (see Options::prefix_extractor).  Filters then
+// also hold the prefixes of the keys, so that iterators that only scan
+// the keys sharing a prefix (see ReadOptions::prefix_same_as_start) can
+// skip tables and blocks that hold none of them.
+//
+// Most people will want to use the builtin fixed-length prefix (see
+// NewFixedPrefixTransform() below).
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+#define STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+
+#include <stddef.h>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT SliceTransform {
+ public:
+  virtual ~SliceTransform();
+
+  // Return the name of this transformation.  The name is persisted in
+  // tables, and filters are only used for prefixes of tables written with
+  // the same name, so it must change whenever Transform() does.
+  virtual const char* Name() const = 0;
+
+  // Return the prefix of "key".  The result must refer to the start of
+  // "key".  All keys with the same prefix must be adjacent in the ordering
+  // of the comparator.
+  //
+  // REQUIRES: InDomain(key)
+  virtual Slice Transform(const Slice& key) const = 0;
+
+  // Return true if "key" has a prefix.  Keys outside the domain are kept
+  // out of filters, and seeks to them scan without bounds.
+  virtual bool InDomain(const Slice& key) const = 0;
+};
+
+// Return a new transformation whose prefix is the first "prefix_length"
+// bytes of a key.  Keys shorter than that have no prefix.  Requires a
+// comparator that keeps keys with a common leading byte string adjacent,
+// as BytewiseComparator() does.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const SliceTransform* NewFixedPrefixTransform(
+    size_t prefix_length);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
@@ -16,6 +16,7 @@ class Block;
 class BlockHandle;
 class Footer;
 struct Options;
+class PinnableSlice;
 class RandomAccessFile;
 struct ReadOptions;
 class TableCache;
@@ -63,18 +64,55 @@ class LEVELDB_EXPORT Table {
   struct Rep;
 
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  static Iterator* ReadaheadBlockReader(void*, const ReadOptions&,
+                                        const Slice&);
+  static Iterator* ReadBlockIterator(Table* table, RandomAccessFile* file,
+                                     const ReadOptions&,
+                                     const Slice& index_value);
+  // Reads the block at "index_value" into *block, which stays valid until
+  // (*cleanup)(*cleanup_arg1, *cleanup_arg2) is called.
+  static Status ReadDataBlock(Table* table, RandomAccessFile* file,
+                              const ReadOptions&, const Slice& index_value,
+                              Block** block,
+                              Iterator::CleanupFunction* cleanup,
+                              void** cleanup_arg1, void** cleanup_arg2);
+  static bool PrefixChecker(void*, const Slice&, const Slice&);
+  static bool ReadaheadPrefixChecker(void*, const Slice&, const Slice&);
 
   explicit Table(Rep* rep) : rep_(rep) {}
 
+  // Returns false if the table holds no key at or after "target" with the
+  // prefix of "target", according to its filters.
+  bool PrefixMayMatch(const Slice& target) const;
+
+  // Like PrefixMayMatch(), but only for the block at "index_value".
+  bool BlockPrefixMayMatch(const Slice& index_value,
+                           const Slice& target) const;
+
+  // Returns a new iterator over the range tombstones of the table, or
+  // nullptr if it has none.
+  Iterator* NewRangeTombstoneIterator() const;
+
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
-  // that key is not present.
+  // that key is not present.  If "value" is non-null and such a call is
+  // made, also points *value at the value of the entry, pinning the block
+  // that holds it.  Blocks that refer to the memory of the file stay valid
+  // only as long as the table, so *value holds on to the table instead,
+  // by handing it (*unref_table)(unref_arg1, unref_arg2) and setting
+  // *table_pinned to true.  Without "unref_table" those values are copied.
   Status InternalGet(const ReadOptions&, const Slice& key, void* arg,
                      void (*handle_result)(void* arg, const Slice& k,
-                                           const Slice& v));
+                                           const Slice& v),
+                     PinnableSlice* value = nullptr,
+                     Iterator::CleanupFunction unref_table = nullptr,
+                     void* unref_arg1 = nullptr, void* unref_arg2 = nullptr,
+                     bool* table_pinned = nullptr);
 
   void ReadMeta(const Footer& footer);
   void ReadFilter(const Slice& filter_handle_value);
+  void ReadZstdDictionary(const Slice& dict_handle_value);
+  void ReadRangeTombstones(const Slice& block_handle_value);
 
   Rep* const rep_;
 };
@@ -51,6 +51,14 @@ class LEVELDB_EXPORT TableBuilder {
   // REQUIRES: Finish(), Abandon() have not been called
   void Add(const Slice& key, const Slice& value);
 
+  // Add a range tombstone to the table being constructed.  Tombstones are
+  // kept in a meta block of their own, apart from the entries passed to
+  // Add(), and are not counted by NumEntries().
+  // REQUIRES: key is after any previously added tombstone key according
+  // to comparator.
+  // REQUIRES: Finish(), Abandon() have not been called
+  void AddRangeTombstone(const Slice& key, const Slice& value);
+
   // Advanced operation: flush any buffered key/value pairs to file.
   // Can be used to ensure that two adjacent entries never live in
   // the same data block.  Most clients should not need to use this method.
@@ -75,14 +83,20 @@ class LEVELDB_EXPORT TableBuilder {
   // Number of calls to Add() so far.
   uint64_t NumEntries() const;
 
-  // Size of the file generated so far.  If invoked after a successful
-  // Finish() call, returns the size of the final generated file.
+  // Size of the file generated so far, counting data blocks held back for
+  // dictionary training at their uncompressed size.  If invoked after a
+  // successful Finish() call, returns the size of the final generated file.
   uint64_t FileSize() const;
 
  private:
   bool ok() const { return status().ok(); }
   void WriteBlock(BlockBuilder* block, BlockHandle* handle);
+  void CompressAndWriteBlock(const Slice& raw, BlockHandle* handle);
+  void WriteBufferedBlocks();
+  void QueueBlock();
+  void WriteCompressedBlocks(size_t max_in_flight);
   void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
+  void AppendBlock(const Slice& data, const char* trailer, BlockHandle* handle);
 
   struct Rep;
   Rep* rep_;
@@ -37,6 +37,10 @@ class LEVELDB_EXPORT WriteBatch {
     virtual ~Handler();
     virtual void Put(const Slice& key, const Slice& value) = 0;
     virtual void Delete(const Slice& key) = 0;
+    // The default implementation ignores range deletions.
+    virtual void DeleteRange(const Slice& begin_key, const Slice& end_key);
+    // The default implementation ignores merges.
+    virtual void Merge(const Slice& key, const Slice& value);
   };
 
   WriteBatch();
@@ -53,6 +57,13 @@ class LEVELDB_EXPORT WriteBatch {
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
+  // Erase every mapping whose key lies in [begin_key, end_key).
+  void DeleteRange(const Slice& begin_key, const Slice& end_key);
+
+  // Apply the operand "value" to the mapping for "key" with the merge
+  // operator of the database.  See leveldb/merge_operator.h.
+  void Merge(const Slice& key, const Slice& value);
+
   // Clear all updates buffered in this batch.
   void Clear();
 
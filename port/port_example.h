@@ -85,6 +85,52 @@ bool Snappy_GetUncompressedLength(const char* input, size_t length,
 bool Snappy_Uncompress(const char* input_data, size_t input_length,
                        char* output);
 
+// Same as the Snappy functions above, for Zstandard at compression
+// level "level".  Returns false if zstd is not supported by this port.
+bool Zstd_Compress(int level, const char* input, size_t input_length,
+                   std::string* output);
+bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                size_t* result);
+bool Zstd_Uncompress(const char* input_data, size_t input_length,
+                     char* output);
+
+// Trains a Zstandard dictionary of at most "max_dict_size" bytes from the
+// concatenated "samples", whose lengths are given by "sample_sizes".
+// Returns false if zstd is not supported by this port or training failed.
+bool Zstd_TrainDictionary(const std::string& samples,
+                          const std::vector<size_t>& sample_sizes,
+                          size_t max_dict_size, std::string* dict);
+
+// A Zstandard dictionary digested once for compressing many blocks.  ok()
+// is false if zstd is not supported by this port.  Safe for concurrent use.
+class ZstdCompressionDict {
+ public:
+  ZstdCompressionDict(const char* dict, size_t size, int level);
+  bool ok() const;
+  bool Compress(const char* input, size_t input_length,
+                std::string* output) const;
+};
+
+// A Zstandard dictionary digested once for decompressing many blocks.
+// Uncompress() also accepts blocks compressed without a dictionary.  Safe
+// for concurrent use.
+class ZstdDecompressionDict {
+ public:
+  ZstdDecompressionDict(const char* dict, size_t size);
+  bool ok() const;
+  bool Uncompress(const char* input_data, size_t input_length,
+                  char* output) const;
+};
+
+// Same as the Snappy functions above, for LZ4.  Returns false if lz4 is
+// not supported by this port.
+bool Lz4_Compress(const char* input, size_t input_length,
+                  std::string* output);
+bool Lz4_GetUncompressedLength(const char* input, size_t length,
+                               size_t* result);
+bool Lz4_Uncompress(const char* input_data, size_t input_length,
+                    char* output);
+
 // ------------------ Miscellaneous -------------------
 
 // If heap profiling is not supported, returns false.
@@ -28,6 +28,13 @@
 #if HAVE_SNAPPY
 #include <snappy.h>
 #endif  // HAVE_SNAPPY
+#if HAVE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif  // HAVE_ZSTD
+#if HAVE_LZ4
+#include <lz4.h>
+#endif  // HAVE_LZ4
 
 #include <cassert>
 #include <condition_variable>  // NOLINT
@@ -35,6 +42,7 @@
 #include <cstdint>
 #include <mutex>  // NOLINT
 #include <string>
+#include <vector>
 
 #include "port/thread_annotations.h"
 
@@ -137,6 +145,290 @@ inline bool Snappy_Uncompress(const char* input, size_t length, char* output) {
 #endif  // HAVE_SNAPPY
 }
 
+inline bool Zstd_Compress(int level, const char* input, size_t length,
+                          std::string* output) {
+#if HAVE_ZSTD
+  output->resize(ZSTD_compressBound(length));
+  const size_t outlen =
+      ZSTD_compress(&(*output)[0], output->size(), input, length, level);
+  if (ZSTD_isError(outlen)) {
+    return false;
+  }
+  output->resize(outlen);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)level;
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+inline bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) {
+#if HAVE_ZSTD
+  const unsigned long long size = ZSTD_getFrameContentSize(input, length);
+  if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+    return false;
+  }
+  // Every zstd block takes at least 4 bytes and expands to at most
+  // ZSTD_BLOCKSIZE_MAX bytes, so a larger size means a corrupt header that
+  // must not be trusted for allocating the output.
+  if (size > static_cast<unsigned long long>(length / 4) * ZSTD_BLOCKSIZE_MAX) {
+    return false;
+  }
+  *result = static_cast<size_t>(size);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)result;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+inline bool Zstd_Uncompress(const char* input, size_t length, char* output) {
+#if HAVE_ZSTD
+  size_t outlen;
+  if (!Zstd_GetUncompressedLength(input, length, &outlen)) {
+    return false;
+  }
+  const size_t result = ZSTD_decompress(output, outlen, input, length);
+  return !ZSTD_isError(result) && result == outlen;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+// Trains a Zstandard dictionary of at most "max_dict_size" bytes from the
+// concatenated "samples", whose lengths are given by "sample_sizes".
+inline bool Zstd_TrainDictionary(const std::string& samples,
+                                 const std::vector<size_t>& sample_sizes,
+                                 size_t max_dict_size, std::string* dict) {
+#if HAVE_ZSTD
+  dict->resize(max_dict_size);
+  const size_t dict_size = ZDICT_trainFromBuffer(
+      &(*dict)[0], dict->size(), samples.data(), sample_sizes.data(),
+      static_cast<unsigned>(sample_sizes.size()));
+  if (ZDICT_isError(dict_size)) {
+    dict->clear();
+    return false;
+  }
+  dict->resize(dict_size);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)samples;
+  (void)sample_sizes;
+  (void)max_dict_size;
+  (void)dict;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+// A dictionary digested once for compressing many blocks.  Safe for
+// concurrent use.
+class ZstdCompressionDict {
+ public:
+  ZstdCompressionDict(const char* dict, size_t size, int level) {
+#if HAVE_ZSTD
+    cdict_ = ZSTD_createCDict(dict, size, level);
+#else
+    (void)dict;
+    (void)size;
+    (void)level;
+#endif  // HAVE_ZSTD
+  }
+
+  ZstdCompressionDict(const ZstdCompressionDict&) = delete;
+  ZstdCompressionDict& operator=(const ZstdCompressionDict&) = delete;
+
+  ~ZstdCompressionDict() {
+#if HAVE_ZSTD
+    ZSTD_freeCDict(cdict_);
+#endif  // HAVE_ZSTD
+  }
+
+  bool ok() const { return cdict_ != nullptr; }
+
+  // Same as Zstd_Compress(), using the dictionary.
+  bool Compress(const char* input, size_t length, std::string* output) const {
+#if HAVE_ZSTD
+    // Compression contexts are expensive to create; keep one per thread.
+    struct Context {
+      Context() : cctx(ZSTD_createCCtx()) {}
+      ~Context() { ZSTD_freeCCtx(cctx); }
+      ZSTD_CCtx* const cctx;
+    };
+    static thread_local Context context;
+    if (context.cctx == nullptr) {
+      return false;
+    }
+    output->resize(ZSTD_compressBound(length));
+    const size_t outlen = ZSTD_compress_usingCDict(
+        context.cctx, &(*output)[0], output->size(), input, length, cdict_);
+    if (ZSTD_isError(outlen)) {
+      return false;
+    }
+    output->resize(outlen);
+    return true;
+#else
+    // Silence compiler warnings about unused arguments.
+    (void)input;
+    (void)length;
+    (void)output;
+    return false;
+#endif  // HAVE_ZSTD
+  }
+
+ private:
+#if HAVE_ZSTD
+  ZSTD_CDict* cdict_;
+#else
+  void* cdict_ = nullptr;
+#endif  // HAVE_ZSTD
+};
+
+// A dictionary digested once for decompressing many blocks.  Safe for
+// concurrent use.
+class ZstdDecompressionDict {
+ public:
+  ZstdDecompressionDict(const char* dict, size_t size) {
+#if HAVE_ZSTD
+    ddict_ = ZSTD_createDDict(dict, size);
+#else
+    (void)dict;
+    (void)size;
+#endif  // HAVE_ZSTD
+  }
+
+  ZstdDecompressionDict(const ZstdDecompressionDict&) = delete;
+  ZstdDecompressionDict& operator=(const ZstdDecompressionDict&) = delete;
+
+  ~ZstdDecompressionDict() {
+#if HAVE_ZSTD
+    ZSTD_freeDDict(ddict_);
+#endif  // HAVE_ZSTD
+  }
+
+  bool ok() const { return ddict_ != nullptr; }
+
+  // Same as Zstd_Uncompress(), using the dictionary.  Also accepts blocks
+  // compressed without a dictionary.
+  bool Uncompress(const char* input, size_t length, char* output) const {
+#if HAVE_ZSTD
+    // Decompression contexts are expensive to create; keep one per thread.
+    struct Context {
+      Context() : dctx(ZSTD_createDCtx()) {}
+      ~Context() { ZSTD_freeDCtx(dctx); }
+      ZSTD_DCtx* const dctx;
+    };
+    static thread_local Context context;
+    size_t outlen;
+    if (context.dctx == nullptr ||
+        !Zstd_GetUncompressedLength(input, length, &outlen)) {
+      return false;
+    }
+    const size_t result = ZSTD_decompress_usingDDict(context.dctx, output,
+                                                     outlen, input, length,
+                                                     ddict_);
+    return !ZSTD_isError(result) && result == outlen;
+#else
+    // Silence compiler warnings about unused arguments.
+    (void)input;
+    (void)length;
+    (void)output;
+    return false;
+#endif  // HAVE_ZSTD
+  }
+
+ private:
+#if HAVE_ZSTD
+  ZSTD_DDict* ddict_;
+#else
+  void* ddict_ = nullptr;
+#endif  // HAVE_ZSTD
+};
+
+// LZ4 block data does not record its uncompressed length, so it is
+// prefixed with it as a 4-byte little-endian integer.
+inline bool Lz4_Compress(const char* input, size_t length,
+                         std::string* output) {
+#if HAVE_LZ4
+  if (length > LZ4_MAX_INPUT_SIZE) {
+    return false;
+  }
+  const int bound = LZ4_compressBound(static_cast<int>(length));
+  output->resize(4 + bound);
+  for (int i = 0; i < 4; i++) {
+    (*output)[i] = static_cast<char>((length >> (8 * i)) & 0xff);
+  }
+  const int outlen = LZ4_compress_default(input, &(*output)[4],
+                                          static_cast<int>(length), bound);
+  if (outlen <= 0) {
+    return false;
+  }
+  output->resize(4 + outlen);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_LZ4
+}
+
+inline bool Lz4_GetUncompressedLength(const char* input, size_t length,
+                                      size_t* result) {
+#if HAVE_LZ4
+  if (length < 4) {
+    return false;
+  }
+  uint32_t size = 0;
+  for (int i = 0; i < 4; i++) {
+    size |= static_cast<uint32_t>(static_cast<uint8_t>(input[i])) << (8 * i);
+  }
+  if (size > LZ4_MAX_INPUT_SIZE) {
+    return false;
+  }
+  *result = size;
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)result;
+  return false;
+#endif  // HAVE_LZ4
+}
+
+inline bool Lz4_Uncompress(const char* input, size_t length, char* output) {
+#if HAVE_LZ4
+  size_t outlen;
+  if (!Lz4_GetUncompressedLength(input, length, &outlen)) {
+    return false;
+  }
+  const int result =
+      LZ4_decompress_safe(input + 4, output, static_cast<int>(length - 4),
+                          static_cast<int>(outlen));
+  return result >= 0 && static_cast<size_t>(result) == outlen;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_LZ4
+}
+
 inline bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg) {
   // Silence compiler warnings about unused arguments.
   (void)func;
@@ -13,28 +13,71 @@
 #include "leveldb/comparator.h"
 #include "table/format.h"
 #include "util/coding.h"
+#include "util/hash.h"
 #include "util/logging.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#endif
+
 namespace leveldb {
 
 inline uint32_t Block::NumRestarts() const {
   assert(size_ >= sizeof(uint32_t));
-  return DecodeFixed32(data_ + size_ - sizeof(uint32_t));
+  return DecodeFixed32(data_ + size_ - sizeof(uint32_t)) &
+         kBlockNumRestartsMask;
+}
+
+inline uint32_t Block::Flags() const {
+  assert(size_ >= sizeof(uint32_t));
+  return DecodeFixed32(data_ + size_ - sizeof(uint32_t)) &
+         ~kBlockNumRestartsMask;
 }
 
 Block::Block(const BlockContents& contents)
     : data_(contents.data.data()),
       size_(contents.data.size()),
+      prefixes_(nullptr),
+      hash_buckets_(nullptr),
+      num_buckets_(0),
       owned_(contents.heap_allocated) {
   if (size_ < sizeof(uint32_t)) {
     size_ = 0;  // Error marker
+  } else if ((Flags() & ~(kBlockHasRestartPrefixes | kBlockHasHashIndex)) !=
+             0) {
+    size_ = 0;  // Written with a feature this reader does not know
   } else {
-    size_t max_restarts_allowed = (size_ - sizeof(uint32_t)) / sizeof(uint32_t);
+    const bool has_prefixes = (Flags() & kBlockHasRestartPrefixes) != 0;
+    const size_t per_restart =
+        sizeof(uint32_t) + (has_prefixes ? sizeof(uint64_t) : 0);
+    size_t max_restarts_allowed = (size_ - sizeof(uint32_t)) / per_restart;
     if (NumRestarts() > max_restarts_allowed) {
       // The size is too small for NumRestarts()
       size_ = 0;
     } else {
       restart_offset_ = size_ - (1 + NumRestarts()) * sizeof(uint32_t);
+      entries_end_ = restart_offset_;
+      if (has_prefixes) {
+        entries_end_ -= NumRestarts() * sizeof(uint64_t);
+        prefixes_ = data_ + entries_end_;
+      }
+      if ((Flags() & kBlockHasHashIndex) != 0) {
+        const uint8_t* p =
+            reinterpret_cast<const uint8_t*>(data_) + entries_end_;
+        if (entries_end_ < sizeof(uint16_t) ||
+            NumRestarts() > kBlockHashMaxRestarts) {
+          size_ = 0;
+        } else {
+          num_buckets_ = p[-2] | (static_cast<uint32_t>(p[-1]) << 8);
+          if (num_buckets_ == 0 ||
+              entries_end_ - sizeof(uint16_t) < num_buckets_) {
+            size_ = 0;
+          } else {
+            entries_end_ -= sizeof(uint16_t) + num_buckets_;
+            hash_buckets_ = data_ + entries_end_;
+          }
+        }
+      }
     }
   }
 }
@@ -78,12 +121,84 @@ static inline const char* DecodeEntry(const char* p, const char* limit,
   return p;
 }
 
+// Returns the number of entries of the sorted array prefixes[0..n-1]
+// (encoded as fixed64) that are < target, or <= target if "inclusive".
+// Branch-free, so the outcome of each probe is never mispredicted.
+static uint32_t CountPrefixesBelowPortable(const char* prefixes, uint32_t n,
+                                           uint64_t target, bool inclusive) {
+  if (n == 0) return 0;
+  const uint64_t bound = target + (inclusive ? 1 : 0);
+  const bool all = inclusive && target == ~static_cast<uint64_t>(0);
+  uint32_t base = 0;
+  uint32_t len = n;
+  while (len > 1) {
+    const uint32_t half = len / 2;
+    const uint64_t v = DecodeFixed64(prefixes + (base + half) * 8);
+    base += (all || v < bound) ? half : 0;
+    len -= half;
+  }
+  const uint64_t v = DecodeFixed64(prefixes + base * 8);
+  return base + ((all || v < bound) ? 1 : 0);
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LEVELDB_HAVE_AVX2_PREFIX_SEARCH 1
+
+// AVX2 version of CountPrefixesBelowPortable(): compares four prefixes per
+// instruction.  Only used for short arrays, where a linear pass beats the
+// dependent loads of a binary search.
+__attribute__((target("avx2"))) static uint32_t CountPrefixesBelowAVX2(
+    const char* prefixes, uint32_t n, uint64_t target, bool inclusive) {
+  // AVX2 only has signed 64-bit compares; flipping the sign bit of both
+  // operands turns them into unsigned compares.
+  const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+  const __m256i t = _mm256_xor_si256(
+      _mm256_set1_epi64x(static_cast<int64_t>(target)), sign);
+  // Count the prefixes above target when inclusive, below target otherwise.
+  uint32_t matches = 0;
+  uint32_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256i x = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prefixes + i * 8)),
+        sign);
+    const __m256i m =
+        inclusive ? _mm256_cmpgt_epi64(x, t) : _mm256_cmpgt_epi64(t, x);
+    matches += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+  }
+  for (; i < n; i++) {
+    const uint64_t v = DecodeFixed64(prefixes + i * 8);
+    matches += inclusive ? (v > target) : (v < target);
+  }
+  return inclusive ? n - matches : matches;
+}
+
+static bool HaveAVX2() {
+  static const bool result = __builtin_cpu_supports("avx2");
+  return result;
+}
+#endif  // defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+
+static inline uint32_t CountPrefixesBelow(const char* prefixes, uint32_t n,
+                                          uint64_t target, bool inclusive) {
+#if defined(LEVELDB_HAVE_AVX2_PREFIX_SEARCH)
+  static const uint32_t kMaxLinearRestarts = 64;
+  if (n <= kMaxLinearRestarts && HaveAVX2()) {
+    return CountPrefixesBelowAVX2(prefixes, n, target, inclusive);
+  }
+#endif  // defined(LEVELDB_HAVE_AVX2_PREFIX_SEARCH)
+  return CountPrefixesBelowPortable(prefixes, n, target, inclusive);
+}
+
 class Block::Iter : public Iterator {
  private:
   const Comparator* const comparator_;
   const char* const data_;       // underlying block contents  
-  uint32_t const restarts_;      // Offset of restart array (list of fixed32)
+  uint32_t const restarts_;      // Offset just past the last entry
+  uint32_t const restart_array_;  // Offset of restart array (list of fixed32)
   uint32_t const num_restarts_;  // Number of uint32_t entries in restart array
+  const char* const prefixes_;   // Restart key prefixes, or nullptr
+  const char* const hash_buckets_;  // Hash index buckets, or nullptr
+  uint32_t const num_buckets_;
 
   // current_ is offset in data_ of current entry.  >= restarts_ if !Valid
   uint32_t current_;
@@ -104,7 +219,7 @@ class Block::Iter : public Iterator {
 
   uint32_t GetRestartPoint(uint32_t index) {
     assert(index < num_restarts_);
-    return DecodeFixed32(data_ + restarts_ + index * sizeof(uint32_t));
+    return DecodeFixed32(data_ + restart_array_ + index * sizeof(uint32_t));
   }
 
   void SeekToRestartPoint(uint32_t index) {
@@ -120,12 +235,17 @@ class Block::Iter : public Iterator {
   }
 
  public:
-  Iter(const Comparator* comparator, const char* data, uint32_t restarts,
-       uint32_t num_restarts)
+  Iter(const Comparator* comparator, const char* data, uint32_t entries_end,
+       uint32_t restarts, uint32_t num_restarts, const char* prefixes,
+       const char* hash_buckets, uint32_t num_buckets)
       : comparator_(comparator),
         data_(data),
-        restarts_(restarts),
+        restarts_(entries_end),
+        restart_array_(restarts),
         num_restarts_(num_restarts),
+        prefixes_(prefixes),
+        hash_buckets_(hash_buckets),
+        num_buckets_(num_buckets),
         current_(restarts_),   //创建一个Block::Itr之后，它是处于invalid状态的，即不能Prev也不能Next；只能先Seek/SeekToxxx之后，才能调用next/prev。
         restart_index_(num_restarts_) {
     assert(num_restarts_ > 0);
@@ -179,10 +299,28 @@ class Block::Iter : public Iterator {
   // 2.定位到该restart，其索引由left指定，这是前面二分查找到的结果。
   // 3.自重启点线性向下查找，直到遇到key>=target的记录或者直到最后一条记录，也不满足key>=target，返回
   void Seek(const Slice& target) override {
+    if (hash_buckets_ != nullptr && HashSeek(target)) {
+      return;
+    }
+
     // Binary search in restart array to find the last restart point
     // with a key < target
     uint32_t left = 0;
     uint32_t right = num_restarts_ - 1;
+    uint64_t target_prefix;
+    if (prefixes_ != nullptr &&
+        comparator_->OrderedPrefix(target, &target_prefix)) {
+      // Restart keys with a smaller prefix are < target and those with a
+      // larger prefix are > target, so only the restart points whose
+      // prefix equals target's need the comparator.
+      const uint32_t lo =
+          CountPrefixesBelow(prefixes_, num_restarts_, target_prefix, false);
+      const uint32_t hi =
+          lo + CountPrefixesBelow(prefixes_ + lo * sizeof(uint64_t),
+                                  num_restarts_ - lo, target_prefix, true);
+      left = (lo > 0) ? lo - 1 : 0;
+      right = (hi > 0) ? hi - 1 : 0;
+    }
     while (left < right) {
       uint32_t mid = (left + right + 1) / 2;
       uint32_t region_offset = GetRestartPoint(mid);
@@ -231,6 +369,37 @@ class Block::Iter : public Iterator {
   }
 
  private:
+  // Tries to answer Seek(target) from the hash index.  Returns false if
+  // the index cannot tell where target is, and the caller must search the
+  // restart array instead.
+  bool HashSeek(const Slice& target) {
+    Slice hash_key;
+    if (!comparator_->HashIndexKey(target, &hash_key)) {
+      return false;
+    }
+    const uint32_t h = Hash(hash_key.data(), hash_key.size(), 0);
+    const uint8_t restart =
+        reinterpret_cast<const uint8_t*>(hash_buckets_)[h % num_buckets_];
+    if (restart >= num_restarts_) {
+      // kBlockHashNoEntry or kBlockHashCollision
+      return false;
+    }
+
+    // If target's record is in this block, all of its keys are in this
+    // restart interval and every key before the interval is < target.
+    SeekToRestartPoint(restart);
+    do {
+      if (!ParseNextKey()) {
+        return !status_.ok();
+      }
+      if (restart_index_ != restart) {
+        return false;
+      }
+    } while (Compare(key_, target) < 0);
+    Slice found;
+    return comparator_->HashIndexKey(key_, &found) && found == hash_key;
+  }
+
   void CorruptionError() {
     current_ = restarts_;
     restart_index_ = num_restarts_;
@@ -277,7 +446,8 @@ Iterator* Block::NewIterator(const Comparator* comparator) {
   if (num_restarts == 0) {
     return NewEmptyIterator();
   } else {
-    return new Iter(comparator, data_, restart_offset_, num_restarts);
+    return new Iter(comparator, data_, entries_end_, restart_offset_,
+                    num_restarts, prefixes_, hash_buckets_, num_buckets_);
   }
 }
 
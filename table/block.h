@@ -26,16 +26,24 @@ class Block {
   ~Block();
 
   size_t size() const { return size_; }
+  // Returns true if the contents live as long as the block, rather than
+  // in memory of the file they were read from.
+  bool owns_data() const { return owned_; }
   Iterator* NewIterator(const Comparator* comparator);
 
  private:
   class Iter;
 
   uint32_t NumRestarts() const;
+  uint32_t Flags() const;
 
   const char* data_;
   size_t size_;
   uint32_t restart_offset_;  // Offset in data_ of restart array
+  uint32_t entries_end_;     // Offset in data_ just past the last entry
+  const char* prefixes_;     // Restart key prefixes, or nullptr if absent
+  const char* hash_buckets_;  // Hash index buckets, or nullptr if absent
+  uint32_t num_buckets_;      // Number of hash index buckets
   bool owned_;               // Block owns data_[]
 };
 
@@ -23,9 +23,22 @@
 // shared_bytes == 0 for restart points.
 //
 // The trailer of the block has the form:
+//     [hash_buckets: uint8[num_buckets]
+//      num_buckets: uint16]
+//     [restart_prefixes: uint64[num_restarts]]
 //     restarts: uint32[num_restarts]
 //     num_restarts: uint32
 // restarts[i] contains the offset within the block of the ith restart point.
+//
+// restart_prefixes is only present if bit kBlockHasRestartPrefixes is set
+// in the num_restarts word.  restart_prefixes[i] is the comparator's
+// OrderedPrefix() of the key at the ith restart point, so Seek() can
+// discard most restart points with integer compares.
+//
+// The hash index is only present if bit kBlockHasHashIndex is set.  Each
+// bucket holds the index of the restart interval containing the keys whose
+// HashIndexKey() hashes to it, kBlockHashNoEntry if there are none, or
+// kBlockHashCollision if they fall in more than one interval.
 
 // Block结构：<entry1><entry2><...><entryn><restart1><restart...><restartm><restarts_num>
 
@@ -38,12 +51,19 @@
 
 #include "leveldb/comparator.h"
 #include "leveldb/options.h"
+#include "table/format.h"
 #include "util/coding.h"
+#include "util/hash.h"
 
 namespace leveldb {
 
 BlockBuilder::BlockBuilder(const Options* options)
-    : options_(options), restarts_(), counter_(0), finished_(false) {
+    : options_(options),
+      restarts_(),
+      prefixes_ok_(true),
+      hash_ok_(true),
+      counter_(0),
+      finished_(false) {
   assert(options->block_restart_interval >= 1);
   restarts_.push_back(0);  // First restart point is at offset 0
 }
@@ -52,23 +72,70 @@ void BlockBuilder::Reset() {
   buffer_.clear();
   restarts_.clear();
   restarts_.push_back(0);  // First restart point is at offset 0
+  restart_prefixes_.clear();
+  prefixes_ok_ = true;
+  hash_entries_.clear();
+  hash_ok_ = true;
   counter_ = 0;
   finished_ = false;
   last_key_.clear();
 }
 
+static size_t NumHashBuckets(size_t num_keys) {
+  // Keep the table about 3/4 full so that few keys share a bucket.
+  return std::max<size_t>(num_keys * 4 / 3, 1);
+}
+
 size_t BlockBuilder::CurrentSizeEstimate() const {
-  return (buffer_.size() +                       // Raw data buffer
-          restarts_.size() * sizeof(uint32_t) +  // Restart array
-          sizeof(uint32_t));                     // Restart array length
+  const size_t hash_index_size =
+      hash_entries_.empty()
+          ? 0
+          : NumHashBuckets(hash_entries_.size()) + sizeof(uint16_t);
+  return (buffer_.size() +                               // Raw data buffer
+          hash_index_size +                              // Hash index
+          restart_prefixes_.size() * sizeof(uint64_t) +  // Prefix array
+          restarts_.size() * sizeof(uint32_t) +          // Restart array
+          sizeof(uint32_t));                             // Restart array length
 }
 
 Slice BlockBuilder::Finish() {
+  uint32_t flags = 0;
+  if (options_->block_hash_index && hash_ok_ && !hash_entries_.empty()) {
+    const size_t num_buckets = NumHashBuckets(hash_entries_.size());
+    if (num_buckets <= 0xffff) {
+      std::string buckets(num_buckets, static_cast<char>(kBlockHashNoEntry));
+      for (size_t i = 0; i < hash_entries_.size(); i++) {
+        const size_t b = hash_entries_[i].first % num_buckets;
+        const uint8_t restart = hash_entries_[i].second;
+        const uint8_t current = static_cast<uint8_t>(buckets[b]);
+        if (current == kBlockHashNoEntry) {
+          buckets[b] = static_cast<char>(restart);
+        } else if (current != restart) {
+          buckets[b] = static_cast<char>(kBlockHashCollision);
+        }
+      }
+      buffer_.append(buckets);
+      char num_buckets_buf[2];
+      num_buckets_buf[0] = static_cast<char>(num_buckets & 0xff);
+      num_buckets_buf[1] = static_cast<char>(num_buckets >> 8);
+      buffer_.append(num_buckets_buf, sizeof(num_buckets_buf));
+      flags |= kBlockHasHashIndex;
+    }
+  }
+  if (options_->block_restart_prefixes && prefixes_ok_ &&
+      restart_prefixes_.size() == restarts_.size()) {
+    for (size_t i = 0; i < restart_prefixes_.size(); i++) {
+      PutFixed64(&buffer_, restart_prefixes_[i]);
+    }
+    flags |= kBlockHasRestartPrefixes;
+  }
+
   // Append restart array
   for (size_t i = 0; i < restarts_.size(); i++) {
     PutFixed32(&buffer_, restarts_[i]);
   }
-  PutFixed32(&buffer_, restarts_.size());
+  assert(restarts_.size() <= kBlockNumRestartsMask);
+  PutFixed32(&buffer_, restarts_.size() | flags);
   finished_ = true;
   return Slice(buffer_);
 }
@@ -93,6 +160,30 @@ void BlockBuilder::Add(const Slice& key, const Slice& value) {
   }
   const size_t non_shared = key.size() - shared;
 
+  if (counter_ == 0 && options_->block_restart_prefixes && prefixes_ok_) {
+    // This entry starts a restart point.
+    uint64_t prefix;
+    if (options_->comparator->OrderedPrefix(key, &prefix)) {
+      restart_prefixes_.push_back(prefix);
+    } else {
+      prefixes_ok_ = false;
+      restart_prefixes_.clear();
+    }
+  }
+
+  if (options_->block_hash_index && hash_ok_) {
+    Slice hash_key;
+    if (restarts_.size() > kBlockHashMaxRestarts ||
+        !options_->comparator->HashIndexKey(key, &hash_key)) {
+      hash_ok_ = false;
+      hash_entries_.clear();
+    } else {
+      hash_entries_.push_back(
+          std::make_pair(Hash(hash_key.data(), hash_key.size(), 0),
+                         static_cast<uint8_t>(restarts_.size() - 1)));
+    }
+  }
+
   // Add "<shared><non_shared><value_size>" to buffer_
   PutVarint32(&buffer_, shared);
   PutVarint32(&buffer_, non_shared);
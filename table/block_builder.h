@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "leveldb/slice.h"
@@ -45,6 +47,14 @@ class BlockBuilder {
   const Options* options_;
   std::string buffer_;              // Destination buffer. Buffer_代表当前数据块
   std::vector<uint32_t> restarts_;  // Restart points
+  // OrderedPrefix() of the key at each restart point, if every key so far
+  // had one.  Only maintained when options_->block_restart_prefixes.
+  std::vector<uint64_t> restart_prefixes_;
+  bool prefixes_ok_;
+  // (hash of HashIndexKey(), restart index) of every key added so far.
+  // Only maintained when options_->block_hash_index.
+  std::vector<std::pair<uint32_t, uint8_t>> hash_entries_;
+  bool hash_ok_;
   int counter_;                     // Number of entries emitted since restart
   bool finished_;                   // Has Finish() been called?
   std::string last_key_;    // 记录最后Add的key。用于获取shared_bytes的大小。
@@ -4,7 +4,9 @@
 
 #include "table/filter_block.h"
 
+#include "leveldb/comparator.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "util/coding.h"
 
 namespace leveldb {
@@ -15,8 +17,33 @@ namespace leveldb {
 static const size_t kFilterBaseLg = 11;
 static const size_t kFilterBase = 1 << kFilterBaseLg;
 
-FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy)
-    : policy_(policy) {}
+bool PrefixFilterKey(const Comparator* comparator,
+                     const SliceTransform* prefix_extractor, const Slice& key,
+                     std::string* result) {
+  Slice user_key;
+  if (!comparator->HashIndexKey(key, &user_key) ||
+      user_key.data() < key.data() ||
+      user_key.data() + user_key.size() > key.data() + key.size() ||
+      !prefix_extractor->InDomain(user_key)) {
+    return false;
+  }
+  // Keep whatever surrounds the user portion, e.g. the sequence number and
+  // type of an internal key, so that the filter policy sees a key in the
+  // format it expects.
+  const Slice prefix = prefix_extractor->Transform(user_key);
+  const char* user_key_end = user_key.data() + user_key.size();
+  result->assign(key.data(), user_key.data() - key.data());
+  result->append(prefix.data(), prefix.size());
+  result->append(user_key_end, key.data() + key.size() - user_key_end);
+  return true;
+}
+
+FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy,
+                                       const Comparator* comparator,
+                                       const SliceTransform* prefix_extractor)
+    : policy_(policy),
+      comparator_(comparator),
+      prefix_extractor_(comparator != nullptr ? prefix_extractor : nullptr) {}
 
 void FilterBlockBuilder::StartBlock(uint64_t block_offset) {
   uint64_t filter_index = (block_offset / kFilterBase);
@@ -30,6 +57,19 @@ void FilterBlockBuilder::AddKey(const Slice& key) {
   Slice k = key;
   start_.push_back(keys_.size());
   keys_.append(k.data(), k.size());
+
+  // Adjacent keys usually share their prefix, which is added once.
+  if (prefix_extractor_ != nullptr &&
+      PrefixFilterKey(comparator_, prefix_extractor_, key, &prefix_key_)) {
+    Slice user_key;
+    comparator_->HashIndexKey(key, &user_key);
+    const Slice prefix = prefix_extractor_->Transform(user_key);
+    if (start_.size() == 1 || prefix != Slice(last_prefix_)) {
+      last_prefix_.assign(prefix.data(), prefix.size());
+      start_.push_back(keys_.size());
+      keys_.append(prefix_key_);
+    }
+  }
 }
 
 Slice FilterBlockBuilder::Finish() {
@@ -20,17 +20,31 @@
 
 namespace leveldb {
 
+class Comparator;
 class FilterPolicy;
+class SliceTransform;
+
+// If "prefix_extractor" has a prefix for the user portion of "key" (see
+// Comparator::HashIndexKey()), stores in *result the key whose user
+// portion is that prefix, which filters hold for it, and returns true.
+bool PrefixFilterKey(const Comparator* comparator,
+                     const SliceTransform* prefix_extractor, const Slice& key,
+                     std::string* result);
 
 // A FilterBlockBuilder is used to construct all of the filters for a
 // particular Table.  It generates a single string which is stored as
 // a special block in the Table.
 //
+// With a "prefix_extractor", each filter also holds the PrefixFilterKey()
+// of the keys added to it.
+//
 // The sequence of calls to FilterBlockBuilder must match the regexp:
 //      (StartBlock AddKey*)* Finish
 class FilterBlockBuilder {
  public:
-  explicit FilterBlockBuilder(const FilterPolicy*);
+  explicit FilterBlockBuilder(const FilterPolicy*,
+                              const Comparator* comparator = nullptr,
+                              const SliceTransform* prefix_extractor = nullptr);
 
   FilterBlockBuilder(const FilterBlockBuilder&) = delete;
   FilterBlockBuilder& operator=(const FilterBlockBuilder&) = delete;
@@ -43,11 +57,15 @@ class FilterBlockBuilder {
   void GenerateFilter();
 
   const FilterPolicy* policy_;
+  const Comparator* comparator_;
+  const SliceTransform* prefix_extractor_;
   std::string keys_;             // Flattened key contents
   std::vector<size_t> start_;    // Starting index in keys_ of each key
   std::string result_;           // Filter data computed so far
   std::vector<Slice> tmp_keys_;  // policy_->CreateFilter() argument
   std::vector<uint32_t> filter_offsets_;
+  std::string prefix_key_;   // PrefixFilterKey() of the key being added
+  std::string last_prefix_;  // Last prefix added to the current filter
 };
 
 class FilterBlockReader {
@@ -4,7 +4,9 @@
 
 #include "table/filter_block.h"
 
+#include "leveldb/comparator.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "util/coding.h"
 #include "util/hash.h"
 #include "util/logging.h"
@@ -119,6 +121,43 @@ TEST(FilterBlockTest, MultiChunk) {
   ASSERT_TRUE(!reader.KeyMayMatch(9000, "bar"));
 }
 
+TEST(FilterBlockTest, Prefixes) {
+  const SliceTransform* prefix_extractor = NewFixedPrefixTransform(3);
+  FilterBlockBuilder builder(&policy_, BytewiseComparator(), prefix_extractor);
+
+  // First filter
+  builder.StartBlock(0);
+  builder.AddKey("foo1");
+  builder.AddKey("foo2");
+  builder.AddKey("x");  // Too short to have a prefix
+
+  // Second filter starts with a prefix already in the first one
+  builder.StartBlock(3100);
+  builder.AddKey("foo3");
+  builder.AddKey("bar1");
+
+  Slice block = builder.Finish();
+  FilterBlockReader reader(&policy_, block);
+
+  ASSERT_TRUE(reader.KeyMayMatch(0, "foo1"));
+  ASSERT_TRUE(reader.KeyMayMatch(0, "foo"));
+  ASSERT_TRUE(reader.KeyMayMatch(0, "x"));
+  ASSERT_TRUE(!reader.KeyMayMatch(0, "bar"));
+
+  ASSERT_TRUE(reader.KeyMayMatch(3100, "foo"));
+  ASSERT_TRUE(reader.KeyMayMatch(3100, "bar"));
+  ASSERT_TRUE(!reader.KeyMayMatch(3100, "foo1"));
+  ASSERT_TRUE(!reader.KeyMayMatch(3100, "x"));
+
+  std::string prefix_key;
+  ASSERT_TRUE(PrefixFilterKey(BytewiseComparator(), prefix_extractor,
+                              "foo123", &prefix_key));
+  ASSERT_EQ("foo", prefix_key);
+  ASSERT_TRUE(!PrefixFilterKey(BytewiseComparator(), prefix_extractor, "fo",
+                               &prefix_key));
+  delete prefix_extractor;
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) { return leveldb::test::RunAllTests(); }
@@ -19,6 +19,10 @@ class Block;
 class RandomAccessFile;
 struct ReadOptions;
 
+namespace port {
+class ZstdDecompressionDict;
+}  // namespace port
+
 // BlockHandle is a pointer to the extent of a file that stores a data
 // block or a meta block.
 class BlockHandle {
@@ -83,6 +87,34 @@ static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// The last fixed32 of a block's contents holds the number of restart
+// points in its low bits.  The high bits flag optional sections stored
+// in front of the restart array (see block_builder.cc).  Blocks written
+// without any optional section are identical to the original format.
+static const uint32_t kBlockNumRestartsMask = (1u << 30) - 1;
+static const uint32_t kBlockHasRestartPrefixes = 1u << 31;
+static const uint32_t kBlockHasHashIndex = 1u << 30;
+
+// Special values of a hash index bucket.  Restart indices are stored in a
+// byte, so blocks with more restart points get no hash index.
+static const uint8_t kBlockHashNoEntry = 255;
+static const uint8_t kBlockHashCollision = 254;
+static const uint32_t kBlockHashMaxRestarts = 254;
+
+// Metaindex key of the Zstandard dictionary that the data blocks of a
+// table were compressed with, if any.
+static const char kZstdDictionaryBlockKey[] = "compression.zstd_dictionary";
+
+// Metaindex key of the block holding the range tombstones of a table, if
+// any.  Its entries map (begin_key, seq, kTypeRangeDeletion) internal keys
+// to end keys.
+static const char kRangeTombstoneBlockKey[] = "range_tombstones";
+
+// Prefix of the metaindex key, followed by SliceTransform::Name(), that
+// marks the filters of a table as holding the prefixes of its keys.  Its
+// value is empty.
+static const char kPrefixExtractorKeyPrefix[] = "prefix_extractor.";
+
 struct BlockContents {
   Slice data;           // Actual contents of data
   bool cachable;        // True iff data can be cached
@@ -90,9 +122,12 @@ struct BlockContents {
 };
 
 // Read the block identified by "handle" from "file".  On failure
-// return non-OK.  On success fill *result and return OK.
+// return non-OK.  On success fill *result and return OK.  Zstd-compressed
+// blocks are decompressed with "zstd_dict" unless it is null.
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result);
+                 const BlockHandle& handle,
+                 const port::ZstdDecompressionDict* zstd_dict,
+                 BlockContents* result);
 
 // Implementation details follow.  Clients should ignore,
 
@@ -4,6 +4,8 @@
 
 #include "table/merger.h"
 
+#include <vector>
+
 #include "leveldb/comparator.h"
 #include "leveldb/iterator.h"
 #include "table/iterator_wrapper.h"
@@ -22,6 +24,7 @@ class MergingIterator : public Iterator {
     for (int i = 0; i < n; i++) {
       children_[i].Set(children[i]);
     }
+    heap_.reserve(n);
   }
 
   ~MergingIterator() override { delete[] children_; }
@@ -32,24 +35,24 @@ class MergingIterator : public Iterator {
     for (int i = 0; i < n_; i++) {
       children_[i].SeekToFirst();
     }
-    FindSmallest();
     direction_ = kForward;
+    BuildHeap();
   }
 
   void SeekToLast() override {
     for (int i = 0; i < n_; i++) {
       children_[i].SeekToLast();
     }
-    FindLargest();
     direction_ = kReverse;
+    BuildHeap();
   }
 
   void Seek(const Slice& target) override {
     for (int i = 0; i < n_; i++) {
       children_[i].Seek(target);
     }
-    FindSmallest();
     direction_ = kForward;
+    BuildHeap();
   }
 
   void Next() override {
@@ -72,10 +75,13 @@ class MergingIterator : public Iterator {
         }
       }
       direction_ = kForward;
+      current_->Next();
+      BuildHeap();
+      return;
     }
 
     current_->Next();
-    FindSmallest();
+    ReplaceTop();
   }
 
   void Prev() override {
@@ -101,10 +107,13 @@ class MergingIterator : public Iterator {
         }
       }
       direction_ = kReverse;
+      current_->Prev();
+      BuildHeap();
+      return;
     }
 
     current_->Prev();
-    FindLargest();
+    ReplaceTop();
   }
 
   Slice key() const override {
@@ -132,48 +141,82 @@ class MergingIterator : public Iterator {
   // Which direction is the iterator moving?
   enum Direction { kForward, kReverse };
 
-  void FindSmallest();
-  void FindLargest();
+  // Returns true if "a" must be yielded before "b" in direction_.  Ties go
+  // to the earlier child when moving forward and to the later one when
+  // moving backward.
+  bool Precedes(const IteratorWrapper* a, const IteratorWrapper* b) const {
+    int r = comparator_->Compare(a->key(), b->key());
+    if (direction_ == kForward) {
+      return r < 0 || (r == 0 && a < b);
+    } else {
+      return r > 0 || (r == 0 && a > b);
+    }
+  }
+
+  void BuildHeap();
+  void ReplaceTop();
+  void SiftDown(size_t i);
 
-  // We might want to use a heap in case there are lots of children.
-  // For now we use a simple array since we expect a very small number
-  // of children in leveldb.
   const Comparator* comparator_;
   IteratorWrapper* children_;
   int n_;
   IteratorWrapper* current_;
   Direction direction_;
+
+  // The valid children, as a binary heap whose top, the child that
+  // Precedes() all others, is current_.  Moving current_ then only takes
+  // O(log n) comparisons instead of a pass over all children.  Rebuilt
+  // when the direction changes.
+  std::vector<IteratorWrapper*> heap_;
 };
 
-void MergingIterator::FindSmallest() {
-  IteratorWrapper* smallest = nullptr;
+void MergingIterator::BuildHeap() {
+  heap_.clear();
   for (int i = 0; i < n_; i++) {
-    IteratorWrapper* child = &children_[i];
-    if (child->Valid()) {
-      if (smallest == nullptr) {
-        smallest = child;
-      } else if (comparator_->Compare(child->key(), smallest->key()) < 0) {
-        smallest = child;
-      }
+    if (children_[i].Valid()) {
+      heap_.push_back(&children_[i]);
     }
   }
-  current_ = smallest;
+  for (size_t i = heap_.size() / 2; i > 0; i--) {
+    SiftDown(i - 1);
+  }
+  current_ = heap_.empty() ? nullptr : heap_[0];
 }
 
-void MergingIterator::FindLargest() {
-  IteratorWrapper* largest = nullptr;
-  for (int i = n_ - 1; i >= 0; i--) {
-    IteratorWrapper* child = &children_[i];
-    if (child->Valid()) {
-      if (largest == nullptr) {
-        largest = child;
-      } else if (comparator_->Compare(child->key(), largest->key()) > 0) {
-        largest = child;
-      }
+// Restores the heap after current_ moved.
+void MergingIterator::ReplaceTop() {
+  if (!current_->Valid()) {
+    heap_[0] = heap_.back();
+    heap_.pop_back();
+  }
+  if (heap_.empty()) {
+    current_ = nullptr;
+    return;
+  }
+  SiftDown(0);
+  current_ = heap_[0];
+}
+
+void MergingIterator::SiftDown(size_t i) {
+  const size_t n = heap_.size();
+  IteratorWrapper* const child = heap_[i];
+  while (true) {
+    size_t next = 2 * i + 1;
+    if (next >= n) {
+      break;
     }
+    if (next + 1 < n && Precedes(heap_[next + 1], heap_[next])) {
+      next++;
+    }
+    if (!Precedes(heap_[next], child)) {
+      break;
+    }
+    heap_[i] = heap_[next];
+    i = next;
   }
-  current_ = largest;
+  heap_[i] = child;
 }
+
 }  // namespace
 
 Iterator* NewMergingIterator(const Comparator* comparator, Iterator** children,
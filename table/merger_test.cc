@@ -0,0 +1,252 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "table/merger.h"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "util/random.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+namespace {
+
+// An iterator over a sorted vector of key/value pairs.
+class VectorIterator : public Iterator {
+ public:
+  explicit VectorIterator(std::vector<std::pair<std::string, std::string>> v)
+      : entries_(std::move(v)), index_(entries_.size()) {}
+
+  bool Valid() const override { return index_ < entries_.size(); }
+  void SeekToFirst() override { index_ = 0; }
+  void SeekToLast() override {
+    index_ = entries_.empty() ? 0 : entries_.size() - 1;
+  }
+  void Seek(const Slice& target) override {
+    index_ = 0;
+    while (index_ < entries_.size() &&
+           Slice(entries_[index_].first).compare(target) < 0) {
+      index_++;
+    }
+  }
+  void Next() override {
+    assert(Valid());
+    index_++;
+  }
+  void Prev() override {
+    assert(Valid());
+    index_ = (index_ == 0) ? entries_.size() : index_ - 1;
+  }
+  Slice key() const override { return entries_[index_].first; }
+  Slice value() const override { return entries_[index_].second; }
+  Status status() const override { return Status::OK(); }
+
+ private:
+  const std::vector<std::pair<std::string, std::string>> entries_;
+  size_t index_;
+};
+
+}  // namespace
+
+class MergerTest {
+ public:
+  MergerTest() : iter_(nullptr) {}
+  ~MergerTest() { delete iter_; }
+
+  // Adds a child holding "keys", each with the child's index as value.
+  void AddChild(const std::vector<std::string>& keys) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (const std::string& key : keys) {
+      entries.push_back(std::make_pair(key, std::to_string(children_.size())));
+    }
+    children_.push_back(new VectorIterator(std::move(entries)));
+  }
+
+  void AddChild(Iterator* child) { children_.push_back(child); }
+
+  void Build() {
+    iter_ = NewMergingIterator(BytewiseComparator(), children_.data(),
+                               children_.size());
+  }
+
+  // Returns "key:child" for the current entry, or "-" if invalid.
+  std::string Current() const {
+    if (!iter_->Valid()) {
+      return "-";
+    }
+    return iter_->key().ToString() + ":" + iter_->value().ToString();
+  }
+
+  std::string ForwardScan() {
+    std::string result;
+    for (iter_->SeekToFirst(); iter_->Valid(); iter_->Next()) {
+      result += Current() + " ";
+    }
+    return result;
+  }
+
+  std::string ReverseScan() {
+    std::string result;
+    for (iter_->SeekToLast(); iter_->Valid(); iter_->Prev()) {
+      result += Current() + " ";
+    }
+    return result;
+  }
+
+ protected:
+  std::vector<Iterator*> children_;
+  Iterator* iter_;
+};
+
+TEST(MergerTest, NoChildren) {
+  Build();
+  iter_->SeekToFirst();
+  ASSERT_TRUE(!iter_->Valid());
+  iter_->SeekToLast();
+  ASSERT_TRUE(!iter_->Valid());
+  ASSERT_OK(iter_->status());
+}
+
+TEST(MergerTest, EmptyChildren) {
+  AddChild(std::vector<std::string>());
+  AddChild(std::vector<std::string>());
+  AddChild(std::vector<std::string>());
+  Build();
+  ASSERT_EQ("", ForwardScan());
+  ASSERT_EQ("", ReverseScan());
+  iter_->Seek("a");
+  ASSERT_TRUE(!iter_->Valid());
+  ASSERT_OK(iter_->status());
+}
+
+TEST(MergerTest, SomeEmptyChildren) {
+  AddChild(std::vector<std::string>());
+  AddChild({"b", "d"});
+  AddChild(std::vector<std::string>());
+  AddChild({"a", "c", "e"});
+  AddChild(std::vector<std::string>());
+  Build();
+  ASSERT_EQ("a:3 b:1 c:3 d:1 e:3 ", ForwardScan());
+  ASSERT_EQ("e:3 d:1 c:3 b:1 a:3 ", ReverseScan());
+  iter_->Seek("bb");
+  ASSERT_EQ("c:3", Current());
+  iter_->Seek("f");
+  ASSERT_EQ("-", Current());
+}
+
+TEST(MergerTest, DuplicateKeys) {
+  AddChild({"a", "b", "c"});
+  AddChild({"b"});
+  AddChild({"a", "b", "d"});
+  Build();
+  // Equal keys are all yielded: from the earlier child first when moving
+  // forward, and from the later child first when moving backward.
+  ASSERT_EQ("a:0 a:2 b:0 b:1 b:2 c:0 d:2 ", ForwardScan());
+  ASSERT_EQ("d:2 c:0 b:2 b:1 b:0 a:2 a:0 ", ReverseScan());
+  iter_->Seek("b");
+  ASSERT_EQ("b:0", Current());
+  iter_->Next();
+  ASSERT_EQ("b:1", Current());
+  iter_->Next();
+  ASSERT_EQ("b:2", Current());
+  iter_->Next();
+  ASSERT_EQ("c:0", Current());
+}
+
+TEST(MergerTest, DirectionSwitches) {
+  AddChild({"a", "d", "g"});
+  AddChild({"b", "e", "h"});
+  AddChild({"c", "f", "i"});
+  Build();
+
+  iter_->Seek("e");
+  ASSERT_EQ("e:1", Current());
+  iter_->Prev();
+  ASSERT_EQ("d:0", Current());
+  iter_->Prev();
+  ASSERT_EQ("c:2", Current());
+  iter_->Next();
+  ASSERT_EQ("d:0", Current());
+  iter_->Next();
+  ASSERT_EQ("e:1", Current());
+  iter_->Prev();
+  ASSERT_EQ("d:0", Current());
+
+  // Switching at either end.
+  iter_->SeekToFirst();
+  iter_->Next();
+  iter_->Prev();
+  ASSERT_EQ("a:0", Current());
+  iter_->Prev();
+  ASSERT_EQ("-", Current());
+  iter_->SeekToLast();
+  iter_->Prev();
+  iter_->Next();
+  ASSERT_EQ("i:2", Current());
+  iter_->Next();
+  ASSERT_EQ("-", Current());
+}
+
+TEST(MergerTest, RandomDirectionSwitches) {
+  Random rnd(301);
+  std::map<std::string, std::string> model;
+  std::vector<std::vector<std::string>> keys(5);
+  for (int i = 0; i < 200; i++) {
+    char buf[10];
+    snprintf(buf, sizeof(buf), "%04d", i);
+    const int child = rnd.Uniform(keys.size());
+    keys[child].push_back(buf);
+    model[buf] = std::to_string(child);
+  }
+  for (const std::vector<std::string>& child_keys : keys) {
+    AddChild(child_keys);
+  }
+  Build();
+
+  auto expected = model.begin();
+  iter_->SeekToFirst();
+  for (int i = 0; i < 2000; i++) {
+    if (expected == model.end()) {
+      ASSERT_TRUE(!iter_->Valid());
+      expected = model.begin();
+      iter_->SeekToFirst();
+      continue;
+    }
+    ASSERT_EQ(expected->first + ":" + expected->second, Current());
+    if (rnd.OneIn(3)) {
+      if (expected == model.begin()) {
+        iter_->Prev();
+        ASSERT_TRUE(!iter_->Valid());
+        iter_->SeekToFirst();
+      } else {
+        --expected;
+        iter_->Prev();
+      }
+    } else {
+      ++expected;
+      iter_->Next();
+    }
+  }
+}
+
+TEST(MergerTest, ErrorChild) {
+  AddChild({"a", "c"});
+  AddChild(NewErrorIterator(Status::Corruption("broken child")));
+  AddChild({"b"});
+  Build();
+  // The other children are still merged, and the error is reported.
+  ASSERT_EQ("a:0 b:2 c:0 ", ForwardScan());
+  ASSERT_EQ("c:0 b:2 a:0 ", ReverseScan());
+  ASSERT_TRUE(iter_->status().IsCorruption());
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) { return leveldb::test::RunAllTests(); }
@@ -4,11 +4,17 @@
 
 #include "leveldb/table.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/pinnable_slice.h"
+#include "leveldb/slice_transform.h"
+#include "port/port.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -21,15 +27,22 @@ struct Table::Rep {
   ~Rep() {
     delete filter;
     delete[] filter_data;
+    delete zstd_dict;
+    delete range_del_block;
     delete index_block;
   }
 
   Options options;
   Status status;
   RandomAccessFile* file;
+  uint64_t file_size;
   uint64_t cache_id; //block cache的ID，用于组建block cache结点的key
   FilterBlockReader* filter;
   const char* filter_data;
+  bool prefix_filtered;  // Filter holds prefixes of options.prefix_extractor
+  port::ZstdDecompressionDict* zstd_dict;  // Used for data blocks only
+  Block* range_del_block;   // Null if the table has no range tombstones
+  Status range_del_status;  // Error reading range_del_block, if any
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
   Block* index_block;
@@ -59,7 +72,8 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     if (options.paranoid_checks) {
       opt.verify_checksums = true;
     }
-    s = ReadBlock(file, opt, footer.index_handle(), &index_block_contents);
+    s = ReadBlock(file, opt, footer.index_handle(), nullptr,
+                  &index_block_contents);
   }
 
   if (s.ok()) {
@@ -69,11 +83,15 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     Rep* rep = new Table::Rep;
     rep->options = options;
     rep->file = file;
+    rep->file_size = size;
     rep->metaindex_handle = footer.metaindex_handle();
     rep->index_block = index_block;
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
     rep->filter_data = nullptr;
     rep->filter = nullptr;
+    rep->prefix_filtered = false;
+    rep->zstd_dict = nullptr;
+    rep->range_del_block = nullptr;
     *table = new Table(rep);
     (*table)->ReadMeta(footer);
   }
@@ -82,29 +100,47 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
 }
 
 void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
+  // An empty metaindex block holds nothing but its restart array, and a
+  // table without filter policy only needs the compression dictionary.
+  if (footer.metaindex_handle().size() <= 2 * sizeof(uint32_t)) {
+    return;
   }
 
-  // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
-  // it is an empty block.
   ReadOptions opt;
   if (rep_->options.paranoid_checks) {
     opt.verify_checksums = true;
   }
   BlockContents contents;
-  if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) {
+  if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), nullptr,
+                 &contents)
+           .ok()) {
     // Do not propagate errors since meta info is not needed for operation
     return;
   }
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+  iter->Seek(kZstdDictionaryBlockKey);
+  if (iter->Valid() && iter->key() == Slice(kZstdDictionaryBlockKey)) {
+    ReadZstdDictionary(iter->value());
+  }
+  if (rep_->options.filter_policy != nullptr) {
+    std::string key = "filter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadFilter(iter->value());
+    }
+    if (rep_->filter != nullptr && rep_->options.prefix_extractor != nullptr) {
+      key = kPrefixExtractorKeyPrefix;
+      key.append(rep_->options.prefix_extractor->Name());
+      iter->Seek(key);
+      rep_->prefix_filtered = iter->Valid() && iter->key() == Slice(key);
+    }
+  }
+  iter->Seek(kRangeTombstoneBlockKey);
+  if (iter->Valid() && iter->key() == Slice(kRangeTombstoneBlockKey)) {
+    ReadRangeTombstones(iter->value());
   }
   delete iter;
   delete meta;
@@ -124,7 +160,7 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
     opt.verify_checksums = true;
   }
   BlockContents block;
-  if (!ReadBlock(rep_->file, opt, filter_handle, &block).ok()) {
+  if (!ReadBlock(rep_->file, opt, filter_handle, nullptr, &block).ok()) {
     return;
   }
   if (block.heap_allocated) {
@@ -133,6 +169,66 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
 }
 
+void Table::ReadRangeTombstones(const Slice& block_handle_value) {
+  // Unlike the other meta blocks, the tombstones are needed for correct
+  // reads, so errors are kept to be reported by their iterator.
+  Slice v = block_handle_value;
+  BlockHandle handle;
+  Status s = handle.DecodeFrom(&v);
+  BlockContents contents;
+  if (s.ok()) {
+    ReadOptions opt;
+    if (rep_->options.paranoid_checks) {
+      opt.verify_checksums = true;
+    }
+    s = ReadBlock(rep_->file, opt, handle, nullptr, &contents);
+  }
+  if (s.ok()) {
+    rep_->range_del_block = new Block(contents);
+  } else {
+    rep_->range_del_status = s;
+  }
+}
+
+Iterator* Table::NewRangeTombstoneIterator() const {
+  if (!rep_->range_del_status.ok()) {
+    return NewErrorIterator(rep_->range_del_status);
+  }
+  if (rep_->range_del_block == nullptr) {
+    return nullptr;
+  }
+  return rep_->range_del_block->NewIterator(rep_->options.comparator);
+}
+
+void Table::ReadZstdDictionary(const Slice& dict_handle_value) {
+  Slice v = dict_handle_value;
+  BlockHandle dict_handle;
+  if (!dict_handle.DecodeFrom(&v).ok()) {
+    return;
+  }
+
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents block;
+  if (!ReadBlock(rep_->file, opt, dict_handle, nullptr, &block).ok()) {
+    return;
+  }
+  // The digested dictionary keeps its own copy of the contents.
+  port::ZstdDecompressionDict* dict =
+      new port::ZstdDecompressionDict(block.data.data(), block.data.size());
+  if (block.heap_allocated) {
+    delete[] block.data.data();
+  }
+  if (dict->ok()) {
+    rep_->zstd_dict = dict;
+  } else {
+    // Reads of the data blocks will report the corruption.
+    delete dict;
+  }
+}
+
 Table::~Table() { delete rep_; }
 
 static void DeleteBlock(void* arg, void* ignored) {
@@ -150,13 +246,156 @@ static void ReleaseBlock(void* arg, void* h) {
   cache->Release(handle);
 }
 
+namespace {
+
+// Serves the reads of a single table iterator out of a private buffer that
+// is refilled readahead_size bytes at a time, so that a sequential scan
+// issues a few large reads instead of one small read per block.  After
+// each refill the following chunk is handed to RandomAccessFile::Prefetch()
+// so the device can work on it while the current chunk is consumed.
+//
+// If the underlying file hands back pointers into its own memory (e.g. an
+// mmap()ed file), copying into the buffer would only add work, so the
+// wrapper forwards reads and just keeps prefetching ahead.
+//
+// Instances are not thread-safe: each one belongs to exactly one iterator.
+class ReadaheadFile : public RandomAccessFile {
+ public:
+  ReadaheadFile(const RandomAccessFile* file, uint64_t file_size,
+                size_t readahead_size)
+      : file_(file),
+        file_size_(file_size),
+        // A buffer larger than the file would never be filled.
+        readahead_size_(std::min<uint64_t>(readahead_size, file_size)),
+        buf_(file->ReadsInPlace() ? nullptr : new char[readahead_size_]),
+        buf_offset_(0),
+        buf_len_(0),
+        prefetched_limit_(0),
+        passthrough_(file->ReadsInPlace()) {}
+
+  ~ReadaheadFile() override { delete[] buf_; }
+
+  bool ReadsInPlace() const override { return file_->ReadsInPlace(); }
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    if (passthrough_ || n > readahead_size_) {
+      MaybePrefetch(offset + n);
+      return file_->Read(offset, n, result, scratch);
+    }
+    if (offset < buf_offset_ || offset + n > buf_offset_ + buf_len_) {
+      // When the iterator moves backwards, keep the chunk ending at the
+      // requested block so that a reverse scan is buffered as well.
+      uint64_t start = offset;
+      if (offset < buf_offset_) {
+        start = (offset + n > readahead_size_) ? offset + n - readahead_size_
+                                               : 0;
+      }
+      Status s = Fill(start);
+      if (!s.ok() || passthrough_) {
+        return file_->Read(offset, n, result, scratch);
+      }
+    }
+    const size_t avail = std::min<uint64_t>(n, buf_offset_ + buf_len_ - offset);
+    std::memcpy(scratch, buf_ + (offset - buf_offset_), avail);
+    *result = Slice(scratch, avail);
+    return Status::OK();
+  }
+
+ private:
+  Status Fill(uint64_t offset) const {
+    buf_offset_ = offset;
+    buf_len_ = 0;
+    if (offset >= file_size_) {
+      return Status::OK();
+    }
+    const size_t n = std::min<uint64_t>(readahead_size_, file_size_ - offset);
+    Slice chunk;
+    Status s = file_->Read(offset, n, &chunk, buf_);
+    if (!s.ok()) {
+      return s;
+    }
+    if (chunk.data() != buf_) {
+      passthrough_ = true;
+    } else {
+      buf_len_ = chunk.size();
+    }
+    MaybePrefetch(offset + chunk.size());
+    return s;
+  }
+
+  // Once reads reach the end of the prefetched region, hint the chunk that
+  // starts at "limit".
+  void MaybePrefetch(uint64_t limit) const {
+    if (limit >= prefetched_limit_ && limit < file_size_) {
+      file_->Prefetch(limit, readahead_size_);
+      prefetched_limit_ = limit + readahead_size_;
+    }
+  }
+
+  const RandomAccessFile* const file_;
+  const uint64_t file_size_;
+  const size_t readahead_size_;
+  char* const buf_;
+
+  // buf_[0, buf_len_ - 1] holds the file contents at buf_offset_.
+  mutable uint64_t buf_offset_;
+  mutable size_t buf_len_;
+  // End of the region most recently handed to Prefetch().
+  mutable uint64_t prefetched_limit_;
+  mutable bool passthrough_;
+};
+
+struct ReadaheadState {
+  Table* table;
+  ReadaheadFile* file;
+};
+
+void DeleteReadaheadState(void* arg, void* ignored) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  delete state->file;
+  delete state;
+}
+
+}  // namespace
+
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
                              const Slice& index_value) {
   Table* table = reinterpret_cast<Table*>(arg);
+  return ReadBlockIterator(table, table->rep_->file, options, index_value);
+}
+
+// Like BlockReader(), but "arg" is a ReadaheadState and block contents come
+// from the iterator's private readahead buffer.
+Iterator* Table::ReadaheadBlockReader(void* arg, const ReadOptions& options,
+                                      const Slice& index_value) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  return ReadBlockIterator(state->table, state->file, options, index_value);
+}
+
+// Returns true if the block at "handle" is stored uncompressed in a file
+// that reads in place, so that it can be used straight out of the file's
+// memory.  Such blocks are never added to the block cache, so looking them
+// up there is skipped as well.
+static bool IsInPlaceBlock(const RandomAccessFile* file,
+                           const BlockHandle& handle) {
+  if (!file->ReadsInPlace()) {
+    return false;
+  }
+  Slice type;
+  Status s = file->Read(handle.offset() + handle.size(), 1, &type, nullptr);
+  return s.ok() && type.size() == 1 && type[0] == kNoCompression;
+}
+
+Status Table::ReadDataBlock(Table* table, RandomAccessFile* file,
+                           const ReadOptions& options,
+                           const Slice& index_value, Block** block,
+                           Iterator::CleanupFunction* cleanup,
+                           void** cleanup_arg1, void** cleanup_arg2) {
   Cache* block_cache = table->rep_->options.block_cache;
-  Block* block = nullptr;
+  *block = nullptr;
   Cache::Handle* cache_handle = nullptr;
 
   BlockHandle handle;
@@ -167,55 +406,137 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
 
   if (s.ok()) {
     BlockContents contents;
-    if (block_cache != nullptr) {
+    if (block_cache != nullptr && !IsInPlaceBlock(file, handle)) {
       char cache_key_buffer[16];
       EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
       EncodeFixed64(cache_key_buffer + 8, handle.offset());
       Slice key(cache_key_buffer, sizeof(cache_key_buffer));
       cache_handle = block_cache->Lookup(key);
       if (cache_handle != nullptr) {
-        block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
+        *block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
       } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        s = ReadBlock(file, options, handle, table->rep_->zstd_dict,
+                      &contents);
         if (s.ok()) {
-          block = new Block(contents);
+          *block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
-            cache_handle = block_cache->Insert(key, block, block->size(),
+            cache_handle = block_cache->Insert(key, *block, (*block)->size(),
                                                &DeleteCachedBlock);
           }
         }
       }
     } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
+      s = ReadBlock(file, options, handle, table->rep_->zstd_dict, &contents);
       if (s.ok()) {
-        block = new Block(contents);
+        *block = new Block(contents);
       }
     }
   }
 
+  if (cache_handle == nullptr) {
+    *cleanup = &DeleteBlock;
+    *cleanup_arg1 = *block;
+    *cleanup_arg2 = nullptr;
+  } else {
+    *cleanup = &ReleaseBlock;
+    *cleanup_arg1 = block_cache;
+    *cleanup_arg2 = cache_handle;
+  }
+  return s;
+}
+
+Iterator* Table::ReadBlockIterator(Table* table, RandomAccessFile* file,
+                                   const ReadOptions& options,
+                                   const Slice& index_value) {
+  Block* block;
+  Iterator::CleanupFunction cleanup;
+  void* cleanup_arg1;
+  void* cleanup_arg2;
+  Status s = ReadDataBlock(table, file, options, index_value, &block,
+                           &cleanup, &cleanup_arg1, &cleanup_arg2);
+
   Iterator* iter;
   if (block != nullptr) {
     iter = block->NewIterator(table->rep_->options.comparator);
-    if (cache_handle == nullptr) {
-      iter->RegisterCleanup(&DeleteBlock, block, nullptr);
-    } else {
-      iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
-    }
+    iter->RegisterCleanup(cleanup, cleanup_arg1, cleanup_arg2);
   } else {
     iter = NewErrorIterator(s);
   }
   return iter;
 }
 
+bool Table::PrefixChecker(void* arg, const Slice& index_value,
+                          const Slice& target) {
+  return reinterpret_cast<Table*>(arg)->BlockPrefixMayMatch(index_value,
+                                                            target);
+}
+
+bool Table::ReadaheadPrefixChecker(void* arg, const Slice& index_value,
+                                   const Slice& target) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  return state->table->BlockPrefixMayMatch(index_value, target);
+}
+
+bool Table::BlockPrefixMayMatch(const Slice& index_value,
+                                const Slice& target) const {
+  if (!rep_->prefix_filtered) {
+    return true;
+  }
+  std::string prefix_key;
+  Slice input = index_value;
+  BlockHandle handle;
+  if (!PrefixFilterKey(rep_->options.comparator,
+                       rep_->options.prefix_extractor, target, &prefix_key) ||
+      !handle.DecodeFrom(&input).ok()) {
+    return true;
+  }
+  return rep_->filter->KeyMayMatch(handle.offset(), prefix_key);
+}
+
+bool Table::PrefixMayMatch(const Slice& target) const {
+  if (!rep_->prefix_filtered) {
+    return true;
+  }
+  // Keys with the prefix of "target" that follow it start in the block
+  // Seek(target) lands in, if there are any.
+  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  iiter->Seek(target);
+  bool result;
+  if (iiter->Valid()) {
+    result = BlockPrefixMayMatch(iiter->value(), target);
+  } else {
+    result = !iiter->status().ok();
+  }
+  delete iiter;
+  return result;
+}
+
 Iterator* Table::NewIterator(const ReadOptions& options) const {
-  return NewTwoLevelIterator(
+  if (options.readahead_size == 0) {
+    return NewTwoLevelIterator(
+        rep_->index_block->NewIterator(rep_->options.comparator),
+        &Table::BlockReader, const_cast<Table*>(this), options,
+        rep_->options.comparator, &Table::PrefixChecker);
+  }
+  ReadaheadState* state = new ReadaheadState;
+  state->table = const_cast<Table*>(this);
+  state->file =
+      new ReadaheadFile(rep_->file, rep_->file_size, options.readahead_size);
+  Iterator* iter = NewTwoLevelIterator(
       rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+      &Table::ReadaheadBlockReader, state, options, rep_->options.comparator,
+      &Table::ReadaheadPrefixChecker);
+  iter->RegisterCleanup(&DeleteReadaheadState, state, nullptr);
+  return iter;
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
                           void (*handle_result)(void*, const Slice&,
-                                                const Slice&)) {
+                                                const Slice&),
+                          PinnableSlice* value,
+                          Iterator::CleanupFunction unref_table,
+                          void* unref_arg1, void* unref_arg2,
+                          bool* table_pinned) {
   Status s;
   Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
   iiter->Seek(k);
@@ -227,13 +548,38 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
         !filter->KeyMayMatch(handle.offset(), k)) {
       // Not found
     } else {
-      Iterator* block_iter = BlockReader(this, options, iiter->value());
-      block_iter->Seek(k);
-      if (block_iter->Valid()) {
-        (*handle_result)(arg, block_iter->key(), block_iter->value());
+      Block* block;
+      Iterator::CleanupFunction cleanup;
+      void* cleanup_arg1;
+      void* cleanup_arg2;
+      s = ReadDataBlock(this, rep_->file, options, iiter->value(), &block,
+                        &cleanup, &cleanup_arg1, &cleanup_arg2);
+      if (block != nullptr) {
+        bool pinned = false;
+        Iterator* block_iter = block->NewIterator(rep_->options.comparator);
+        block_iter->Seek(k);
+        if (block_iter->Valid()) {
+          (*handle_result)(arg, block_iter->key(), block_iter->value());
+          if (value == nullptr) {
+            // Nothing to pin
+          } else if (block->owns_data()) {
+            value->PinSlice(block_iter->value(), cleanup, cleanup_arg1,
+                            cleanup_arg2);
+            pinned = true;
+          } else if (unref_table != nullptr) {
+            value->PinSlice(block_iter->value(), unref_table, unref_arg1,
+                            unref_arg2);
+            *table_pinned = true;
+          } else {
+            value->PinSelf(block_iter->value());
+          }
+        }
+        s = block_iter->status();
+        delete block_iter;
+        if (!pinned) {
+          (*cleanup)(cleanup_arg1, cleanup_arg2);
+        }
       }
-      s = block_iter->status();
-      delete block_iter;
     }
   }
   if (s.ok()) {
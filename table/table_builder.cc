@@ -6,18 +6,92 @@
 
 #include <assert.h>
 
+#include <deque>
+#include <string>
+#include <vector>
+
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
+namespace {
+
+// Compresses "raw" with "type" into *compressed.  Returns the type of the
+// block contents to store: kNoCompression, meaning "raw" itself, if the
+// algorithm is not supported or saves less than 12.5%.
+CompressionType CompressBlock(CompressionType type, int zstd_level,
+                              const port::ZstdCompressionDict* zstd_dict,
+                              const Slice& raw, std::string* compressed) {
+  switch (type) {
+    case kNoCompression:
+      return kNoCompression;
+
+    //采用Snappy压缩，Snappy是谷歌开源的压缩库
+    case kSnappyCompression:
+      if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
+          compressed->size() < raw.size() - (raw.size() / 8u)) {
+        return kSnappyCompression;
+      }
+      // Snappy not supported, or compressed(压缩比) less than 12.5%, so just
+      // store uncompressed form
+      return kNoCompression;
+
+    case kZstdCompression: {
+      const bool compressed_ok =
+          zstd_dict != nullptr
+              ? zstd_dict->Compress(raw.data(), raw.size(), compressed)
+              : port::Zstd_Compress(zstd_level, raw.data(), raw.size(),
+                                    compressed);
+      if (compressed_ok &&
+          compressed->size() < raw.size() - (raw.size() / 8u)) {
+        return kZstdCompression;
+      }
+      // Zstd not supported, or compressed less than 12.5%, so just
+      // store uncompressed form
+      return kNoCompression;
+    }
+
+    case kLZ4Compression:
+      if (port::Lz4_Compress(raw.data(), raw.size(), compressed) &&
+          compressed->size() < raw.size() - (raw.size() / 8u)) {
+        return kLZ4Compression;
+      }
+      // LZ4 not supported, or compressed less than 12.5%, so just
+      // store uncompressed form
+      return kNoCompression;
+
+    default:
+      return kNoCompression;
+  }
+}
+
+// Fills trailer[0, kBlockTrailerSize - 1] with the type and checksum of a
+// block.
+void FillBlockTrailer(const Slice& block_contents, CompressionType type,
+                      char* trailer) {
+  trailer[0] = type;
+
+  // 为block_contents、type添加校验
+  uint32_t crc = crc32c::Value(block_contents.data(), block_contents.size());
+  crc = crc32c::Extend(crc, trailer, 1);  // Extend crc to cover block type
+  // 将校验码拷贝到trailer的后四个字节
+  EncodeFixed32(trailer + 1, crc32c::Mask(crc));
+}
+
+}  // namespace
+
 struct TableBuilder::Rep {
   Rep(const Options& opt, WritableFile* f)
       : options(opt),
@@ -26,13 +100,25 @@ struct TableBuilder::Rep {
         offset(0),
         data_block(&options),
         index_block(&index_block_options),
+        range_del_block(&index_block_options),
         num_entries(0),
         closed(false),
         filter_block(opt.filter_policy == nullptr
                          ? nullptr
-                         : new FilterBlockBuilder(opt.filter_policy)),
-        pending_index_entry(false) {
+                         : new FilterBlockBuilder(opt.filter_policy,
+                                                  opt.comparator,
+                                                  opt.prefix_extractor)),
+        pending_index_entry(false),
+        buffering(opt.compression == kZstdCompression &&
+                  opt.zstd_max_train_bytes > 0),
+        zstd_dict(nullptr),
+        compression_workers(opt.compression == kNoCompression
+                                ? 0
+                                : opt.parallel_compression_threads - 1),
+        done_cv(&mu),
+        in_flight_bytes(0) {
     index_block_options.block_restart_interval = 1;
+    index_block_options.block_hash_index = false;
   }
 
   Options options;
@@ -42,6 +128,8 @@ struct TableBuilder::Rep {
   Status status;
   BlockBuilder data_block;
   BlockBuilder index_block;
+  BlockBuilder range_del_block;  // Range tombstones, written as a meta block
+  std::string last_range_del_key;
   std::string last_key; //上一个插入的key值，新插入的key必须比它大，保证.sst文件中的key是从小到大排列的
   int64_t num_entries; //.sst文件中存储的所有记录总数。
   bool closed;  // Either Finish() or Abandon() has been called.
@@ -60,6 +148,75 @@ struct TableBuilder::Rep {
   BlockHandle pending_handle;  // Handle to add to index block
 
   std::string compressed_output;  //Data Block的block_data字段压缩后的结果
+
+  // While "buffering", finished data blocks are held back in memory until
+  // enough of them have been seen to train a compression dictionary (see
+  // Options::zstd_max_train_bytes), and then written with it.  The keys
+  // for the filter block and the index block are held back with them.
+  struct BufferedBlock {
+    size_t size;            // Length of the contents in buffered_data
+    size_t keys_end;        // Index past its last key in buffered_key_sizes
+    std::string index_key;  // Unset for the last block
+  };
+  bool buffering;
+  std::string buffered_data;
+  std::vector<BufferedBlock> buffered_blocks;
+  std::string buffered_keys;
+  std::vector<size_t> buffered_key_sizes;
+
+  port::ZstdCompressionDict* zstd_dict;  // Null if not trained
+  std::string zstd_dict_contents;
+
+  // With Options::parallel_compression_threads > 1, finished data blocks
+  // are compressed and checksummed on the threads of
+  // Env::ScheduleParallel(), and then written in order on the caller's
+  // thread.  The keys of a block are given to the filter block when it is
+  // written, like for "buffering".
+  struct ParallelBlock {
+    Rep* rep;
+    std::string raw;
+    CompressionType type;  // Requested, and after compression, actual type
+    int zstd_level;
+    const port::ZstdCompressionDict* zstd_dict;
+    std::string compressed;
+    char trailer[kBlockTrailerSize];
+    bool done;  // Guarded by mu
+
+    std::string keys;
+    std::vector<size_t> key_sizes;
+    bool has_index_key;
+    std::string index_key;
+  };
+
+  static void CompressParallelBlock(void* arg) {
+    ParallelBlock* block = reinterpret_cast<ParallelBlock*>(arg);
+    block->type = CompressBlock(block->type, block->zstd_level,
+                                block->zstd_dict, block->raw,
+                                &block->compressed);
+    FillBlockTrailer(
+        block->type == kNoCompression ? block->raw : block->compressed,
+        block->type, block->trailer);
+
+    Rep* r = block->rep;
+    MutexLock l(&r->mu);
+    block->done = true;
+    r->done_cv.Signal();
+  }
+
+  void WaitForParallelBlocks() {
+    MutexLock l(&mu);
+    for (ParallelBlock* block : in_flight) {
+      while (!block->done) {
+        done_cv.Wait();
+      }
+    }
+  }
+
+  int compression_workers;  // Zero unless blocks are compressed in parallel
+  port::Mutex mu;
+  port::CondVar done_cv;  // Signaled when a block has been compressed
+  std::deque<ParallelBlock*> in_flight;  // Queued but not yet written
+  uint64_t in_flight_bytes;
 };
 
 TableBuilder::TableBuilder(const Options& options, WritableFile* file)
@@ -71,6 +228,12 @@ TableBuilder::TableBuilder(const Options& options, WritableFile* file)
 
 TableBuilder::~TableBuilder() {
   assert(rep_->closed);  // Catch errors where caller forgot to call Finish()
+  // Blocks left behind by Abandon() may still be compressed by the pool.
+  rep_->WaitForParallelBlocks();
+  for (Rep::ParallelBlock* block : rep_->in_flight) {
+    delete block;
+  }
+  delete rep_->zstd_dict;
   delete rep_->filter_block;
   delete rep_;
 }
@@ -88,9 +251,22 @@ Status TableBuilder::ChangeOptions(const Options& options) {
   rep_->options = options;
   rep_->index_block_options = options;
   rep_->index_block_options.block_restart_interval = 1;
+  rep_->index_block_options.block_hash_index = false;
   return Status::OK();
 }
 
+void TableBuilder::AddRangeTombstone(const Slice& key, const Slice& value) {
+  Rep* r = rep_;
+  assert(!r->closed);
+  if (!ok()) return;
+  if (!r->range_del_block.empty()) {
+    assert(r->options.comparator->Compare(key, Slice(r->last_range_del_key)) >
+           0);
+  }
+  r->last_range_del_key.assign(key.data(), key.size());
+  r->range_del_block.Add(key, value);
+}
+
 void TableBuilder::Add(const Slice& key, const Slice& value) {
   Rep* r = rep_;
   assert(!r->closed);
@@ -109,15 +285,27 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
     // 处理后，r->last_key=the r。这样的话r->last_key就大于上一个Data Block的
     // 所有key，并且小于后面所有Data Block的key。    
     r->options.comparator->FindShortestSeparator(&r->last_key, key);
-    std::string handle_encoding;
-    r->pending_handle.EncodeTo(&handle_encoding);
-    r->index_block.Add(r->last_key, Slice(handle_encoding));
+    if (r->buffering) {
+      r->buffered_blocks.back().index_key = r->last_key;
+    } else if (!r->in_flight.empty()) {
+      r->in_flight.back()->has_index_key = true;
+      r->in_flight.back()->index_key = r->last_key;
+    } else {
+      std::string handle_encoding;
+      r->pending_handle.EncodeTo(&handle_encoding);
+      r->index_block.Add(r->last_key, Slice(handle_encoding));
+    }
     r->pending_index_entry = false;
   }
 
   // 2. 构建过滤器
   if (r->filter_block != nullptr) {
-    r->filter_block->AddKey(key);
+    if (r->buffering || r->compression_workers > 0) {
+      r->buffered_keys.append(key.data(), key.size());
+      r->buffered_key_sizes.push_back(key.size());
+    } else {
+      r->filter_block->AddKey(key);
+    }
   }
 
   // 3. 记录数据
@@ -139,6 +327,28 @@ void TableBuilder::Flush() {
   if (!ok()) return;
   if (r->data_block.empty()) return;
   assert(!r->pending_index_entry);
+  if (r->buffering) {
+    Slice raw = r->data_block.Finish();
+    r->buffered_data.append(raw.data(), raw.size());
+    Rep::BufferedBlock block;
+    block.size = raw.size();
+    block.keys_end = r->buffered_key_sizes.size();
+    r->buffered_blocks.push_back(block);
+    r->data_block.Reset();
+    r->pending_index_entry = true;
+    if (r->buffered_data.size() >= r->options.zstd_max_train_bytes) {
+      WriteBufferedBlocks();
+    }
+    return;
+  }
+  if (r->compression_workers > 0) {
+    QueueBlock();
+    r->pending_index_entry = true;
+    // Keep a few blocks queued per worker so that none of them idles while
+    // the caller waits for the oldest block.
+    WriteCompressedBlocks(2 * r->compression_workers);
+    return;
+  }
   WriteBlock(&r->data_block, &r->pending_handle);
   if (ok()) {
     r->pending_index_entry = true;
@@ -155,52 +365,163 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
   //    type: uint8
   //    crc: uint32
   assert(ok());
+  CompressAndWriteBlock(block->Finish(), handle);
+  block->Reset();
+}
+
+void TableBuilder::CompressAndWriteBlock(const Slice& raw,
+                                         BlockHandle* handle) {
   Rep* r = rep_;
-  Slice raw = block->Finish();
+  const CompressionType type =
+      CompressBlock(r->options.compression, r->options.zstd_compression_level,
+                    r->zstd_dict, raw, &r->compressed_output);
+  WriteRawBlock(type == kNoCompression ? raw : Slice(r->compressed_output),
+                type, handle);
+  r->compressed_output.clear();
+}
 
-  Slice block_contents;
-  CompressionType type = r->options.compression;
-  // TODO(postrelease): Support more compression options: zlib?
-  switch (type) {
-    case kNoCompression:
-      block_contents = raw;
-      break;
+void TableBuilder::QueueBlock() {
+  Rep* r = rep_;
+  Rep::ParallelBlock* block = new Rep::ParallelBlock;
+  block->rep = r;
+  Slice raw = r->data_block.Finish();
+  block->raw.assign(raw.data(), raw.size());
+  r->data_block.Reset();
+  block->type = r->options.compression;
+  block->zstd_level = r->options.zstd_compression_level;
+  block->zstd_dict = r->zstd_dict;
+  block->done = false;
+  block->keys.swap(r->buffered_keys);
+  block->key_sizes.swap(r->buffered_key_sizes);
+  block->has_index_key = false;
+  r->in_flight.push_back(block);
+  r->in_flight_bytes += block->raw.size();
+
+  r->options.env->ScheduleParallel(&Rep::CompressParallelBlock, block,
+                                   r->compression_workers);
+}
 
-    //采用Snappy压缩，Snappy是谷歌开源的压缩库
-    case kSnappyCompression: {
-      std::string* compressed = &r->compressed_output;
-      if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
-          compressed->size() < raw.size() - (raw.size() / 8u)) {
-        block_contents = *compressed;
+void TableBuilder::WriteCompressedBlocks(size_t max_in_flight) {
+  Rep* r = rep_;
+  bool wrote = false;
+  while (!r->in_flight.empty()) {
+    Rep::ParallelBlock* block = r->in_flight.front();
+    r->mu.Lock();
+    if (!block->done && r->in_flight.size() <= max_in_flight) {
+      r->mu.Unlock();
+      break;
+    }
+    while (!block->done) {
+      r->done_cv.Wait();
+    }
+    r->mu.Unlock();
+    r->in_flight.pop_front();
+    r->in_flight_bytes -= block->raw.size();
+
+    if (ok()) {
+      if (r->filter_block != nullptr) {
+        const char* keys = block->keys.data();
+        for (size_t key_size : block->key_sizes) {
+          r->filter_block->AddKey(Slice(keys, key_size));
+          keys += key_size;
+        }
+      }
+      BlockHandle handle;
+      AppendBlock(
+          block->type == kNoCompression ? block->raw : block->compressed,
+          block->trailer, &handle);
+      if (r->filter_block != nullptr) {
+        r->filter_block->StartBlock(r->offset);
+      }
+      if (block->has_index_key) {
+        std::string handle_encoding;
+        handle.EncodeTo(&handle_encoding);
+        r->index_block.Add(block->index_key, Slice(handle_encoding));
       } else {
-        // Snappy not supported, or compressed(压缩比) less than 12.5%, so just
-        // store uncompressed form
-        block_contents = raw;
-        type = kNoCompression;
+        r->pending_handle = handle;
       }
-      break;
+      wrote = true;
     }
+    delete block;
+  }
+  if (wrote && ok()) {
+    r->status = r->file->Flush();
   }
-  WriteRawBlock(block_contents, type, handle);
-  r->compressed_output.clear();
-  block->Reset();
+}
+
+void TableBuilder::WriteBufferedBlocks() {
+  Rep* r = rep_;
+  assert(r->buffering);
+  r->buffering = false;
+
+  // Training fails if the samples are too few or too small, in which case
+  // the blocks are compressed without a dictionary.
+  std::vector<size_t> sample_sizes;
+  for (const Rep::BufferedBlock& block : r->buffered_blocks) {
+    sample_sizes.push_back(block.size);
+  }
+  std::string dict;
+  if (port::Zstd_TrainDictionary(r->buffered_data, sample_sizes,
+                                 r->options.zstd_max_dict_bytes, &dict)) {
+    r->zstd_dict = new port::ZstdCompressionDict(
+        dict.data(), dict.size(), r->options.zstd_compression_level);
+    if (r->zstd_dict->ok()) {
+      r->zstd_dict_contents.swap(dict);
+    } else {
+      delete r->zstd_dict;
+      r->zstd_dict = nullptr;
+    }
+  }
+
+  // Replay the held back blocks as Add() and Flush() would have.
+  const char* data = r->buffered_data.data();
+  const char* keys = r->buffered_keys.data();
+  size_t key_index = 0;
+  for (size_t i = 0; i < r->buffered_blocks.size() && ok(); i++) {
+    const Rep::BufferedBlock& block = r->buffered_blocks[i];
+    if (r->filter_block != nullptr) {
+      for (; key_index < block.keys_end; key_index++) {
+        const size_t key_size = r->buffered_key_sizes[key_index];
+        r->filter_block->AddKey(Slice(keys, key_size));
+        keys += key_size;
+      }
+    }
+    CompressAndWriteBlock(Slice(data, block.size), &r->pending_handle);
+    data += block.size;
+    if (r->filter_block != nullptr) {
+      r->filter_block->StartBlock(r->offset);
+    }
+    if (i + 1 < r->buffered_blocks.size()) {
+      std::string handle_encoding;
+      r->pending_handle.EncodeTo(&handle_encoding);
+      r->index_block.Add(block.index_key, Slice(handle_encoding));
+    }
+  }
+  if (ok()) {
+    r->status = r->file->Flush();
+  }
+
+  // The index entry of the last block is still pending.
+  std::string().swap(r->buffered_data);
+  std::vector<Rep::BufferedBlock>().swap(r->buffered_blocks);
+  std::string().swap(r->buffered_keys);
+  std::vector<size_t>().swap(r->buffered_key_sizes);
 }
 
 void TableBuilder::WriteRawBlock(const Slice& block_contents,
                                  CompressionType type, BlockHandle* handle) {
+  char trailer[kBlockTrailerSize];
+  FillBlockTrailer(block_contents, type, trailer);
+  AppendBlock(block_contents, trailer, handle);
+}
+
+void TableBuilder::AppendBlock(const Slice& block_contents,
+                               const char* trailer, BlockHandle* handle) {
   Rep* r = rep_;
   handle->set_offset(r->offset);
   handle->set_size(block_contents.size());
   r->status = r->file->Append(block_contents);
   if (r->status.ok()) {
-    char trailer[kBlockTrailerSize];
-    trailer[0] = type;
-
-    // 为block_contents、type添加校验
-    uint32_t crc = crc32c::Value(block_contents.data(), block_contents.size());
-    crc = crc32c::Extend(crc, trailer, 1);  // Extend crc to cover block type
-    // 将校验码拷贝到trailer的后四个字节
-    EncodeFixed32(trailer + 1, crc32c::Mask(crc));
     // 向文件尾部添加压缩类型和校验码，这样一个完整的Block Data诞生
     r->status = r->file->Append(Slice(trailer, kBlockTrailerSize));
     if (r->status.ok()) {
@@ -221,10 +542,26 @@ Status TableBuilder::status() const { return rep_->status; }
 Status TableBuilder::Finish() {
   Rep* r = rep_;
   Flush(); // 是因为调用Finish的时候，block_data不一定大于等于block_size，所以要调用Flush,将这部分block_data写入到磁盘
+  if (ok() && r->buffering) {
+    WriteBufferedBlocks();
+  }
+  WriteCompressedBlocks(0);
   assert(!r->closed);
   r->closed = true;
 
-  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  // Only data blocks use the dictionary, because Table::Open() reads the
+  // index block before the dictionary.
+  delete r->zstd_dict;
+  r->zstd_dict = nullptr;
+
+  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle,
+      zstd_dict_block_handle, range_del_block_handle;
+
+  // Write the compression dictionary
+  if (ok() && !r->zstd_dict_contents.empty()) {
+    WriteRawBlock(r->zstd_dict_contents, kNoCompression,
+                  &zstd_dict_block_handle);
+  }
 
   // Write filter block
   if (ok() && r->filter_block != nullptr) {
@@ -232,9 +569,25 @@ Status TableBuilder::Finish() {
                   &filter_block_handle);
   }
 
+  // Write range tombstone block
+  const bool has_range_dels = !r->range_del_block.empty();
+  if (ok() && has_range_dels) {
+    WriteBlock(&r->range_del_block, &range_del_block_handle);
+  }
+
   // Write metaindex block
   if (ok()) {
-    BlockBuilder meta_index_block(&r->options);
+    // Meta blocks are searched with BytewiseComparator(), so prefixes and
+    // hashes computed with r->options.comparator would not match.
+    Options meta_index_options = r->options;
+    meta_index_options.block_restart_prefixes = false;
+    meta_index_options.block_hash_index = false;
+    BlockBuilder meta_index_block(&meta_index_options);
+    if (!r->zstd_dict_contents.empty()) {
+      std::string handle_encoding;
+      zstd_dict_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(kZstdDictionaryBlockKey, handle_encoding);
+    }
     if (r->filter_block != nullptr) {
       // Add mapping from "filter.Name" to location of filter data
       std::string key = "filter.";
@@ -242,6 +595,16 @@ Status TableBuilder::Finish() {
       std::string handle_encoding;
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
+      if (r->options.prefix_extractor != nullptr) {
+        key = kPrefixExtractorKeyPrefix;
+        key.append(r->options.prefix_extractor->Name());
+        meta_index_block.Add(key, Slice());
+      }
+    }
+    if (has_range_dels) {
+      std::string handle_encoding;
+      range_del_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(kRangeTombstoneBlockKey, handle_encoding);
     }
 
     // TODO(postrelease): Add stats and other meta blocks
@@ -283,6 +646,8 @@ void TableBuilder::Abandon() {
 
 uint64_t TableBuilder::NumEntries() const { return rep_->num_entries; }
 
-uint64_t TableBuilder::FileSize() const { return rep_->offset; }
+uint64_t TableBuilder::FileSize() const {
+  return rep_->offset + rep_->buffered_data.size() + rep_->in_flight_bytes;
+}
 
 }  // namespace leveldb
@@ -4,14 +4,17 @@
 
 #include "leveldb/table.h"
 
+#include <algorithm>
 #include <map>
 #include <string>
 
 #include "db/dbformat.h"
 #include "db/memtable.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
 #include "leveldb/table_builder.h"
 #include "table/block.h"
@@ -132,6 +135,35 @@ class StringSource : public RandomAccessFile {
   std::string contents_;
 };
 
+// Like StringSource, but hands out pointers into its contents, as a
+// memory-mapped file does.
+class InPlaceSource : public RandomAccessFile {
+ public:
+  InPlaceSource(const Slice& contents)
+      : contents_(contents.data(), contents.size()) {}
+
+  uint64_t Size() const { return contents_.size(); }
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    if (offset >= contents_.size()) {
+      return Status::InvalidArgument("invalid Read offset");
+    }
+    if (offset + n > contents_.size()) {
+      n = contents_.size() - offset;
+    }
+    *result = Slice(&contents_[offset], n);
+    return Status::OK();
+  }
+
+  bool ReadsInPlace() const override { return true; }
+
+  const std::string& contents() const { return contents_; }
+
+ private:
+  std::string contents_;
+};
+
 typedef std::map<std::string, std::string, STLLessThan> KVMap;
 
 // Helper class for tests to unify the interface between
@@ -376,30 +408,44 @@ struct TestArgs {
   TestType type;
   bool reverse_compare;
   int restart_interval;
+  bool restart_prefixes;
+  bool hash_index;
 };
 
 static const TestArgs kTestArgList[] = {
-    {TABLE_TEST, false, 16},
-    {TABLE_TEST, false, 1},
-    {TABLE_TEST, false, 1024},
-    {TABLE_TEST, true, 16},
-    {TABLE_TEST, true, 1},
-    {TABLE_TEST, true, 1024},
-
-    {BLOCK_TEST, false, 16},
-    {BLOCK_TEST, false, 1},
-    {BLOCK_TEST, false, 1024},
-    {BLOCK_TEST, true, 16},
-    {BLOCK_TEST, true, 1},
-    {BLOCK_TEST, true, 1024},
+    {TABLE_TEST, false, 16, false, false},
+    {TABLE_TEST, false, 1, false, false},
+    {TABLE_TEST, false, 1024, false, false},
+    {TABLE_TEST, true, 16, false, false},
+    {TABLE_TEST, true, 1, false, false},
+    {TABLE_TEST, true, 1024, false, false},
+    {TABLE_TEST, false, 16, true, false},
+    {TABLE_TEST, false, 1, true, false},
+    {TABLE_TEST, false, 16, false, true},
+
+    {BLOCK_TEST, false, 16, false, false},
+    {BLOCK_TEST, false, 1, false, false},
+    {BLOCK_TEST, false, 1024, false, false},
+    {BLOCK_TEST, true, 16, false, false},
+    {BLOCK_TEST, true, 1, false, false},
+    {BLOCK_TEST, true, 1024, false, false},
+    {BLOCK_TEST, false, 16, true, false},
+    {BLOCK_TEST, false, 1, true, false},
+    {BLOCK_TEST, false, 1024, true, false},
+    // ReverseKeyComparator has no OrderedPrefix(), so none are written.
+    {BLOCK_TEST, true, 16, true, false},
+    {BLOCK_TEST, false, 16, false, true},
+    {BLOCK_TEST, false, 1, true, true},
+    // ReverseKeyComparator has no HashIndexKey(), so no index is written.
+    {BLOCK_TEST, true, 1, false, true},
 
     // Restart interval does not matter for memtables
-    {MEMTABLE_TEST, false, 16},
-    {MEMTABLE_TEST, true, 16},
+    {MEMTABLE_TEST, false, 16, false, false},
+    {MEMTABLE_TEST, true, 16, false, false},
 
     // Do not bother with restart interval variations for DB
-    {DB_TEST, false, 16},
-    {DB_TEST, true, 16},
+    {DB_TEST, false, 16, false, false},
+    {DB_TEST, true, 16, false, false},
 };
 static const int kNumTestArgs = sizeof(kTestArgList) / sizeof(kTestArgList[0]);
 
@@ -413,6 +459,8 @@ class Harness {
     options_ = Options();
 
     options_.block_restart_interval = args.restart_interval;
+    options_.block_restart_prefixes = args.restart_prefixes;
+    options_.block_hash_index = args.hash_index;
     // Use shorter block size for tests to exercise block boundary
     // conditions more.
     options_.block_size = 256;
@@ -699,7 +747,7 @@ TEST(Harness, Randomized) {
 
 TEST(Harness, RandomizedLongDB) {
   Random rnd(test::RandomSeed());
-  TestArgs args = {DB_TEST, false, 16};
+  TestArgs args = {DB_TEST, false, 16, false, false};
   Init(args);
   int num_entries = 100000;
   for (int e = 0; e < num_entries; e++) {
@@ -721,6 +769,121 @@ TEST(Harness, RandomizedLongDB) {
   ASSERT_GT(files, 0);
 }
 
+TEST(Harness, RestartPrefixesSharedPrefix) {
+  // Keys longer than the 8-byte prefix that only differ past it, plus keys
+  // that are proper prefixes of others, exercise the comparator fallback.
+  Options options;
+  options.block_restart_interval = 2;
+  std::vector<std::string> keys;
+  for (int i = 0; i < 40; i++) {
+    keys.push_back("prefix00" + std::string(1, 'a' + i % 20) +
+                   std::to_string(i / 20));
+  }
+  keys.push_back("prefix0");
+  keys.push_back("prefix");
+  keys.push_back(std::string("pre\0\0", 5));
+  keys.push_back("q");
+  std::sort(keys.begin(), keys.end());
+
+  std::string contents[2];
+  for (int prefixes = 0; prefixes < 2; prefixes++) {
+    options.block_restart_prefixes = prefixes;
+    BlockBuilder builder(&options);
+    for (size_t i = 0; i < keys.size(); i++) {
+      builder.Add(keys[i], "v" + std::to_string(i));
+    }
+    contents[prefixes] = builder.Finish().ToString();
+  }
+  ASSERT_EQ(contents[0].size() + (keys.size() / 2) * sizeof(uint64_t),
+            contents[1].size());
+
+  BlockContents block_contents;
+  block_contents.data = contents[1];
+  block_contents.cachable = false;
+  block_contents.heap_allocated = false;
+  Block block(block_contents);
+  Iterator* iter = block.NewIterator(BytewiseComparator());
+  std::vector<std::string> targets = keys;
+  targets.push_back("");
+  targets.push_back("a");
+  targets.push_back("prefix00");
+  targets.push_back("prefix00z");
+  targets.push_back("prefix01");
+  targets.push_back("z");
+  for (const std::string& target : targets) {
+    iter->Seek(target);
+    auto expected = std::lower_bound(keys.begin(), keys.end(), target);
+    if (expected == keys.end()) {
+      ASSERT_TRUE(!iter->Valid());
+    } else {
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(*expected, iter->key().ToString());
+    }
+  }
+  ASSERT_OK(iter->status());
+  delete iter;
+}
+
+TEST(Harness, HashIndexInternalKeys) {
+  // Several versions per user key, some straddling restart points, so the
+  // index has both usable buckets and collisions.
+  InternalKeyComparator cmp(BytewiseComparator());
+  Options options;
+  options.comparator = &cmp;
+  options.block_restart_interval = 4;
+  std::vector<std::string> keys;
+  for (int i = 0; i < 30; i++) {
+    char user_key[20];
+    snprintf(user_key, sizeof(user_key), "key%03d", i * 2);
+    for (int v = 0; v < 1 + i % 3; v++) {
+      keys.push_back(
+          InternalKey(user_key, 100 - v * 10, kTypeValue).Encode().ToString());
+    }
+  }
+
+  std::string contents[2];
+  for (int hash = 0; hash < 2; hash++) {
+    options.block_hash_index = hash;
+    BlockBuilder builder(&options);
+    for (size_t i = 0; i < keys.size(); i++) {
+      builder.Add(keys[i], "v" + std::to_string(i));
+    }
+    contents[hash] = builder.Finish().ToString();
+  }
+  ASSERT_GT(contents[1].size(), contents[0].size());
+
+  BlockContents block_contents;
+  block_contents.data = contents[1];
+  block_contents.cachable = false;
+  block_contents.heap_allocated = false;
+  Block block(block_contents);
+  Iterator* iter = block.NewIterator(&cmp);
+  for (int i = -1; i <= 60; i++) {
+    char user_key[20];
+    snprintf(user_key, sizeof(user_key), "key%03d", i);
+    for (SequenceNumber seq = 75; seq <= 105; seq += 5) {
+      const std::string target =
+          InternalKey(user_key, seq, kValueTypeForSeek).Encode().ToString();
+      iter->Seek(target);
+      std::string expected;
+      for (size_t k = 0; k < keys.size(); k++) {
+        if (cmp.Compare(keys[k], target) >= 0) {
+          expected = keys[k];
+          break;
+        }
+      }
+      if (expected.empty()) {
+        ASSERT_TRUE(!iter->Valid());
+      } else {
+        ASSERT_TRUE(iter->Valid());
+        ASSERT_EQ(expected, iter->key().ToString());
+      }
+    }
+  }
+  ASSERT_OK(iter->status());
+  delete iter;
+}
+
 class MemTableTest {};
 
 TEST(MemTableTest, Simple) {
@@ -788,15 +951,24 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612000));
 }
 
-static bool SnappyCompressionSupported() {
+static bool CompressionSupported(CompressionType type) {
   std::string out;
   Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
-  return port::Snappy_Compress(in.data(), in.size(), &out);
+  switch (type) {
+    case kSnappyCompression:
+      return port::Snappy_Compress(in.data(), in.size(), &out);
+    case kZstdCompression:
+      return port::Zstd_Compress(1, in.data(), in.size(), &out);
+    case kLZ4Compression:
+      return port::Lz4_Compress(in.data(), in.size(), &out);
+    default:
+      return true;
+  }
 }
 
-TEST(TableTest, ApproximateOffsetOfCompressed) {
-  if (!SnappyCompressionSupported()) {
-    fprintf(stderr, "skipping compression tests\n");
+static void TestApproximateOffsetOfCompressed(CompressionType type) {
+  if (!CompressionSupported(type)) {
+    fprintf(stderr, "skipping compression tests for type %d\n", type);
     return;
   }
 
@@ -811,7 +983,7 @@ TEST(TableTest, ApproximateOffsetOfCompressed) {
   KVMap kvmap;
   Options options;
   options.block_size = 1024;
-  options.compression = kSnappyCompression;
+  options.compression = type;
   c.Finish(options, &keys, &kvmap);
 
   // Expected upper and lower bounds of space used by compressible strings.
@@ -828,6 +1000,212 @@ TEST(TableTest, ApproximateOffsetOfCompressed) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("k04"), min_z, max_z));
   // Have now emitted two large compressible strings, so adjust expected offset.
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 2 * min_z, 2 * max_z));
+
+  // The compressed blocks must read back.
+  Iterator* iter = c.NewIterator();
+  iter->Seek("k04");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ(tmp, iter->value().ToString());
+  ASSERT_OK(iter->status());
+  delete iter;
+}
+
+TEST(TableTest, ApproximateOffsetOfCompressed) {
+  TestApproximateOffsetOfCompressed(kSnappyCompression);
+}
+
+TEST(TableTest, ApproximateOffsetOfZstdCompressed) {
+  TestApproximateOffsetOfCompressed(kZstdCompression);
+}
+
+TEST(TableTest, ApproximateOffsetOfLZ4Compressed) {
+  TestApproximateOffsetOfCompressed(kLZ4Compression);
+}
+
+// Builds a table of compressible records with "options" into *contents.
+static void BuildCompressibleTable(const Options& options,
+                                   std::string* contents) {
+  Random rnd(301);
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  std::string value;
+  for (int i = 0; i < 2000; i++) {
+    snprintf(key, sizeof(key), "k%06d", i);
+    test::CompressibleString(&rnd, 0.5, 200, &value);
+    builder.Add(key, value);
+  }
+  ASSERT_OK(builder.Finish());
+  ASSERT_EQ(sink.contents().size(), builder.FileSize());
+  *contents = sink.contents();
+}
+
+TEST(TableTest, ParallelCompression) {
+  const FilterPolicy* filter_policy = NewBloomFilterPolicy(10);
+  const CompressionType types[] = {kSnappyCompression, kZstdCompression,
+                                   kLZ4Compression};
+  for (CompressionType type : types) {
+    for (int train = 0; train < 2; train++) {
+      Options options;
+      options.block_size = 1024;
+      options.compression = type;
+      options.filter_policy = filter_policy;
+      options.zstd_max_train_bytes = train ? 64 << 10 : 0;
+      std::string expected;
+      BuildCompressibleTable(options, &expected);
+
+      // Compressing on other threads must produce the very same table.
+      for (int threads = 2; threads <= 8; threads *= 2) {
+        options.parallel_compression_threads = threads;
+        std::string actual;
+        BuildCompressibleTable(options, &actual);
+        ASSERT_EQ(expected.size(), actual.size());
+        ASSERT_TRUE(expected == actual);
+      }
+    }
+  }
+  delete filter_policy;
+}
+
+TEST(TableTest, ParallelCompressionAbandon) {
+  Options options;
+  options.block_size = 1024;
+  options.compression = kSnappyCompression;
+  options.parallel_compression_threads = 4;
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, std::string(100, 'a' + i % 26));
+  }
+  // The destructor must wait for the blocks still being compressed.
+  builder.Abandon();
+}
+
+// Counts the reads issued against a StringSource.
+class CountingSource : public StringSource {
+ public:
+  CountingSource(const Slice& contents) : StringSource(contents), reads_(0) {}
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    reads_++;
+    return StringSource::Read(offset, n, result, scratch);
+  }
+
+  int reads() const { return reads_; }
+  void ResetReads() { reads_ = 0; }
+
+ private:
+  mutable int reads_;
+};
+
+TEST(TableTest, ReadaheadScan) {
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, std::string(100, 'v'));
+  }
+  ASSERT_OK(builder.Finish());
+
+  CountingSource source(sink.contents());
+  Table* table;
+  ASSERT_OK(Table::Open(options, &source, source.Size(), &table));
+
+  int counts[2];
+  for (int readahead = 0; readahead < 2; readahead++) {
+    ReadOptions read_options;
+    read_options.fill_cache = false;
+    read_options.readahead_size = readahead ? 64 << 10 : 0;
+    source.ResetReads();
+    Iterator* iter = table->NewIterator(read_options);
+    int n = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      snprintf(key, sizeof(key), "k%06d", n++);
+      ASSERT_EQ(key, iter->key().ToString());
+      ASSERT_EQ(100, iter->value().size());
+    }
+    ASSERT_OK(iter->status());
+    ASSERT_EQ(1000, n);
+
+    // Reading backwards hits blocks out of buffer order.
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+      n--;
+    }
+    ASSERT_OK(iter->status());
+    ASSERT_EQ(0, n);
+    delete iter;
+    counts[readahead] = source.reads();
+  }
+  // The table is ~100KB of data blocks: two 64KB chunks per pass instead of
+  // a read per block.
+  ASSERT_LT(counts[1] * 10, counts[0]);
+  delete table;
+}
+
+TEST(TableTest, InPlaceReads) {
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, std::string(100, 'v'));
+  }
+  ASSERT_OK(builder.Finish());
+
+  // Blocks of a file that reads in place are used without being copied
+  // or cached; blocks of other files are cached.
+  for (int in_place = 0; in_place < 2; in_place++) {
+    Cache* cache = NewLRUCache(1 << 20);
+    options.block_cache = cache;
+    RandomAccessFile* source;
+    InPlaceSource* in_place_source = nullptr;
+    if (in_place) {
+      source = in_place_source = new InPlaceSource(sink.contents());
+    } else {
+      source = new StringSource(sink.contents());
+    }
+    Table* table;
+    ASSERT_OK(Table::Open(options, source, sink.contents().size(), &table));
+
+    for (int readahead = 0; readahead < 2; readahead++) {
+      ReadOptions read_options;
+      read_options.verify_checksums = true;
+      read_options.readahead_size = readahead ? 16 << 10 : 0;
+      Iterator* iter = table->NewIterator(read_options);
+      int n = 0;
+      for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        snprintf(key, sizeof(key), "k%06d", n++);
+        ASSERT_EQ(key, iter->key().ToString());
+        ASSERT_EQ(std::string(100, 'v'), iter->value().ToString());
+        if (in_place) {
+          const std::string& contents = in_place_source->contents();
+          ASSERT_TRUE(iter->value().data() >= contents.data() &&
+                      iter->value().data() < contents.data() + contents.size());
+        }
+      }
+      ASSERT_OK(iter->status());
+      ASSERT_EQ(1000, n);
+      delete iter;
+    }
+    if (in_place) {
+      ASSERT_EQ(0, cache->TotalCharge());
+    } else {
+      ASSERT_GT(cache->TotalCharge(), 100000);
+    }
+    delete table;
+    delete source;
+    delete cache;
+  }
 }
 
 }  // namespace leveldb
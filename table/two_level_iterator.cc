@@ -4,6 +4,7 @@
 
 #include "table/two_level_iterator.h"
 
+#include "leveldb/comparator.h"
 #include "leveldb/table.h"
 #include "table/block.h"
 #include "table/format.h"
@@ -14,11 +15,14 @@ namespace leveldb {
 namespace {
 
 typedef Iterator* (*BlockFunction)(void*, const ReadOptions&, const Slice&);
+typedef bool (*PrefixFunction)(void*, const Slice&, const Slice&);
 
 class TwoLevelIterator : public Iterator {
  public:
   TwoLevelIterator(Iterator* index_iter, BlockFunction block_function,
-                   void* arg, const ReadOptions& options);
+                   void* arg, const ReadOptions& options,
+                   const Comparator* comparator,
+                   PrefixFunction prefix_function);
 
   ~TwoLevelIterator() override;
 
@@ -56,8 +60,24 @@ class TwoLevelIterator : public Iterator {
   void SkipEmptyDataBlocksBackward();
   void SetDataIterator(Iterator* data_iter);
   void InitDataBlock();
+  bool PrefixMayMatch();
+
+  // Returns true if the blocks after, respectively before, the one at
+  // index_iter_ are entirely outside the bounds of options_.
+  bool LastBlockBeforeUpperBound() const {
+    return comparator_ != nullptr && options_.iterate_upper_bound != nullptr &&
+           comparator_->Compare(index_iter_.key(),
+                                *options_.iterate_upper_bound) >= 0;
+  }
+  bool FirstBlockAfterLowerBound() const {
+    return comparator_ != nullptr && options_.iterate_lower_bound != nullptr &&
+           comparator_->Compare(index_iter_.key(),
+                                *options_.iterate_lower_bound) < 0;
+  }
 
   BlockFunction block_function_;
+  const Comparator* const comparator_;  // Null unless bounds are checked
+  PrefixFunction prefix_function_;  // Null unless prefix_same_as_start
   void* arg_;
   const ReadOptions options_;
   Status status_;
@@ -66,12 +86,19 @@ class TwoLevelIterator : public Iterator {
   // If data_iter_ is non-null, then "data_block_handle_" holds the
   // "index_value" passed to block_function_ to create the data_iter_.
   std::string data_block_handle_;
+  // Target of the last Seek() while its prefix bounds the iteration.
+  std::string prefix_target_;
 };
 
 TwoLevelIterator::TwoLevelIterator(Iterator* index_iter,
                                    BlockFunction block_function, void* arg,
-                                   const ReadOptions& options)
+                                   const ReadOptions& options,
+                                   const Comparator* comparator,
+                                   PrefixFunction prefix_function)
     : block_function_(block_function),
+      comparator_(comparator),
+      prefix_function_(options.prefix_same_as_start ? prefix_function
+                                                    : nullptr),
       arg_(arg),
       options_(options),
       index_iter_(index_iter),
@@ -81,22 +108,59 @@ TwoLevelIterator::~TwoLevelIterator() = default;
 
 void TwoLevelIterator::Seek(const Slice& target) {
   index_iter_.Seek(target);
+  if (prefix_function_ != nullptr) {
+    prefix_target_.assign(target.data(), target.size());
+    if (!PrefixMayMatch()) {
+      SetDataIterator(nullptr);
+      return;
+    }
+  }
   InitDataBlock();
   if (data_iter_.iter() != nullptr) data_iter_.Seek(target);
   SkipEmptyDataBlocksForward();
 }
 
 void TwoLevelIterator::SeekToFirst() {
-  index_iter_.SeekToFirst();
-  InitDataBlock();
-  if (data_iter_.iter() != nullptr) data_iter_.SeekToFirst();
+  prefix_target_.clear();
+  if (comparator_ != nullptr && options_.iterate_lower_bound != nullptr) {
+    const Slice lower_bound = *options_.iterate_lower_bound;
+    index_iter_.Seek(lower_bound);
+    InitDataBlock();
+    if (data_iter_.iter() != nullptr) data_iter_.Seek(lower_bound);
+  } else {
+    index_iter_.SeekToFirst();
+    InitDataBlock();
+    if (data_iter_.iter() != nullptr) data_iter_.SeekToFirst();
+  }
   SkipEmptyDataBlocksForward();
 }
 
 void TwoLevelIterator::SeekToLast() {
-  index_iter_.SeekToLast();
-  InitDataBlock();
-  if (data_iter_.iter() != nullptr) data_iter_.SeekToLast();
+  prefix_target_.clear();
+  if (comparator_ != nullptr && options_.iterate_upper_bound != nullptr) {
+    // Position at the last entry before the bound, so that the iterator
+    // stays consistent with Seek() stopping at it.
+    const Slice upper_bound = *options_.iterate_upper_bound;
+    index_iter_.Seek(upper_bound);
+    if (!index_iter_.Valid()) {
+      index_iter_.SeekToLast();
+    }
+    InitDataBlock();
+    if (data_iter_.iter() != nullptr) {
+      // Blocks that are themselves two-level iterators with these bounds
+      // already stop before the bound.
+      data_iter_.SeekToLast();
+      if (data_iter_.Valid() &&
+          comparator_->Compare(data_iter_.key(), upper_bound) >= 0) {
+        data_iter_.Seek(upper_bound);
+        data_iter_.Prev();
+      }
+    }
+  } else {
+    index_iter_.SeekToLast();
+    InitDataBlock();
+    if (data_iter_.iter() != nullptr) data_iter_.SeekToLast();
+  }
   SkipEmptyDataBlocksBackward();
 }
 
@@ -108,6 +172,7 @@ void TwoLevelIterator::Next() {
 
 void TwoLevelIterator::Prev() {
   assert(Valid());
+  prefix_target_.clear();
   data_iter_.Prev();
   SkipEmptyDataBlocksBackward();
 }
@@ -115,11 +180,15 @@ void TwoLevelIterator::Prev() {
 void TwoLevelIterator::SkipEmptyDataBlocksForward() {
   while (data_iter_.iter() == nullptr || !data_iter_.Valid()) {
     // Move to next block
-    if (!index_iter_.Valid()) {
+    if (!index_iter_.Valid() || LastBlockBeforeUpperBound()) {
       SetDataIterator(nullptr);
       return;
     }
     index_iter_.Next();
+    if (!PrefixMayMatch()) {
+      SetDataIterator(nullptr);
+      return;
+    }
     InitDataBlock();
     if (data_iter_.iter() != nullptr) data_iter_.SeekToFirst();
   }
@@ -133,11 +202,24 @@ void TwoLevelIterator::SkipEmptyDataBlocksBackward() {
       return;
     }
     index_iter_.Prev();
+    if (index_iter_.Valid() && FirstBlockAfterLowerBound()) {
+      SetDataIterator(nullptr);
+      return;
+    }
     InitDataBlock();
     if (data_iter_.iter() != nullptr) data_iter_.SeekToLast();
   }
 }
 
+// Returns false if the block at index_iter_ holds no key with the prefix
+// of prefix_target_, in which case neither do the blocks after it.
+bool TwoLevelIterator::PrefixMayMatch() {
+  if (prefix_target_.empty() || !index_iter_.Valid()) {
+    return true;
+  }
+  return (*prefix_function_)(arg_, index_iter_.value(), prefix_target_);
+}
+
 void TwoLevelIterator::SetDataIterator(Iterator* data_iter) {
   if (data_iter_.iter() != nullptr) SaveError(data_iter_.status());
   data_iter_.Set(data_iter);
@@ -164,8 +246,11 @@ void TwoLevelIterator::InitDataBlock() {
 
 Iterator* NewTwoLevelIterator(Iterator* index_iter,
                               BlockFunction block_function, void* arg,
-                              const ReadOptions& options) {
-  return new TwoLevelIterator(index_iter, block_function, arg, options);
+                              const ReadOptions& options,
+                              const Comparator* comparator,
+                              PrefixFunction prefix_function) {
+  return new TwoLevelIterator(index_iter, block_function, arg, options,
+                              comparator, prefix_function);
 }
 
 }  // namespace leveldb
@@ -9,6 +9,7 @@
 
 namespace leveldb {
 
+class Comparator;
 struct ReadOptions;
 
 // Return a new two level iterator.  A two-level iterator contains an
@@ -20,11 +21,26 @@ struct ReadOptions;
 //
 // Uses a supplied function to convert an index_iter value into
 // an iterator over the contents of the corresponding block.
+//
+// If "comparator" is non-null, the bounds of "options", which must then be
+// in the format of the index keys, keep the iterator from moving into the
+// blocks entirely outside them.  The caller must stop at the bounds
+// within a block.
+//
+// If "prefix_function" is non-null and options.prefix_same_as_start is
+// set, Seek(target) consults it before reading a block, and a block for
+// which it returns false ends the iteration: it must only do so if the
+// block holds no key with the prefix of "target".  The iterator relies on
+// keys with a common prefix being adjacent, and on the caller to stop at
+// the end of the prefix otherwise.
 Iterator* NewTwoLevelIterator(
     Iterator* index_iter,
     Iterator* (*block_function)(void* arg, const ReadOptions& options,
                                 const Slice& index_value),
-    void* arg, const ReadOptions& options);
+    void* arg, const ReadOptions& options,
+    const Comparator* comparator = nullptr,
+    bool (*prefix_function)(void* arg, const Slice& index_value,
+                            const Slice& target) = nullptr);
 
 }  // namespace leveldb
 
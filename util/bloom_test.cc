@@ -21,6 +21,7 @@ static Slice Key(int i, char* buffer) {
 class BloomTest {
  public:
   BloomTest() : policy_(NewBloomFilterPolicy(10)) {}
+  explicit BloomTest(const FilterPolicy* policy) : policy_(policy) {}
 
   ~BloomTest() { delete policy_; }
 
@@ -149,6 +150,68 @@ TEST(BloomTest, VaryingLengths) {
   ASSERT_LE(mediocre_filters, good_filters / 5);
 }
 
+class BlockedBloomTest : public BloomTest {
+ public:
+  BlockedBloomTest() : BloomTest(NewBlockedBloomFilterPolicy(10)) {}
+};
+
+TEST(BlockedBloomTest, BlockedEmptyFilter) {
+  ASSERT_TRUE(!Matches("hello"));
+  ASSERT_TRUE(!Matches("world"));
+}
+
+TEST(BlockedBloomTest, BlockedSmall) {
+  Add("hello");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("x"));
+  ASSERT_TRUE(!Matches("foo"));
+}
+
+TEST(BlockedBloomTest, BlockedVaryingLengths) {
+  char buffer[sizeof(int)];
+
+  // Count number of filters that significantly exceed the false positive rate
+  int mediocre_filters = 0;
+  int good_filters = 0;
+
+  for (int length = 1; length <= 10000; length = NextLength(length)) {
+    Reset();
+    for (int i = 0; i < length; i++) {
+      Add(Key(i, buffer));
+    }
+    Build();
+
+    // Filters are rounded up to whole cache lines.
+    ASSERT_LE(FilterSize(), static_cast<size_t>((length * 10 / 8) + 65))
+        << length;
+
+    // All added keys must match
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(Matches(Key(i, buffer)))
+          << "Length " << length << "; key " << i;
+    }
+
+    // Check false positive rate
+    double rate = FalsePositiveRate();
+    if (kVerbose >= 1) {
+      fprintf(stderr, "False positives: %5.2f%% @ length = %6d ; bytes = %6d\n",
+              rate * 100.0, length, static_cast<int>(FilterSize()));
+    }
+    ASSERT_LE(rate, 0.02);  // Must not be over 2%
+    if (rate > 0.0125)
+      mediocre_filters++;  // Allowed, but not too often
+    else
+      good_filters++;
+  }
+  if (kVerbose >= 1) {
+    fprintf(stderr, "Filters: %d good, %d mediocre\n", good_filters,
+            mediocre_filters);
+  }
+  ASSERT_LE(mediocre_filters, good_filters / 5);
+}
+
 // Different bits-per-byte
 
 }  // namespace leveldb
@@ -0,0 +1,47 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/compaction_filter.h"
+
+#include "leveldb/env.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+CompactionFilter::~CompactionFilter() {}
+
+namespace {
+
+class TTLCompactionFilter : public CompactionFilter {
+ public:
+  TTLCompactionFilter(Env* env, uint32_t ttl_seconds)
+      : env_(env), ttl_seconds_(ttl_seconds) {}
+
+  const char* Name() const override { return "leveldb.TTLCompactionFilter"; }
+
+  bool Filter(int level, const Slice& key, const Slice& existing_value,
+              std::string* new_value, bool* value_changed) const override {
+    if (existing_value.size() < 4) {
+      return false;
+    }
+    const uint64_t written =
+        DecodeFixed32(existing_value.data() + existing_value.size() - 4);
+    const uint64_t now = env_->NowMicros() / 1000000;
+    return written + ttl_seconds_ < now;
+  }
+
+ private:
+  Env* const env_;
+  const uint64_t ttl_seconds_;
+};
+
+}  // namespace
+
+const CompactionFilter* NewTTLCompactionFilter(Env* env,
+                                               uint32_t ttl_seconds) {
+  return new TTLCompactionFilter(env, ttl_seconds);
+}
+
+}  // namespace leveldb
@@ -17,6 +17,14 @@ namespace leveldb {
 
 Comparator::~Comparator() = default;
 
+bool Comparator::OrderedPrefix(const Slice& key, uint64_t* prefix) const {
+  return false;
+}
+
+bool Comparator::HashIndexKey(const Slice& key, Slice* result) const {
+  return false;
+}
+
 namespace {
 class BytewiseComparatorImpl : public Comparator {
  public:
@@ -64,6 +72,27 @@ class BytewiseComparatorImpl : public Comparator {
     }
     // *key is a run of 0xffs.  Leave it alone.
   }
+
+  // The first eight bytes of the key, zero-padded, as a big-endian integer.
+  // Zero padding keeps the mapping monotonic: a key that is a proper
+  // prefix of another maps to a value no larger than the longer key's.
+  bool OrderedPrefix(const Slice& key, uint64_t* prefix) const override {
+    const size_t n = std::min<size_t>(key.size(), 8);
+    uint64_t result = 0;
+    for (size_t i = 0; i < 8; i++) {
+      result <<= 8;
+      if (i < n) {
+        result |= static_cast<uint8_t>(key[i]);
+      }
+    }
+    *prefix = result;
+    return true;
+  }
+
+  bool HashIndexKey(const Slice& key, Slice* result) const override {
+    *result = key;
+    return true;
+  }
 };
 }  // namespace
 
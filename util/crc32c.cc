@@ -2,16 +2,31 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 //
-// A portable implementation of crc32c.
+// A portable implementation of crc32c, plus implementations that use the
+// CRC32C instructions of SSE4.2 (x86-64) and ARMv8, picked at runtime.
 
 #include "util/crc32c.h"
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "port/port.h"
 #include "util/coding.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LEVELDB_HAVE_SSE42_CRC32C 1
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__linux__) || defined(__APPLE__))
+#define LEVELDB_HAVE_ARM64_CRC32C 1
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif  // defined(__linux__)
+#endif
+
 namespace leveldb {
 namespace crc32c {
 
@@ -260,6 +275,187 @@ constexpr inline const uint8_t* RoundUp(const uint8_t* pointer) {
       ~static_cast<uintptr_t>(N - 1));
 }
 
+#if defined(LEVELDB_HAVE_SSE42_CRC32C) || defined(LEVELDB_HAVE_ARM64_CRC32C)
+
+// The hardware implementations below run three independent CRCs over
+// adjacent stripes of kLongStripe (then kShortStripe) bytes, hiding the
+// latency of the CRC instruction, and then combine them.  Combining needs
+// the CRC of a stripe followed by a stripe's worth of zeros, which is a
+// linear function of the stripe's CRC computed with the tables below.
+// See Mark Adler's crc32c.c (https://stackoverflow.com/a/17646775).
+static const size_t kLongStripe = 8192;
+static const size_t kShortStripe = 256;
+
+// The reflected CRC32C polynomial.
+static const uint32_t kCRC32CPoly = 0x82f63b78;
+
+// Multiplies the 32x32 matrix "mat" over GF(2) by "vec".
+uint32_t GF2MatrixTimes(const uint32_t* mat, uint32_t vec) {
+  uint32_t sum = 0;
+  while (vec != 0) {
+    if (vec & 1) sum ^= *mat;
+    vec >>= 1;
+    mat++;
+  }
+  return sum;
+}
+
+void GF2MatrixSquare(uint32_t* square, const uint32_t* mat) {
+  for (int n = 0; n < 32; n++) {
+    square[n] = GF2MatrixTimes(mat, mat[n]);
+  }
+}
+
+// Stores in *even the operator that appends "len" zero bytes to a CRC.
+// "len" must be a power of two.
+void ZerosOperator(uint32_t* even, size_t len) {
+  uint32_t odd[32];
+  odd[0] = kCRC32CPoly;  // Operator for one zero bit
+  uint32_t row = 1;
+  for (int n = 1; n < 32; n++) {
+    odd[n] = row;
+    row <<= 1;
+  }
+  GF2MatrixSquare(even, odd);  // Two zero bits
+  GF2MatrixSquare(odd, even);  // Four zero bits
+  // Each square doubles the number of zeros, starting at one byte.
+  do {
+    GF2MatrixSquare(even, odd);
+    len >>= 1;
+    if (len == 0) return;
+    GF2MatrixSquare(odd, even);
+    len >>= 1;
+  } while (len != 0);
+  memcpy(even, odd, sizeof(odd));
+}
+
+// Byte-wise tables for the operator that appends a stripe of zeros.
+struct ZerosTable {
+  explicit ZerosTable(size_t len) {
+    uint32_t op[32];
+    ZerosOperator(op, len);
+    for (uint32_t n = 0; n < 256; n++) {
+      table[0][n] = GF2MatrixTimes(op, n);
+      table[1][n] = GF2MatrixTimes(op, n << 8);
+      table[2][n] = GF2MatrixTimes(op, n << 16);
+      table[3][n] = GF2MatrixTimes(op, n << 24);
+    }
+  }
+
+  uint32_t Shift(uint32_t crc) const {
+    return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^
+           table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+  }
+
+  uint32_t table[4][256];
+};
+
+const ZerosTable& LongZeros() {
+  static const ZerosTable table(kLongStripe);
+  return table;
+}
+
+const ZerosTable& ShortZeros() {
+  static const ZerosTable table(kShortStripe);
+  return table;
+}
+
+inline uint64_t ReadUint64(const uint8_t* p) {
+  uint64_t result;
+  memcpy(&result, p, sizeof(result));
+  return result;
+}
+
+#endif  // defined(LEVELDB_HAVE_SSE42_CRC32C) || defined(LEVELDB_HAVE_ARM64_CRC32C)
+
+// Defines ExtendWith<Name>(), which computes the CRC with the 8-byte and
+// 1-byte CRC32C instructions CRC64 and CRC8, in a function compiled for
+// TARGET.
+#define LEVELDB_DEFINE_HARDWARE_EXTEND(Name, TARGET, CRC64, CRC8)              \
+  __attribute__((target(TARGET))) uint32_t ExtendWith##Name(                   \
+      uint32_t crc, const char* data, size_t n) {                              \
+    const ZerosTable& long_zeros = LongZeros();                                \
+    const ZerosTable& short_zeros = ShortZeros();                              \
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);                 \
+    uint64_t crc0 = crc ^ kCRC32Xor;                                           \
+                                                                               \
+    /* Align p to 8 bytes. */                                                  \
+    while (n > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {               \
+      crc0 = CRC8(static_cast<uint32_t>(crc0), *p++);                          \
+      n--;                                                                     \
+    }                                                                          \
+                                                                               \
+    while (n >= 3 * kLongStripe) {                                             \
+      uint64_t crc1 = 0;                                                       \
+      uint64_t crc2 = 0;                                                       \
+      const uint8_t* end = p + kLongStripe;                                    \
+      do {                                                                     \
+        crc0 = CRC64(crc0, ReadUint64(p));                                     \
+        crc1 = CRC64(crc1, ReadUint64(p + kLongStripe));                       \
+        crc2 = CRC64(crc2, ReadUint64(p + 2 * kLongStripe));                   \
+        p += 8;                                                                \
+      } while (p < end);                                                       \
+      crc0 = long_zeros.Shift(static_cast<uint32_t>(crc0)) ^ crc1;             \
+      crc0 = long_zeros.Shift(static_cast<uint32_t>(crc0)) ^ crc2;             \
+      p += 2 * kLongStripe;                                                    \
+      n -= 3 * kLongStripe;                                                    \
+    }                                                                          \
+                                                                               \
+    while (n >= 3 * kShortStripe) {                                            \
+      uint64_t crc1 = 0;                                                       \
+      uint64_t crc2 = 0;                                                       \
+      const uint8_t* end = p + kShortStripe;                                   \
+      do {                                                                     \
+        crc0 = CRC64(crc0, ReadUint64(p));                                     \
+        crc1 = CRC64(crc1, ReadUint64(p + kShortStripe));                      \
+        crc2 = CRC64(crc2, ReadUint64(p + 2 * kShortStripe));                  \
+        p += 8;                                                                \
+      } while (p < end);                                                       \
+      crc0 = short_zeros.Shift(static_cast<uint32_t>(crc0)) ^ crc1;            \
+      crc0 = short_zeros.Shift(static_cast<uint32_t>(crc0)) ^ crc2;            \
+      p += 2 * kShortStripe;                                                   \
+      n -= 3 * kShortStripe;                                                   \
+    }                                                                          \
+                                                                               \
+    while (n >= 8) {                                                           \
+      crc0 = CRC64(crc0, ReadUint64(p));                                       \
+      p += 8;                                                                  \
+      n -= 8;                                                                  \
+    }                                                                          \
+    while (n > 0) {                                                            \
+      crc0 = CRC8(static_cast<uint32_t>(crc0), *p++);                          \
+      n--;                                                                     \
+    }                                                                          \
+    return static_cast<uint32_t>(crc0) ^ kCRC32Xor;                            \
+  }
+
+#if defined(LEVELDB_HAVE_SSE42_CRC32C)
+LEVELDB_DEFINE_HARDWARE_EXTEND(SSE42, "sse4.2", _mm_crc32_u64, _mm_crc32_u8)
+
+bool CanUseSSE42() { return __builtin_cpu_supports("sse4.2"); }
+#endif  // defined(LEVELDB_HAVE_SSE42_CRC32C)
+
+#if defined(LEVELDB_HAVE_ARM64_CRC32C)
+#if defined(__clang__)
+#define LEVELDB_ARM64_CRC_TARGET "crc"
+#else
+#define LEVELDB_ARM64_CRC_TARGET "+crc"
+#endif
+LEVELDB_DEFINE_HARDWARE_EXTEND(ARM64, LEVELDB_ARM64_CRC_TARGET, __crc32cd,
+                               __crc32cb)
+#undef LEVELDB_ARM64_CRC_TARGET
+
+bool CanUseARM64() {
+#if defined(__linux__)
+  return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+  return true;  // Every Apple ARM64 CPU has the CRC32 instructions.
+#endif  // defined(__linux__)
+}
+#endif  // defined(LEVELDB_HAVE_ARM64_CRC32C)
+
+#undef LEVELDB_DEFINE_HARDWARE_EXTEND
+
 }  // namespace
 
 // Determine if the CPU running this program can accelerate the CRC32C
@@ -273,12 +469,36 @@ static bool CanAccelerateCRC32C() {
   return port::AcceleratedCRC32C(0, kTestCRCBuffer, kBufSize) == kTestCRCValue;
 }
 
-uint32_t Extend(uint32_t crc, const char* data, size_t n) {
-  static bool accelerate = CanAccelerateCRC32C();
-  if (accelerate) {
-    return port::AcceleratedCRC32C(crc, data, n);
+static uint32_t ExtendWithPort(uint32_t crc, const char* data, size_t n) {
+  return port::AcceleratedCRC32C(crc, data, n);
+}
+
+typedef uint32_t (*ExtendFunction)(uint32_t, const char*, size_t);
+
+// Picks the fastest implementation available on this CPU.
+static ExtendFunction ChooseExtend() {
+  if (CanAccelerateCRC32C()) {
+    return &ExtendWithPort;
+  }
+#if defined(LEVELDB_HAVE_SSE42_CRC32C)
+  if (CanUseSSE42()) {
+    return &ExtendWithSSE42;
   }
+#endif  // defined(LEVELDB_HAVE_SSE42_CRC32C)
+#if defined(LEVELDB_HAVE_ARM64_CRC32C)
+  if (CanUseARM64()) {
+    return &ExtendWithARM64;
+  }
+#endif  // defined(LEVELDB_HAVE_ARM64_CRC32C)
+  return &ExtendPortable;
+}
+
+uint32_t Extend(uint32_t crc, const char* data, size_t n) {
+  static const ExtendFunction extend = ChooseExtend();
+  return extend(crc, data, n);
+}
 
+uint32_t ExtendPortable(uint32_t crc, const char* data, size_t n) {
   const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
   const uint8_t* e = p + n;
   uint32_t l = crc ^ kCRC32Xor;
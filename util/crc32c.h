@@ -19,6 +19,11 @@ uint32_t Extend(uint32_t init_crc, const char* data, size_t n);
 // Return the crc32c of data[0,n-1]
 inline uint32_t Value(const char* data, size_t n) { return Extend(0, data, n); }
 
+// Same as Extend(), but never uses CRC32C instructions.  Extend() picks a
+// hardware implementation at runtime when the CPU has one; this is exposed
+// for tests and benchmarks.
+uint32_t ExtendPortable(uint32_t init_crc, const char* data, size_t n);
+
 static const uint32_t kMaskDelta = 0xa282ead8ul;
 
 // Return a masked representation of crc.
@@ -3,6 +3,10 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "util/crc32c.h"
+
+#include <string>
+
+#include "util/random.h"
 #include "util/testharness.h"
 
 namespace leveldb {
@@ -45,6 +49,23 @@ TEST(CRC, Extend) {
   ASSERT_EQ(Value("hello world", 11), Extend(Value("hello ", 6), "world", 5));
 }
 
+TEST(CRC, MatchesPortable) {
+  // Cover every alignment and the tails of the interleaved stripes.
+  Random rnd(301);
+  std::string data(3 * 3 * 8192 + 100, '\0');
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<char>(rnd.Uniform(256));
+  }
+  for (size_t offset = 0; offset < 8; offset++) {
+    for (size_t n = 0; n + offset <= data.size();
+         n = (n < 1024) ? n + 1 : n * 3 / 2 + 7) {
+      const char* p = data.data() + offset;
+      ASSERT_EQ(ExtendPortable(0, p, n), Value(p, n)) << offset << " " << n;
+      ASSERT_EQ(ExtendPortable(0x12345678, p, n), Extend(0x12345678, p, n));
+    }
+  }
+}
+
 TEST(CRC, Mask) {
   uint32_t crc = Value("foo", 3);
   ASSERT_NE(crc, Mask(crc));
@@ -4,20 +4,120 @@
 
 #include "leveldb/env.h"
 
+#include <queue>
+#include <thread>
+
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+#include "util/no_destructor.h"
+
 namespace leveldb {
 
+namespace {
+
+// The threads behind the default Env::ScheduleParallel().  They are shared
+// by every Env in the process and never exit.
+class ParallelWorkPool {
+ public:
+  ParallelWorkPool() : work_cv_(&mu_), num_threads_(0) {}
+
+  ParallelWorkPool(const ParallelWorkPool&) = delete;
+  ParallelWorkPool& operator=(const ParallelWorkPool&) = delete;
+
+  void Schedule(void (*function)(void*), void* arg, int num_threads) {
+    MutexLock l(&mu_);
+    while (num_threads_ < num_threads) {
+      num_threads_++;
+      std::thread worker(&ParallelWorkPool::WorkerMain, this);
+      worker.detach();
+    }
+    work_queue_.emplace(function, arg);
+    work_cv_.Signal();
+  }
+
+ private:
+  struct WorkItem {
+    explicit WorkItem(void (*function)(void*), void* arg)
+        : function(function), arg(arg) {}
+
+    void (*const function)(void*);
+    void* const arg;
+  };
+
+  void WorkerMain() {
+    while (true) {
+      mu_.Lock();
+      while (work_queue_.empty()) {
+        work_cv_.Wait();
+      }
+      auto function = work_queue_.front().function;
+      void* arg = work_queue_.front().arg;
+      work_queue_.pop();
+      mu_.Unlock();
+      function(arg);
+    }
+  }
+
+  port::Mutex mu_;
+  port::CondVar work_cv_ GUARDED_BY(mu_);
+  std::queue<WorkItem> work_queue_ GUARDED_BY(mu_);
+  int num_threads_ GUARDED_BY(mu_);
+};
+
+}  // namespace
+
 Env::~Env() = default;
 
 Status Env::NewAppendableFile(const std::string& fname, WritableFile** result) {
   return Status::NotSupported("NewAppendableFile", fname);
 }
 
+void Env::ScheduleParallel(void (*function)(void*), void* arg,
+                           int num_threads) {
+  static NoDestructor<ParallelWorkPool> pool;
+  pool.get()->Schedule(function, arg, num_threads);
+}
+
+Status Env::NewDirectRandomAccessFile(const std::string& fname,
+                                      RandomAccessFile** result) {
+  return NewRandomAccessFile(fname, result);
+}
+
+Status Env::NewDirectWritableFile(const std::string& fname,
+                                  WritableFile** result) {
+  return NewWritableFile(fname, result);
+}
+
+Status Env::ReuseWritableFile(const std::string& fname,
+                              const std::string& old_fname,
+                              WritableFile** result) {
+  Status s = RenameFile(old_fname, fname);
+  if (!s.ok()) {
+    *result = nullptr;
+    return s;
+  }
+  return NewWritableFile(fname, result);
+}
+
 SequentialFile::~SequentialFile() = default;
 
 RandomAccessFile::~RandomAccessFile() = default;
 
+void RandomAccessFile::Prefetch(uint64_t offset, size_t n) const {}
+
+bool RandomAccessFile::ReadsInPlace() const { return false; }
+
 WritableFile::~WritableFile() = default;
 
+bool WritableFile::SupportsConcurrentSync() const { return false; }
+
+Status WritableFile::SyncFlushed() {
+  return Status::NotSupported("SyncFlushed");
+}
+
+void WritableFile::Preallocate(uint64_t size) {}
+
 Logger::~Logger() = default;
 
 FileLock::~FileLock() = default;
@@ -42,11 +42,16 @@ namespace {
 // Set by EnvPosixTestHelper::SetReadOnlyMMapLimit() and MaxOpenFiles().
 int g_open_read_only_file_limit = -1;
 
-// Up to 1000 mmap regions for 64-bit binaries; none for 32-bit.
+// Up to 1000 mmap regions for 64-bit binaries if the limits of the
+// process cannot be determined; none for 32-bit.
 constexpr const int kDefaultMmapLimit = (sizeof(void*) >= 8) ? 1000 : 0;
 
-// Can be set using EnvPosixTestHelper::SetReadOnlyMMapLimit.
-int g_mmap_limit = kDefaultMmapLimit;
+// Address space set aside for each mmap region when the address space of
+// the process is limited.  Generous, as table files may be large.
+constexpr const uint64_t kMmapRegionBudget = 64 << 20;
+
+// Set by EnvPosixTestHelper::SetReadOnlyMMapLimit() and MaxMmaps().
+int g_mmap_limit = -1;
 
 // Common flags defined for all posix open operations
 #if defined(HAVE_O_CLOEXEC)
@@ -57,6 +62,25 @@ constexpr const int kOpenBaseFlags = 0;
 
 constexpr const size_t kWritableFileBufferSize = 65536;
 
+// Flag that makes reads and writes bypass the page cache, or 0 if the
+// platform has none.
+#if defined(O_DIRECT)
+constexpr const int kOpenDirectFlag = O_DIRECT;
+#else
+constexpr const int kOpenDirectFlag = 0;
+#endif  // defined(O_DIRECT)
+
+// O_DIRECT transfers must start at file offsets and memory addresses that
+// are multiples of the device's logical block size, and cover a multiple of
+// it.  4096 bytes satisfies all common devices.
+constexpr const size_t kDirectIOAlignment = 4096;
+
+constexpr const size_t kDirectWritableFileBufferSize = 1 << 20;
+
+uint64_t RoundUpToDirectIOAlignment(uint64_t n) {
+  return (n + kDirectIOAlignment - 1) & ~uint64_t{kDirectIOAlignment - 1};
+}
+
 Status PosixError(const std::string& context, int error_number) {
   if (error_number == ENOENT) {
     return Status::NotFound(context, std::strerror(error_number));
@@ -65,6 +89,137 @@ Status PosixError(const std::string& context, int error_number) {
   }
 }
 
+// Ensures that all the caches associated with the given file descriptor's
+// data are flushed all the way to durable media, and can withstand power
+// failures.
+//
+// The path argument is only used to populate the description string in the
+// returned Status if an error occurs.
+Status SyncFd(int fd, const std::string& fd_path) {
+#if HAVE_FULLFSYNC
+  // On macOS and iOS, fsync() doesn't guarantee durability past power
+  // failures. fcntl(F_FULLFSYNC) is required for that purpose. Some
+  // filesystems don't support fcntl(F_FULLFSYNC), and require a fallback to
+  // fsync().
+  if (::fcntl(fd, F_FULLFSYNC) == 0) {
+    return Status::OK();
+  }
+#endif  // HAVE_FULLFSYNC
+
+#if HAVE_FDATASYNC
+  bool sync_success = ::fdatasync(fd) == 0;
+#else
+  bool sync_success = ::fsync(fd) == 0;
+#endif  // HAVE_FDATASYNC
+
+  if (sync_success) {
+    return Status::OK();
+  }
+  return PosixError(fd_path, errno);
+}
+
+// A buffer aligned to kDirectIOAlignment that only ever grows, so that
+// direct reads do not allocate once it is large enough.
+class DirectReadBuffer {
+ public:
+  DirectReadBuffer() : data_(nullptr), capacity_(0) {}
+
+  DirectReadBuffer(const DirectReadBuffer&) = delete;
+  DirectReadBuffer& operator=(const DirectReadBuffer&) = delete;
+
+  ~DirectReadBuffer() { std::free(data_); }
+
+  // Returns a buffer of at least |size| bytes, or nullptr if it cannot be
+  // allocated.
+  char* Reserve(size_t size) {
+    if (size > capacity_) {
+      void* buf;
+      if (::posix_memalign(&buf, kDirectIOAlignment, size) != 0) {
+        return nullptr;
+      }
+      std::free(data_);
+      data_ = static_cast<char*>(buf);
+      capacity_ = size;
+    }
+    return data_;
+  }
+
+ private:
+  char* data_;
+  size_t capacity_;
+};
+
+// The kDirectWritableFileBufferSize buffer of the last direct writable file
+// a thread closed, handed to the next one the thread opens, as flushes and
+// compactions write one table after another.
+class DirectWriteBufferCache {
+ public:
+  DirectWriteBufferCache() : free_buffer_(nullptr) {}
+
+  DirectWriteBufferCache(const DirectWriteBufferCache&) = delete;
+  DirectWriteBufferCache& operator=(const DirectWriteBufferCache&) = delete;
+
+  ~DirectWriteBufferCache() { std::free(free_buffer_); }
+
+  // Returns a buffer, or nullptr if it cannot be allocated.
+  char* Acquire() {
+    char* buf = free_buffer_;
+    if (buf != nullptr) {
+      free_buffer_ = nullptr;
+      return buf;
+    }
+    void* new_buf;
+    if (::posix_memalign(&new_buf, kDirectIOAlignment,
+                         kDirectWritableFileBufferSize) != 0) {
+      return nullptr;
+    }
+    return static_cast<char*>(new_buf);
+  }
+
+  void Release(char* buf) {
+    if (free_buffer_ == nullptr) {
+      free_buffer_ = buf;
+    } else {
+      std::free(buf);
+    }
+  }
+
+  static DirectWriteBufferCache* ForThisThread() {
+    static thread_local DirectWriteBufferCache cache;
+    return &cache;
+  }
+
+ private:
+  char* free_buffer_;
+};
+
+// Reads up to |n| bytes at |offset| into |scratch| from |fd|, which was
+// opened with kOpenDirectFlag, through the aligned bounce buffer of the
+// calling thread.  Returns the number of bytes read, or -1 and sets errno
+// on failure, like pread().
+ssize_t DirectPread(int fd, uint64_t offset, size_t n, char* scratch) {
+  static thread_local DirectReadBuffer bounce_buffer;
+
+  const uint64_t aligned_offset = offset & ~uint64_t{kDirectIOAlignment - 1};
+  const size_t skip = static_cast<size_t>(offset - aligned_offset);
+  const size_t aligned_size = RoundUpToDirectIOAlignment(skip + n);
+  char* buf = bounce_buffer.Reserve(aligned_size);
+  if (buf == nullptr) {
+    errno = ENOMEM;
+    return -1;
+  }
+  ssize_t read_size = ::pread(fd, buf, aligned_size,
+                              static_cast<off_t>(aligned_offset));
+  if (read_size >= 0) {
+    // A short read means the end of the file was reached.
+    read_size = (static_cast<size_t>(read_size) > skip)
+                    ? std::min(static_cast<size_t>(read_size) - skip, n)
+                    : 0;
+    std::memcpy(scratch, buf + skip, read_size);
+  }
+  return read_size;
+}
+
 // Helper class to limit resource usage to avoid exhaustion.
 // Currently used to limit read-only file descriptors and mmap file usage
 // so that we do not run out of file descriptors or virtual memory, or run into
@@ -148,10 +303,13 @@ class PosixSequentialFile final : public SequentialFile {
 class PosixRandomAccessFile final : public RandomAccessFile {
  public:
   // The new instance takes ownership of |fd|. |fd_limiter| must outlive this
-  // instance, and will be used to determine if .
-  PosixRandomAccessFile(std::string filename, int fd, Limiter* fd_limiter)
+  // instance, and will be used to determine if .  If |direct| is true, |fd|
+  // was opened with kOpenDirectFlag, and so is the file on every read.
+  PosixRandomAccessFile(std::string filename, int fd, Limiter* fd_limiter,
+                        bool direct)
       : has_permanent_fd_(fd_limiter->Acquire()),
         fd_(has_permanent_fd_ ? fd : -1),
+        direct_(direct),
         fd_limiter_(fd_limiter),
         filename_(std::move(filename)) {
     if (!has_permanent_fd_) {
@@ -172,7 +330,8 @@ class PosixRandomAccessFile final : public RandomAccessFile {
               char* scratch) const override {
     int fd = fd_;
     if (!has_permanent_fd_) {
-      fd = ::open(filename_.c_str(), O_RDONLY | kOpenBaseFlags);
+      fd = ::open(filename_.c_str(),
+                  O_RDONLY | kOpenBaseFlags | (direct_ ? kOpenDirectFlag : 0));
       if (fd < 0) {
         return PosixError(filename_, errno);
       }
@@ -181,7 +340,9 @@ class PosixRandomAccessFile final : public RandomAccessFile {
     assert(fd != -1);
 
     Status status;
-    ssize_t read_size = ::pread(fd, scratch, n, static_cast<off_t>(offset));
+    ssize_t read_size =
+        direct_ ? DirectPread(fd, offset, n, scratch)
+                : ::pread(fd, scratch, n, static_cast<off_t>(offset));
     *result = Slice(scratch, (read_size < 0) ? 0 : read_size);
     if (read_size < 0) {
       // An error: return a non-ok status.
@@ -195,9 +356,22 @@ class PosixRandomAccessFile final : public RandomAccessFile {
     return status;
   }
 
+  void Prefetch(uint64_t offset, size_t n) const override {
+#if HAVE_POSIX_FADVISE
+    // Files without a permanent descriptor are re-opened on every read, so
+    // there is no descriptor to attach the hint to.  Direct reads do not
+    // use the page cache the hint would fill.
+    if (has_permanent_fd_ && !direct_) {
+      ::posix_fadvise(fd_, static_cast<off_t>(offset), static_cast<off_t>(n),
+                      POSIX_FADV_WILLNEED);
+    }
+#endif  // HAVE_POSIX_FADVISE
+  }
+
  private:
   const bool has_permanent_fd_;  // If false, the file is opened on every read.
   const int fd_;                 // -1 if has_permanent_fd_ is false.
+  const bool direct_;            // If true, reads bypass the page cache.
   Limiter* const fd_limiter_;
   const std::string filename_;
 };
@@ -239,6 +413,21 @@ class PosixMmapReadableFile final : public RandomAccessFile {
     return Status::OK();
   }
 
+  bool ReadsInPlace() const override { return true; }
+
+  void Prefetch(uint64_t offset, size_t n) const override {
+    if (offset >= length_) {
+      return;
+    }
+    n = std::min<uint64_t>(n, length_ - offset);
+    // madvise() requires a page-aligned start address.
+    static const uintptr_t kPageMask = ::sysconf(_SC_PAGESIZE) - 1;
+    uintptr_t start = reinterpret_cast<uintptr_t>(mmap_base_ + offset);
+    uintptr_t aligned_start = start & ~kPageMask;
+    ::madvise(reinterpret_cast<void*>(aligned_start), n + (start - aligned_start),
+              MADV_WILLNEED);
+  }
+
  private:
   char* const mmap_base_;
   const size_t length_;
@@ -303,6 +492,16 @@ class PosixWritableFile final : public WritableFile {
 
   Status Flush() override { return FlushBuffer(); }
 
+  void Preallocate(uint64_t size) override {
+#if HAVE_FALLOCATE
+    // Ignoring errors: this is only a hint, and the space is allocated on
+    // demand otherwise.
+    ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+#else
+    (void)size;
+#endif  // HAVE_FALLOCATE
+  }
+
   Status Sync() override {
     // Ensure new files referred to by the manifest are in the filesystem.
     //
@@ -322,6 +521,11 @@ class PosixWritableFile final : public WritableFile {
     return SyncFd(fd_, filename_);
   }
 
+  // Only touches fd_, which stays unchanged until Close().
+  bool SupportsConcurrentSync() const override { return true; }
+
+  Status SyncFlushed() override { return SyncFd(fd_, filename_); }
+
  private:
   Status FlushBuffer() {
     Status status = WriteUnbuffered(buf_, pos_);
@@ -360,35 +564,6 @@ class PosixWritableFile final : public WritableFile {
     return status;
   }
 
-  // Ensures that all the caches associated with the given file descriptor's
-  // data are flushed all the way to durable media, and can withstand power
-  // failures.
-  //
-  // The path argument is only used to populate the description string in the
-  // returned Status if an error occurs.
-  static Status SyncFd(int fd, const std::string& fd_path) {
-#if HAVE_FULLFSYNC
-    // On macOS and iOS, fsync() doesn't guarantee durability past power
-    // failures. fcntl(F_FULLFSYNC) is required for that purpose. Some
-    // filesystems don't support fcntl(F_FULLFSYNC), and require a fallback to
-    // fsync().
-    if (::fcntl(fd, F_FULLFSYNC) == 0) {
-      return Status::OK();
-    }
-#endif  // HAVE_FULLFSYNC
-
-#if HAVE_FDATASYNC
-    bool sync_success = ::fdatasync(fd) == 0;
-#else
-    bool sync_success = ::fsync(fd) == 0;
-#endif  // HAVE_FDATASYNC
-
-    if (sync_success) {
-      return Status::OK();
-    }
-    return PosixError(fd_path, errno);
-  }
-
   // Returns the directory name in a path pointing to a file.
   //
   // Returns "." if the path does not contain any directory separator.
@@ -436,6 +611,129 @@ class PosixWritableFile final : public WritableFile {
   const std::string dirname_;  // The directory of filename_.
 };
 
+// Writes a file bypassing the page cache.
+//
+// Direct writes must be aligned, so data is buffered until a full buffer can
+// be written.  Sync() and Close() also write the partial block at the end,
+// padded, and then truncate the file to its actual size; the partial block
+// stays buffered and is rewritten once more data has been appended.  Flush()
+// does not write anything: only tables are written this way, and those are
+// synced before being used.
+class PosixDirectWritableFile final : public WritableFile {
+ public:
+  // The new instance takes ownership of |fd|, opened with kOpenDirectFlag,
+  // and of |buf|, a buffer of DirectWriteBufferCache.
+  PosixDirectWritableFile(std::string filename, int fd, char* buf)
+      : buf_(buf),
+        pos_(0),
+        file_offset_(0),
+        fd_(fd),
+        filename_(std::move(filename)) {}
+
+  ~PosixDirectWritableFile() override {
+    if (fd_ >= 0) {
+      // Ignoring any potential errors
+      Close();
+    }
+    DirectWriteBufferCache::ForThisThread()->Release(buf_);
+  }
+
+  Status Append(const Slice& data) override {
+    const char* write_data = data.data();
+    size_t write_size = data.size();
+    while (write_size > 0) {
+      size_t copy_size =
+          std::min(write_size, kDirectWritableFileBufferSize - pos_);
+      std::memcpy(buf_ + pos_, write_data, copy_size);
+      write_data += copy_size;
+      write_size -= copy_size;
+      pos_ += copy_size;
+      if (pos_ == kDirectWritableFileBufferSize) {
+        Status status = WriteAligned(pos_);
+        if (!status.ok()) {
+          return status;
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+  Status Close() override {
+    Status status = WriteTail();
+    const int close_result = ::close(fd_);
+    if (close_result < 0 && status.ok()) {
+      status = PosixError(filename_, errno);
+    }
+    fd_ = -1;
+    return status;
+  }
+
+  Status Flush() override { return Status::OK(); }
+
+  Status Sync() override {
+    Status status = WriteTail();
+    if (!status.ok()) {
+      return status;
+    }
+    return SyncFd(fd_, filename_);
+  }
+
+ private:
+  // Writes buf_[0, size - 1], where |size| is a multiple of
+  // kDirectIOAlignment, and drops it from the buffer.
+  Status WriteAligned(size_t size) {
+    assert(size % kDirectIOAlignment == 0);
+    Status status = WriteAt(buf_, size, file_offset_);
+    if (status.ok()) {
+      file_offset_ += size;
+      pos_ -= size;
+      std::memmove(buf_, buf_ + size, pos_);
+    }
+    return status;
+  }
+
+  // Writes the buffered data padded to kDirectIOAlignment and truncates the
+  // padding, keeping the data buffered.
+  Status WriteTail() {
+    if (pos_ == 0) {
+      return Status::OK();
+    }
+    const size_t padded_size = RoundUpToDirectIOAlignment(pos_);
+    std::memset(buf_ + pos_, 0, padded_size - pos_);
+    Status status = WriteAt(buf_, padded_size, file_offset_);
+    if (status.ok() &&
+        ::ftruncate(fd_, static_cast<off_t>(file_offset_ + pos_)) != 0) {
+      status = PosixError(filename_, errno);
+    }
+    return status;
+  }
+
+  Status WriteAt(const char* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+      ssize_t write_result =
+          ::pwrite(fd_, data, size, static_cast<off_t>(offset));
+      if (write_result < 0) {
+        if (errno == EINTR) {
+          continue;  // Retry
+        }
+        return PosixError(filename_, errno);
+      }
+      data += write_result;
+      size -= write_result;
+      offset += write_result;
+    }
+    return Status::OK();
+  }
+
+  // buf_[0, pos_ - 1] contains data to be written to fd_ at file_offset_.
+  char* const buf_;
+  size_t pos_;
+  uint64_t file_offset_;  // Multiple of kDirectIOAlignment.
+  int fd_;
+
+  const std::string filename_;
+};
+
 int LockOrUnlock(int fd, bool lock) {
   errno = 0;
   struct ::flock file_lock_info;
@@ -517,7 +815,8 @@ class PosixEnv : public Env {
     }
 
     if (!mmap_limiter_.Acquire()) {
-      *result = new PosixRandomAccessFile(filename, fd, &fd_limiter_);
+      *result = new PosixRandomAccessFile(filename, fd, &fd_limiter_,
+                                          /*direct=*/false);
       return Status::OK();
     }
 
@@ -567,6 +866,71 @@ class PosixEnv : public Env {
     return Status::OK();
   }
 
+  Status NewDirectRandomAccessFile(const std::string& filename,
+                                   RandomAccessFile** result) override {
+    if (kOpenDirectFlag == 0) {
+      return NewRandomAccessFile(filename, result);
+    }
+    *result = nullptr;
+    int fd =
+        ::open(filename.c_str(), O_RDONLY | kOpenBaseFlags | kOpenDirectFlag);
+    if (fd < 0) {
+      if (errno == EINVAL) {
+        // The file system does not support direct I/O.
+        return NewRandomAccessFile(filename, result);
+      }
+      return PosixError(filename, errno);
+    }
+
+    *result = new PosixRandomAccessFile(filename, fd, &fd_limiter_,
+                                        /*direct=*/true);
+    return Status::OK();
+  }
+
+  Status NewDirectWritableFile(const std::string& filename,
+                               WritableFile** result) override {
+    if (kOpenDirectFlag == 0) {
+      return NewWritableFile(filename, result);
+    }
+    *result = nullptr;
+    int fd = ::open(filename.c_str(),
+                    O_TRUNC | O_WRONLY | O_CREAT | kOpenBaseFlags |
+                        kOpenDirectFlag,
+                    0644);
+    if (fd < 0) {
+      if (errno == EINVAL) {
+        // The file system does not support direct I/O.
+        return NewWritableFile(filename, result);
+      }
+      return PosixError(filename, errno);
+    }
+
+    char* buf = DirectWriteBufferCache::ForThisThread()->Acquire();
+    if (buf == nullptr) {
+      ::close(fd);
+      return PosixError(filename, ENOMEM);
+    }
+    *result = new PosixDirectWritableFile(filename, fd, buf);
+    return Status::OK();
+  }
+
+  Status ReuseWritableFile(const std::string& filename,
+                           const std::string& old_filename,
+                           WritableFile** result) override {
+    *result = nullptr;
+    if (std::rename(old_filename.c_str(), filename.c_str()) != 0) {
+      return PosixError(old_filename, errno);
+    }
+    // No O_TRUNC: the old contents are overwritten in place.
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | kOpenBaseFlags, 0644);
+    if (fd < 0) {
+      return PosixError(filename, errno);
+    }
+
+    *result = new PosixWritableFile(filename, fd);
+    return Status::OK();
+  }
+
   bool FileExists(const std::string& filename) override {
     return ::access(filename.c_str(), F_OK) == 0;
   }
@@ -743,8 +1107,50 @@ class PosixEnv : public Env {
   Limiter fd_limiter_;    // Thread-safe.
 };
 
+// Return the kernel's limit on the number of memory regions of a process,
+// or 0 if it is unknown.
+int MaxMapCount() {
+#if defined(__linux__)
+  int fd = ::open("/proc/sys/vm/max_map_count", O_RDONLY | kOpenBaseFlags);
+  if (fd < 0) {
+    return 0;
+  }
+  char buf[32];
+  ssize_t n = ::read(fd, buf, sizeof(buf) - 1);
+  ::close(fd);
+  if (n <= 0) {
+    return 0;
+  }
+  buf[n] = '\0';
+  return std::atoi(buf);
+#else
+  return 0;
+#endif  // defined(__linux__)
+}
+
 // Return the maximum number of concurrent mmaps.
-int MaxMmaps() { return g_mmap_limit; }
+int MaxMmaps() {
+  if (g_mmap_limit >= 0) {
+    return g_mmap_limit;
+  }
+  if (kDefaultMmapLimit == 0) {
+    g_mmap_limit = 0;
+    return g_mmap_limit;
+  }
+  // Each mmap takes a region out of the address space of the process, and
+  // the kernel caps the number of regions.  Allow use of half of both.
+  uint64_t limit = kDefaultMmapLimit;
+  const int max_map_count = MaxMapCount();
+  if (max_map_count > 0) {
+    limit = max_map_count / 2;
+  }
+  struct ::rlimit rlim;
+  if (::getrlimit(RLIMIT_AS, &rlim) == 0 && rlim.rlim_cur != RLIM_INFINITY) {
+    limit = std::min<uint64_t>(limit, rlim.rlim_cur / 2 / kMmapRegionBudget);
+  }
+  g_mmap_limit = static_cast<int>(limit);
+  return g_mmap_limit;
+}
 
 // Return the maximum number of read-only files to keep open.
 int MaxOpenFiles() {
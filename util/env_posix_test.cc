@@ -6,6 +6,7 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -16,7 +17,9 @@
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "util/env_posix_test_helper.h"
+#include "util/random.h"
 #include "util/testharness.h"
+#include "util/testutil.h"
 
 #if HAVE_O_CLOEXEC
 
@@ -198,6 +201,8 @@ TEST(EnvPosixTest, TestOpenOnRead) {
   leveldb::RandomAccessFile* files[kNumFiles] = {0};
   for (int i = 0; i < kNumFiles; i++) {
     ASSERT_OK(env_->NewRandomAccessFile(test_file, &files[i]));
+    // Only the memory-mapped files read in place.
+    ASSERT_EQ(i < kMMapLimit, files[i]->ReadsInPlace());
   }
   char scratch;
   Slice read_result;
@@ -211,6 +216,92 @@ TEST(EnvPosixTest, TestOpenOnRead) {
   ASSERT_OK(env_->DeleteFile(test_file));
 }
 
+TEST(EnvPosixTest, TestDirectReadWrite) {
+  std::string test_dir;
+  ASSERT_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/direct_read_write.txt";
+
+  // Appends of odd sizes that straddle the write buffer, with syncs that
+  // write a partial block in between.
+  Random rnd(301);
+  std::string data;
+  WritableFile* writable_file;
+  ASSERT_OK(env_->NewDirectWritableFile(test_file, &writable_file));
+  while (data.size() < (3 << 20)) {
+    std::string piece;
+    test::RandomString(&rnd, rnd.Skewed(17), &piece);
+    ASSERT_OK(writable_file->Append(piece));
+    ASSERT_OK(writable_file->Flush());
+    data += piece;
+    if (rnd.OneIn(50)) {
+      ASSERT_OK(writable_file->Sync());
+      uint64_t file_size;
+      ASSERT_OK(env_->GetFileSize(test_file, &file_size));
+      ASSERT_EQ(data.size(), file_size);
+    }
+  }
+  ASSERT_OK(writable_file->Close());
+  delete writable_file;
+
+  uint64_t file_size;
+  ASSERT_OK(env_->GetFileSize(test_file, &file_size));
+  ASSERT_EQ(data.size(), file_size);
+
+  // More files than kReadOnlyFileLimit, so some are opened on every read.
+  const int kNumFiles = kReadOnlyFileLimit + 2;
+  RandomAccessFile* files[kNumFiles];
+  for (int i = 0; i < kNumFiles; i++) {
+    ASSERT_OK(env_->NewDirectRandomAccessFile(test_file, &files[i]));
+  }
+  std::string scratch;
+  for (int i = 0; i < 1000; i++) {
+    const uint64_t offset = rnd.Uniform(data.size() + 100);
+    const size_t n = rnd.Skewed(16);
+    scratch.resize(n);
+    Slice result;
+    ASSERT_OK(files[i % kNumFiles]->Read(offset, n, &result, &scratch[0]));
+    const size_t expected =
+        offset < data.size() ? std::min<size_t>(n, data.size() - offset) : 0;
+    ASSERT_EQ(expected, result.size());
+    ASSERT_EQ(data.substr(std::min<size_t>(offset, data.size()), expected),
+              result.ToString());
+  }
+  for (int i = 0; i < kNumFiles; i++) {
+    delete files[i];
+  }
+  ASSERT_OK(env_->DeleteFile(test_file));
+}
+
+TEST(EnvPosixTest, TestReuseWritableFile) {
+  std::string test_dir;
+  ASSERT_OK(env_->GetTestDirectory(&test_dir));
+  std::string old_file = test_dir + "/reuse_writable_file_old.txt";
+  std::string new_file = test_dir + "/reuse_writable_file_new.txt";
+  env_->DeleteFile(new_file);
+
+  WritableFile* writable_file;
+  ASSERT_OK(env_->NewWritableFile(old_file, &writable_file));
+  writable_file->Preallocate(1 << 20);
+  ASSERT_OK(writable_file->Append("0123456789"));
+  ASSERT_OK(writable_file->Close());
+  delete writable_file;
+  uint64_t file_size;
+  ASSERT_OK(env_->GetFileSize(old_file, &file_size));
+  ASSERT_EQ(10, file_size);
+
+  // The old contents are overwritten in place, not truncated.
+  ASSERT_OK(env_->ReuseWritableFile(new_file, old_file, &writable_file));
+  ASSERT_OK(writable_file->Append("abc"));
+  ASSERT_OK(writable_file->Sync());
+  ASSERT_OK(writable_file->Close());
+  delete writable_file;
+  ASSERT_TRUE(!env_->FileExists(old_file));
+  std::string contents;
+  ASSERT_OK(ReadFileToString(env_, new_file, &contents));
+  ASSERT_EQ("abc3456789", contents);
+  ASSERT_OK(env_->DeleteFile(new_file));
+}
+
 #if HAVE_O_CLOEXEC
 
 TEST(EnvPosixTest, TestCloseOnExecSequentialFile) {
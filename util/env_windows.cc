@@ -235,6 +235,8 @@ class WindowsMmapReadableFile : public RandomAccessFile {
     return s;
   }
 
+  bool ReadsInPlace() const override { return true; }
+
  private:
   std::string filename_;
   void* mmapped_region_;
@@ -0,0 +1,107 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/merge_operator.h"
+
+#include "util/coding.h"
+
+namespace leveldb {
+
+MergeOperator::~MergeOperator() {}
+
+bool MergeOperator::PartialMerge(const Slice& key, const Slice& left,
+                                 const Slice& right,
+                                 std::string* new_value) const {
+  return false;
+}
+
+namespace {
+
+class UInt64AddOperator : public MergeOperator {
+ public:
+  const char* Name() const override { return "leveldb.UInt64AddOperator"; }
+
+  bool FullMerge(const Slice& key, const Slice* existing_value,
+                 const std::vector<Slice>& operands,
+                 std::string* new_value) const override {
+    uint64_t sum = 0;
+    if (existing_value != nullptr && !Decode(*existing_value, &sum)) {
+      return false;
+    }
+    for (const Slice& operand : operands) {
+      uint64_t n;
+      if (!Decode(operand, &n)) {
+        return false;
+      }
+      sum += n;
+    }
+    new_value->clear();
+    PutFixed64(new_value, sum);
+    return true;
+  }
+
+  bool PartialMerge(const Slice& key, const Slice& left, const Slice& right,
+                    std::string* new_value) const override {
+    uint64_t a, b;
+    if (!Decode(left, &a) || !Decode(right, &b)) {
+      return false;
+    }
+    new_value->clear();
+    PutFixed64(new_value, a + b);
+    return true;
+  }
+
+ private:
+  static bool Decode(const Slice& value, uint64_t* result) {
+    if (value.size() != sizeof(uint64_t)) {
+      return false;
+    }
+    *result = DecodeFixed64(value.data());
+    return true;
+  }
+};
+
+class StringAppendOperator : public MergeOperator {
+ public:
+  explicit StringAppendOperator(char delimiter) : delimiter_(delimiter) {}
+
+  const char* Name() const override { return "leveldb.StringAppendOperator"; }
+
+  bool FullMerge(const Slice& key, const Slice* existing_value,
+                 const std::vector<Slice>& operands,
+                 std::string* new_value) const override {
+    new_value->clear();
+    if (existing_value != nullptr) {
+      new_value->assign(existing_value->data(), existing_value->size());
+    }
+    for (size_t i = 0; i < operands.size(); i++) {
+      if (existing_value != nullptr || i > 0) {
+        new_value->push_back(delimiter_);
+      }
+      new_value->append(operands[i].data(), operands[i].size());
+    }
+    return true;
+  }
+
+  bool PartialMerge(const Slice& key, const Slice& left, const Slice& right,
+                    std::string* new_value) const override {
+    new_value->assign(left.data(), left.size());
+    new_value->push_back(delimiter_);
+    new_value->append(right.data(), right.size());
+    return true;
+  }
+
+ private:
+  const char delimiter_;
+};
+
+}  // namespace
+
+const MergeOperator* NewUInt64AddOperator() { return new UInt64AddOperator; }
+
+const MergeOperator* NewStringAppendOperator(char delimiter) {
+  return new StringAppendOperator(delimiter);
+}
+
+}  // namespace leveldb
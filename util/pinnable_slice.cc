@@ -0,0 +1,52 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/pinnable_slice.h"
+
+#include <assert.h>
+
+namespace leveldb {
+
+PinnableSlice::PinnableSlice()
+    : buf_(&self_space_), function_(nullptr), arg1_(nullptr), arg2_(nullptr) {}
+
+PinnableSlice::PinnableSlice(std::string* buf)
+    : buf_(buf), function_(nullptr), arg1_(nullptr), arg2_(nullptr) {}
+
+PinnableSlice::~PinnableSlice() { ReleasePin(); }
+
+void PinnableSlice::PinSlice(const Slice& s, CleanupFunction function,
+                             void* arg1, void* arg2) {
+  assert(function != nullptr);
+  ReleasePin();
+  Slice::operator=(s);
+  function_ = function;
+  arg1_ = arg1;
+  arg2_ = arg2;
+}
+
+void PinnableSlice::PinSelf(const Slice& s) {
+  // "s" may refer to the pinned memory, so copy it before releasing that.
+  buf_->assign(s.data(), s.size());
+  PinSelf();
+}
+
+void PinnableSlice::PinSelf() {
+  ReleasePin();
+  Slice::operator=(*buf_);
+}
+
+void PinnableSlice::Reset() {
+  ReleasePin();
+  clear();
+}
+
+void PinnableSlice::ReleasePin() {
+  if (function_ != nullptr) {
+    (*function_)(arg1_, arg2_);
+    function_ = nullptr;
+  }
+}
+
+}  // namespace leveldb
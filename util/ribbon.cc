@@ -0,0 +1,272 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A Ribbon filter (Dillinger & Walzer, "Ribbon filter: practically smaller
+// than Bloom and Xor") stores an r-bit fingerprint per key as the solution
+// S of a linear system over GF(2).  Each key hashes to a start slot s, a
+// 64-bit coefficient row c and a fingerprint f, and the system requires
+//     parity(c & S_b[s .. s+63]) == bit b of f
+// for every fingerprint bit b.  The rows are banded (every row only covers
+// 64 consecutive slots), so the system is solved by incremental Gaussian
+// elimination in near-linear time.  A lookup recomputes the r parities and
+// compares them with the fingerprint, giving a false positive rate of
+// 2^-r with a little over r bits per key.
+//
+// Filter layout:
+//     columns: char[(r * num_slots + 7) / 8]  // S_0 .. S_r-1, bit-packed
+//     seed: uint8
+//     r: uint8
+// num_slots is the number of whole r-bit slots that fit in the columns, so
+// it takes no space of its own.  r == 0 marks a filter that matches every
+// key, written if no seed gave a solvable system.
+//
+// Filters are built per 2KB of data, i.e. for a few dozen keys, so the
+// fixed overhead matters as much as the per-key one: the system starts
+// with a single spare slot (plus 1/32 per key for long bands) and only
+// grows if seeds keep failing.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+static const size_t kRibbonWidth = 64;
+static const size_t kTrailerSize = 1 + 1;
+static const int kMaxFingerprintBits = 32;
+static const int kMaxSeeds = 256;
+
+static uint32_t RibbonHash(const Slice& key) {
+  return Hash(key.data(), key.size(), 0x4b9a2f33);
+}
+
+static inline uint64_t Mix64(uint64_t x) {
+  // Finalizer of MurmurHash3.
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33;
+  return x;
+}
+
+static inline int Parity(uint64_t x) { return __builtin_parityll(x); }
+
+static inline int CountTrailingZeros(uint64_t x) { return __builtin_ctzll(x); }
+
+// The row a key contributes to the system for a given seed and size.
+struct RibbonRow {
+  RibbonRow(uint32_t key_hash, uint32_t seed, size_t num_slots,
+            int fingerprint_bits) {
+    const size_t width = std::min(num_slots, kRibbonWidth);
+    const uint64_t h =
+        Mix64(key_hash ^ (uint64_t{seed} * 0x9e3779b97f4a7c15ull));
+    start = static_cast<size_t>(((h >> 32) * (num_slots - width + 1)) >> 32);
+    coeff = Mix64(h ^ 0x6a09e667f3bcc909ull);
+    if (width < 64) coeff &= (uint64_t{1} << width) - 1;
+    coeff |= 1;
+    fingerprint = static_cast<uint32_t>(h);
+    if (fingerprint_bits < 32) {
+      fingerprint &= (uint32_t{1} << fingerprint_bits) - 1;
+    }
+  }
+
+  size_t start;
+  uint64_t coeff;
+  uint32_t fingerprint;
+};
+
+// Returns the 64 bits of "column" starting at bit "bit".  Bits past
+// "limit" read as zero.
+static inline uint64_t LoadWindow(const char* column, const char* limit,
+                                  size_t bit) {
+  const char* p = column + bit / 8;
+  const int shift = bit % 8;
+  if (limit - p >= 9) {
+    uint64_t result = DecodeFixed64(p) >> shift;
+    if (shift != 0) {
+      result |= static_cast<uint64_t>(static_cast<uint8_t>(p[8]))
+                << (64 - shift);
+    }
+    return result;
+  }
+  uint64_t result = 0;
+  for (int i = 0; i < 9 && p + i < limit; i++) {
+    const uint64_t byte = static_cast<uint8_t>(p[i]);
+    if (i == 0) {
+      result = byte >> shift;
+    } else if (8 * i - shift < 64) {
+      result |= byte << (8 * i - shift);
+    }
+  }
+  return result;
+}
+
+class RibbonFilterPolicy : public FilterPolicy {
+ public:
+  explicit RibbonFilterPolicy(int bloom_equivalent_bits_per_key) {
+    // A Bloom filter with b bits per key and the best number of probes has
+    // a false positive rate of about 0.6185^b = 2^(-0.693 b).
+    fingerprint_bits_ =
+        static_cast<int>(bloom_equivalent_bits_per_key * 0.693 + 0.5);
+    if (fingerprint_bits_ < 1) fingerprint_bits_ = 1;
+    if (fingerprint_bits_ > kMaxFingerprintBits) {
+      fingerprint_bits_ = kMaxFingerprintBits;
+    }
+  }
+
+  const char* Name() const override { return "leveldb.RibbonFilter"; }
+
+  void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+    std::vector<uint32_t> hashes(n);
+    for (int i = 0; i < n; i++) {
+      hashes[i] = RibbonHash(keys[i]);
+    }
+
+    // Slack needed for the system to be solvable; each seed succeeds with
+    // probability of about 1/2 at first, and the slack grows a little
+    // after every two unlucky seeds.
+    size_t num_slots = n == 0 ? 0 : n + 1 + n / 32;
+    std::vector<uint64_t> coeffs;
+    std::vector<uint32_t> results;
+    for (int seed = 0; seed < kMaxSeeds; seed++) {
+      if (seed > 0 && seed % 2 == 0) {
+        num_slots += 1 + num_slots / 128;
+      }
+      // Also use the padding bits of the last byte as slots.
+      num_slots = ColumnBytes(num_slots, fingerprint_bits_) * 8 /
+                  fingerprint_bits_;
+      if (Band(hashes, seed, num_slots, &coeffs, &results)) {
+        Solve(coeffs, results, seed, num_slots, dst);
+        return;
+      }
+    }
+
+    // Practically unreachable; fall back to a filter that matches all.
+    dst->push_back(0);
+    dst->push_back(0);
+  }
+
+  bool KeyMayMatch(const Slice& key, const Slice& filter) const override {
+    const size_t len = filter.size();
+    if (len < kTrailerSize) return false;
+
+    const size_t column_bytes = len - kTrailerSize;
+    const char* trailer = filter.data() + column_bytes;
+    const uint32_t seed = static_cast<uint8_t>(trailer[0]);
+    const int fingerprint_bits = static_cast<uint8_t>(trailer[1]);
+    if (fingerprint_bits == 0 || fingerprint_bits > kMaxFingerprintBits) {
+      // Unsolved, or reserved for potentially new encodings.
+      return true;
+    }
+    const size_t num_slots = column_bytes * 8 / fingerprint_bits;
+    if (num_slots == 0) return false;  // Empty filter
+
+    // Bits of the window past the slots of column b belong to the next
+    // column, but the coefficients never cover them.
+    const RibbonRow row(RibbonHash(key), seed, num_slots, fingerprint_bits);
+    for (int b = 0; b < fingerprint_bits; b++) {
+      const uint64_t window =
+          LoadWindow(filter.data(), trailer, b * num_slots + row.start);
+      if (Parity(window & row.coeff) !=
+          static_cast<int>((row.fingerprint >> b) & 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  // Bytes of the columns of a filter with "num_slots" slots.
+  static size_t ColumnBytes(size_t num_slots, int fingerprint_bits) {
+    return (num_slots * fingerprint_bits + 7) / 8;
+  }
+
+  // Gaussian elimination: reduces every row so that its lowest coefficient
+  // bit lands on a distinct slot.  Returns false if two rows conflict.
+  bool Band(const std::vector<uint32_t>& hashes, uint32_t seed,
+            size_t num_slots, std::vector<uint64_t>* coeffs,
+            std::vector<uint32_t>* results) const {
+    coeffs->assign(num_slots, 0);
+    results->assign(num_slots, 0);
+    for (size_t k = 0; k < hashes.size(); k++) {
+      const RibbonRow row(hashes[k], seed, num_slots, fingerprint_bits_);
+      size_t i = row.start;
+      uint64_t c = row.coeff;
+      uint32_t r = row.fingerprint;
+      while (true) {
+        if ((*coeffs)[i] == 0) {
+          (*coeffs)[i] = c;
+          (*results)[i] = r;
+          break;
+        }
+        c ^= (*coeffs)[i];
+        r ^= (*results)[i];
+        if (c == 0) {
+          // A duplicate key (r == 0) is harmless; anything else makes the
+          // system unsolvable with this seed.
+          if (r != 0) return false;
+          break;
+        }
+        const int shift = CountTrailingZeros(c);
+        i += shift;
+        c >>= shift;
+      }
+    }
+    return true;
+  }
+
+  // Back substitution from the last slot down, appending the solution
+  // columns and the trailer to *dst.
+  void Solve(const std::vector<uint64_t>& coeffs,
+             const std::vector<uint32_t>& results, uint32_t seed,
+             size_t num_slots, std::string* dst) const {
+    const size_t init_size = dst->size();
+    dst->resize(init_size + ColumnBytes(num_slots, fingerprint_bits_), 0);
+    char* columns = &(*dst)[init_size];
+
+    // windows[b] holds S_b[i .. i+63], bit j being slot i+j.
+    std::vector<uint64_t> windows(fingerprint_bits_, 0);
+    for (size_t i = num_slots; i-- > 0;) {
+      const uint64_t c = coeffs[i];
+      // Slots no row depends on get arbitrary but well-mixed values.
+      const uint64_t free_bits = Mix64(i ^ (uint64_t{seed} << 32));
+      for (int b = 0; b < fingerprint_bits_; b++) {
+        const uint64_t shifted = windows[b] << 1;
+        int bit;
+        if (c == 0) {
+          bit = (free_bits >> b) & 1;
+        } else {
+          bit = ((results[i] >> b) & 1) ^ Parity(c & shifted);
+        }
+        windows[b] = shifted | bit;
+        if (bit) {
+          const size_t pos = b * num_slots + i;
+          columns[pos / 8] |= 1 << (pos % 8);
+        }
+      }
+    }
+
+    dst->push_back(static_cast<char>(seed));
+    dst->push_back(static_cast<char>(fingerprint_bits_));
+  }
+
+  int fingerprint_bits_;
+};
+
+}  // namespace
+
+const FilterPolicy* NewRibbonFilterPolicy(int bloom_equivalent_bits_per_key) {
+  return new RibbonFilterPolicy(bloom_equivalent_bits_per_key);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,192 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/filter_policy.h"
+
+#include "util/coding.h"
+#include "util/logging.h"
+#include "util/testharness.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+static const int kVerbose = 1;
+
+static Slice Key(int i, char* buffer) {
+  EncodeFixed32(buffer, i);
+  return Slice(buffer, sizeof(uint32_t));
+}
+
+class RibbonTest {
+ public:
+  RibbonTest() : policy_(NewRibbonFilterPolicy(10)) {}
+
+  explicit RibbonTest(const FilterPolicy* policy) : policy_(policy) {}
+
+  ~RibbonTest() { delete policy_; }
+
+  void Reset() {
+    keys_.clear();
+    filter_.clear();
+  }
+
+  void Add(const Slice& s) { keys_.push_back(s.ToString()); }
+
+  void Build() {
+    std::vector<Slice> key_slices;
+    for (size_t i = 0; i < keys_.size(); i++) {
+      key_slices.push_back(Slice(keys_[i]));
+    }
+    filter_.clear();
+    policy_->CreateFilter(key_slices.data(),
+                          static_cast<int>(key_slices.size()), &filter_);
+    keys_.clear();
+  }
+
+  size_t FilterSize() const { return filter_.size(); }
+
+  bool Matches(const Slice& s) {
+    if (!keys_.empty()) {
+      Build();
+    }
+    return policy_->KeyMayMatch(s, filter_);
+  }
+
+  double FalsePositiveRate() {
+    char buffer[sizeof(int)];
+    int result = 0;
+    for (int i = 0; i < 10000; i++) {
+      if (Matches(Key(i + 1000000000, buffer))) {
+        result++;
+      }
+    }
+    return result / 10000.0;
+  }
+
+ private:
+  const FilterPolicy* policy_;
+  std::string filter_;
+  std::vector<std::string> keys_;
+};
+
+TEST(RibbonTest, EmptyFilter) {
+  Build();
+  ASSERT_TRUE(!Matches("hello"));
+  ASSERT_TRUE(!Matches("world"));
+}
+
+TEST(RibbonTest, Small) {
+  Add("hello");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("x"));
+  ASSERT_TRUE(!Matches("foo"));
+}
+
+TEST(RibbonTest, Duplicates) {
+  for (int i = 0; i < 3; i++) {
+    Add("hello");
+    Add("world");
+  }
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("x"));
+}
+
+static int NextLength(int length) {
+  if (length < 10) {
+    length += 1;
+  } else if (length < 100) {
+    length += 10;
+  } else if (length < 1000) {
+    length += 100;
+  } else {
+    length += 1000;
+  }
+  return length;
+}
+
+TEST(RibbonTest, VaryingLengths) {
+  char buffer[sizeof(int)];
+
+  // Count number of filters that significantly exceed the false positive rate
+  int mediocre_filters = 0;
+  int good_filters = 0;
+
+  for (int length = 1; length <= 10000; length = NextLength(length)) {
+    Reset();
+    for (int i = 0; i < length; i++) {
+      Add(Key(i, buffer));
+    }
+    Build();
+
+    // Well under the 10 bits per key of the equivalent bloom filter.
+    ASSERT_LE(FilterSize(), static_cast<size_t>(length * 15 / 16 + 4)) << length;
+
+    // All added keys must match
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(Matches(Key(i, buffer)))
+          << "Length " << length << "; key " << i;
+    }
+
+    // Check false positive rate
+    double rate = FalsePositiveRate();
+    if (kVerbose >= 1) {
+      fprintf(stderr, "False positives: %5.2f%% @ length = %6d ; bytes = %6d\n",
+              rate * 100.0, length, static_cast<int>(FilterSize()));
+    }
+    ASSERT_LE(rate, 0.02);  // Must not be over 2%
+    if (rate > 0.0125)
+      mediocre_filters++;  // Allowed, but not too often
+    else
+      good_filters++;
+  }
+  if (kVerbose >= 1) {
+    fprintf(stderr, "Filters: %d good, %d mediocre\n", good_filters,
+            mediocre_filters);
+  }
+  ASSERT_LE(mediocre_filters, good_filters / 5);
+}
+
+// Filters are built for a few dozen keys at a time, where the fixed
+// overhead of the filter counts as much as the bits per key.
+TEST(RibbonTest, SmallerThanBloom) {
+  char buffer[sizeof(int)];
+  RibbonTest bloom(NewBloomFilterPolicy(10));
+  size_t bytes = 0, bloom_bytes = 0;
+  double rates = 0, bloom_rates = 0;
+  for (int length = 20; length <= 50; length += 5) {
+    Reset();
+    bloom.Reset();
+    for (int i = 0; i < length; i++) {
+      Add(Key(i, buffer));
+      bloom.Add(Key(i, buffer));
+    }
+    Build();
+    bloom.Build();
+
+    const double rate = FalsePositiveRate();
+    const double bloom_rate = bloom.FalsePositiveRate();
+    if (kVerbose >= 1) {
+      fprintf(stderr,
+              "length = %2d: ribbon %3d bytes, %5.2f%%; "
+              "bloom %3d bytes, %5.2f%%\n",
+              length, static_cast<int>(FilterSize()), rate * 100.0,
+              static_cast<int>(bloom.FilterSize()), bloom_rate * 100.0);
+    }
+    ASSERT_LE(FilterSize() * 100, bloom.FilterSize() * 85) << length;
+    bytes += FilterSize();
+    bloom_bytes += bloom.FilterSize();
+    rates += rate;
+    bloom_rates += bloom_rate;
+  }
+  // At least 20% smaller, with no more false positives.
+  ASSERT_LE(bytes * 5, bloom_bytes * 4);
+  ASSERT_LE(rates, bloom_rates);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) { return leveldb::test::RunAllTests(); }
@@ -0,0 +1,45 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/slice_transform.h"
+
+#include <assert.h>
+
+#include <string>
+
+namespace leveldb {
+
+SliceTransform::~SliceTransform() {}
+
+namespace {
+
+class FixedPrefixTransform : public SliceTransform {
+ public:
+  explicit FixedPrefixTransform(size_t prefix_length)
+      : prefix_length_(prefix_length),
+        name_("leveldb.FixedPrefix." + std::to_string(prefix_length)) {}
+
+  const char* Name() const override { return name_.c_str(); }
+
+  Slice Transform(const Slice& key) const override {
+    assert(InDomain(key));
+    return Slice(key.data(), prefix_length_);
+  }
+
+  bool InDomain(const Slice& key) const override {
+    return key.size() >= prefix_length_;
+  }
+
+ private:
+  const size_t prefix_length_;
+  const std::string name_;
+};
+
+}  // namespace
+
+const SliceTransform* NewFixedPrefixTransform(size_t prefix_length) {
+  return new FixedPrefixTransform(prefix_length);
+}
+
+}  // namespace leveldb